@@ -168,11 +168,14 @@ ComputationNetworkPtr GetModelFromConfig(const ConfigRecordType& config, const w
     else // no NetworkBuilder given: load from 'modelPath'
     {
         wstring modelPath = config(L"modelPath");
+        // optionally use the parameters of the model file in place rather than reading them (CPU only), so that
+        // processes that evaluate the same model share its memory
+        bool memoryMapModel = config(L"memoryMapModel", false);
 
         // We don't use CreateFromFile() here since the user might specify OutputNodeNames in the config.
         // By not compiling the network before patching, we avoid double log output for validation.
         net = make_shared<ComputationNetwork>(deviceId);
-        net->Read<ElemType>(modelPath);
+        net->Read<ElemType>(modelPath, memoryMapModel);
         if (outputNodeNames.size() > 0)
             PatchOutputNodes(net, outputNodeNames, outputNodeNamesVector);
         net->CompileNetwork();
@@ -18,6 +18,7 @@
 #include "NDLNetworkBuilder.h"
 #include "ModelEditLanguage.h"
 #include "CPUMatrix.h" // used for SetNumThreads()
+#include "TensorOpsVectorized.h"
 #include "CommonMatrix.h"
 #include "SGD.h"
 #include "MPIWrapper.h"
@@ -168,6 +169,11 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
         LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
     }
 
+    SetVectorMathMode((string) config(L"vectorMathMode", "off"));
+    SetMaxVectorInstructionSet((string) config(L"vectorInstructionSet", "avx512"));
+    if (GetVectorInstructionSet() != VectorInstructionSet::None)
+        LOGPRINTF(stderr, "Using %s kernels for elementwise CPU tensor operations.\n", VectorInstructionSetName(GetVectorInstructionSet()));
+
     bool progressTracing = config(L"progressTracing", false);
 
     // temporary hack to prevent users from failing due to a small breaking change related to the "truncated" flag (will be redone bigger and better some day)
@@ -506,6 +512,11 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     if (numCPUThreads > 0)
         LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
 
+    SetVectorMathMode(msra::strfun::utf8(config(L"vectorMathMode", L"off")));
+    SetMaxVectorInstructionSet(msra::strfun::utf8(config(L"vectorInstructionSet", L"avx512")));
+    if (GetVectorInstructionSet() != VectorInstructionSet::None)
+        LOGPRINTF(stderr, "Using %s kernels for elementwise CPU tensor operations.\n", VectorInstructionSetName(GetVectorInstructionSet()));
+
     bool progressTracing = config(L"progressTracing", false);
     size_t fullTotalMaxEpochs = 1; // BUGBUG: BS does not allow me to read out the max epochs parameters, as that would instantiate and thus execute the objects
 
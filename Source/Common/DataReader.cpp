@@ -177,6 +177,58 @@ bool DataReader::SupportsDistributedMBRead() const
     return supportsDistributedMBRead;
 }
 
+//SupportsSamplePosition - Tells if all readers can report and restore the position of the next minibatch
+bool DataReader::SupportsSamplePosition() const
+{
+    bool supportsSamplePosition = true;
+    for (size_t i = 0; i < m_ioNames.size(); i++)
+    {
+        auto currReaderIter = m_dataReaders.find(m_ioNames[i]);
+        assert(currReaderIter != m_dataReaders.end());
+
+        supportsSamplePosition &= currReaderIter->second->SupportsSamplePosition();
+    }
+
+    return supportsSamplePosition;
+}
+
+//IsSamplePositionSharedByWorkers - Tells if all readers are at the same position on all workers
+bool DataReader::IsSamplePositionSharedByWorkers() const
+{
+    bool isShared = true;
+    for (size_t i = 0; i < m_ioNames.size(); i++)
+    {
+        auto currReaderIter = m_dataReaders.find(m_ioNames[i]);
+        assert(currReaderIter != m_dataReaders.end());
+
+        isShared &= currReaderIter->second->IsSamplePositionSharedByWorkers();
+    }
+
+    return isShared;
+}
+
+//GetCurrentSamplePosition - Get the position of the next minibatch, which all readers have to agree on
+size_t DataReader::GetCurrentSamplePosition()
+{
+    size_t position = SIZE_MAX;
+    for (size_t i = 0; i < m_ioNames.size(); i++)
+    {
+        size_t thisPosition = m_dataReaders[m_ioNames[i]]->GetCurrentSamplePosition();
+        if (position == SIZE_MAX)
+            position = thisPosition;
+        else if (thisPosition != position)
+            LogicError("GetCurrentSamplePosition: the readers are at different positions");
+    }
+    return position;
+}
+
+//SetCurrentSamplePosition - Move all readers to the given position in the current epoch
+void DataReader::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    for (size_t i = 0; i < m_ioNames.size(); i++)
+        m_dataReaders[m_ioNames[i]]->SetCurrentSamplePosition(currentSamplePosition);
+}
+
 //StartDistributedMinibatchLoop - Startup a distributed minibatch loop for parallel training
 // mbSize - [in] size of the minibatch (number of frames, etc.)
 // epoch - [in] epoch number for this loop
@@ -159,6 +159,29 @@ public:
         return StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
     }
 
+    // Tells if the reader can report and restore the position of the next minibatch inside of an epoch,
+    // which allows resuming training from a checkpoint taken in the middle of an epoch.
+    virtual bool SupportsSamplePosition() const
+    {
+        return false;
+    }
+    // Tells if all workers of a distributed read are at the same position, so that the position of one of them can be
+    // used to resume all of them. Not so e.g. with bucketing, where each worker reports its own oldest buffered sequence.
+    virtual bool IsSamplePositionSharedByWorkers() const
+    {
+        return true;
+    }
+    // Position of the next minibatch in samples, counted over all workers since the beginning of the first epoch.
+    virtual size_t GetCurrentSamplePosition()
+    {
+        NOT_IMPLEMENTED;
+    }
+    // Moves to a position returned by GetCurrentSamplePosition() for the current epoch; call after StartMinibatchLoop().
+    virtual void SetCurrentSamplePosition(size_t /*currentSamplePosition*/)
+    {
+        NOT_IMPLEMENTED;
+    }
+
     virtual bool GetMinibatch(StreamMinibatchInputs& matrices) = 0;
     virtual bool GetMinibatch4SE(std::vector<shared_ptr<const msra::dbn::latticepair>>& /*latticeinput*/, vector<size_t>& /*uids*/, vector<size_t>& /*boundaries*/, vector<size_t>& /*extrauttmap*/)
     {
@@ -329,6 +352,11 @@ public:
     virtual bool SupportsDistributedMBRead() const override;
     virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
 
+    virtual bool SupportsSamplePosition() const override;
+    virtual bool IsSamplePositionSharedByWorkers() const override;
+    virtual size_t GetCurrentSamplePosition() override;
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
     // GetMinibatch - Get the next minibatch (features and labels)
     // matrices - [in] a map with named matrix types (i.e. 'features', 'labels') mapped to the corresponding matrix,
     //             [out] each matrix resized if necessary containing data.
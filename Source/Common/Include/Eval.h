@@ -26,6 +26,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <algorithm>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -293,6 +294,57 @@ class VariableSchema : public std::vector<VariableLayout>
         }
 };
 
+//
+// Latency distribution of requests, with buckets of exponentially growing width.
+//
+struct LatencyHistogram
+{
+    // m_counts[k] is the number of requests that took less than 2^k microseconds, and at least 2^(k-1) for k > 0.
+    // The last bucket also holds everything slower.
+    std::vector<size_t> m_counts;
+    size_t m_numRequests;
+    double m_totalMicroseconds;
+    double m_maxMicroseconds;
+
+    LatencyHistogram() : m_counts(32, 0), m_numRequests(0), m_totalMicroseconds(0), m_maxMicroseconds(0) {}
+
+    void Add(double microseconds)
+    {
+        size_t k = 0;
+        while (k + 1 < m_counts.size() && microseconds >= (double) (1ull << k))
+            k++;
+        m_counts[k]++;
+        m_numRequests++;
+        m_totalMicroseconds += microseconds;
+        if (microseconds > m_maxMicroseconds)
+            m_maxMicroseconds = microseconds;
+    }
+
+    double MeanMicroseconds() const { return m_numRequests > 0 ? m_totalMicroseconds / m_numRequests : 0; }
+
+    // upper bound of the latency of the fastest 'fraction' (e.g. 0.99) of the requests, at the resolution of the buckets
+    double PercentileMicroseconds(double fraction) const
+    {
+        size_t count = 0;
+        for (size_t k = 0; k < m_counts.size(); k++)
+        {
+            count += m_counts[k];
+            if (count > 0 && count >= fraction * m_numRequests)
+                return k + 1 < m_counts.size() ? std::min((double) (1ull << k), m_maxMicroseconds) : m_maxMicroseconds;
+        }
+        return 0;
+    }
+};
+
+struct RequestStatistics
+{
+    LatencyHistogram m_latency;      // from the ForwardPass() call until its outputs are available
+    LatencyHistogram m_queueLatency; // from the ForwardPass() call until the evaluation of its batch starts
+    size_t m_numBatches;             // number of network evaluations the requests were combined into
+
+    RequestStatistics() : m_numBatches(0) {}
+};
+
 //
 // Extended interface, allowing for sparse input.
 // Implementation constraints: 
@@ -329,7 +381,10 @@ public:
     // The layout and shape of the data in inputs vector must match the schema returned by GetInputLayouts.
     // Output must be preallocated and sized to avoid memory allocation / deallocation across DLL
     // boundaries.
-    // This method is not reentrant, as the forward pass keeps internal state.
+    // This method may be called from multiple threads at the same time; up to 'numConcurrentForwardPasses' (a config
+    // parameter, default 1) calls run in parallel, further ones wait.
+    // With the config parameter 'maxBatchedRequests' > 1, concurrent calls are combined into one minibatch of up to that
+    // many requests, each as a separate sequence; a call waits at most 'maxBatchingDelayMs' (default 1) for others to join.
     // inputs - vector of input buffers, one for every input as given by GetInputLayouts()
     // outputs - vector of output buffers. Must be sized to fit output schema.
     //
@@ -340,6 +395,12 @@ public:
     // (e.g. when vectors are manages by .net)
     // 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output) = 0;
+
+    //
+    // GetRequestStatistics - latencies of all ForwardPass() calls since StartForwardEvaluation(), and how many network
+    // evaluations they were batched into.
+    //
+    virtual RequestStatistics GetRequestStatistics() const = 0;
 };
 
 template <typename ElemType>
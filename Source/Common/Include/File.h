@@ -99,6 +99,8 @@ private:
     bool m_pcloseNeeded; // was opened with popen(), use pclose() when destructing
     bool m_seekable;     // this stream is seekable
     int m_options;       // FileOptions ored togther
+    const char* m_mappedData; // optional memory mapping of the whole file, see SetMappedView()
+    size_t m_mappedSize;
     void Init(const wchar_t* filename, int fileOptions);
 
 public:
@@ -110,6 +112,19 @@ public:
     void Flush();
 
     bool CanSeek() const { return m_seekable; }
+
+    // A caller that has mapped this file into memory can make the mapping known here, so that readers of large
+    // arrays can use them in place instead of reading a copy (see ComputationNode::LoadValuePageAligned()).
+    // The File does not own the mapping; it must outlive the File and anything that uses the mapped data.
+    void SetMappedView(const char* data, size_t size) { m_mappedData = data; m_mappedSize = size; }
+    // returns the mapped bytes [pos, pos + size), or nullptr if the file is not mapped
+    const char* GetMappedView(uint64_t pos, size_t size) const
+    {
+        if (!m_mappedData || pos > m_mappedSize || size > m_mappedSize - pos)
+            return nullptr;
+        return m_mappedData + pos;
+    }
+
     size_t Size();
     uint64_t GetPosition();
     void SetPosition(uint64_t pos);
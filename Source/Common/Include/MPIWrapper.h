@@ -19,6 +19,8 @@
 #include <array>
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <cstring>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -61,6 +63,15 @@ static int operator||(int rc, const MpiFail &what)
 class MPIWrapper;
 typedef std::shared_ptr<MPIWrapper> MPIWrapperPtr;
 
+// algorithm used by MPIWrapper::AllReduce()
+enum class AllReduceAlgorithm
+{
+    MPI,          // MPI_Allreduce() of the installed MPI
+    Ring,         // bandwidth-optimal ring: reduce-scatter and all-gather in 2 (N-1) steps that each send 1/N of the data
+    Hierarchical, // reduce-scatter within each machine through shared memory, ring all-reduce across machines, then all-gather through shared memory
+    Auto          // MPI below a message size threshold; above, Hierarchical if there are several ranks on each of several machines, else Ring
+};
+
 class MPIWrapper : public std::enable_shared_from_this<MPIWrapper>
 {
     int m_myRank;
@@ -70,6 +81,19 @@ class MPIWrapper : public std::enable_shared_from_this<MPIWrapper>
     // MPI communicator that reflects the current subset selection
     MPI_Comm m_currentComm;
 
+    // built-in all-reduce algorithms
+    AllReduceAlgorithm m_allReduceAlgorithm;
+    size_t m_allReduceAutoThresholdInBytes;
+    MPI_Comm m_allReduceComm;  // duplicate of m_currentComm, so that the point-to-point messages can never be confused with others
+    MPI_Comm m_nodeComm;       // ranks on the same machine (Hierarchical)
+    MPI_Comm m_crossNodeComm;  // ranks with the same rank within their machine (Hierarchical)
+    int m_numMachines;         // number of distinct m_nodeComm's
+    bool m_isHierarchyUniform; // all machines have the same number of ranks
+    MPI_Win m_sharedWindow;    // shared memory of the ranks in m_nodeComm
+    char *m_sharedBuffer;
+    size_t m_sharedBufferSize;
+    std::vector<char> m_allReduceRecvBuffer;
+
     static MPIWrapperPtr s_mpi;
 
     // MPI_Init() with delay-loading the msmpi.dll (possibly causing a failure if missing; we want to catch that)
@@ -119,7 +143,9 @@ class MPIWrapper : public std::enable_shared_from_this<MPIWrapper>
 
 public:
     MPIWrapper()
-        : m_currentComm(MPI_COMM_WORLD)
+        : m_currentComm(MPI_COMM_WORLD), m_allReduceAlgorithm(AllReduceAlgorithm::MPI), m_allReduceAutoThresholdInBytes(0),
+          m_allReduceComm(MPI_COMM_NULL), m_nodeComm(MPI_COMM_NULL), m_crossNodeComm(MPI_COMM_NULL), m_numMachines(0), m_isHierarchyUniform(false),
+          m_sharedWindow(MPI_WIN_NULL), m_sharedBuffer(nullptr), m_sharedBufferSize(0)
     {
         static bool initialized = false;
         if (initialized)
@@ -169,7 +195,15 @@ public:
         // Do not finalize in event of an exception since calling MPI_Finalize without
         // all pending communications being finished results in a hang
         if (!std::uncaught_exception())
+        {
+            if (m_sharedWindow != MPI_WIN_NULL)
+                MPI_Win_free(&m_sharedWindow);
+            // the communicators of SetAllReduceAlgorithm() (all ranks create them, so all ranks get here with them)
+            for (MPI_Comm* comm : { &m_crossNodeComm, &m_nodeComm, &m_allReduceComm })
+                if (*comm != MPI_COMM_NULL)
+                    MPI_Comm_free(comm);
             MPI_Finalize();
+        }
     }
 
 private:
@@ -258,6 +292,27 @@ public:
         s_mpi = nullptr;
     }
 
+    // Set aside the last 'numRanks' ranks for a different role, e.g. as parameter servers.
+    // Afterwards, Communicator() and NumNodesInUse() only cover the remaining ranks, while the ranks set aside are idle
+    // (their Communicator() is MPI_COMM_NULL); they can still communicate through MPI_COMM_WORLD.
+    // This must be called by all ranks, with the same argument.
+    void SetAsideRanks(size_t numRanks)
+    {
+        if (numRanks < (size_t) m_numMPINodes && m_numNodesInUse == m_numMPINodes - numRanks)
+            return; // already done
+        if (m_numNodesInUse != (size_t) m_numMPINodes)
+            LogicError("SetAsideRanks: Ranks can only be set aside once.");
+        if (numRanks >= (size_t) m_numMPINodes)
+            InvalidArgument("SetAsideRanks: Cannot set aside %d of %d ranks.", (int) numRanks, (int) m_numMPINodes);
+
+        size_t numRemaining = m_numMPINodes - numRanks;
+        MPI_Comm_split(MPI_COMM_WORLD, (size_t) m_myRank < numRemaining ? 0 : MPI_UNDEFINED, m_myRank, &m_currentComm) || MpiFail("SetAsideRanks: MPI_Comm_split");
+        m_numNodesInUse = numRemaining;
+        fprintf(stderr, "SetAsideRanks: using %d out of %d MPI nodes; we (%d) are %s\n",
+                (int) m_numNodesInUse, (int) m_numMPINodes, (int) CurrentNodeRank(), IsIdle() ? "set aside" : "in (participating)");
+        fflush(stderr);
+    }
+
     MPI_Comm Communicator() const
     {
         return m_currentComm;
@@ -328,15 +383,197 @@ public:
     }
 
     // for raw pointer
+    // This uses the algorithm selected by SetAllReduceAlgorithm().
     template <class ElemType>
     void AllReduce(ElemType *pData, size_t nData)
     {
         if ((NumNodesInUse() > 1 && (Communicator() != MPI_COMM_NULL)))
         {
-            MPI_Allreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
+            switch (SelectAllReduceAlgorithm(nData * sizeof(ElemType)))
+            {
+            case AllReduceAlgorithm::Ring:
+                RingAllReduce(pData, nData, m_allReduceComm);
+                break;
+            case AllReduceAlgorithm::Hierarchical:
+                HierarchicalAllReduce(pData, nData);
+                break;
+            default:
+                MPI_Allreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
+            }
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // built-in all-reduce algorithms
+    // -----------------------------------------------------------------------
+
+    static AllReduceAlgorithm ParseAllReduceAlgorithm(const std::wstring &s)
+    {
+        if (s == L"mpi")
+            return AllReduceAlgorithm::MPI;
+        else if (s == L"ring")
+            return AllReduceAlgorithm::Ring;
+        else if (s == L"hierarchical")
+            return AllReduceAlgorithm::Hierarchical;
+        else if (s == L"auto")
+            return AllReduceAlgorithm::Auto;
+        InvalidArgument("ParseAllReduceAlgorithm: Invalid all-reduce algorithm '%ls'; must be 'mpi', 'ring', 'hierarchical', or 'auto'.", s.c_str());
+    }
+
+    // Select the algorithm used by AllReduce(pData, nData). With Auto, messages smaller than 'autoThresholdInBytes' go to MPI_Allreduce(),
+    // whose latency is usually better for small data.
+    // For testing the hierarchical algorithm on a single machine, 'numRanksPerNode' can split the ranks of a machine into groups that are treated
+    // like separate machines (0: group by shared-memory domain).
+    // This must be called by all ranks with the same arguments.
+    void SetAllReduceAlgorithm(AllReduceAlgorithm algorithm, size_t autoThresholdInBytes = 64 * 1024, size_t numRanksPerNode = 0)
+    {
+        m_allReduceAlgorithm = algorithm;
+        m_allReduceAutoThresholdInBytes = autoThresholdInBytes;
+        if (algorithm == AllReduceAlgorithm::MPI || m_allReduceComm != MPI_COMM_NULL || Communicator() == MPI_COMM_NULL)
+            return;
+
+        MPI_Comm_dup(Communicator(), &m_allReduceComm) || MpiFail("SetAllReduceAlgorithm: MPI_Comm_dup");
+
+        // the ranks of each machine, and across machines the ranks with the same local rank
+        int rank, localRank, localSize;
+        MPI_Comm_rank(m_allReduceComm, &rank);
+        MPI_Comm_split_type(m_allReduceComm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &m_nodeComm) || MpiFail("SetAllReduceAlgorithm: MPI_Comm_split_type");
+        if (numRanksPerNode > 0)
+        {
+            MPI_Comm sharedMemoryComm = m_nodeComm;
+            MPI_Comm_rank(sharedMemoryComm, &localRank);
+            MPI_Comm_split(sharedMemoryComm, localRank / (int) numRanksPerNode, rank, &m_nodeComm) || MpiFail("SetAllReduceAlgorithm: MPI_Comm_split");
+            MPI_Comm_free(&sharedMemoryComm);
+        }
+        MPI_Comm_rank(m_nodeComm, &localRank);
+        MPI_Comm_size(m_nodeComm, &localSize);
+        MPI_Comm_split(m_allReduceComm, localRank, rank, &m_crossNodeComm) || MpiFail("SetAllReduceAlgorithm: MPI_Comm_split");
+
+        // the hierarchical algorithm requires the same number of ranks on each machine
+        int minMaxLocalSize[2] = { -localSize, localSize };
+        MPI_Allreduce(MPI_IN_PLACE, minMaxLocalSize, 2, MPI_INT, MPI_MAX, m_allReduceComm) || MpiFail("SetAllReduceAlgorithm: MPI_Allreduce");
+        m_isHierarchyUniform = (-minMaxLocalSize[0] == minMaxLocalSize[1]);
+        m_numMachines = (localRank == 0);
+        MPI_Allreduce(MPI_IN_PLACE, &m_numMachines, 1, MPI_INT, MPI_SUM, m_allReduceComm) || MpiFail("SetAllReduceAlgorithm: MPI_Allreduce");
+
+        fprintf(stderr, "SetAllReduceAlgorithm: %d ranks on %d machines%s\n", (int) NumNodesInUse(), m_numMachines,
+                m_isHierarchyUniform ? "" : " (differing numbers of ranks per machine; hierarchical all-reduce will fall back to ring)");
+    }
+
+    AllReduceAlgorithm SelectAllReduceAlgorithm(size_t numBytes) const
+    {
+        // the built-in algorithms cannot deal with idle ranks
+        if (m_allReduceAlgorithm == AllReduceAlgorithm::MPI || !UsingAllNodes())
+            return AllReduceAlgorithm::MPI;
+
+        bool useHierarchy = m_isHierarchyUniform && m_numMachines > 1 && (int) NumNodesInUse() > m_numMachines;
+
+        switch (m_allReduceAlgorithm)
+        {
+        case AllReduceAlgorithm::Hierarchical:
+            return m_isHierarchyUniform ? AllReduceAlgorithm::Hierarchical : AllReduceAlgorithm::Ring;
+        case AllReduceAlgorithm::Auto:
+            if (numBytes < m_allReduceAutoThresholdInBytes)
+                return AllReduceAlgorithm::MPI;
+            return useHierarchy ? AllReduceAlgorithm::Hierarchical : AllReduceAlgorithm::Ring;
+        default:
+            return m_allReduceAlgorithm;
         }
     }
 
+private:
+    // Ring all-reduce (sum) of 'data' among the ranks of 'comm', using point-to-point messages only.
+    // The data is split into N chunks. In N-1 reduce-scatter steps, each rank sends one chunk to its right neighbor and adds the one received
+    // from its left neighbor, after which every rank holds one fully reduced chunk. In N-1 all-gather steps, these are passed around the ring.
+    // Each chunk is summed up in the same order on all ranks, so all get bit-identical results.
+    template <class ElemType>
+    void RingAllReduce(ElemType *data, size_t numElements, MPI_Comm comm)
+    {
+        int rank, numRanks;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &numRanks);
+        if (numRanks == 1)
+            return;
+
+        auto chunkBegin = [&](int chunk) { return numElements * chunk / numRanks; };
+        auto chunkSize = [&](int chunk) { return chunkBegin(chunk + 1) - chunkBegin(chunk); };
+        int right = (rank + 1) % numRanks;
+        int left = (rank + numRanks - 1) % numRanks;
+
+        m_allReduceRecvBuffer.resize(chunkSize(numRanks - 1) * sizeof(ElemType)); // (the last chunk is the largest)
+        ElemType *recvBuffer = (ElemType *) m_allReduceRecvBuffer.data();
+        for (int step = 0; step < numRanks - 1; step++)
+        {
+            int sendChunk = (rank - step + numRanks) % numRanks;
+            int recvChunk = (rank - step - 1 + numRanks) % numRanks;
+            MPI_Sendrecv(data + chunkBegin(sendChunk), (int) chunkSize(sendChunk), GetDataType(data), right, 0,
+                         recvBuffer, (int) chunkSize(recvChunk), GetDataType(data), left, 0, comm, MPI_STATUS_IGNORE) || MpiFail("RingAllReduce: MPI_Sendrecv");
+            ElemType *target = data + chunkBegin(recvChunk);
+            for (size_t i = 0; i < chunkSize(recvChunk); i++)
+                target[i] += recvBuffer[i];
+        }
+
+        for (int step = 0; step < numRanks - 1; step++)
+        {
+            int sendChunk = (rank - step + 1 + numRanks) % numRanks;
+            int recvChunk = (rank - step + numRanks) % numRanks;
+            MPI_Sendrecv(data + chunkBegin(sendChunk), (int) chunkSize(sendChunk), GetDataType(data), right, 0,
+                         data + chunkBegin(recvChunk), (int) chunkSize(recvChunk), GetDataType(data), left, 0, comm, MPI_STATUS_IGNORE) || MpiFail("RingAllReduce: MPI_Sendrecv");
+        }
+    }
+
+    // Hierarchical all-reduce: the ranks of each machine copy their data into shared memory, and each reduces one chunk of it.
+    // The reduced chunks are all-reduced by a ring across machines (among the ranks with the same local rank),
+    // and written back to shared memory for all ranks of the machine to copy out.
+    template <class ElemType>
+    void HierarchicalAllReduce(ElemType *data, size_t numElements)
+    {
+        if (numElements == 0)
+            return;
+
+        int localRank, localSize;
+        MPI_Comm_rank(m_nodeComm, &localRank);
+        MPI_Comm_size(m_nodeComm, &localSize);
+
+        // one segment per local rank; local rank 0 allocates the shared memory for all
+        size_t numBytes = numElements * sizeof(ElemType);
+        if (m_sharedBufferSize < numBytes * localSize)
+        {
+            if (m_sharedWindow != MPI_WIN_NULL)
+                MPI_Win_free(&m_sharedWindow) || MpiFail("HierarchicalAllReduce: MPI_Win_free");
+            m_sharedBufferSize = numBytes * localSize;
+            MPI_Win_allocate_shared(localRank == 0 ? m_sharedBufferSize : 0, 1, MPI_INFO_NULL, m_nodeComm, &m_sharedBuffer, &m_sharedWindow) || MpiFail("HierarchicalAllReduce: MPI_Win_allocate_shared");
+            MPI_Aint size;
+            int dispUnit;
+            MPI_Win_shared_query(m_sharedWindow, 0, &size, &dispUnit, &m_sharedBuffer) || MpiFail("HierarchicalAllReduce: MPI_Win_shared_query");
+        }
+        auto segment = [&](int r) { return (ElemType *) m_sharedBuffer + numElements * r; };
+
+        memcpy(segment(localRank), data, numBytes);
+        MPI_Win_fence(0, m_sharedWindow) || MpiFail("HierarchicalAllReduce: MPI_Win_fence");
+
+        // reduce our chunk across the segments of all local ranks, into segment 0
+        size_t begin = numElements * localRank / localSize;
+        size_t end = numElements * (localRank + 1) / localSize;
+        ElemType *chunk = segment(0) + begin;
+        for (int r = 1; r < localSize; r++)
+        {
+            const ElemType *other = segment(r) + begin;
+            for (size_t i = 0; i < end - begin; i++)
+                chunk[i] += other[i];
+        }
+
+        // all-reduce the chunk across machines
+        RingAllReduce(chunk, end - begin, m_crossNodeComm);
+
+        MPI_Win_fence(0, m_sharedWindow) || MpiFail("HierarchicalAllReduce: MPI_Win_fence");
+        memcpy(data, segment(0), numBytes);
+        // nobody may overwrite the shared memory before everyone has its copy
+        MPI_Win_fence(0, m_sharedWindow) || MpiFail("HierarchicalAllReduce: MPI_Win_fence");
+    }
+
+public:
+
     template <class ElemType>
     void Bcast(ElemType *pData, size_t nData, size_t srcRank)
     {
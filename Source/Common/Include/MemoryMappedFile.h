@@ -0,0 +1,144 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MemoryMappedFile.h -- read-only or copy-on-write memory mapping of a whole file
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <string>
+#include <algorithm>
+#include <cerrno>
+#ifndef _WIN32 // (Windows.h is included by Basics.h)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Maps a whole file into the address space of the process.
+// By default the mapping is read-only. With 'copyOnWrite', the pages may also be written to; a written page becomes
+// a private copy of this process, and the file and other processes mapping it are not affected. Pages that are
+// only read are shared with all processes that map the same file.
+// The mapping is released in the destructor; pointers obtained from Data() must not outlive this object.
+// An empty file results in Data() == nullptr and Size() == 0.
+class MemoryMappedFile
+{
+public:
+    explicit MemoryMappedFile(const std::wstring& path, bool copyOnWrite = false)
+        : m_path(path), m_data(nullptr), m_size(0)
+    {
+#ifdef _WIN32
+        m_fileHandle = INVALID_HANDLE_VALUE;
+        m_mappingHandle = NULL;
+        m_fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_fileHandle == INVALID_HANDLE_VALUE)
+            RuntimeError("MemoryMappedFile: Cannot open '%ls' (error %d).", path.c_str(), (int) GetLastError());
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_fileHandle, &size))
+        {
+            Close();
+            RuntimeError("MemoryMappedFile: Cannot determine the size of '%ls' (error %d).", path.c_str(), (int) GetLastError());
+        }
+        m_size = (size_t) size.QuadPart;
+        if (m_size == 0)
+            return;
+        m_mappingHandle = CreateFileMappingW(m_fileHandle, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+        if (m_mappingHandle != NULL)
+            m_data = (const char*) MapViewOfFile(m_mappingHandle, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+        if (m_data == nullptr)
+        {
+            int error = (int) GetLastError();
+            Close();
+            RuntimeError("MemoryMappedFile: Cannot map '%ls' (error %d).", path.c_str(), error);
+        }
+#else
+        m_fd = open(wtocharpath(path.c_str()).c_str(), O_RDONLY);
+        if (m_fd < 0)
+            RuntimeError("MemoryMappedFile: Cannot open '%ls' (errno %d).", path.c_str(), errno);
+        struct stat buf;
+        if (fstat(m_fd, &buf) != 0)
+        {
+            int error = errno;
+            Close();
+            RuntimeError("MemoryMappedFile: Cannot determine the size of '%ls' (errno %d).", path.c_str(), error);
+        }
+        m_size = (size_t) buf.st_size;
+        if (m_size == 0)
+            return;
+        void* data = mmap(nullptr, m_size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (data == MAP_FAILED)
+        {
+            int error = errno;
+            Close();
+            RuntimeError("MemoryMappedFile: Cannot map '%ls' (errno %d).", path.c_str(), error);
+        }
+        m_data = (const char*) data;
+#endif
+    }
+
+    ~MemoryMappedFile()
+    {
+        Close();
+    }
+
+    const char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+    const std::wstring& Path() const { return m_path; }
+
+    // Hints the OS that the given byte range will be accessed soon (no-op where not supported).
+    void WillNeed(size_t offset, size_t size) const
+    {
+#ifndef _WIN32
+        if (m_data == nullptr || offset >= m_size)
+            return;
+        // madvise() requires a page-aligned start address
+        const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+        size_t alignedOffset = offset - offset % pageSize;
+        size = std::min(size + (offset - alignedOffset), m_size - alignedOffset);
+        madvise((void*) (m_data + alignedOffset), size, MADV_WILLNEED);
+#else
+        offset; size;
+#endif
+    }
+
+private:
+    void Close()
+    {
+#ifdef _WIN32
+        if (m_data)
+            UnmapViewOfFile(m_data);
+        if (m_mappingHandle != NULL)
+            CloseHandle(m_mappingHandle);
+        if (m_fileHandle != INVALID_HANDLE_VALUE)
+            CloseHandle(m_fileHandle);
+        m_mappingHandle = NULL;
+        m_fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (m_data)
+            munmap((void*) m_data, m_size);
+        if (m_fd >= 0)
+            close(m_fd);
+        m_fd = -1;
+#endif
+        m_data = nullptr;
+    }
+
+    std::wstring m_path;
+    const char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    HANDLE m_fileHandle;
+    HANDLE m_mappingHandle;
+#else
+    int m_fd;
+#endif
+
+    DISABLE_COPY_AND_MOVE(MemoryMappedFile);
+};
+
+}}}
@@ -19,6 +19,7 @@
 #include "EvaluationNodes.h"
 #include "SpecialPurposeNodes.h"
 #include "MPIWrapper.h" // TODO: does not belong here
+#include "MemoryMappedFile.h"
 #include <string>
 #include <vector>
 #include <stack>
@@ -34,15 +35,27 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 
 template <>
-vector<shared_ptr<Matrix<float>>>& MatrixPool::GetReleasedMatrices<float>()
+vector<MatrixPool::MemRequestInfo<float>>& MatrixPool::GetMemRequests<float>()
 {
-    return m_releasedFloatMatrices;
+    return m_floatRequests;
 }
 
 template <>
-vector<shared_ptr<Matrix<double>>>& MatrixPool::GetReleasedMatrices<double>()
+vector<MatrixPool::MemRequestInfo<double>>& MatrixPool::GetMemRequests<double>()
 {
-    return m_releasedDoubleMatrices;
+    return m_doubleRequests;
+}
+
+template <>
+vector<MatrixPool::BufferUsageInfo<float>>& MatrixPool::GetBuffers<float>()
+{
+    return m_floatBuffers;
+}
+
+template <>
+vector<MatrixPool::BufferUsageInfo<double>>& MatrixPool::GetBuffers<double>()
+{
+    return m_doubleBuffers;
 }
 
 // -----------------------------------------------------------------------
@@ -75,6 +88,12 @@ void ComputationNetwork::ClearNetwork()
 
     m_nameToNodeMap.clear();
 
+    for (auto& iter : m_nodesReplacedByFusedNode)
+        for (auto& node : iter.second)
+            if (node->GetEnvironmentPtr() == m_environment)
+                node->DetachInputs();
+    m_nodesReplacedByFusedNode.clear();
+
     m_pMBLayoutOfNetwork->Init(1, 0);
 }
 
@@ -100,6 +119,40 @@ void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFor
     renameOrDie(tmpFileName, fileName);
 }
 
+// Parameters and the minibatch count of batch normalization are the only saved content that changes while training,
+// so these nodes are copied. The other nodes are only referenced, not taken over, so they keep their environment,
+// and ClearNetwork() leaves them alone.
+template <class ElemType>
+ComputationNetworkPtr ComputationNetwork::CreateSnapshotForSaving() const
+{
+    VerifyIsCompiled("CreateSnapshotForSaving");
+    auto snapshot = make_shared<ComputationNetwork>(CPUDEVICE);
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        if (node->Is<LearnableParameter<ElemType>>())
+        {
+            ComputationNodeBasePtr copy = make_shared<LearnableParameter<ElemType>>(CPUDEVICE, node->NodeName(), node->GetSampleLayout());
+            copy->SetLearningRateMultiplier(node->GetLearningRateMultiplier());
+            copy->As<LearnableParameter<ElemType>>()->Value().AssignValuesOf(node->As<LearnableParameter<ElemType>>()->Value());
+            snapshot->AddNodeToNet(copy);
+        }
+        else if (node->Is<BatchNormalizationNode<ElemType>>())
+            snapshot->AddNodeToNet(node->As<BatchNormalizationNode<ElemType>>()->CreateSnapshotForSaving());
+        else
+            snapshot->m_nameToNodeMap.insert(iter);
+    }
+    // (the groups are saved by node name only)
+    snapshot->m_featureNodes    = m_featureNodes;
+    snapshot->m_labelNodes      = m_labelNodes;
+    snapshot->m_criterionNodes  = m_criterionNodes;
+    snapshot->m_evaluationNodes = m_evaluationNodes;
+    snapshot->m_outputNodes     = m_outputNodes;
+    snapshot->m_nodesReplacedByFusedNode = m_nodesReplacedByFusedNode;
+    snapshot->m_isCompiled = true; // only good for Save(), which just walks m_nameToNodeMap and the node groups
+    return snapshot;
+}
+
 // TODO: how does the file distinguish float vs double nodes?
 void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat) const
 {
@@ -111,13 +164,23 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
     fstream << (size_t) CURRENT_CNTK_MODEL_VERSION;
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
 
-    fstream << (size_t) m_nameToNodeMap.size();
+    // fused nodes are saved in their original form (see FuseLSTMs())
+    vector<ComputationNodeBasePtr> nodesToSave;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        auto replaced = m_nodesReplacedByFusedNode.find(iter.second);
+        if (replaced != m_nodesReplacedByFusedNode.end())
+            nodesToSave.insert(nodesToSave.end(), replaced->second.begin(), replaced->second.end());
+        else
+            nodesToSave.push_back(iter.second);
+    }
+
+    fstream << (size_t) nodesToSave.size();
 
     // put all node info first
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BNodeList");
-    for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
+    for (const auto& nodePtr : nodesToSave)
     {
-        ComputationNodeBasePtr nodePtr = nodeIter->second;
         // type
 #if CURRENT_CNTK_MODEL_VERSION >= CNTK_MODEL_VERSION_7
         wstring precision;
@@ -139,9 +202,8 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
 
     // put relationship
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BRelation");
-    for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
+    for (const auto& nodePtr : nodesToSave)
     {
-        ComputationNodeBasePtr nodePtr = nodeIter->second;
         fstream << nodePtr->NodeName() << nodePtr->GetNumInputs();
         for (size_t i = 0; i < nodePtr->GetNumInputs(); i++)
         {
@@ -213,6 +275,15 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
     size_t numNodes;
     fstream >> numNodes;
 
+    // when reloading, the file holds fused nodes in their original form (see SaveToFileImpl()), which we reload in place of them
+    map<wstring, ComputationNodeBasePtr, nocase_compare> nodesReplacedByFusedNodes;
+    if (!create)
+    {
+        for (const auto& iter : m_nodesReplacedByFusedNode)
+            for (const auto& node : iter.second)
+                nodesReplacedByFusedNodes[node->NodeName()] = node;
+    }
+
     // get all node info first
     fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BNodeList");
     for (size_t i = 0; i < numNodes; i++)
@@ -226,7 +297,10 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
 
         ComputationNodeBasePtr node;
         if (!create) // reloading existing
-            node = GetNodeFromName(nodeName);
+        {
+            auto replaced = nodesReplacedByFusedNodes.find(nodeName);
+            node = replaced != nodesReplacedByFusedNodes.end() ? replaced->second : GetNodeFromName(nodeName);
+        }
         else if (precision == L"float")
             node = ComputationNetworkBuilder<float>::NewNode(opName, m_deviceId, nodeName);
         else if (precision == L"double")
@@ -260,11 +334,16 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
 // deserialize the model
 // This does not post-process the model (CompileNetwork()). Use Load() instead.
 template <class ElemType> // for ReadPersistableParameters()
-void ComputationNetwork::Read(const wstring& fileName)
+void ComputationNetwork::Read(const wstring& fileName, bool mapParameters)
 {
     ClearNetwork();
 
     File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    // Copy-on-write, so that code that modifies a parameter in place (e.g. when folding or quantizing a model) gets a
+    // private copy of the touched pages rather than a crash or a modified model file.
+    m_mappedModel = mapParameters ? make_shared<MemoryMappedFile>(fileName, /*copyOnWrite=*/true) : nullptr;
+    if (m_mappedModel)
+        fstream.SetMappedView(m_mappedModel->Data(), m_mappedModel->Size());
 
     ReadPersistableParameters<ElemType>(fstream, true);
 
@@ -470,7 +549,7 @@ void ComputationNetwork::CollectInputAndLearnableParameters(const ComputationNod
 
 void ComputationNetwork::CollectInputAndLearnableParametersRec(const ComputationNodeBasePtr& node, set<ComputationNodeBasePtr>& visited, list<ComputationNodeBasePtr>& inputs, list<ComputationNodeBasePtr>& learnableParameters)
 {
-    if (visited.find(node) != visited.end())    // allready got this one
+    if (!visited.insert(node).second)    // allready got this one (leaves included, since a parameter may have several consumers)
         return;
     else if (node->OperationName() == OperationNameOf(InputValue) || node->OperationName() == OperationNameOf(SparseInputValue))
         inputs.push_back(node);
@@ -483,7 +562,6 @@ void ComputationNetwork::CollectInputAndLearnableParametersRec(const Computation
         if (pcnode && pcnode->HasComputed())
             return;
         // recurse
-        visited.insert(node);
         for (const auto & input : node->GetInputs())
             CollectInputAndLearnableParametersRec(input, visited, inputs, learnableParameters);
     }
@@ -604,6 +682,71 @@ void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
     }
 }
 
+template <class ElemType>
+void ComputationNetwork::SetQuantizedTimes(bool quantized)
+{
+    size_t numNodes = 0, numQuantized = 0;
+    for (auto& node : GetAllNodes())
+    {
+        if (node->GetNumInputs() != 2 || node->GetInputs()[0]->OperationName() != OperationNameOf(LearnableParameter))
+            continue;
+        bool isQuantized;
+        if (auto timesNode = dynamic_pointer_cast<TimesNode<ElemType>>(node))
+            isQuantized = timesNode->SetQuantized(quantized);
+        else if (auto transposeTimesNode = dynamic_pointer_cast<TransposeTimesNode<ElemType>>(node))
+            isQuantized = transposeTimesNode->SetQuantized(quantized);
+        else
+            continue;
+        numNodes++;
+        if (isQuantized)
+            numQuantized++;
+    }
+    if (quantized)
+        fprintf(stderr, "SetQuantizedTimes: %d out of %d Times operations with parameter weights use the quantized product.\n", (int) numQuantized, (int) numNodes);
+}
+
+// a view of elements [offset, offset + numRows * numCols) of an arena, holding the values of 'matrix' if it has that shape
+template <class ElemType>
+static Matrix<ElemType> ArenaViewOf(const Matrix<ElemType>& matrix, const Matrix<ElemType>& arena, size_t offset, size_t numRows, size_t numCols)
+{
+    Matrix<ElemType> view = arena.ColumnSlice(offset, numRows * numCols);
+    view.Reshape(numRows, numCols);
+    if (matrix.GetMatrixType() == DENSE && matrix.GetNumRows() == numRows && matrix.GetNumCols() == numCols && !matrix.IsEmpty())
+        view.SetValue(matrix);
+    return view;
+}
+
+template <class ElemType>
+vector<size_t> ComputationNetwork::AllocateLearnableParametersContiguously(const vector<ComputationNodeBasePtr>& nodes, Matrix<ElemType>& valueArena, Matrix<ElemType>& gradientArena)
+{
+    vector<size_t> offsets;
+    size_t totalSize = 0;
+    for (const auto& node : nodes)
+    {
+        auto parameter = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+        if (!parameter || parameter->Value().GetMatrixType() != DENSE || parameter->Value().GetDeviceId() != CPUDEVICE)
+            InvalidArgument("AllocateLearnableParametersContiguously: %ls %ls operation is not a dense CPU parameter.", node->NodeName().c_str(), node->OperationName().c_str());
+        offsets.push_back(totalSize);
+        totalSize += parameter->Value().GetNumElements();
+    }
+
+    valueArena.Resize(1, totalSize);
+    gradientArena.Resize(1, totalSize);
+    gradientArena.SetValue(0);
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        auto parameter = dynamic_pointer_cast<ComputationNode<ElemType>>(nodes[i]);
+        size_t numRows = parameter->Value().GetNumRows();
+        size_t numCols = parameter->Value().GetNumCols();
+        parameter->Value() = ArenaViewOf(parameter->Value(), valueArena, offsets[i], numRows, numCols);
+        // The gradient may come from the matrix pool and be shared with the gradients of other nodes, which must not
+        // turn into views of the arena, so the parameter gets a matrix object of its own.
+        parameter->CreateGradientMatrixIfNull();
+        parameter->SetGradientMatrix(ArenaViewOf(parameter->Gradient(), gradientArena, offsets[i], numRows, numCols));
+    }
+    return offsets;
+}
+
 // -----------------------------------------------------------------------
 // unit test
 // -----------------------------------------------------------------------
@@ -1464,24 +1607,30 @@ void ComputationNetwork::SaveToDbnFile(ComputationNetworkPtr net, const std::wst
 }
 
 template void ComputationNetwork::InitLearnableParameters<float>(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const float initValueScale, bool initOnCPUOnly);
-template void ComputationNetwork::Read<float>(const wstring& fileName);
+template void ComputationNetwork::Read<float>(const wstring& fileName, bool mapParameters);
 template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template void ComputationNetwork::SetQuantizedTimes<float>(bool quantized);
+template vector<size_t> ComputationNetwork::AllocateLearnableParametersContiguously<float>(const vector<ComputationNodeBasePtr>& nodes, Matrix<float>& valueArena, Matrix<float>& gradientArena);
 template /*static*/ void ComputationNetwork::SetDropoutRate<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
 template void ComputationNetwork::SetSeqParam<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
                                                      const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
 template void ComputationNetwork::SaveToDbnFile<float>(ComputationNetworkPtr net, const std::wstring& fileName) const;
+template ComputationNetworkPtr ComputationNetwork::CreateSnapshotForSaving<float>() const;
 
 template void ComputationNetwork::InitLearnableParameters<double>(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const double initValueScale, bool initOnCPUOnly);
-template void ComputationNetwork::Read<double>(const wstring& fileName);
+template void ComputationNetwork::Read<double>(const wstring& fileName, bool mapParameters);
 template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template void ComputationNetwork::SetQuantizedTimes<double>(bool quantized);
+template vector<size_t> ComputationNetwork::AllocateLearnableParametersContiguously<double>(const vector<ComputationNodeBasePtr>& nodes, Matrix<double>& valueArena, Matrix<double>& gradientArena);
 template /*static*/ void ComputationNetwork::SetDropoutRate<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
 template void ComputationNetwork::SetSeqParam<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
                                                       const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
 template void ComputationNetwork::SaveToDbnFile<double>(ComputationNetworkPtr net, const std::wstring& fileName) const;
+template ComputationNetworkPtr ComputationNetwork::CreateSnapshotForSaving<double>() const;
 
 // register ComputationNetwork with the ScriptableObject system
 ScriptableObjects::ConfigurableRuntimeTypeRegister::Add<ComputationNetwork> registerComputationNetwork(L"ComputationNetwork");
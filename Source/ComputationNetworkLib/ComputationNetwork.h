@@ -29,9 +29,14 @@
 #include <chrono>
 #include <unordered_map>
 #include <set>
+#include <functional>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class ConcurrentNodeScheduler;
+class MemoryMappedFile;
+
 // ===========================================================================
 // ComputationNetwork -- computation graph and operations
 // ===========================================================================
@@ -100,24 +105,32 @@ public:
     }
     // design BUGBUG: binary files do not know whether they are float or double.
     // TODO: modify file format to know this; then eliminate the <ElemType> dependency (and in some future, allow nodes to be different)
-    template <class ElemType> void Read(const std::wstring& fileName);
-    template <class ElemType> void Load(const std::wstring& fileName)
+    // With 'mapParameters', the file is memory-mapped (copy-on-write), and large parameters of CPU networks use the
+    // mapped pages in place instead of being read (see ComputationNode::LoadValuePageAligned()). The pages are shared
+    // by all processes that load the same model this way. The mapping is held by the network, so the parameter values
+    // must not be used after the network is destroyed, and the model file must not be overwritten while it is in use.
+    template <class ElemType> void Read(const std::wstring& fileName, bool mapParameters = false);
+    template <class ElemType> void Load(const std::wstring& fileName, bool mapParameters = false)
     {
-        Read<ElemType>(fileName);
+        Read<ElemType>(fileName, mapParameters);
         // perform all further post-processing, caching, etc.
         CompileNetwork();
     }
 
     // static helper to instantiate a network from a file
     template <class ElemType>
-    static ComputationNetworkPtr CreateFromFile(DEVICEID_TYPE deviceId, const std::wstring& fileName)
+    static ComputationNetworkPtr CreateFromFile(DEVICEID_TYPE deviceId, const std::wstring& fileName, bool mapParameters = false)
     {
         auto net = make_shared<ComputationNetwork>(deviceId);
-        net->Load<ElemType>(fileName);
+        net->Load<ElemType>(fileName, mapParameters);
         return net;
     }
 
     void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
+    // Creates a network that can be Save()d on another thread while this one goes on training.
+    // It holds CPU copies of the learnable parameters and shares all other nodes with this network.
+    template <class ElemType>
+    ComputationNetworkPtr CreateSnapshotForSaving() const;
     void SaveEdited(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary);
 
 private:
@@ -133,8 +146,13 @@ public:
     // main entry point for forward prop
     void ForwardProp(const ComputationNodeBasePtr rootNode);
 
+    // called during backprop for each learnable parameter as soon as its gradient is final
+    typedef std::function<void(const ComputationNodeBasePtr&)> GradientReadyCallback;
+
     // main entry point for backprop
-    void Backprop(const ComputationNodeBasePtr rootNode);
+    // If given, 'gradientReadyCallback' is called for every learnable parameter right after the last node consuming it
+    // has backpropagated, i.e. in reverse evaluation order, while the gradients of earlier layers are still being computed.
+    void Backprop(const ComputationNodeBasePtr rootNode, const GradientReadyCallback& gradientReadyCallback = nullptr);
 
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
@@ -188,10 +206,21 @@ private:
     void VerifyIsCompiled(const char* where) const;
 public:
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
+    // run nodes and recurrent loops that do not depend on each other concurrently, on up to 'numThreads' threads (CPU only; 0 or 1 for
+    // the sequential traversal). Must be called before AllocateAllMatrices(), which then plans the memory sharing for it.
+    void SetConcurrentScheduling(size_t numThreads);
+    size_t GetConcurrentSchedulingThreads() const;
+    // report the memory planned by AllocateAllMatrices() for minibatches of 'numSamples' columns vs. what is actually allocated
+    void PrintMemoryUsage(size_t numSamples)
+    {
+        m_matrixPool.PrintMemoryUsage<float>(numSamples);
+        m_matrixPool.PrintMemoryUsage<double>(numSamples);
+    }
 
 private:
     template <class ElemType> void PrintMemorySharingStructure(const std::vector<ComputationNodeBasePtr>& nodes);
     void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount);
+    MatrixPool::ReuseOrderPredicate ConcurrentReuseOrder(const std::vector<ComputationNodeBasePtr>& forwardNodes, const std::list<ComputationNodeBasePtr>& backPropNodes, int backpropStartStep);
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
 
 public:
@@ -359,6 +388,7 @@ public:
     ComputationNodeBasePtr CopyNode(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toName, const CopyNodeFlags flags);
     void CopySubTree(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toNamePrefix, const CopyNodeFlags flags);
     void CopyInputs(const std::wstring fromName, std::wstring toName);
+    ComputationNetworkPtr CloneSharingParameters();
     void RenameNode(const std::wstring& nodeNameOrig, const std::wstring& nodeNameNew);
     void RenameNode(ComputationNodeBasePtr node, const std::wstring& newNodeName);
     void DeleteNode(const std::wstring& nodeName);
@@ -451,6 +481,32 @@ public:
                             const bool& sMBR = false);
     static void SetMaxTempMemSizeForCNN(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const size_t maxTempMemSizeInSamples);
 
+    // switch Times and TransposeTimes nodes with LearnableParameter weights to the int16 quantized CPU product for inference
+    // The weights are quantized once, in here, so this must be called after the model has been loaded.
+    template <class ElemType>
+    void SetQuantizedTimes(bool quantized);
+
+    // store the values and gradients of the given learnable parameters (dense, on the CPU) back to back in two arenas, e.g. for fused
+    // parameter updates. The nodes' matrices become views into the arenas, with their values kept. Returns the offset of each node.
+    template <class ElemType>
+    std::vector<size_t> AllocateLearnableParametersContiguously(const std::vector<ComputationNodeBasePtr>& nodes, Matrix<ElemType>& valueArena, Matrix<ElemType>& gradientArena);
+
+    // replace LSTM subgraphs (as created by the BrainScript LSTMP without projection) by OptimizedLSTMNodes, which run the whole
+    // recurrence in one node instead of a frame-by-frame loop over ~30 nodes. CPU only. Must be called before AllocateAllMatrices().
+    // The replaced nodes are kept, and Save() writes them instead of the fused node, so that saved models also load on a GPU.
+    template <class ElemType>
+    void FuseLSTMs();
+
+    // for inference: fold spatial batch normalizations into the weights of the preceding convolution, and replace convolution, (bias,)
+    // batch normalization, and a following ReLU, if any, by a FusedConvolutionNode. Must be called before AllocateAllMatrices().
+    template <class ElemType>
+    void FoldBatchNormalization();
+
+    // split projections of stacked inputs W * [x(t); h(t-1)] inside recurrent loops into W_x * x(t) + W_h * h(t-1), so that the
+    // part that does not depend on the loop runs once over the whole minibatch. Must be called before AllocateAllMatrices().
+    template <class ElemType>
+    void HoistLoopInvariantProjections();
+
     // -----------------------------------------------------------------------
     // node-group access
     // -----------------------------------------------------------------------
@@ -1027,6 +1083,22 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        // set for the duration of a Backprop() call by ComputationNetwork::Backprop()
+        GradientReadyCallback m_gradientReadyCallback;
+
+        // if set, independent nodes are run concurrently, see ComputationNetwork::SetConcurrentScheduling()
+        shared_ptr<ConcurrentNodeScheduler> m_scheduler;
+
+    private:
+        void ForwardPropNode(const ComputationNodeBasePtr& node, const FrameRange& fr);
+        void BackpropNode(const ComputationNodeBasePtr& node, const FrameRange& fr);
+        bool NestedNodeNeedsGradient(size_t i) const;
+
+        // the dependencies among m_nestedNodes, for the concurrent traversal
+        std::vector<std::vector<size_t>> m_inputIndices;    // [i] indices of the nested nodes that compute the inputs of nested node i
+        std::vector<std::vector<size_t>> m_consumerIndices; // [i] indices of the nested nodes that take nested node i as an input
+        std::mutex m_gradientReadyMutex;                    // the callback is not expected to be thread-safe
     };
 
 public:
@@ -1047,9 +1119,16 @@ private:
     DEVICEID_TYPE m_deviceId; // TODO: is this shared by all nodes?
     unsigned long m_randomSeedOffset;
 
+    // model file whose pages are used in place by parameter values, see Read(); declared before the nodes so that it is released after them
+    std::shared_ptr<MemoryMappedFile> m_mappedModel;
+
     // main node holder
     std::map<const std::wstring, ComputationNodeBasePtr, nocase_compare> m_nameToNodeMap; // [name] -> node; this is the main container that holds this networks' nodes
 
+    // [fused node] -> the nodes it replaced, which Save() writes in its place; the first one is the node whose name and links the fused node took over
+    // These are no longer part of m_nameToNodeMap, but still linked to each other and to the inputs of the fused node.
+    std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> m_nodesReplacedByFusedNode;
+
     // node groups
     // These are specified by the user by means of tags or explicitly listing the node groups.
     // TODO: Are these meant to be disjoint?
@@ -1097,6 +1176,9 @@ private:
     // pool for matrices that can be shared across nodes
     // TODO: does this apply to anything else besides temporary node-internal intermediate results? What, for example?
     MatrixPool m_matrixPool;
+
+    // worker threads for running independent nodes concurrently, see SetConcurrentScheduling(); null for the sequential traversal
+    shared_ptr<ConcurrentNodeScheduler> m_scheduler;
 };
 typedef ComputationNetwork::ComputationNetworkPtr ComputationNetworkPtr;
 
@@ -9,10 +9,17 @@
 #include "ComputationNode.h"
 #include "ComputationNetwork.h"
 #include "InputAndParamNodes.h"
+#include "ConvolutionalNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "RecurrentNodes.h"
+#include "ReshapingNodes.h"
 #include "TrainingNodes.h"
 #include <string>
 #include <vector>
 #include <list>
+#include <set>
+#include <map>
 
 using namespace std;
 
@@ -100,6 +107,50 @@ void ComputationNetwork::CopyInputs(const std::wstring fromName, std::wstring to
     CopyNode(*this, fromName, toName, CopyNodeFlags::copyNodeInputLinks);
 }
 
+// create a copy of this network for concurrent inference (e.g. one per thread)
+// All nodes are duplicated except for the LearnableParameters, which are shared with this network, so that the model
+// parameters exist only once in memory, while activations and the MatrixPool are private to each copy.
+// The copy is compiled but its matrices are not allocated. The parameters must not be modified while copies exist,
+// and all copies must be created before any of them (or this network) is evaluated, since creating one touches the shared nodes.
+ComputationNetworkPtr ComputationNetwork::CloneSharingParameters()
+{
+    VerifyIsCompiled("CloneSharingParameters");
+
+    auto net = make_shared<ComputationNetwork>(GetDeviceId());
+    net->SetRandomSeedOffset(GetRandomSeedOffset());
+
+    // duplicate or share the nodes
+    map<ComputationNodeBasePtr, ComputationNodeBasePtr> clones;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        bool isParameter = node->OperationName() == OperationNameOf(LearnableParameter);
+        clones[node] = net->AddNodeToNet(isParameter ? node : node->Duplicate(node->NodeName(), CopyNodeFlags::copyNodeValue));
+    }
+
+    // connect the duplicates among each other
+    for (const auto& iter : clones)
+    {
+        const auto& node = iter.first;
+        const auto& clone = iter.second;
+        if (clone == node)
+            continue;
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+            clone->SetInput(i, clones[node->GetInputs()[i]]);
+    }
+
+    // node groups
+    auto groups = GetAllNodeGroups();
+    auto cloneGroups = net->GetAllNodeGroups();
+    for (size_t k = 0; k < groups.size(); k++)
+        for (const auto& node : *groups[k])
+            cloneGroups[k]->push_back(clones[node]);
+
+    net->CompileNetwork();
+    net->SetConcurrentScheduling(GetConcurrentSchedulingThreads());
+    return net;
+}
+
 // RenameNode - Rename a node to another name
 // nodeNameOrig - original node name
 // nodeNameNew - new node name
@@ -120,6 +171,11 @@ void ComputationNetwork::RenameNode(ComputationNodeBasePtr node, const std::wstr
     RemoveNodeFromNet(node);        // take it out remporarily
     node->SetNodeName(newNodeName); // change the name
     AddNodeToNet(node);             // and put it back
+
+    // a fused node is saved as the nodes it replaced, whose output must then have the new name as well
+    auto replaced = m_nodesReplacedByFusedNode.find(node);
+    if (replaced != m_nodesReplacedByFusedNode.end())
+        replaced->second.front()->SetNodeName(newNodeName);
 }
 
 // deletes a node from the network including setting all input links to it to null, and removing it from the node groups
@@ -160,6 +216,15 @@ void ComputationNetwork::DeleteNode(const std::wstring& nodeName)
 
     // Note: the necessary update of m_allSEQNodes is hanlded by the InvalidateCompiledNetwork() call above
 
+    // if it is a fused node, the nodes it replaced go with it
+    auto replaced = m_nodesReplacedByFusedNode.find(nodeToDelete);
+    if (replaced != m_nodesReplacedByFusedNode.end())
+    {
+        for (const auto& node : replaced->second)
+            node->DetachInputs();
+        m_nodesReplacedByFusedNode.erase(replaced);
+    }
+
     // delete the node itself
     RemoveNodeFromNet(nodeToDelete);
 }
@@ -336,6 +401,679 @@ ComputationNodeBasePtr ComputationNetwork::RemoveFeatureNode(ComputationNodeBase
 }
 #endif
 
+// -----------------------------------------------------------------------
+// LSTM fusion
+// -----------------------------------------------------------------------
+
+// an LSTM subgraph as recognized by FuseLSTMs(); see OptimizedLSTMNode for the function it computes
+struct LSTMSubgraph
+{
+    ComputationNodeBasePtr hidden;                     // h(t), which gets replaced by the OptimizedLSTMNode
+    ComputationNodeBasePtr prevHidden, prevCell;       // the PastValue or FutureValue nodes for h(t-1) and c(t-1)
+    ComputationNodeBasePtr input;                      // x
+    ComputationNodeBasePtr weights[OptimizedLSTMNode<float>::numGates];          // in the order of OptimizedLSTMNode::Gate
+    ComputationNodeBasePtr recurrentWeights[OptimizedLSTMNode<float>::numGates];
+    ComputationNodeBasePtr biases[OptimizedLSTMNode<float>::numGates];
+    ComputationNodeBasePtr peepholes[OptimizedLSTMNode<float>::numGates];        // (none for the cell input; all or none for the others)
+    set<ComputationNodeBasePtr> nodes;                 // all nodes of the subgraph, including 'hidden'
+};
+
+static bool IsOperation(const ComputationNodeBasePtr& node, const wstring& operationName)
+{
+    return node && node->OperationName() == operationName;
+}
+
+// match a binary node with operation 'operationName' whose inputs satisfy the two predicates, in either order
+template <class P1, class P2>
+static bool MatchCommutative(const ComputationNodeBasePtr& node, const wstring& operationName, const P1& isFirst, const P2& isSecond,
+                             ComputationNodeBasePtr& first, ComputationNodeBasePtr& second)
+{
+    if (!IsOperation(node, operationName) || node->GetNumInputs() != 2)
+        return false;
+    for (size_t k = 0; k < 2; k++)
+    {
+        if (isFirst(node->GetInputs()[k]) && isSecond(node->GetInputs()[1 - k]))
+        {
+            first = node->GetInputs()[k];
+            second = node->GetInputs()[1 - k];
+            return true;
+        }
+    }
+    return false;
+}
+
+// match a gate pre-activation: a sum of W * x, H * prevHidden, a bias, and optionally a peephole term C .* peepholeOperand,
+// in any order or nesting of the Plus nodes
+static bool MatchGateInput(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& prevHidden, const ComputationNodeBasePtr& peepholeOperand,
+                           ComputationNodeBasePtr& x, ComputationNodeBasePtr& weight, ComputationNodeBasePtr& recurrentWeight,
+                           ComputationNodeBasePtr& bias, ComputationNodeBasePtr& peephole, set<ComputationNodeBasePtr>& nodes)
+{
+    x = weight = recurrentWeight = bias = peephole = nullptr;
+    ComputationNodeBasePtr matchedOperand;
+    vector<ComputationNodeBasePtr> pending{ node };
+    while (!pending.empty())
+    {
+        auto term = pending.back();
+        pending.pop_back();
+        if (IsOperation(term, OperationNameOf(PlusNode)) && term->HasMBLayout())
+        {
+            nodes.insert(term);
+            pending.push_back(term->GetInputs()[0]);
+            pending.push_back(term->GetInputs()[1]);
+        }
+        else if (IsOperation(term, OperationNameOf(TimesNode)) && !term->GetInputs()[0]->HasMBLayout())
+        {
+            if (term->GetInputs()[1] == prevHidden && !recurrentWeight)
+                recurrentWeight = term->GetInputs()[0];
+            else if (term->GetInputs()[1] != prevHidden && term->GetInputs()[1]->HasMBLayout() && !weight)
+            {
+                weight = term->GetInputs()[0];
+                x = term->GetInputs()[1];
+            }
+            else
+                return false;
+            nodes.insert(term);
+        }
+        else if (peepholeOperand && !peephole &&
+                 MatchCommutative(term, OperationNameOf(ElementTimesNode),
+                                  [](const ComputationNodeBasePtr& n) { return !n->HasMBLayout(); },
+                                  [&](const ComputationNodeBasePtr& n) { return n == peepholeOperand; }, peephole, matchedOperand))
+        {
+            nodes.insert(term);
+        }
+        else if (!term->HasMBLayout() && !bias)
+            bias = term;
+        else
+            return false;
+    }
+    return weight && recurrentWeight && bias;
+}
+
+// match a complete LSTM whose output is 'hidden'
+template <class ElemType>
+static bool MatchLSTM(const ComputationNodeBasePtr& hidden, const map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>>& consumers, LSTMSubgraph& lstm, int& direction)
+{
+    typedef OptimizedLSTMNode<ElemType> LSTM;
+    let isOp = [](const wstring& operationName) { return [operationName](const ComputationNodeBasePtr& node) { return IsOperation(node, operationName); }; };
+    let isDelayOf = [](const ComputationNodeBasePtr& of) // PastValue or FutureValue of 'of' with a time step of 1
+    {
+        return [of](const ComputationNodeBasePtr& node)
+        {
+            if (auto pastValue = dynamic_pointer_cast<PastValueNode<ElemType>>(node))
+                return pastValue->GetInputs()[0] == of && pastValue->TimeStep() == 1;
+            if (auto futureValue = dynamic_pointer_cast<FutureValueNode<ElemType>>(node))
+                return futureValue->GetInputs()[0] == of && futureValue->TimeStep() == 1;
+            return false;
+        };
+    };
+
+    // h = o .* Tanh (c)
+    ComputationNodeBasePtr o, tanhC, c;
+    if (!MatchCommutative(hidden, OperationNameOf(ElementTimesNode), isOp(OperationNameOf(SigmoidNode)), isOp(OperationNameOf(TanhNode)), o, tanhC))
+        return false;
+    c = tanhC->GetInputs()[0];
+
+    // c = f .* c(t-1) + i .* g
+    ComputationNodeBasePtr fTerm, iTerm, f, prevCell, i, tanhG;
+    if (!MatchCommutative(c, OperationNameOf(PlusNode), isOp(OperationNameOf(ElementTimesNode)), isOp(OperationNameOf(ElementTimesNode)), fTerm, iTerm))
+        return false;
+    if (!MatchCommutative(fTerm, OperationNameOf(ElementTimesNode), isOp(OperationNameOf(SigmoidNode)), isDelayOf(c), f, prevCell))
+    {
+        swap(fTerm, iTerm);
+        if (!MatchCommutative(fTerm, OperationNameOf(ElementTimesNode), isOp(OperationNameOf(SigmoidNode)), isDelayOf(c), f, prevCell))
+            return false;
+    }
+    if (!MatchCommutative(iTerm, OperationNameOf(ElementTimesNode), isOp(OperationNameOf(SigmoidNode)), isOp(OperationNameOf(TanhNode)), i, tanhG))
+        return false;
+    direction = IsOperation(prevCell, OperationNameOf(PastValueNode)) ? -1 : +1;
+
+    // gate inputs; h(t-1) is whichever delay of h, of the same kind as c(t-1), the cell input's recurrent projection uses
+    lstm = LSTMSubgraph();
+    ComputationNodeBasePtr gateInputs[LSTM::numGates] = { i->GetInputs()[0], f->GetInputs()[0], o->GetInputs()[0], tanhG->GetInputs()[0] };
+    ComputationNodeBasePtr peepholeOperands[LSTM::numGates] = { prevCell, prevCell, c, nullptr };
+    auto hiddenConsumers = consumers.find(hidden);
+    if (hiddenConsumers == consumers.end())
+        return false;
+    for (const auto& candidate : hiddenConsumers->second)
+    {
+        if (candidate->OperationName() != prevCell->OperationName() || !isDelayOf(hidden)(candidate))
+            continue;
+        set<ComputationNodeBasePtr> nodes;
+        ComputationNodeBasePtr x, weight, recurrentWeight, bias, peephole;
+        if (MatchGateInput(gateInputs[LSTM::cellInput], candidate, nullptr, x, weight, recurrentWeight, bias, peephole, nodes))
+        {
+            lstm.prevHidden = candidate;
+            break;
+        }
+    }
+    if (!lstm.prevHidden)
+        return false;
+    for (size_t gate = 0; gate < LSTM::numGates; gate++)
+    {
+        ComputationNodeBasePtr x;
+        if (!MatchGateInput(gateInputs[gate], lstm.prevHidden, peepholeOperands[gate], x, lstm.weights[gate], lstm.recurrentWeights[gate], lstm.biases[gate], lstm.peepholes[gate], lstm.nodes))
+            return false;
+        if (gate == 0)
+            lstm.input = x;
+        else if (x != lstm.input)
+            return false;
+    }
+    bool hasPeepholes = lstm.peepholes[LSTM::inputGate] != nullptr;
+    if (!!lstm.peepholes[LSTM::forgetGate] != hasPeepholes || !!lstm.peepholes[LSTM::outputGate] != hasPeepholes)
+        return false;
+
+    lstm.hidden = hidden;
+    lstm.prevCell = prevCell;
+    for (const auto& node : { hidden, o, tanhC, c, fTerm, iTerm, f, prevCell, i, tanhG, lstm.prevHidden })
+        lstm.nodes.insert(node);
+    for (const auto& node : lstm.nodes)
+        if (!dynamic_pointer_cast<ComputationNode<ElemType>>(node))
+            return false;
+
+    // The operations alone don't make it an LSTM that OptimizedLSTMNode can compute: a Times may have an output rank > 1,
+    // a Plus or ElementTimes may broadcast, and x may be a tensor. Check the shapes that OptimizedLSTMNode::Validate() requires,
+    // so that such subgraphs are left alone rather than failing validation after the rewrite.
+    let isColumnOf = [](const ComputationNodeBasePtr& node, size_t rows) // [rows] or [rows x 1 x ...]
+    {
+        let& shape = node->GetSampleLayout();
+        return shape.GetRank() > 0 && shape[0] == rows && shape.GetNumElements() == rows;
+    };
+    let isParameterOf = [&](const ComputationNodeBasePtr& node, size_t rows, size_t cols)
+    {
+        let& shape = node->GetSampleLayout();
+        bool isValid = cols == 1 ? isColumnOf(node, rows) : shape.GetRank() == 2 && shape[0] == rows && shape[1] == cols;
+        return isValid && !node->HasMBLayout() && dynamic_pointer_cast<ComputationNode<ElemType>>(node) != nullptr;
+    };
+    size_t cellDim = hidden->GetSampleLayout().GetRank() > 0 ? hidden->GetSampleLayout()[0] : 0;
+    size_t inputDim = lstm.input->GetSampleLayout().GetRank() > 0 ? lstm.input->GetSampleLayout()[0] : 0;
+    if (!isColumnOf(lstm.input, inputDim) || !dynamic_pointer_cast<ComputationNode<ElemType>>(lstm.input))
+        return false;
+    for (const auto& node : lstm.nodes) // all intermediate values are [cellDim], which includes the output of each Times
+        if (!isColumnOf(node, cellDim))
+            return false;
+    for (size_t gate = 0; gate < LSTM::numGates; gate++)
+    {
+        if (!isParameterOf(lstm.weights[gate], cellDim, inputDim) ||
+            !isParameterOf(lstm.recurrentWeights[gate], cellDim, cellDim) ||
+            !isParameterOf(lstm.biases[gate], cellDim, 1) ||
+            (lstm.peepholes[gate] && !isParameterOf(lstm.peepholes[gate], cellDim, 1)))
+            return false;
+    }
+    return true;
+}
+
+// initial activation of a PastValue or FutureValue node
+template <class ElemType>
+static ElemType InitialActivationValueOf(const ComputationNodeBasePtr& node)
+{
+    if (auto pastValue = dynamic_pointer_cast<PastValueNode<ElemType>>(node))
+        return pastValue->InitialActivationValue();
+    return dynamic_pointer_cast<FutureValueNode<ElemType>>(node)->InitialActivationValue();
+}
+
+// does 'node' depend on any node in 'nodes'?
+static bool DependsOn(const ComputationNodeBasePtr& node, const set<ComputationNodeBasePtr>& nodes, set<ComputationNodeBasePtr>& visited)
+{
+    if (!node || !visited.insert(node).second)
+        return false;
+    if (nodes.find(node) != nodes.end())
+        return true;
+    for (const auto& input : node->GetInputs())
+        if (DependsOn(input, nodes, visited))
+            return true;
+    return false;
+}
+
+template <class ElemType>
+void ComputationNetwork::FuseLSTMs()
+{
+    VerifyIsCompiled("FuseLSTMs");
+    if (AreMatricesAllocated())
+        LogicError("FuseLSTMs: Must be called before the network's matrices are allocated.");
+    if (GetDeviceId() != CPUDEVICE)
+    {
+        fprintf(stderr, "FuseLSTMs: Skipped, since the fused LSTM is only implemented for the CPU.\n");
+        return;
+    }
+
+    size_t numFused = 0;
+    for (;;)
+    {
+        // who consumes what (recomputed after each rewrite, since the rewrite changes the links)
+        map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>> consumers;
+        set<ComputationNodeBasePtr> groupMembers;
+        for (const auto& node : GetAllNodes())
+            for (const auto& input : node->GetInputs())
+                consumers[input].push_back(node);
+        for (const auto& group : GetAllNodeGroups())
+            groupMembers.insert(group->begin(), group->end());
+
+        // find the next LSTM that we can replace
+        LSTMSubgraph lstm;
+        int direction = 0;
+        bool found = false;
+        for (const auto& node : GetAllNodes())
+        {
+            if (!MatchLSTM<ElemType>(node, consumers, lstm, direction))
+                continue;
+
+            // the inner nodes must not be used outside of the subgraph
+            bool isSelfContained = true;
+            for (const auto& inner : lstm.nodes)
+            {
+                if (inner == lstm.hidden)
+                    continue;
+                isSelfContained &= groupMembers.find(inner) == groupMembers.end();
+                for (const auto& consumer : consumers[inner])
+                    isSelfContained &= lstm.nodes.find(consumer) != lstm.nodes.end();
+            }
+            // and the inputs must not depend on the LSTM output (that would be a loop around the LSTM, e.g. in a decoder)
+            set<ComputationNodeBasePtr> visited;
+            isSelfContained &= !DependsOn(lstm.input, lstm.nodes, visited);
+            for (size_t gate = 0; gate < OptimizedLSTMNode<ElemType>::numGates; gate++)
+                for (const auto& parameter : { lstm.weights[gate], lstm.recurrentWeights[gate], lstm.biases[gate], lstm.peepholes[gate] })
+                    isSelfContained &= !DependsOn(parameter, lstm.nodes, visited);
+            if (isSelfContained)
+            {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            break;
+
+        // create the fused node under the name of h(t), with the original parameter nodes as inputs
+        typedef OptimizedLSTMNode<ElemType> LSTM;
+        auto fused = New<LSTM>(GetDeviceId(), lstm.hidden->NodeName(), direction,
+                               InitialActivationValueOf<ElemType>(lstm.prevHidden), InitialActivationValueOf<ElemType>(lstm.prevCell));
+        vector<ComputationNodeBasePtr> inputs{ lstm.input };
+        for (size_t gate = 0; gate < LSTM::numGates; gate++)
+        {
+            inputs.push_back(lstm.weights[gate]);
+            inputs.push_back(lstm.recurrentWeights[gate]);
+            inputs.push_back(lstm.biases[gate]);
+        }
+        if (lstm.peepholes[LSTM::inputGate])
+        {
+            for (size_t gate = 0; gate < LSTM::cellInput; gate++)
+                inputs.push_back(lstm.peepholes[gate]);
+        }
+        fprintf(stderr, "FuseLSTMs: Replacing %d nodes of the %s LSTM %ls by a %ls node.\n",
+                (int) lstm.nodes.size(), direction < 0 ? "left-to-right" : "right-to-left", lstm.hidden->NodeName().c_str(), LSTM::TypeName().c_str());
+
+        // move all links and node-group memberships of h(t) over to the fused node, then take the subgraph out of the network
+        // The subgraph stays linked, with the delays of h(t) now reading the fused node under the same name, so that Save() can write it
+        // instead of the fused node.
+        InvalidateCompiledNetwork();
+        ChangeNodeInputs(lstm.hidden, fused);
+        for (auto group : GetAllNodeGroups())
+            replace(group->begin(), group->end(), lstm.hidden, (ComputationNodeBasePtr) fused);
+        vector<ComputationNodeBasePtr> replacedNodes{ lstm.hidden };
+        for (const auto& node : lstm.nodes)
+        {
+            if (node != lstm.hidden)
+                replacedNodes.push_back(node);
+            m_nameToNodeMap.erase(node->NodeName());
+        }
+        AddNodeToNetAndAttachInputs(fused, inputs);
+        m_nodesReplacedByFusedNode[fused] = move(replacedNodes);
+        numFused++;
+    }
+
+    if (numFused > 0)
+        CompileNetwork();
+    fprintf(stderr, "FuseLSTMs: %d LSTMs replaced by %ls nodes.\n", (int) numFused, OperationNameOf(OptimizedLSTMNode).c_str());
+}
+
+// -----------------------------------------------------------------------
+// hoisting of loop-invariant input projections
+// -----------------------------------------------------------------------
+
+// FormRecurrentLoops() only puts the strongly connected nodes into a loop, so a projection W * x(t) of a loop input
+// already runs outside the loop, as a single GEMM over the whole minibatch. A projection of stacked inputs
+// W * [x(t); h(t-1)], however, depends on the loop through h(t-1), and therefore runs as one skinny GEMM per time step,
+// including its x(t) part. HoistLoopInvariantProjections() splits such projections by columns of W into
+// W_x * x(t) + W_h * h(t-1), which moves W_x * x(t) out of the loop.
+
+// a projection W * RowStack(...) inside a loop, some of whose stacked inputs do not depend on that loop
+struct LoopInvariantProjection
+{
+    ComputationNodeBasePtr times;   // the TimesNode, which gets replaced by the sum of the partial projections
+    vector<bool> isInvariant;       // [i] whether the i-th stacked input is computed outside the loop
+};
+
+// a column vector, possibly with trailing singleton dimensions, e.g. the [N x 1] output of a PastValue node
+static bool IsColumnVector(const ComputationNodeBasePtr& node)
+{
+    const auto& shape = node->GetSampleLayout();
+    return shape.GetRank() > 0 && shape.GetNumElements() == shape[0];
+}
+
+// 'loopIds' maps each node inside a loop to the loop's id
+static bool MatchLoopInvariantProjection(const ComputationNodeBasePtr& node, const map<ComputationNodeBasePtr, int>& loopIds,
+                                         LoopInvariantProjection& projection)
+{
+    if (!IsOperation(node, OperationNameOf(TimesNode)) || !node->IsPartOfLoop() || !IsColumnVector(node))
+        return false;
+    const auto& weight = node->GetInputs()[0];
+    const auto& stack = node->GetInputs()[1];
+    if (weight->HasMBLayout() || weight->GetSampleLayout().GetRank() != 2 || !IsOperation(stack, OperationNameOf(RowStackNode)))
+        return false;
+    auto loop = loopIds.find(stack);
+    if (loop == loopIds.end())
+        return false;
+    projection.times = node;
+    projection.isInvariant.clear();
+    for (const auto& input : stack->GetInputs())
+    {
+        if (!IsColumnVector(input))
+            return false;
+        auto inputLoop = loopIds.find(input);
+        projection.isInvariant.push_back(inputLoop == loopIds.end() || inputLoop->second != loop->second);
+    }
+    return find(projection.isInvariant.begin(), projection.isInvariant.end(), true) != projection.isInvariant.end();
+}
+
+template <class ElemType>
+void ComputationNetwork::HoistLoopInvariantProjections()
+{
+    VerifyIsCompiled("HoistLoopInvariantProjections");
+    if (AreMatricesAllocated())
+        LogicError("HoistLoopInvariantProjections: Must be called before the network's matrices are allocated.");
+
+    let uniqueName = [this](const wstring& name)
+    {
+        wstring uniqueName = name;
+        for (size_t i = 1; NodeNameExists(uniqueName); i++)
+            uniqueName = name + L"_" + to_wstring(i);
+        return uniqueName;
+    };
+
+    // find them all first, since the loop analysis is gone once we start editing
+    map<ComputationNodeBasePtr, int> loopIds;
+    for (const auto& loop : m_allSEQNodes)
+        for (const auto& node : loop->m_nestedNodes)
+            loopIds[node] = loop->m_loopId;
+    vector<LoopInvariantProjection> projections;
+    for (const auto& node : GetAllNodes())
+    {
+        LoopInvariantProjection projection;
+        if (MatchLoopInvariantProjection(node, loopIds, projection))
+            projections.push_back(move(projection));
+    }
+    if (projections.empty())
+        return;
+
+    InvalidateCompiledNetwork();
+    for (const auto& projection : projections)
+    {
+        auto times = projection.times;
+        auto weight = times->GetInputs()[0];
+        auto stack = times->GetInputs()[1];
+        const auto& stackedInputs = stack->GetInputs();
+        fprintf(stderr, "HoistLoopInvariantProjections: Splitting %ls %ls operation over %d stacked inputs.\n",
+                times->NodeName().c_str(), times->OperationName().c_str(), (int) stackedInputs.size());
+
+        // one partial projection W[:, begin:end] * RowStack(...) per run of stacked inputs that are all (in)variant
+        ComputationNodeBasePtr sums[2]; // [isInvariant] sum of the partial projections
+        size_t begin = 0;
+        for (size_t i = 0; i < stackedInputs.size();)
+        {
+            bool isInvariant = projection.isInvariant[i];
+            size_t end = begin, j = i;
+            for (; j < stackedInputs.size() && projection.isInvariant[j] == isInvariant; j++)
+                end += stackedInputs[j]->GetSampleLayout().GetNumElements();
+            ComputationNodeBasePtr operand = stackedInputs[i];
+            if (j - i > 1)
+                operand = AddNodeToNetAndAttachInputs(New<RowStackNode<ElemType>>(GetDeviceId(), uniqueName(stack->NodeName() + L".part")),
+                                                      vector<ComputationNodeBasePtr>(stackedInputs.begin() + i, stackedInputs.begin() + j));
+            auto weightSlice = AddNodeToNetAndAttachInputs(New<SliceNode<ElemType>>(GetDeviceId(), uniqueName(weight->NodeName() + L".part"), (int) begin, (int) end, /*axis=*/2),
+                                                           { weight });
+            ComputationNodeBasePtr partialProjection = AddNodeToNetAndAttachInputs(New<TimesNode<ElemType>>(GetDeviceId(), uniqueName(times->NodeName() + L".part")),
+                                                                                   { weightSlice, operand });
+            auto& sum = sums[isInvariant];
+            if (sum)
+                sum = AddNodeToNetAndAttachInputs(New<PlusNode<ElemType>>(GetDeviceId(), uniqueName(times->NodeName() + L".sum")), { sum, partialProjection });
+            else
+                sum = partialProjection;
+            begin = end;
+            i = j;
+        }
+
+        // replace the projection by the sum of the two parts under its name, and remove the stack unless it is still used elsewhere
+        auto plus = New<PlusNode<ElemType>>(GetDeviceId(), times->NodeName());
+        ChangeNodeInputs(times, plus);
+        for (auto group : GetAllNodeGroups())
+            replace(group->begin(), group->end(), times, (ComputationNodeBasePtr) plus);
+        times->DetachInputs();
+        DeleteNode(times->NodeName());
+        AddNodeToNetAndAttachInputs(plus, { sums[true], sums[false] });
+        bool isUsed = false;
+        for (const auto& node : GetAllNodes())
+            for (const auto& nodeInput : node->GetInputs())
+                isUsed |= nodeInput == stack;
+        for (const auto& group : GetAllNodeGroups())
+            isUsed |= find(group->begin(), group->end(), stack) != group->end();
+        if (!isUsed)
+        {
+            stack->DetachInputs();
+            DeleteNode(stack->NodeName());
+        }
+    }
+
+    CompileNetwork();
+    fprintf(stderr, "HoistLoopInvariantProjections: %d projections split.\n", (int) projections.size());
+}
+
+// -----------------------------------------------------------------------
+// batch-normalization folding
+// -----------------------------------------------------------------------
+
+// a convolution followed by a spatial batch normalization, as recognized by FoldBatchNormalization()
+template <class ElemType>
+struct ConvolutionBatchNormalization
+{
+    shared_ptr<ConvolutionNode<ElemType>> convolution;
+    ComputationNodeBasePtr bias;                                 // optional Plus node that adds a bias to the convolution
+    ComputationNodeBasePtr biasParameter;                        // and its parameter
+    shared_ptr<BatchNormalizationNode<ElemType>> batchNormalization;
+    ComputationNodeBasePtr reLU;                                 // optional RectifiedLinear node that follows
+    ComputationNodeBasePtr top;                                  // the last node of the subgraph, which gets replaced by the fused node
+    set<ComputationNodeBasePtr> nodes;                           // all nodes of the subgraph, including 'top'
+};
+
+static bool IsLearnableParameter(const ComputationNodeBasePtr& node)
+{
+    return IsOperation(node, OperationNameOf(LearnableParameter));
+}
+
+// match convolution -> [+ bias ->] batch normalization [-> ReLU] where 'node' is the batch normalization
+template <class ElemType>
+static bool MatchConvolutionBatchNormalization(const ComputationNodeBasePtr& node, map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>>& consumers,
+                                               const set<ComputationNodeBasePtr>& groupMembers, ConvolutionBatchNormalization<ElemType>& match)
+{
+    match = ConvolutionBatchNormalization<ElemType>();
+
+    // spatial batch normalization with constant parameters (it is per-map, so it commutes with the convolution)
+    match.batchNormalization = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(node);
+    if (!match.batchNormalization || !match.batchNormalization->IsSpatial())
+        return false;
+    for (size_t i = 1; i < node->GetNumInputs(); i++)
+        if (!IsLearnableParameter(node->GetInputs()[i]))
+            return false;
+
+    // optional bias
+    auto input = node->GetInputs()[0];
+    ComputationNodeBasePtr convolution;
+    if (MatchCommutative(input, OperationNameOf(PlusNode), [](const ComputationNodeBasePtr& n) { return IsOperation(n, OperationNameOf(ConvolutionNode)); },
+                         IsLearnableParameter, convolution, match.biasParameter))
+    {
+        match.bias = input;
+        input = convolution;
+    }
+
+    // non-transposed CHW convolution whose kernel spans all input channels, so that output maps correspond to kernels
+    match.convolution = dynamic_pointer_cast<ConvolutionNode<ElemType>>(input);
+    if (!match.convolution || match.convolution->IsTransposed() || match.convolution->GetImageLayoutKind() != ImageLayoutKind::CHW ||
+        !IsLearnableParameter(input->GetInputs()[0]))
+        return false;
+    const auto& inputShape = input->GetInputs()[1]->GetSampleLayout();
+    const auto& outputShape = input->GetSampleLayout();
+    const auto& kernelShape = match.convolution->KernelShape();
+    const auto& mapCount = match.convolution->MapCount();
+    size_t numMaps = outputShape[outputShape.GetRank() - 1];
+    if (kernelShape.GetRank() != inputShape.GetRank() || kernelShape[kernelShape.GetRank() - 1] != inputShape[inputShape.GetRank() - 1] ||
+        mapCount.GetNumElements() != numMaps || mapCount[mapCount.GetRank() - 1] != numMaps ||
+        input->GetInputs()[0]->GetAsMatrixNumRows() != numMaps || node->GetInputs()[1]->GetSampleLayout().GetNumElements() != numMaps)
+        return false;
+    if (match.bias && match.biasParameter->GetSampleLayout() != FusedConvolutionNode<ElemType>::BiasShape(outputShape))
+    {
+        // a bias of lower rank is fine as long as it has one value per map in the map dimension
+        const auto& biasShape = match.biasParameter->GetSampleLayout();
+        if (biasShape.GetRank() != outputShape.GetRank() || biasShape.GetNumElements() != numMaps || biasShape[biasShape.GetRank() - 1] != numMaps)
+            return false;
+    }
+
+    // a following ReLU, unless the batch normalization itself is needed
+    match.top = node;
+    const auto& bnConsumers = consumers[node];
+    if (bnConsumers.size() == 1 && IsOperation(bnConsumers[0], OperationNameOf(RectifiedLinearNode)) &&
+        groupMembers.find(node) == groupMembers.end() && dynamic_pointer_cast<ComputationNode<ElemType>>(bnConsumers[0]))
+    {
+        match.reLU = bnConsumers[0];
+        match.top = match.reLU;
+    }
+
+    // the inner nodes must not be used outside of the subgraph
+    for (const auto& inner : { (ComputationNodeBasePtr) match.convolution, match.bias, node, match.reLU })
+        if (inner)
+            match.nodes.insert(inner);
+    for (const auto& inner : match.nodes)
+    {
+        if (inner == match.top)
+            continue;
+        if (groupMembers.find(inner) != groupMembers.end())
+            return false;
+        for (const auto& consumer : consumers[inner])
+            if (match.nodes.find(consumer) == match.nodes.end())
+                return false;
+    }
+    return true;
+}
+
+template <class ElemType>
+void ComputationNetwork::FoldBatchNormalization()
+{
+    VerifyIsCompiled("FoldBatchNormalization");
+    if (AreMatricesAllocated())
+        LogicError("FoldBatchNormalization: Must be called before the network's matrices are allocated.");
+
+    let uniqueName = [this](const wstring& name)
+    {
+        wstring uniqueName = name;
+        for (size_t i = 1; NodeNameExists(uniqueName); i++)
+            uniqueName = name + L"_" + to_wstring(i);
+        return uniqueName;
+    };
+
+    size_t numFolded = 0, numReLUs = 0;
+    for (;;)
+    {
+        // who consumes what (recomputed after each rewrite, since the rewrite changes the links)
+        map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>> consumers;
+        set<ComputationNodeBasePtr> groupMembers;
+        for (const auto& node : GetAllNodes())
+            for (const auto& input : node->GetInputs())
+                consumers[input].push_back(node);
+        for (const auto& group : GetAllNodeGroups())
+            groupMembers.insert(group->begin(), group->end());
+
+        // find the next convolution + batch normalization
+        ConvolutionBatchNormalization<ElemType> match;
+        bool found = false;
+        for (const auto& node : GetAllNodes())
+        {
+            if (MatchConvolutionBatchNormalization<ElemType>(node, consumers, groupMembers, match))
+            {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            break;
+
+        // fold y = a .* (W * x + c) + b into y = (a .* W) * x + (a .* c + b), where a and b are per map
+        // The weights are [numMaps x kernelSize], but stored row-major in the cudnn layout, i.e. each map's kernel is contiguous.
+        vector<double> a, b;
+        match.batchNormalization->GetInferenceTransform(a, b);
+        ComputationNodeBasePtr convolution = match.convolution, batchNormalization = match.batchNormalization;
+        auto weights = dynamic_pointer_cast<ComputationNode<ElemType>>(convolution->GetInputs()[0]);
+        size_t numMaps = weights->GetAsMatrixNumRows(), kernelSize = weights->GetAsMatrixNumCols();
+        unique_ptr<ElemType[]> weightsData(weights->Value().CopyToArray());
+        for (size_t k = 0; k < numMaps; k++)
+            for (size_t j = 0; j < kernelSize; j++)
+                weightsData[j + k * kernelSize] = (ElemType) (a[k] * weightsData[j + k * kernelSize]);
+        vector<ElemType> biasData(numMaps);
+        unique_ptr<ElemType[]> convolutionBias(match.bias ? dynamic_pointer_cast<ComputationNode<ElemType>>(match.biasParameter)->Value().CopyToArray() : nullptr);
+        for (size_t k = 0; k < numMaps; k++)
+            biasData[k] = (ElemType) (b[k] + (convolutionBias ? a[k] * convolutionBias[k] : 0));
+
+        // create the fused node under the name of the last node, with new parameters (the original weights may be shared)
+        auto fused = New<FusedConvolutionNode<ElemType>>(GetDeviceId(), match.top->NodeName(), (bool) match.reLU);
+        match.convolution->CopyGeometryTo(*fused);
+        ComputationNodeBasePtr fusedNode = fused; // (take over the dimensions, since the next match may look at them before the network is validated again)
+        fusedNode->LinkToMBLayout(match.top->GetMBLayout());
+        fusedNode->SetDims(match.top);
+        auto foldedWeights = New<LearnableParameter<ElemType>>(GetDeviceId(), uniqueName(convolution->NodeName() + L".foldedW"), weights->GetSampleLayout());
+        foldedWeights->Value().SetValue(numMaps, kernelSize, GetDeviceId(), weightsData.get());
+        auto foldedBias = New<LearnableParameter<ElemType>>(GetDeviceId(), uniqueName(convolution->NodeName() + L".foldedB"),
+                                                            FusedConvolutionNode<ElemType>::BiasShape(convolution->GetSampleLayout()));
+        foldedBias->Value().SetValue(numMaps, 1, GetDeviceId(), biasData.data());
+        for (const auto& parameter : { (ComputationNodeBasePtr) foldedWeights, (ComputationNodeBasePtr) foldedBias })
+        {
+            parameter->SetLearningRateMultiplier(0);
+            AddNodeToNet(parameter);
+        }
+        auto input = convolution->GetInputs()[1];
+        vector<ComputationNodeBasePtr> parameters{ weights, match.biasParameter };
+        for (size_t i = 1; i < batchNormalization->GetNumInputs(); i++)
+            parameters.push_back(batchNormalization->GetInputs()[i]);
+
+        // move all links and node-group memberships of the last node over to the fused node, then remove the subgraph
+        InvalidateCompiledNetwork();
+        ChangeNodeInputs(match.top, fused);
+        for (auto group : GetAllNodeGroups())
+            replace(group->begin(), group->end(), match.top, (ComputationNodeBasePtr) fused);
+        for (const auto& node : match.nodes) // (unlink first, so that DeleteNode() will not find any consumers to reset)
+            node->DetachInputs();
+        for (const auto& node : match.nodes)
+            DeleteNode(node->NodeName());
+        AddNodeToNetAndAttachInputs(fused, { foldedWeights, input, foldedBias });
+
+        // and the original parameters, unless they are still used elsewhere
+        for (const auto& parameter : parameters)
+        {
+            if (!parameter || groupMembers.find(parameter) != groupMembers.end())
+                continue;
+            bool isUsed = false;
+            for (const auto& node : GetAllNodes())
+                for (const auto& nodeInput : node->GetInputs())
+                    isUsed |= nodeInput == parameter;
+            if (!isUsed && NodeNameExists(parameter->NodeName()))
+                DeleteNode(parameter->NodeName());
+        }
+
+        numFolded++;
+        if (match.reLU)
+            numReLUs++;
+    }
+
+    if (numFolded > 0)
+        CompileNetwork();
+    fprintf(stderr, "FoldBatchNormalization: %d batch normalizations folded into %ls nodes, %d of them with ReLU.\n",
+            (int) numFolded, OperationNameOf(FusedConvolutionNode).c_str(), (int) numReLUs);
+}
+
 // sets m_learningRateMultiplier in all LearnableParameters feeding into the passed rootNode
 // Called from MEL
 void ComputationNetwork::SetLearnableNodesBelowLearningRateMultiplier(const float learningRateMultiplier, const ComputationNodeBasePtr& rootNode)
@@ -361,4 +1099,11 @@ void ComputationNetwork::SetLearnableNodesBelowLearningRateMultiplier(const floa
     }
 }
 
+template void ComputationNetwork::FuseLSTMs<float>();
+template void ComputationNetwork::FuseLSTMs<double>();
+template void ComputationNetwork::FoldBatchNormalization<float>();
+template void ComputationNetwork::FoldBatchNormalization<double>();
+template void ComputationNetwork::HoistLoopInvariantProjections<float>();
+template void ComputationNetwork::HoistLoopInvariantProjections<double>();
+
 }}}
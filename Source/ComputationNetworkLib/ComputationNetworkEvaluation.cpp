@@ -10,6 +10,7 @@
 #include "ComputationNetwork.h"
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
+#include "ConcurrentNodeScheduler.h"
 #include <string>
 #include <vector>
 #include <list>
@@ -63,7 +64,8 @@ static bool SetRootGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for eval nodes
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
-void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, // training criterion to compute the gradients for
+                                  const GradientReadyCallback& gradientReadyCallback)
 {
     if (!Environment().IsTraining())
         LogicError("Backprop: Requires network is to be in training mode.");
@@ -76,7 +78,10 @@ void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // trai
     ZeroInputGradients(rootNode);
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    auto network = static_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    network->m_gradientReadyCallback = gradientReadyCallback;
+    network->Backprop(FrameRange(nullptr), true, true);
+    network->m_gradientReadyCallback = nullptr;
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -84,7 +89,32 @@ void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNod
     if (m_nestedNetworks.find(rootNode) != m_nestedNetworks.end())
         fprintf(stderr, "FormNestedNetwork: WARNING: Was called twice for %ls %ls operation\n", rootNode->NodeName().c_str(), rootNode->OperationName().c_str());
 
-    m_nestedNetworks[rootNode] = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, GetEvalOrder(rootNode));
+    auto network = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, GetEvalOrder(rootNode));
+    network->m_scheduler = m_scheduler;
+    m_nestedNetworks[rootNode] = network;
+}
+
+void ComputationNetwork::SetConcurrentScheduling(size_t numThreads)
+{
+    if (AreMatricesAllocated())
+        LogicError("SetConcurrentScheduling: Must be called before the network's matrices are allocated.");
+    if (numThreads > 1 && GetDeviceId() != CPUDEVICE)
+    {
+        fprintf(stderr, "SetConcurrentScheduling: Skipped, since concurrent scheduling is only implemented for the CPU.\n");
+        numThreads = 0;
+    }
+
+    if (numThreads <= 1)
+        m_scheduler.reset();
+    else if (!m_scheduler || m_scheduler->GetNumThreads() != numThreads)
+        m_scheduler = make_shared<ConcurrentNodeScheduler>(numThreads);
+    for (auto& iter : m_nestedNetworks)
+        static_pointer_cast<PARTraversalFlowControlNode>(iter.second)->m_scheduler = m_scheduler;
+}
+
+size_t ComputationNetwork::GetConcurrentSchedulingThreads() const
+{
+    return m_scheduler ? m_scheduler->GetNumThreads() : 0;
 }
 
 ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -100,6 +130,15 @@ ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNod
 // This implements an outer loop over non-recurrent nodes, where each node can be
 // executed in PAR mode; that is, all samples are independent and allow for
 // concurrent computation in bulk CUDA launches.
+//
+// With a scheduler (see ComputationNetwork::SetConcurrentScheduling()), the nested
+// nodes are not run in list order but as a DAG: a node (or loop) starts as soon as
+// the nodes computing its inputs are done (and in backprop, as soon as the nodes
+// consuming it are done, where consumers of a common input take turns), so that
+// e.g. the two directions of a bidirectional recurrence, or the towers of a
+// multi-tower model, run at the same time.
+// This is safe w.r.t. memory sharing only because AllocateAllMatrices() planned
+// the MatrixPool for it, see ConcurrentReuseOrder() below.
 // -----------------------------------------------------------------------
 
 ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes /*must be in eval order*/)
@@ -128,37 +167,136 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
             nodeIter++; // and consume this node
         }
     }
+
+    // dependencies among the nested nodes; loop members are represented by their loop
+    std::map<ComputationNodeBasePtr, size_t> indexOf;
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        if (loop)
+        {
+            for (const auto& node : loop->m_nestedNodes)
+                indexOf[node] = i;
+        }
+        else
+            indexOf[m_nestedNodes[i]] = i;
+    }
+    m_inputIndices.resize(m_nestedNodes.size());
+    m_consumerIndices.resize(m_nestedNodes.size());
+    for (const auto& iter : indexOf)
+    {
+        size_t i = iter.second;
+        for (const auto& input : iter.first->GetInputs())
+        {
+            auto inputIndex = indexOf.find(input);
+            if (inputIndex == indexOf.end() || inputIndex->second == i ||
+                std::find(m_inputIndices[i].begin(), m_inputIndices[i].end(), inputIndex->second) != m_inputIndices[i].end())
+                continue;
+            m_inputIndices[i].push_back(inputIndex->second);
+            m_consumerIndices[inputIndex->second].push_back(i);
+        }
+    }
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
-    for (auto& node : m_nestedNodes)
+    if (m_scheduler)
+    {
+        std::vector<size_t> numDependencies;
+        for (const auto& inputs : m_inputIndices)
+            numDependencies.push_back(inputs.size());
+        m_scheduler->Run(numDependencies, m_consumerIndices, [this, &fr](size_t i)
+                         {
+                             ForwardPropNode(m_nestedNodes[i], fr);
+                         });
+    }
+    else
     {
+        for (auto& node : m_nestedNodes)
+            ForwardPropNode(node, fr);
+    }
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropNode(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
 #if 0
-        if (dynamic_pointer_cast<LearnableParameter<float>>(node))
-            dynamic_pointer_cast<ComputationNode<float>>(node)->DebugLogMinibatch();
+    if (dynamic_pointer_cast<LearnableParameter<float>>(node))
+        dynamic_pointer_cast<ComputationNode<float>>(node)->DebugLogMinibatch();
 #endif
-        if (node->IsOutOfDateWrtInputs())
-        {
-            node->BeginForwardProp();
-            node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
-            node->EndForwardProp();
+    if (node->IsOutOfDateWrtInputs())
+    {
+        node->BeginForwardProp();
+        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+        node->EndForwardProp();
 
-            node->BumpEvalTimeStamp();
-        }
+        node->BumpEvalTimeStamp();
     }
 }
 
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
-    // process nodes in pre-determined order
-    for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+    if (m_scheduler)
     {
-        auto& node = *pnode;
+        // backwards: a node waits for its consumers
+        // All consumers of a node that needs a gradient add into that gradient (and the first one zeroes it), so they
+        // must not run at the same time. We chain them in reverse evaluation order, i.e. in the order of the sequential
+        // traversal. Which nodes need a gradient is only known after validation, so this is determined here.
+        std::vector<size_t> numDependencies;
+        for (const auto& consumers : m_consumerIndices)
+            numDependencies.push_back(consumers.size());
+        std::vector<std::vector<size_t>> successors = m_inputIndices;
+        for (size_t i = 0; i < m_nestedNodes.size(); i++)
+        {
+            if (m_consumerIndices[i].size() < 2 || !NestedNodeNeedsGradient(i))
+                continue;
+            std::vector<size_t> consumers = m_consumerIndices[i];
+            std::sort(consumers.begin(), consumers.end(), std::greater<size_t>());
+            for (size_t k = 0; k + 1 < consumers.size(); k++)
+            {
+                auto& consumerSuccessors = successors[consumers[k]];
+                if (std::find(consumerSuccessors.begin(), consumerSuccessors.end(), consumers[k + 1]) != consumerSuccessors.end())
+                    continue;
+                consumerSuccessors.push_back(consumers[k + 1]);
+                numDependencies[consumers[k + 1]]++;
+            }
+        }
+        m_scheduler->Run(numDependencies, successors, [this, &fr](size_t i)
+                         {
+                             BackpropNode(m_nestedNodes[i], fr);
+                         });
+    }
+    else
+    {
+        // process nodes in pre-determined order
+        for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+            BackpropNode(*pnode, fr);
+    }
+}
 
-        node->BeginBackprop();
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndBackprop();
+// a loop needs a gradient if any of its members does, since its consumers may propagate into any of them
+bool ComputationNetwork::PARTraversalFlowControlNode::NestedNodeNeedsGradient(size_t i) const
+{
+    auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+    if (!loop)
+        return m_nestedNodes[i]->NeedsGradient();
+    for (const auto& node : loop->m_nestedNodes)
+        if (node->NeedsGradient())
+            return true;
+    return false;
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::BackpropNode(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    node->BeginBackprop();
+    node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+    node->EndBackprop();
+
+    // All consumers of a parameter come after it in evaluation order, so by now its gradient is final.
+    // This allows e.g. distributed training to start aggregating it while we continue with the earlier layers.
+    if (m_gradientReadyCallback && node->OperationName() == OperationNameOf(LearnableParameter) && node->IsParameterUpdateRequired())
+    {
+        std::lock_guard<std::mutex> lock(m_gradientReadyMutex);
+        m_gradientReadyCallback(node);
     }
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
@@ -841,6 +979,112 @@ void ComputationNetwork::PrintMemorySharingStructure(const std::vector<Computati
 // predetermine how to share matrices to reduce memory usage.
 // TODO: find a simple topological order and allocateEvalMatrices on that order directly
 // without passing in eval, out, and train nodes.
+// With concurrent scheduling, nodes that do not depend on each other may run at the same time, so it is not enough for two
+// matrices to be live at different steps of the simulated evaluation order to share a buffer. The predicate returned here tells
+// the MatrixPool whether every task that may still use a released matrix is guaranteed to be done before the first task that
+// may use a requested one starts. Tasks are the forward and backward computations of the top-level nodes and loops (units),
+// as scheduled by PARTraversalFlowControlNode:
+//  - in forward, a node's matrix is first used by the node itself; if released in forward, it may still be used by all consumers
+//  - in backward, a node's matrix (e.g. its gradient) is first used by any of its consumers; if released in backward, the last
+//    user is the node itself, which runs after all its consumers
+//  - all forward tasks are done before any backward task starts
+MatrixPool::ReuseOrderPredicate ComputationNetwork::ConcurrentReuseOrder(const std::vector<ComputationNodeBasePtr>& forwardNodes, const std::list<ComputationNodeBasePtr>& backPropNodes, int backpropStartStep)
+{
+    struct Order
+    {
+        std::map<const ComputationNodeBase*, size_t> unitOf;                        // [node] index of its unit, in evaluation order
+        std::vector<std::vector<uint64_t>> ancestors;                               // [unit] bit set of the units it depends on, directly or indirectly
+        std::map<const ComputationNodeBase*, std::vector<size_t>> forwardConsumers;  // [node] units that consume it
+        std::map<const ComputationNodeBase*, std::vector<size_t>> backwardConsumers; // [node] units that consume it and take part in backprop
+        int backpropStartStep;
+
+        bool DependsOn(size_t unit, size_t other) const
+        {
+            return unit == other || ((ancestors[unit][other / 64] >> (other % 64)) & 1) != 0;
+        }
+    };
+    auto order = make_shared<Order>();
+    order->backpropStartStep = backpropStartStep;
+
+    std::map<shared_ptr<SEQTraversalFlowControlNode>, size_t> loopUnits;
+    size_t numUnits = 0;
+    for (const auto& node : forwardNodes)
+    {
+        auto loop = node->IsPartOfLoop() ? FindInRecurrentLoops(m_allSEQNodes, node) : nullptr;
+        if (loop)
+        {
+            auto iter = loopUnits.find(loop);
+            if (iter == loopUnits.end())
+                iter = loopUnits.insert(make_pair(loop, numUnits++)).first;
+            order->unitOf[node.get()] = iter->second;
+        }
+        else
+            order->unitOf[node.get()] = numUnits++;
+    }
+
+    // units are in evaluation order, so the ancestors of all inputs are known by the time we get to a unit
+    order->ancestors.assign(numUnits, std::vector<uint64_t>((numUnits + 63) / 64, 0));
+    std::set<ComputationNodeBasePtr> backPropNodeSet(backPropNodes.begin(), backPropNodes.end());
+    for (const auto& node : forwardNodes)
+    {
+        size_t unit = order->unitOf[node.get()];
+        for (const auto& input : node->GetInputs())
+        {
+            auto inputUnit = order->unitOf.find(input.get());
+            if (inputUnit == order->unitOf.end())
+                continue;
+            order->forwardConsumers[input.get()].push_back(unit);
+            if (backPropNodeSet.find(node) != backPropNodeSet.end())
+                order->backwardConsumers[input.get()].push_back(unit);
+            if (inputUnit->second == unit)
+                continue;
+            auto& ancestors = order->ancestors[unit];
+            const auto& inputAncestors = order->ancestors[inputUnit->second];
+            for (size_t k = 0; k < ancestors.size(); k++)
+                ancestors[k] |= inputAncestors[k];
+            ancestors[inputUnit->second / 64] |= (uint64_t) 1 << (inputUnit->second % 64);
+        }
+    }
+
+    return [order](const ComputationNodeBase* releaseOwner, int releaseStep, const ComputationNodeBase* requestOwner, int requestStep)
+    {
+        bool releasedInBackprop = releaseStep >= order->backpropStartStep;
+        bool requestedInBackprop = requestStep >= order->backpropStartStep;
+        if (releasedInBackprop != requestedInBackprop)
+            return !releasedInBackprop;
+
+        auto releaseUnit = order->unitOf.find(releaseOwner);
+        auto requestUnit = order->unitOf.find(requestOwner);
+        if (releaseUnit == order->unitOf.end() || requestUnit == order->unitOf.end())
+            return false;
+
+        if (!releasedInBackprop)
+        {
+            // all consumers of the released matrix's owner must be done before the requesting node starts
+            auto consumers = order->forwardConsumers.find(releaseOwner);
+            if (consumers == order->forwardConsumers.end())
+                return order->DependsOn(requestUnit->second, releaseUnit->second);
+            for (size_t consumer : consumers->second)
+                if (!order->DependsOn(requestUnit->second, consumer))
+                    return false;
+            return true;
+        }
+        else
+        {
+            // the releasing node must be done before the requesting node and all its consumers start their backprop
+            // (backprop runs a node after its consumers, i.e. after the nodes that depend on it)
+            if (!order->DependsOn(releaseUnit->second, requestUnit->second))
+                return false;
+            auto consumers = order->backwardConsumers.find(requestOwner);
+            if (consumers != order->backwardConsumers.end())
+                for (size_t consumer : consumers->second)
+                    if (!order->DependsOn(releaseUnit->second, consumer))
+                        return false;
+            return true;
+        }
+    };
+}
+
 void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes,
                                              const std::vector<ComputationNodeBasePtr>& outValueRootNodes,
                                              ComputationNodeBasePtr trainRootNode)
@@ -946,9 +1190,11 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    int backpropStartStep = m_matrixPool.GetStep();
+    std::list<ComputationNodeBasePtr> backPropNodes;
     if (trainRootNode != nullptr)
     {
-        const std::list<ComputationNodeBasePtr>& backPropNodes = GetEvalOrder(trainRootNode);
+        backPropNodes = GetEvalOrder(trainRootNode);
 
         // now, simulate the gradient computation order to determine how to allocate matrices
         set<ComputationNodeBasePtr> completedGradient;
@@ -984,6 +1230,13 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    // now that all lifetimes are known, decide which matrices share memory
+    MatrixPool::ReuseOrderPredicate reuseOrder;
+    if (m_scheduler)
+        reuseOrder = ConcurrentReuseOrder(compositeForwardPropEvalOrder, backPropNodes, backpropStartStep);
+    m_matrixPool.OptimizedMemoryAllocation<float>(reuseOrder);
+    m_matrixPool.OptimizedMemoryAllocation<double>(reuseOrder);
+
     m_areMatricesAllocated = true;
 
     //print the memory sharing structure
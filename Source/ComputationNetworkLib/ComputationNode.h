@@ -38,7 +38,8 @@
 #define CNTK_MODEL_VERSION_7 7 // ElemType tag in model file
 #define CNTK_MODEL_VERSION_8 8 // DynamicAxis for inputs
 #define CNTK_MODEL_VERSION_9 9 // Transpose flag in ConvolutionNode to support deconvolution. 
-#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_9
+#define CNTK_MODEL_VERSION_10 10 // LearnableParameter values stored as page-aligned raw arrays, for memory-mapped loading
+#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_10
 
 extern bool g_shareNodeValueMatrices;
 
@@ -995,6 +996,84 @@ public:
         SetDims(TensorShape(Value().GetNumRows(), Value().GetNumCols()), false);
     }
 
+    // helpers to save and load m_value as a raw array (CNTK_MODEL_VERSION_10 and up)
+    // In binary files, arrays of at least one page are padded to start at a file offset that is a multiple of the
+    // page size. If the file being loaded is memory-mapped (File::SetMappedView()) and the value lives on the CPU,
+    // such arrays are not read but used in place, so that processes loading the same model share its pages.
+    // Text files use the regular matrix format.
+    static const size_t valuePageSize = 4096;
+
+    void SaveValuePageAligned(File& fstream) const
+    {
+        if (fstream.IsTextBased())
+        {
+            fstream << Value();
+            return;
+        }
+        const size_t numRows = Value().GetNumRows();
+        const size_t numCols = Value().GetNumCols();
+        const size_t numBytes = numRows * numCols * sizeof(ElemType);
+        fstream.PutMarker(fileMarkerBeginSection, std::wstring(L"BMAP"));
+        fstream << sizeof(ElemType) << numRows << numCols;
+        size_t padding = 0;
+        if (numBytes >= valuePageSize && fstream.CanSeek())
+        {
+            uint64_t dataPos = fstream.GetPosition() + sizeof(padding);
+            padding = (valuePageSize - dataPos % valuePageSize) % valuePageSize;
+        }
+        fstream << padding;
+        if (padding > 0)
+        {
+            std::vector<char> zeros(padding, 0);
+            fwriteOrDie(zeros.data(), 1, padding, fstream);
+        }
+        if (numBytes > 0)
+        {
+            if (Value().GetDeviceId() == CPUDEVICE)
+                fwriteOrDie(Value().Data(), sizeof(ElemType), numRows * numCols, fstream);
+            else
+            {
+                std::unique_ptr<ElemType[]> array(Value().CopyToArray());
+                fwriteOrDie(array.get(), sizeof(ElemType), numRows * numCols, fstream);
+            }
+        }
+        fstream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAP"));
+    }
+
+    void LoadValuePageAligned(File& fstream)
+    {
+        if (fstream.IsTextBased())
+            return LoadValue(fstream);
+        CreateMatrixIfNull(m_value);
+        fstream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAP"));
+        size_t elemSize, numRows, numCols, padding;
+        fstream >> elemSize >> numRows >> numCols >> padding;
+        if (elemSize != sizeof(ElemType))
+            RuntimeError("LoadValue: %ls %ls operation was saved with %d-byte elements, but %d-byte elements were expected.", NodeName().c_str(), OperationName().c_str(), (int) elemSize, (int) sizeof(ElemType));
+        const size_t numBytes = numRows * numCols * sizeof(ElemType);
+        const char* mapped = fstream.CanSeek() ? fstream.GetMappedView(fstream.GetPosition() + padding, numBytes) : nullptr;
+        if (mapped && numBytes >= valuePageSize && (uintptr_t) mapped % valuePageSize == 0 && Value().GetDeviceId() == CPUDEVICE)
+        {
+            // use the mapped pages in place; the matrix does not own them and cannot be resized
+            Value().SetValue(numRows, numCols, CPUDEVICE, (ElemType*) mapped, matrixFlagDontOwnBuffer);
+            fstream.SetPosition(fstream.GetPosition() + padding + numBytes);
+        }
+        else
+        {
+            if (padding > 0)
+            {
+                std::vector<char> zeros(padding);
+                freadOrDie(zeros.data(), 1, padding, fstream);
+            }
+            std::vector<ElemType> array(numRows * numCols);
+            if (numBytes > 0)
+                freadOrDie(array.data(), sizeof(ElemType), array.size(), fstream);
+            Value().SetValue(numRows, numCols, m_deviceId, array.data(), matrixFlagNormal);
+        }
+        fstream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAP"));
+        SetDims(TensorShape(numRows, numCols), false);
+    }
+
     // reader updated m_functionValue and MBLayout--ensure our internal state is consistent
     virtual void NotifyFunctionValuesMBSizeModified() override final
     {
@@ -1156,6 +1235,9 @@ public:
     MatrixBasePtr GradientPtr() const { return m_gradient; }
     // TODO: This is only used for testing whether a gradient has been allocated. Maybe reduce to bool HasGradient()?
 
+    // replace the gradient by a matrix object of its own, e.g. a view of a fused parameter arena
+    void SetGradientMatrix(Matrix<ElemType>&& gradient) { m_gradient = make_shared<Matrix<ElemType>>(std::move(gradient)); }
+
 private:
 
     template<class E>
@@ -1525,18 +1607,32 @@ protected:
             matrixPtr = make_shared<Matrix<ElemType>>(m_deviceId);
     }
 
-    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
+    // The pool plans sharing by size, so it must be told the size of each matrix requested from it.
+    // By default, a matrix is expected to have the shape of this node's output, which is the case for the value, the
+    // gradient, and many temporaries. Temporaries of another shape pass their size: 'numElements' per sample if 'mbScale'
+    // (the matrix has one column per minibatch column), else in total; or the node whose output shape they have.
+    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool, size_t numElements, bool mbScale)
     {
         if (matrixPtr == nullptr)
         {
-            matrixPtr = matrixPool.Request<ElemType>(m_deviceId);
+            matrixPool.Request<ElemType>(matrixPtr, this, m_deviceId, numElements, mbScale);
         }
     }
 
+    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
+    {
+        RequestMatrixFromPool(matrixPtr, matrixPool, GetSampleLayout().GetNumElements(), HasMBLayout());
+    }
+
+    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool, const ComputationNodeBasePtr& shapeOf)
+    {
+        RequestMatrixFromPool(matrixPtr, matrixPool, shapeOf->GetSampleLayout().GetNumElements(), shapeOf->HasMBLayout());
+    }
+
     void ReleaseMatrixToPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
     {
         assert(matrixPtr != nullptr);
-        matrixPool.Release<ElemType>(matrixPtr);
+        matrixPool.Release<ElemType>(matrixPtr, this, GetSampleLayout().GetNumElements(), HasMBLayout());
     }
 
 public:
@@ -1967,6 +2063,7 @@ protected:
     using Base::LinkToMBLayout;                                                                                                                          \
     using Base::Load;                                                                                                                                    \
     using Base::LoadValue;                                                                                                                               \
+    using Base::LoadValuePageAligned;                                                                                                                    \
     using Base::MaskMissingColumnsToZero;                                                                                                                \
     using Base::MaskMissingGradientColumnsToZero;                                                                                                        \
     using Base::MaskMissingValueColumnsToZero;                                                                                                           \
@@ -1984,6 +2081,7 @@ protected:
     using Base::RequestMatricesBeforeForwardProp;                                                                                                        \
     using Base::RequestMatrixFromPool;                                                                                                                   \
     using Base::Save;                                                                                                                                    \
+    using Base::SaveValuePageAligned;                                                                                                                    \
     using Base::SetDims1;                                                                                                                                \
     using Base::SetDims;                                                                                                                                 \
     using Base::SetInput;                                                                                                                                \
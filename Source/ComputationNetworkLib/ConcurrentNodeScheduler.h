@@ -0,0 +1,266 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ConcurrentNodeScheduler.h -- runs a DAG of tasks (the nodes of a network) on a small pool of threads
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// ConcurrentNodeScheduler -- used by PARTraversalFlowControlNode to run independent nodes at the same time
+//
+// Run() executes task i once all tasks it depends on are done, on whichever thread is free. Each thread keeps its own
+// queue of ready tasks: it pushes the tasks its own work has made ready and pops them LIFO, so that a chain of nodes
+// tends to stay on one thread; a thread that runs out of work steals the oldest task of another thread.
+//
+// Nodes parallelize internally with OpenMP (and BLAS). The scheduler shares the OpenMP thread budget of the calling
+// thread among the tasks that run at the same time: each task is started with an OpenMP thread count of the budget
+// divided by the number of tasks running, so that a lone node on the critical path still gets all cores.
+//
+// The calling thread takes part in the work. Only one Run() may be active at a time.
+// -----------------------------------------------------------------------
+
+class ConcurrentNodeScheduler
+{
+public:
+    // 'numThreads' includes the thread calling Run()
+    ConcurrentNodeScheduler(size_t numThreads)
+        : m_queues(std::max(numThreads, (size_t) 1))
+    {
+        for (auto& queue : m_queues)
+            queue.reset(new WorkQueue());
+        for (size_t w = 1; w < m_queues.size(); w++)
+            m_threads.emplace_back([this, w]
+                                   {
+                                       WorkerThread(w);
+                                   });
+    }
+
+    ~ConcurrentNodeScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_shutdown = true;
+        }
+        m_wakeUp.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    size_t GetNumThreads() const
+    {
+        return m_queues.size();
+    }
+
+    // run tasks [0, numDependencies.size()), where task i must wait for numDependencies[i] others to finish,
+    // and successors[i] are the tasks waiting for task i
+    // If a task throws, the tasks that have not started yet are skipped, and the first exception is rethrown here.
+    void Run(const std::vector<size_t>& numDependencies, const std::vector<std::vector<size_t>>& successors, const std::function<void(size_t)>& runTask)
+    {
+        size_t numTasks = numDependencies.size();
+        if (numTasks == 0)
+            return;
+
+        std::unique_ptr<std::atomic<size_t>[]> dependencies(new std::atomic<size_t>[numTasks]);
+        for (size_t i = 0; i < numTasks; i++)
+            dependencies[i] = numDependencies[i];
+#ifdef _OPENMP
+        int ompBudget = omp_get_max_threads();
+#else
+        int ompBudget = 1;
+#endif
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_run = RunState{ &successors, &runTask, dependencies.get(), numTasks, ompBudget };
+            m_exception = nullptr;
+            m_numQueued = 0;
+            m_numBusy = 0;
+            m_numWorkersInRun = m_threads.size();
+            m_runGeneration++;
+        }
+        for (size_t i = 0; i < numTasks; i++)
+            if (numDependencies[i] == 0)
+                Push(0, i);
+        m_wakeUp.notify_all();
+
+        WorkOnRun(0);
+
+        // the workers may still be looking at the run state; wait until they have let go of it
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_runDone.wait(lock, [this] { return m_numWorkersInRun == 0; });
+        m_run = RunState();
+#ifdef _OPENMP
+        omp_set_num_threads(ompBudget);
+#endif
+        if (m_exception)
+            std::rethrow_exception(m_exception);
+    }
+
+private:
+    struct WorkQueue
+    {
+        std::mutex m_mutex;
+        std::deque<size_t> m_tasks;
+    };
+
+    struct RunState
+    {
+        const std::vector<std::vector<size_t>>* m_successors;
+        const std::function<void(size_t)>* m_runTask;
+        std::atomic<size_t>* m_dependencies;
+        size_t m_numRemaining;  // tasks not finished yet
+        int m_ompBudget;
+    };
+
+    void Push(size_t w, size_t task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_queues[w]->m_mutex);
+            m_queues[w]->m_tasks.push_back(task);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_numQueued++;
+        }
+        m_wakeUp.notify_one();
+    }
+
+    // own queue first, newest task first; then steal the oldest task of another thread
+    bool TryPop(size_t w, size_t& task)
+    {
+        for (size_t k = 0; k < m_queues.size(); k++)
+        {
+            auto& queue = *m_queues[(w + k) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(queue.m_mutex);
+            if (queue.m_tasks.empty())
+                continue;
+            if (k == 0)
+            {
+                task = queue.m_tasks.back();
+                queue.m_tasks.pop_back();
+            }
+            else
+            {
+                task = queue.m_tasks.front();
+                queue.m_tasks.pop_front();
+            }
+            std::lock_guard<std::mutex> runLock(m_mutex);
+            m_numQueued--;
+            return true;
+        }
+        return false;
+    }
+
+    void Execute(size_t w, size_t task)
+    {
+        bool skip;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            skip = m_exception != nullptr;
+        }
+        if (!skip)
+        {
+            int numBusy = ++m_numBusy;
+#ifdef _OPENMP
+            omp_set_num_threads(std::max(1, m_run.m_ompBudget / numBusy));
+#endif
+            try
+            {
+                (*m_run.m_runTask)(task);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_exception)
+                    m_exception = std::current_exception();
+            }
+            m_numBusy--;
+        }
+
+        for (size_t successor : (*m_run.m_successors)[task])
+            if (--m_run.m_dependencies[successor] == 0)
+                Push(w, successor);
+
+        bool runDone;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            runDone = --m_run.m_numRemaining == 0;
+        }
+        if (runDone)
+            m_wakeUp.notify_all();
+    }
+
+    // work on the current run until all of its tasks are done
+    void WorkOnRun(size_t w)
+    {
+        for (;;)
+        {
+            size_t task;
+            if (TryPop(w, task))
+            {
+                Execute(w, task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait(lock, [this] { return m_numQueued > 0 || m_run.m_numRemaining == 0; });
+            if (m_run.m_numRemaining == 0)
+                return;
+        }
+    }
+
+    void WorkerThread(size_t w)
+    {
+        size_t generation = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wakeUp.wait(lock, [this, generation] { return m_shutdown || m_runGeneration != generation; });
+                if (m_shutdown)
+                    return;
+                generation = m_runGeneration;
+            }
+            WorkOnRun(w);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_numWorkersInRun--;
+            }
+            m_runDone.notify_all();
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues; // [w] ready tasks of thread w; thread 0 is the one calling Run()
+    std::vector<std::thread> m_threads;               // threads 1..
+
+    // all of the following is protected by m_mutex, except for m_numBusy and the task dependency counts, which are atomic
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;  // a task got queued, the run is done, a run starts, or shutdown
+    std::condition_variable m_runDone; // a worker has left the run
+    RunState m_run = RunState();
+    size_t m_runGeneration = 0;
+    size_t m_numQueued = 0;            // tasks in all queues
+    size_t m_numWorkersInRun = 0;      // workers that have not yet left the current run
+    std::atomic<int> m_numBusy{ 0 };   // tasks being executed
+    std::exception_ptr m_exception;
+    bool m_shutdown = false;
+};
+
+}}}
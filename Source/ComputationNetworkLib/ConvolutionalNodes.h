@@ -116,20 +116,43 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<ConvolutionNodeBase<ElemType>>(nodeP);
-            node->m_kernelShape = m_kernelShape;
-            node->m_mapCount = m_mapCount;
-            node->m_stride = m_stride;
-            node->m_sharing = m_sharing;
-            node->m_autoPad = m_autoPad;
-            node->m_lowerPad = m_lowerPad;
-            node->m_upperPad = m_upperPad;
-            node->m_poolKind = m_poolKind;
-            node->m_transpose = m_transpose;
-            node->m_imageLayout = m_imageLayout;
-            node->m_maxTempMemSizeInSamples = m_maxTempMemSizeInSamples;
+            CopyGeometryTo(*node);
         }
     }
 
+    // copy the convolution parameters to another node, which may be of a different type (e.g. a FusedConvolutionNode that replaces this node)
+    void CopyGeometryTo(ConvolutionNodeBase<ElemType>& node) const
+    {
+        node.m_kernelShape = m_kernelShape;
+        node.m_mapCount = m_mapCount;
+        node.m_stride = m_stride;
+        node.m_sharing = m_sharing;
+        node.m_autoPad = m_autoPad;
+        node.m_lowerPad = m_lowerPad;
+        node.m_upperPad = m_upperPad;
+        node.m_poolKind = m_poolKind;
+        node.m_transpose = m_transpose;
+        node.m_imageLayout = m_imageLayout;
+        node.m_maxTempMemSizeInSamples = m_maxTempMemSizeInSamples;
+    }
+
+    const TensorShape& KernelShape() const { return m_kernelShape; }
+    const TensorShape& MapCount() const { return m_mapCount; }
+    bool IsTransposed() const { return m_transpose; }
+    ImageLayoutKind GetImageLayoutKind() const { return m_imageLayout; }
+
+protected:
+    // The engines unfold the input into m_tempMatrix, one kernel-sized column per position of the (non-transposed)
+    // output image. This is the size per sample that the matrix pool plans with.
+    size_t TempMatrixSampleSize(size_t inputIndex) const
+    {
+        size_t mapCount = max(m_mapCount.GetNumElements(), (size_t)1);
+        size_t numPositions = max(GetSampleLayout().GetNumElements(), GetInputSampleLayout(inputIndex).GetNumElements()) / mapCount;
+        return m_kernelShape.GetNumElements() * numPositions;
+    }
+
+public:
+
     void DumpNodeInfo(const bool printValues, const bool printMetadata, File& fstream) const override
     {
         Base::DumpNodeInfo(printValues, printMetadata, fstream);
@@ -173,6 +196,7 @@ protected:                                  \
     using Base::m_maxTempMemSizeInSamples;  \
     using Base::m_tempMatrix;               \
     using Base::m_convEng;                  \
+    using Base::TempMatrixSampleSize;       \
 public:
 
 // -----------------------------------------------------------------------
@@ -395,7 +419,7 @@ public:
     void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_tempMatrix, matrixPool);
+        RequestMatrixFromPool(m_tempMatrix, matrixPool, TempMatrixSampleSize(1), HasMBLayout());
     }
 
     void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
@@ -416,6 +440,163 @@ protected:
     bool m_convolution2D;
 };
 
+// -----------------------------------------------------------------------
+// FusedConvolutionNode (convolutionWeights, inputFeature, bias)
+// Convolution plus a bias per output map, optionally followed by ReLU, where bias and ReLU are applied in a
+// single in-place pass over the output. ComputationNetwork::FoldBatchNormalization() creates these nodes for
+// inference, from a convolution and the batch normalization (and ReLU) that follow it. The geometry is copied from
+// the original ConvolutionNode after validation, so only the cudnn (CHW) layout is supported.
+// There is no gradient.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class FusedConvolutionNode : public ConvolutionNodeBase<ElemType>, public NumInputs<3>
+{
+    typedef ConvolutionNodeBase<ElemType> Base;
+    UsingConvolutionNodeBaseMembers;
+    static const std::wstring TypeName()
+    {
+        return L"FusedConvolution";
+    }
+
+public:
+    FusedConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, bool reLU = false)
+        : Base(deviceId, name), m_reLU(reLU)
+    {
+    }
+    FusedConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& kernelShape, const TensorShape& mapCount, const TensorShape& strideShape,
+                         const std::vector<bool>& sharing, const std::vector<bool>& autoPadding, const TensorShape& lowerPad, const TensorShape& upperPad,
+                         size_t maxTempMemSizeInSamples, bool reLU)
+                         : Base(deviceId, name, kernelShape, mapCount, strideShape, sharing, autoPadding, lowerPad, upperPad, PoolKind::None, false, ImageLayoutKind::CHW, maxTempMemSizeInSamples),
+                         m_reLU(reLU)
+    {
+    }
+    FusedConvolutionNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : FusedConvolutionNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"kernelShape"), configp->Get(L"mapCount"), configp->Get(L"strideShape"),
+                               configp->Get(L"dimSharing"), configp->Get(L"dimPadding"), configp->Get(L"dimPadLower"), configp->Get(L"dimPadUpper"),
+                               configp->Get(L"maxTempMemSizeInSamples"), configp->Get(L"reLU"))
+    {
+        AttachInputsFromConfig(configp, GetExpectedNumInputs());
+    }
+
+    void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_reLU;
+    }
+
+    void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_reLU;
+    }
+
+    void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<FusedConvolutionNode<ElemType>>(nodeP);
+            node->m_reLU = m_reLU;
+        }
+    }
+
+    void ForwardProp(const FrameRange& fr) override
+    {
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+        const Matrix<ElemType>& input0 = Input(0)->ValueAsMatrix();
+        Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
+        m_convEng->Forward(sliceInput1Value, input0, sliceOutputValue, *m_tempMatrix);
+
+        // add the bias (broadcast over the image) and apply the ReLU, in place
+        size_t rank = GetSampleLayout().GetRank();
+        auto output = ValueTensorFor(rank, fr);
+        auto bias = Input(2)->ValueTensorFor(rank, fr.AllowBroadcast());
+        if (m_reLU)
+            output.AssignLinearRectifierOfSumOf(output, bias);
+        else
+            output.AssignSumOf(output, bias);
+    }
+
+    void BackpropTo(const size_t /*inputIndex*/, const FrameRange& /*fr*/) override
+    {
+        LogicError("%ls %ls operation is for inference only and cannot be trained.", NodeName().c_str(), OperationName().c_str());
+    }
+
+    bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+    void Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+        if (m_imageLayout != ImageLayoutKind::CHW || m_transpose)
+            InvalidArgument("%ls %ls supports only non-transposed convolutions in cuDNN (CHW) data layout.", NodeName().c_str(), OperationName().c_str());
+
+        auto inputShape = GetInputSampleLayout(1);
+        auto outputShape = ConvolveGeometry::ComputeOutputShape(inputShape, m_kernelShape, m_mapCount, m_stride,
+                                                                m_sharing, m_autoPad, m_lowerPad, m_upperPad);
+        SetDims(outputShape, HasMBLayout());
+
+        if (isFinalValidationPass)
+        {
+            if (m_convEng == nullptr)
+            {
+                auto geometry = std::make_shared<ConvolveGeometry>(inputShape, m_kernelShape, m_mapCount, m_stride,
+                                                                   m_sharing, m_autoPad, m_lowerPad, m_upperPad);
+                m_convEng = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, m_imageLayout,
+                                                                m_maxTempMemSizeInSamples, m_poolKind,
+                                                                ConvolutionEngineKind::All, NodeName());
+            }
+
+            if (Input(0)->GetAsMatrixNumCols() != m_kernelShape.GetNumElements() ||
+                Input(0)->GetAsMatrixNumRows() != m_convEng->Geometry()->KernelCount())
+            {
+                LogicError("Convolution weight matrix %ls should have dimension [%d, %d] which is [kernelCount, kernelWidth * kernelHeight * inputChannels]",
+                           Input(0)->NodeName().c_str(), (int)m_convEng->Geometry()->KernelCount(), (int)m_kernelShape.GetNumElements());
+            }
+
+            // one bias per output map, i.e. [1 x ... x 1 x outputChannels]
+            const auto& biasShape = Input(2)->GetSampleLayout();
+            size_t numMaps = outputShape[outputShape.GetRank() - 1];
+            if (Input(2)->HasMBLayout() || biasShape.GetRank() != outputShape.GetRank() || biasShape.GetNumElements() != numMaps ||
+                biasShape[biasShape.GetRank() - 1] != numMaps)
+            {
+                InvalidArgument("%ls %ls: The bias %ls should have the shape [%s], with one value per output map.", NodeName().c_str(), OperationName().c_str(),
+                                Input(2)->NodeName().c_str(), string(BiasShape(outputShape)).c_str());
+            }
+        }
+    }
+
+    // shape of the bias for a given output shape: all ones except for the last (map) dimension
+    static TensorShape BiasShape(const TensorShape& outputShape)
+    {
+        SmallVector<size_t> dims(outputShape.GetRank(), 1);
+        dims[dims.size() - 1] = outputShape[outputShape.GetRank() - 1];
+        return TensorShape(dims);
+    }
+
+    void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_tempMatrix, matrixPool, TempMatrixSampleSize(1), HasMBLayout());
+    }
+
+    // (no backprop, so the workspace can go back to the pool right away)
+    void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        ReleaseMatrixToPool(m_tempMatrix, matrixPool);
+    }
+
+    bool IsReLUFused() const { return m_reLU; }
+
+protected:
+    // Whether ReLU is applied after adding the bias.
+    bool m_reLU;
+};
+
 // -----------------------------------------------------------------------
 // PoolingNode (inputFeature)
 // Performs max or average ND pooling.
@@ -110,9 +110,10 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_maxIndexes0, matrixPool);
-        RequestMatrixFromPool(m_maxIndexes1, matrixPool);
-        RequestMatrixFromPool(m_maxValues, matrixPool);
+        // these hold the top-K indexes resp. values of each column of the inputs
+        RequestMatrixFromPool(m_maxIndexes0, matrixPool, m_topK, Input(0)->HasMBLayout());
+        RequestMatrixFromPool(m_maxIndexes1, matrixPool, m_topK, Input(0)->HasMBLayout());
+        RequestMatrixFromPool(m_maxValues, matrixPool, m_topK, Input(0)->HasMBLayout());
     }
 
     // release temp matrices that are only used by forward computation
@@ -8,6 +8,7 @@
 #include "ComputationNode.h"
 #include "Matrix.h"
 #include "TensorView.h"
+#include "QuantizedMultiplier.h"
 
 #include <unordered_set>
 #include <map>
@@ -240,6 +241,7 @@ public:
         {
             auto node = dynamic_pointer_cast<TimesNodeBase<ElemType, m_transpose>>(nodeP);
             node->m_outputRank = m_outputRank;
+            node->m_quantizedMultiplier = m_quantizedMultiplier; // (immutable once created, so copies can share it)
         }
     }
 
@@ -290,6 +292,16 @@ public:
             return;
         }
 
+        // quantized inference: int16 product against the weights that were quantized once in SetQuantized()
+        if (m_quantizedMultiplier && Environment().IsInferring() && QuantizedMultiplier<ElemType>::IsSupported(Input(1)->Value()))
+        {
+            auto input1 = Input(1)->ValueFor(fr.AllowBroadcast());
+            size_t numCols = input1.GetNumElements() / m_quantizedMultiplier->GetInputDim(); // flatten trailing dimensions of B
+            auto output = ValueFor(fr).Reshaped(m_quantizedMultiplier->GetOutputDim(), numCols);
+            m_quantizedMultiplier->Multiply(input1.Reshaped(m_quantizedMultiplier->GetInputDim(), numCols), output);
+            return;
+        }
+
         // TensorView::DoMatrixProductOf() will reduce each tensor object into a 2D tensor (or fail if it cannot)
         // and recreate actual Matrix objects (in case of sparse, they must be identical to the original tensor storage object).
         // Transposition is applied after flattening into 2D, but only allowed if the input sample is 2D anyway.
@@ -453,8 +465,29 @@ public:
         Base::AllocateGradientMatricesForInputs(matrixPool);
     }
 
+    // switch the forward computation to the int16 quantized CPU product (inference only; see QuantizedMultiplier)
+    // The left operand must not change anymore, since it is quantized right here, once.
+    // Returns false if the operands are not supported, in which case the regular product remains in use.
+    bool SetQuantized(bool quantized)
+    {
+        m_quantizedMultiplier.reset();
+        const auto& weights = Input(0)->Value();
+        if (!quantized || Input(0)->HasMBLayout() || !QuantizedMultiplier<ElemType>::IsSupported(weights) || weights.GetNumElements() == 0)
+            return false;
+
+        // flatten the left operand into a matrix the same way DoMatrixProductOf() does
+        auto dimsA = Input(0)->GetSampleLayout().GetDims();
+        size_t numRowDims = m_transpose ? 1 : m_outputRank; // (transposition is only allowed for 1D or 2D tensors)
+        size_t numRows = 1;
+        for (size_t k = 0; k < numRowDims && k < dimsA.size(); k++)
+            numRows *= dimsA[k];
+        m_quantizedMultiplier = make_shared<QuantizedMultiplier<ElemType>>(weights.Reshaped(numRows, weights.GetNumElements() / numRows), m_transpose);
+        return true;
+    }
+
 private:
     size_t m_outputRank;
+    shared_ptr<QuantizedMultiplier<ElemType>> m_quantizedMultiplier; // set if the quantized inference path is enabled
 };
 
 // -----------------------------------------------------------------------
@@ -919,8 +952,8 @@ public:
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_leftTerm, matrixPool);
-        RequestMatrixFromPool(m_rightTerm, matrixPool);
+        RequestMatrixFromPool(m_leftTerm, matrixPool, Input(0));
+        RequestMatrixFromPool(m_rightTerm, matrixPool, Input(0));
         RequestMatrixFromPool(m_temp, matrixPool);
     }
 
@@ -1230,18 +1263,19 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_invNorm0, matrixPool);
-        RequestMatrixFromPool(m_invNorm1, matrixPool);
-        RequestMatrixFromPool(m_leftTerm, matrixPool);
-        RequestMatrixFromPool(m_rightTerm, matrixPool);
+        // the norms are one value per column, the terms have the shape of the inputs
+        RequestMatrixFromPool(m_invNorm0, matrixPool, 1, Input(0)->HasMBLayout());
+        RequestMatrixFromPool(m_invNorm1, matrixPool, 1, Input(0)->HasMBLayout());
+        RequestMatrixFromPool(m_leftTerm, matrixPool, Input(0));
+        RequestMatrixFromPool(m_rightTerm, matrixPool, Input(0));
     }
 
     // request matrices that are needed for gradient computation
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_invNormSquare, matrixPool);
-        RequestMatrixFromPool(m_temp, matrixPool);
+        RequestMatrixFromPool(m_invNormSquare, matrixPool, 1, Input(0)->HasMBLayout());
+        RequestMatrixFromPool(m_temp, matrixPool, 1, Input(0)->HasMBLayout());
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -8,7 +8,10 @@
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include <map>
 #include <algorithm>
+#include <climits>
+#include <functional>
 #include <stdlib.h>
 
 #include "Basics.h"
@@ -17,59 +20,279 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class ComputationNodeBase;
+
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
 // Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
+//
+// Sharing is planned ahead of time rather than decided on the fly:
+//  - ComputationNetwork::AllocateAllMatrices() simulates the evaluation order and calls Request() and Release() in that order.
+//    Request() hands out an empty placeholder matrix and records the step at which the matrix becomes live,
+//    together with its expected size (elements per sample, and whether it scales with the minibatch size).
+//    Release() records the step after which it is dead. [allocStep, releaseStep] is the liveness interval.
+//  - OptimizedMemoryAllocation() then assigns the requests to buffers such that the liveness intervals of all requests
+//    sharing a buffer are disjoint. Requests are processed from largest to smallest, and each goes to the smallest
+//    compatible buffer that is large enough (best fit), so that large and small matrices do not end up in the same buffer,
+//    which would make the small users' buffer grow to the large size. Finally, the placeholders are replaced by the buffers.
+//  - Disjoint liveness intervals are enough as long as the nodes run one at a time, in the simulated order. If independent
+//    nodes may run concurrently (see ComputationNetwork::SetConcurrentScheduling()), OptimizedMemoryAllocation() is given a
+//    predicate that additionally tells whether all users of one matrix are guaranteed to be done before the first user of
+//    another one starts, and only then lets the two share a buffer.
 class MatrixPool
 {
-    vector<shared_ptr<Matrix<float>>>  m_releasedFloatMatrices;
-    vector<shared_ptr<Matrix<double>>> m_releasedDoubleMatrices;
+public:
+    // can a buffer be handed over from the request owned by 'releaseOwner', released at step 'releaseStep',
+    // to the one owned by 'requestOwner', requested at step 'requestStep'?
+    typedef std::function<bool(const ComputationNodeBase* releaseOwner, int releaseStep, const ComputationNodeBase* requestOwner, int requestStep)> ReuseOrderPredicate;
+
+private:
+    // a matrix requested from the pool, or released to it without having been requested (which makes it available for sharing)
+    template <class ElemType>
+    struct MemRequestInfo
+    {
+        shared_ptr<Matrix<ElemType>>* m_pMatrixPtr; // where the requester keeps the matrix; nullptr if released without request
+        shared_ptr<Matrix<ElemType>> m_matrix;      // placeholder handed out by Request(), or the released matrix
+        const ComputationNodeBase* m_owner;         // node whose matrix this is
+        DEVICEID_TYPE m_deviceId;
+        size_t m_numElements;                       // expected size: elements per sample if m_mbScale, else elements
+        bool m_mbScale;                             // size scales with the number of minibatch columns
+        int m_allocStep;
+        int m_releaseStep;                          // INT_MAX if never released
+    };
+
+    // a planned buffer, shared by requests with disjoint liveness intervals
+    template <class ElemType>
+    struct MemAllocInfo
+    {
+        shared_ptr<Matrix<ElemType>> m_matrix;
+        DEVICEID_TYPE m_deviceId;
+        size_t m_numElementsPerSample;              // largest size of all minibatch-scaled users
+        size_t m_numElements;                       // largest size of all fixed-size users
+        std::map<int, const MemRequestInfo<ElemType>*> m_occupancy; // [allocStep -> request] of all users
 
+        // Only the neighbors in time need to be checked against the reuse order, since both the order of the intervals
+        // and the reuse order are transitive.
+        bool IsFree(const MemRequestInfo<ElemType>& request, const ReuseOrderPredicate& canReuse) const
+        {
+            auto next = m_occupancy.lower_bound(request.m_allocStep);
+            if (next != m_occupancy.end())
+            {
+                if (next->first <= request.m_releaseStep)
+                    return false;
+                if (canReuse && !canReuse(request.m_owner, request.m_releaseStep, next->second->m_owner, next->first))
+                    return false;
+            }
+            if (next != m_occupancy.begin())
+            {
+                const auto& prev = *(--next)->second;
+                if (prev.m_releaseStep >= request.m_allocStep)
+                    return false;
+                if (canReuse && !canReuse(prev.m_owner, prev.m_releaseStep, request.m_owner, request.m_allocStep))
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    // what is kept of a buffer after planning, for reporting planned vs. actual memory
+    template <class ElemType>
+    struct BufferUsageInfo
+    {
+        weak_ptr<Matrix<ElemType>> m_matrix;
+        size_t m_numElementsPerSample;
+        size_t m_numElements;
+    };
+
+    vector<MemRequestInfo<float>>  m_floatRequests;
+    vector<MemRequestInfo<double>> m_doubleRequests;
+    vector<BufferUsageInfo<float>>  m_floatBuffers;
+    vector<BufferUsageInfo<double>> m_doubleBuffers;
+    std::map<const void*, size_t> m_requestIndex; // [placeholder or released matrix -> index into m_floatRequests or m_doubleRequests]
+    int m_stepCounter = 0;
+
+    template <class ElemType>
+    vector<MemRequestInfo<ElemType>>& GetMemRequests();
     template <class ElemType>
-    vector<shared_ptr<Matrix<ElemType>>>& GetReleasedMatrices();
+    vector<BufferUsageInfo<ElemType>>& GetBuffers();
+
+    template <class ElemType>
+    MemRequestInfo<ElemType>* FindRequest(const shared_ptr<Matrix<ElemType>>& matrix)
+    {
+        auto iter = m_requestIndex.find(matrix.get());
+        return iter != m_requestIndex.end() ? &GetMemRequests<ElemType>()[iter->second] : nullptr;
+    }
+
+    template <class ElemType>
+    MemRequestInfo<ElemType>& AddRequest(const MemRequestInfo<ElemType>& request)
+    {
+        vector<MemRequestInfo<ElemType>>& requests = GetMemRequests<ElemType>();
+        m_requestIndex[request.m_matrix.get()] = requests.size();
+        requests.push_back(request);
+        return requests.back();
+    }
+
+    // order in which requests get assigned to buffers: minibatch-scaled ones first, then by decreasing size
+    template <class ElemType>
+    static bool IsLarger(const MemRequestInfo<ElemType>& a, const MemRequestInfo<ElemType>& b)
+    {
+        if (a.m_mbScale != b.m_mbScale)
+            return a.m_mbScale;
+        if (a.m_numElements != b.m_numElements)
+            return a.m_numElements > b.m_numElements;
+        return a.m_allocStep < b.m_allocStep;
+    }
+
+    // how much a buffer needs to grow to accommodate a request (0 if it fits)
+    template <class ElemType>
+    static size_t GrowthFor(const MemAllocInfo<ElemType>& buffer, const MemRequestInfo<ElemType>& request)
+    {
+        size_t current = request.m_mbScale ? buffer.m_numElementsPerSample : buffer.m_numElements;
+        return request.m_numElements > current ? request.m_numElements - current : 0;
+    }
+
+    template <class ElemType>
+    static size_t BytesFor(size_t numElementsPerSample, size_t numElements, size_t numSamples)
+    {
+        return max(numElementsPerSample * numSamples, numElements) * sizeof(ElemType);
+    }
 
 public:
     // release here means the matrix can be put back and shared by others
+    // 'owner' is the node whose matrix this is
     template <class ElemType>
-    void Release(shared_ptr<Matrix<ElemType>> freeMatrix)
+    void Release(shared_ptr<Matrix<ElemType>> freeMatrix, const ComputationNodeBase* owner, size_t numElements = 0, bool mbScale = false)
     {
         if (freeMatrix == nullptr || freeMatrix->GetMatrixType() == SPARSE)
             LogicError("MatrixPool::Release: freeMatrix should not be null or sparse.");
 //#define SUPRESS_MEMSHARING // #define this to disable memory sharing through this structure
         // TODO: Make this a runtime option.
 #ifndef SUPRESS_MEMSHARING
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
+        MemRequestInfo<ElemType>* request = FindRequest(freeMatrix);
 #ifdef _DEBUG
-        for (int i = 0; i < releasedMatrices.size(); i++)
-        {
-            if (releasedMatrices[i] == freeMatrix)
-                RuntimeError("MatrixPool::Release: freeMatrix is already in the released pool.");
-        }
-
+        if (request && request->m_releaseStep != INT_MAX)
+            RuntimeError("MatrixPool::Release: freeMatrix is already in the released pool.");
 #endif
-        releasedMatrices.push_back(freeMatrix);
+        if (!request) // not requested from us: the matrix itself becomes available for sharing from now on
+            request = &AddRequest(MemRequestInfo<ElemType>{ nullptr, freeMatrix, owner, freeMatrix->GetDeviceId(), numElements, mbScale, 0, INT_MAX });
+        request->m_releaseStep = m_stepCounter++; // (if released twice, the later release counts)
 #endif
     }
 
+    // hands out an empty placeholder in 'matrixPtr', which OptimizedMemoryAllocation() will later replace by the shared buffer
+    // 'numElements' is the expected size of the matrix, per sample if 'mbScale'; it is only used for planning
+    // 'owner' is the node the matrix is requested for
+    template <class ElemType>
+    void Request(shared_ptr<Matrix<ElemType>>& matrixPtr, const ComputationNodeBase* owner, DEVICEID_TYPE deviceId, size_t numElements, bool mbScale)
+    {
+        matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+        if (!matrixPtr) // this can't really happen
+            LogicError("MatrixPool::Request: failed to get a valid matrix.");
+
+        AddRequest(MemRequestInfo<ElemType>{ &matrixPtr, matrixPtr, owner, deviceId, numElements, mbScale, m_stepCounter++, INT_MAX });
+    }
+
+    // the step the next Request() or Release() will be recorded at
+    int GetStep() const
+    {
+        return m_stepCounter;
+    }
+
+    // assign all requests made so far to shared buffers and hand the buffers to the requesters
+    // Must be called once all Request() and Release() calls have been made, and before any of the matrices is used.
+    // If 'canReuse' is given, two requests only share a buffer if it allows handing the buffer over from the earlier to the later.
     template <class ElemType>
-    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId)
+    void OptimizedMemoryAllocation(const ReuseOrderPredicate& canReuse = nullptr)
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
-        shared_ptr<Matrix<ElemType>> matrixPtr;
-        if (releasedMatrices.empty())
+        vector<MemRequestInfo<ElemType>>& requests = GetMemRequests<ElemType>();
+        vector<MemAllocInfo<ElemType>> buffers;
+
+        // matrices released without request keep their identity, so each seeds a buffer of its own
+        vector<MemRequestInfo<ElemType>*> sortedRequests;
+        for (auto& request : requests)
         {
-            matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+            if (request.m_pMatrixPtr)
+                sortedRequests.push_back(&request);
+            else
+            {
+                buffers.push_back(MemAllocInfo<ElemType>{ request.m_matrix, request.m_deviceId, 0, 0 });
+                buffers.back().m_occupancy[request.m_allocStep] = &request;
+                (request.m_mbScale ? buffers.back().m_numElementsPerSample : buffers.back().m_numElements) = request.m_numElements;
+            }
         }
-        else
+        sort(sortedRequests.begin(), sortedRequests.end(), [](const MemRequestInfo<ElemType>* a, const MemRequestInfo<ElemType>* b) { return IsLarger(*a, *b); });
+
+        size_t numUnsharedElementsPerSample = 0, numUnsharedElements = 0;
+        for (auto request : sortedRequests)
         {
-            matrixPtr = releasedMatrices.back();
-            releasedMatrices.pop_back();
+            (request->m_mbScale ? numUnsharedElementsPerSample : numUnsharedElements) += request->m_numElements;
+
+            // best fit: among the buffers that are free during the request's lifetime,
+            // take the one that needs to grow least, and among those the smallest
+            MemAllocInfo<ElemType>* bestBuffer = nullptr;
+            for (auto& buffer : buffers)
+            {
+                if (buffer.m_deviceId != request->m_deviceId || !buffer.IsFree(*request, canReuse))
+                    continue;
+                if (!bestBuffer)
+                    bestBuffer = &buffer;
+                else
+                {
+                    size_t growth = GrowthFor(buffer, *request), bestGrowth = GrowthFor(*bestBuffer, *request);
+                    if (growth < bestGrowth ||
+                        (growth == bestGrowth && make_pair(buffer.m_numElementsPerSample, buffer.m_numElements) < make_pair(bestBuffer->m_numElementsPerSample, bestBuffer->m_numElements)))
+                        bestBuffer = &buffer;
+                }
+            }
+            if (!bestBuffer)
+            {
+                buffers.push_back(MemAllocInfo<ElemType>{ make_shared<Matrix<ElemType>>(request->m_deviceId), request->m_deviceId, 0, 0 });
+                bestBuffer = &buffers.back();
+            }
+
+            bestBuffer->m_occupancy[request->m_allocStep] = request;
+            size_t& bufferSize = request->m_mbScale ? bestBuffer->m_numElementsPerSample : bestBuffer->m_numElements;
+            bufferSize = max(bufferSize, request->m_numElements);
+            *request->m_pMatrixPtr = bestBuffer->m_matrix;
         }
 
-        if (!matrixPtr) // this can't really happen
-            LogicError("MatrixPool::Request: failed to get a valid matrix.");
+        size_t numPlannedElementsPerSample = 0, numPlannedElements = 0;
+        vector<BufferUsageInfo<ElemType>>& bufferUsage = GetBuffers<ElemType>();
+        for (const auto& buffer : buffers)
+        {
+            numPlannedElementsPerSample += buffer.m_numElementsPerSample;
+            numPlannedElements += buffer.m_numElements;
+            bufferUsage.push_back(BufferUsageInfo<ElemType>{ buffer.m_matrix, buffer.m_numElementsPerSample, buffer.m_numElements });
+        }
+
+        if (!sortedRequests.empty())
+            fprintf(stderr, "MatrixPool: %d matrices planned into %d shared buffers: %.1f KB per sample + %.1f KB (without sharing: %.1f KB per sample + %.1f KB).\n",
+                    (int) sortedRequests.size(), (int) buffers.size(),
+                    numPlannedElementsPerSample * sizeof(ElemType) / 1024.0, numPlannedElements * sizeof(ElemType) / 1024.0,
+                    numUnsharedElementsPerSample * sizeof(ElemType) / 1024.0, numUnsharedElements * sizeof(ElemType) / 1024.0);
+
+        // the plan is final; drop the placeholders and the pointers into the requesters
+        for (const auto& request : requests)
+            m_requestIndex.erase(request.m_matrix.get());
+        requests.clear();
+    }
 
-        return matrixPtr;
+    // compare the memory planned by OptimizedMemoryAllocation() for a minibatch of 'numSamples' columns to what the buffers actually hold
+    // Buffers grow to the largest minibatch they have seen, so 'numSamples' should be the largest minibatch size.
+    template <class ElemType>
+    void PrintMemoryUsage(size_t numSamples)
+    {
+        size_t plannedBytes = 0, actualBytes = 0;
+        for (const auto& buffer : GetBuffers<ElemType>())
+        {
+            plannedBytes += BytesFor<ElemType>(buffer.m_numElementsPerSample, buffer.m_numElements, numSamples);
+            auto matrix = buffer.m_matrix.lock();
+            if (matrix)
+                actualBytes += matrix->BufferSize();
+        }
+        if (!GetBuffers<ElemType>().empty())
+            fprintf(stderr, "MatrixPool: %d shared buffers, planned peak %.2f MB for %d samples, actually allocated %.2f MB.\n",
+                    (int) GetBuffers<ElemType>().size(), plannedBytes / (1024.0 * 1024.0), (int) numSamples, actualBytes / (1024.0 * 1024.0));
     }
 };
 
@@ -227,7 +227,7 @@ public:
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_gradientTemp, matrixPool);
+        RequestMatrixFromPool(m_gradientTemp, matrixPool, 1, HasMBLayout()); // one inner product resp. sum per column
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -0,0 +1,507 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// RecurrentNodes.cpp -- implementation of the fused LSTM node (the delay nodes are implemented in the header)
+//
+
+#include "Basics.h"
+#include "RecurrentNodes.h"
+#include "Matrix.h"
+#include "TensorOps.h"
+#include "ComputationNode.h"
+#include "Sequences.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <assert.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// OptimizedLSTMNode
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+/*virtual*/ void OptimizedLSTMNode<ElemType>::CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const /*override*/
+{
+    Base::CopyTo(nodeP, newName, flags);
+    if (flags & CopyNodeFlags::copyNodeValue)
+    {
+        auto node = dynamic_pointer_cast<OptimizedLSTMNode<ElemType>>(nodeP);
+        node->m_direction               = m_direction;
+        node->m_initialHiddenActivation = m_initialHiddenActivation;
+        node->m_initialCellActivation   = m_initialCellActivation;
+        node->m_carriedState.SetValue(m_carriedState);
+    }
+}
+
+template <class ElemType>
+/*virtual*/ void OptimizedLSTMNode<ElemType>::Load(File& fstream, size_t modelVersion) /*override*/
+{
+    Base::Load(fstream, modelVersion);
+    fstream >> m_direction >> m_initialHiddenActivation >> m_initialCellActivation;
+}
+
+template <class ElemType>
+/*virtual*/ void OptimizedLSTMNode<ElemType>::Save(File& fstream) const /*override*/
+{
+    Base::Save(fstream);
+    fstream << m_direction << m_initialHiddenActivation << m_initialCellActivation;
+}
+
+template <class ElemType>
+/*virtual*/ void OptimizedLSTMNode<ElemType>::Validate(bool isFinalValidationPass) /*override*/
+{
+    Base::Validate(isFinalValidationPass);
+    InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+    if (GetNumInputs() != numInputsWithoutPeepholes && GetNumInputs() != numInputsWithPeepholes)
+        InvalidArgument("%ls operation requires %d inputs, or %d with peephole weights.", NodeDescription().c_str(), (int) numInputsWithoutPeepholes, (int) numInputsWithPeepholes);
+    if (m_direction != -1 && m_direction != +1)
+        InvalidArgument("%ls: Invalid direction %d; must be -1 (left-to-right) or +1 (right-to-left).", NodeDescription().c_str(), m_direction);
+
+    // the cell dimension is that of the first weight matrix
+    let& weightShape = Input(WeightInputIndex(inputGate))->GetSampleLayout();
+    size_t cellDim = weightShape.GetRank() > 0 ? weightShape[0] : 0;
+    SetDims(TensorShape(cellDim), HasMBLayout());
+
+    if (isFinalValidationPass)
+    {
+        if (!HasMBLayout())
+            InvalidArgument("%ls: The input must be a sequence.", NodeDescription().c_str());
+        if (m_deviceId != CPUDEVICE)
+            InvalidArgument("%ls: This operation is currently only implemented for the CPU.", NodeDescription().c_str());
+
+        // all parameters must be non-minibatch inputs of matching dimensions
+        size_t inputDim = Input(0)->GetSampleLayout().GetNumElements();
+        auto verifyParameterShape = [&](size_t inputIndex, size_t rows, size_t cols)
+        {
+            let& shape = Input(inputIndex)->GetSampleLayout();
+            bool isValid = cols == 1 ? shape.GetRank() > 0 && shape[0] == rows && shape.GetNumElements() == rows
+                                     : shape.GetRank() == 2 && shape[0] == rows && shape[1] == cols;
+            if (!isValid || Input(inputIndex)->HasMBLayout())
+                InvalidArgument("%ls: Input %d (%ls) must be a [%d x %d] parameter, but has shape [%s]%s.", NodeDescription().c_str(),
+                                (int) inputIndex, Input(inputIndex)->NodeName().c_str(), (int) rows, (int) cols, string(shape).c_str(), Input(inputIndex)->HasMBLayout() ? " and a minibatch layout" : "");
+        };
+        for (size_t gate = 0; gate < numGates; gate++)
+        {
+            verifyParameterShape(WeightInputIndex(gate),          cellDim, inputDim);
+            verifyParameterShape(RecurrentWeightInputIndex(gate), cellDim, cellDim);
+            verifyParameterShape(BiasInputIndex(gate),            cellDim, 1);
+            if (HasPeepholes() && gate != cellInput)
+                verifyParameterShape(PeepholeInputIndex(gate),    cellDim, 1);
+        }
+    }
+}
+
+// copy the parameters of the individual gates into the stacked matrices, so that each projection is a single GEMM
+template <class ElemType>
+void OptimizedLSTMNode<ElemType>::StackParameters()
+{
+    size_t cellDim = CellDim();
+    size_t inputDim = Input(0)->GetSampleLayout().GetNumElements();
+    m_stackedW.Resize(numGates * cellDim, inputDim);
+    m_stackedR.Resize(numGates * cellDim, cellDim);
+    m_stackedB.Resize(numGates * cellDim, 1);
+    for (size_t gate = 0; gate < numGates; gate++)
+    {
+        m_stackedW.AssignToRowSliceValuesOf(Input(WeightInputIndex(gate))->Value().Reshaped(cellDim, inputDim), gate * cellDim, cellDim);
+        m_stackedR.AssignToRowSliceValuesOf(Input(RecurrentWeightInputIndex(gate))->Value().Reshaped(cellDim, cellDim), gate * cellDim, cellDim);
+        m_stackedB.AssignToRowSliceValuesOf(Input(BiasInputIndex(gate))->Value().Reshaped(cellDim, 1), gate * cellDim, cellDim);
+    }
+}
+
+// determine for each column where its h(t-1) and c(t-1) come from
+template <class ElemType>
+void OptimizedLSTMNode<ElemType>::DeterminePredecessors()
+{
+    size_t numParallelSequences = GetNumParallelSequences();
+    ptrdiff_t numTimeSteps = (ptrdiff_t) GetNumTimeSteps();
+    m_predecessors.assign(numParallelSequences * numTimeSteps, gap);
+    bool needsCarriedState = false;
+    for (const auto& seq : m_pMBLayout->GetAllSequences())
+    {
+        if (seq.seqId == GAP_SEQUENCE_ID)
+            continue;
+        ptrdiff_t tEnd = min((ptrdiff_t) seq.tEnd, numTimeSteps);
+        for (ptrdiff_t t = max(seq.tBegin, (ptrdiff_t) 0); t < tEnd; t++)
+        {
+            ptrdiff_t& predecessor = m_predecessors[t * numParallelSequences + seq.s];
+            ptrdiff_t tPrev = t + m_direction;
+            if (tPrev < seq.tBegin || tPrev >= (ptrdiff_t) seq.tEnd)
+                predecessor = initialState; // sequence boundary
+            else if (tPrev >= numTimeSteps)
+                InvalidArgument("%ls: A sequence extends beyond the end of the minibatch, which is not supported for right-to-left recurrence. Possibly there is no sentence end marker in the MBLayout.", NodeDescription().c_str());
+            else if (tPrev < 0)
+            {
+                predecessor = carriedState; // sequence began in the previous minibatch (truncated BPTT)
+                needsCarriedState = true;
+            }
+            else
+                predecessor = tPrev * numParallelSequences + seq.s;
+        }
+    }
+    if (needsCarriedState && (m_carriedState.GetNumRows() != 2 * CellDim() || m_carriedState.GetNumCols() != numParallelSequences))
+        InvalidArgument("%ls: Tried to access past values that are out of bound, possibly because there is no sentence start marker in the MBLayout.", NodeDescription().c_str());
+}
+
+template <class ElemType>
+/*virtual*/ void OptimizedLSTMNode<ElemType>::ForwardProp(const FrameRange& fr) /*override*/
+{
+    if (!fr.IsAllFrames())
+        LogicError("%ls: This node implements the recurrence itself and cannot be part of a recurrent loop.", NodeDescription().c_str());
+
+    const size_t cellDim = CellDim();
+    const size_t numParallelSequences = GetNumParallelSequences();
+    const size_t numTimeSteps = GetNumTimeSteps();
+    const size_t numCols = numParallelSequences * numTimeSteps;
+    const bool hasPeepholes = HasPeepholes();
+
+    StackParameters();
+    DeterminePredecessors();
+
+    // input projections of all frames in one go (gaps may hold garbage, which must not get into the GEMM)
+    Input(0)->MaskMissingValueColumnsToZero(fr);
+    Matrix<ElemType>::Multiply(m_stackedW, false, Input(0)->ValueFor(fr), false, *m_gates);
+    m_cell->Resize(cellDim, numCols);
+    m_prevHidden->Resize(cellDim, numCols);
+    m_prevCell->Resize(cellDim, numCols);
+
+    Matrix<ElemType> output = ValueFor(fr);
+    ElemType* hidden = output.Data();
+    ElemType* gates = m_gates->Data();
+    ElemType* cell = m_cell->Data();
+    ElemType* prevHidden = m_prevHidden->Data();
+    ElemType* prevCell = m_prevCell->Data();
+    const ElemType* carried = m_carriedState.IsEmpty() ? nullptr : m_carriedState.Data();
+    const ElemType* bias = m_stackedB.Data();
+    const ElemType* peepholeI = hasPeepholes ? Input(PeepholeInputIndex(inputGate))->Value().Data() : nullptr;
+    const ElemType* peepholeF = hasPeepholes ? Input(PeepholeInputIndex(forgetGate))->Value().Data() : nullptr;
+    const ElemType* peepholeO = hasPeepholes ? Input(PeepholeInputIndex(outputGate))->Value().Data() : nullptr;
+
+    for (size_t step = 0; step < numTimeSteps; step++)
+    {
+        const size_t t = m_direction < 0 ? step : numTimeSteps - 1 - step;
+        const size_t firstCol = t * numParallelSequences;
+
+        // gather h(t-1) and c(t-1)
+        for (size_t s = 0; s < numParallelSequences; s++)
+        {
+            const size_t j = firstCol + s;
+            ElemType* hp = prevHidden + j * cellDim;
+            ElemType* cp = prevCell + j * cellDim;
+            const ptrdiff_t predecessor = m_predecessors[j];
+            if (predecessor >= 0)
+            {
+                memcpy(hp, hidden + predecessor * cellDim, cellDim * sizeof(ElemType));
+                memcpy(cp, cell + predecessor * cellDim, cellDim * sizeof(ElemType));
+            }
+            else if (predecessor == carriedState)
+            {
+                memcpy(hp, carried + s * 2 * cellDim, cellDim * sizeof(ElemType));
+                memcpy(cp, carried + s * 2 * cellDim + cellDim, cellDim * sizeof(ElemType));
+            }
+            else
+            {
+                std::fill(hp, hp + cellDim, predecessor == initialState ? m_initialHiddenActivation : 0);
+                std::fill(cp, cp + cellDim, predecessor == initialState ? m_initialCellActivation : 0);
+            }
+        }
+
+        // recurrent projections of all parallel sequences
+        Matrix<ElemType> stepGates = m_gates->ColumnSlice(firstCol, numParallelSequences);
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_stackedR, false, m_prevHidden->ColumnSlice(firstCol, numParallelSequences), false, 1, stepGates);
+
+        // gate nonlinearities and cell update, all in a single pass; the gate pre-activations get overwritten by the gate values
+#pragma omp parallel for if (numParallelSequences * cellDim >= 4096)
+        for (long s = 0; s < (long) numParallelSequences; s++)
+        {
+            const size_t j = firstCol + s;
+            ElemType* z  = gates + j * numGates * cellDim;
+            ElemType* c  = cell + j * cellDim;
+            ElemType* h  = hidden + j * cellDim;
+            const ElemType* cp = prevCell + j * cellDim;
+            if (m_predecessors[j] == gap)
+            {
+                std::fill(z, z + numGates * cellDim, (ElemType) 0);
+                std::fill(c, c + cellDim, (ElemType) 0);
+                std::fill(h, h + cellDim, (ElemType) 0);
+                continue;
+            }
+            ElemType* zi = z + inputGate  * cellDim;
+            ElemType* zf = z + forgetGate * cellDim;
+            ElemType* zo = z + outputGate * cellDim;
+            ElemType* zg = z + cellInput  * cellDim;
+            const ElemType* bi = bias + inputGate  * cellDim;
+            const ElemType* bf = bias + forgetGate * cellDim;
+            const ElemType* bo = bias + outputGate * cellDim;
+            const ElemType* bg = bias + cellInput  * cellDim;
+            for (size_t r = 0; r < cellDim; r++)
+            {
+                ElemType i = zi[r] + bi[r];
+                ElemType f = zf[r] + bf[r];
+                ElemType o = zo[r] + bo[r];
+                if (hasPeepholes)
+                {
+                    i += peepholeI[r] * cp[r];
+                    f += peepholeF[r] * cp[r];
+                }
+                i = Sigmoid(i);
+                f = Sigmoid(f);
+                ElemType g = tanh_(zg[r] + bg[r]);
+                c[r] = f * cp[r] + i * g;
+                if (hasPeepholes)
+                    o += peepholeO[r] * c[r];
+                o = Sigmoid(o);
+                h[r] = o * tanh_(c[r]);
+                zi[r] = i;
+                zf[r] = f;
+                zo[r] = o;
+                zg[r] = g;
+            }
+        }
+    }
+}
+
+template <class ElemType>
+/*virtual*/ void OptimizedLSTMNode<ElemType>::EndForwardProp() /*override*/
+{
+    Base::EndForwardProp();
+
+    // In truncated BPTT, we carry over left-to-right state across minibatches, like PastValueNode.
+    if (m_direction < 0 && m_pMBLayout->HasSequenceBeyondEnd())
+    {
+        const size_t cellDim = CellDim();
+        const size_t numParallelSequences = GetNumParallelSequences();
+        const size_t lastCol = (GetNumTimeSteps() - 1) * numParallelSequences;
+        m_carriedState.Resize(2 * cellDim, numParallelSequences);
+        for (size_t s = 0; s < numParallelSequences; s++)
+        {
+            ElemType* carried = m_carriedState.Data() + s * 2 * cellDim;
+            memcpy(carried,           Value().Data()   + (lastCol + s) * cellDim, cellDim * sizeof(ElemType));
+            memcpy(carried + cellDim, m_cell->Data()   + (lastCol + s) * cellDim, cellDim * sizeof(ElemType));
+        }
+    }
+    else
+        m_carriedState.Resize(0, 0);
+}
+
+// backpropagate through all time steps into m_gateGradients (gradients w.r.t. the gate pre-activations),
+// from which BackpropTo() then computes the gradients of the individual inputs
+template <class ElemType>
+void OptimizedLSTMNode<ElemType>::BackpropThroughTime(const FrameRange& fr)
+{
+    const size_t cellDim = CellDim();
+    const size_t numParallelSequences = GetNumParallelSequences();
+    const size_t numTimeSteps = GetNumTimeSteps();
+    const size_t numCols = numParallelSequences * numTimeSteps;
+    const bool hasPeepholes = HasPeepholes();
+
+    m_gateGradients->Resize(numGates * cellDim, numCols);
+    m_hiddenGradient->Resize(cellDim, numCols); // gradient w.r.t. h(t) that arrives from step t+1 through the recurrence
+    m_hiddenGradient->SetValue(0);
+    m_cellGradient->Resize(cellDim, numCols);   // same for c(t)
+    m_cellGradient->SetValue(0);
+    Matrix<ElemType> stepHiddenGradient(cellDim, numParallelSequences, m_deviceId);
+
+    Matrix<ElemType> outputGradient = GradientFor(fr);
+    const ElemType* dOutput = outputGradient.Data();
+    ElemType* dGates = m_gateGradients->Data();
+    ElemType* dHidden = m_hiddenGradient->Data();
+    ElemType* dCell = m_cellGradient->Data();
+    const ElemType* gates = m_gates->Data();
+    const ElemType* cell = m_cell->Data();
+    const ElemType* prevCell = m_prevCell->Data();
+    const ElemType* peepholeI = hasPeepholes ? Input(PeepholeInputIndex(inputGate))->Value().Data() : nullptr;
+    const ElemType* peepholeF = hasPeepholes ? Input(PeepholeInputIndex(forgetGate))->Value().Data() : nullptr;
+    const ElemType* peepholeO = hasPeepholes ? Input(PeepholeInputIndex(outputGate))->Value().Data() : nullptr;
+
+    for (size_t step = numTimeSteps; step-- > 0;)
+    {
+        const size_t t = m_direction < 0 ? step : numTimeSteps - 1 - step;
+        const size_t firstCol = t * numParallelSequences;
+
+#pragma omp parallel for if (numParallelSequences * cellDim >= 4096)
+        for (long s = 0; s < (long) numParallelSequences; s++)
+        {
+            const size_t j = firstCol + s;
+            ElemType* dz = dGates + j * numGates * cellDim;
+            const ptrdiff_t predecessor = m_predecessors[j];
+            if (predecessor == gap)
+            {
+                std::fill(dz, dz + numGates * cellDim, (ElemType) 0);
+                continue;
+            }
+            const ElemType* z = gates + j * numGates * cellDim;
+            const ElemType* c = cell + j * cellDim;
+            const ElemType* cp = prevCell + j * cellDim;
+            const ElemType* dh = dOutput + j * cellDim;
+            const ElemType* dhRecurrent = dHidden + j * cellDim;
+            const ElemType* dcRecurrent = dCell + j * cellDim;
+            ElemType* dcp = predecessor >= 0 ? dCell + predecessor * cellDim : nullptr;
+            for (size_t r = 0; r < cellDim; r++)
+            {
+                const ElemType i = z[inputGate  * cellDim + r];
+                const ElemType f = z[forgetGate * cellDim + r];
+                const ElemType o = z[outputGate * cellDim + r];
+                const ElemType g = z[cellInput  * cellDim + r];
+                const ElemType tanhC = tanh_(c[r]);
+                const ElemType dhTotal = dh[r] + dhRecurrent[r];
+                const ElemType dzo = dhTotal * tanhC * o * (1 - o);
+                ElemType dc = dcRecurrent[r] + dhTotal * o * (1 - tanhC * tanhC);
+                if (hasPeepholes)
+                    dc += peepholeO[r] * dzo;
+                const ElemType dzi = dc * g * i * (1 - i);
+                const ElemType dzf = dc * cp[r] * f * (1 - f);
+                const ElemType dzg = dc * i * (1 - g * g);
+                dz[inputGate  * cellDim + r] = dzi;
+                dz[forgetGate * cellDim + r] = dzf;
+                dz[outputGate * cellDim + r] = dzo;
+                dz[cellInput  * cellDim + r] = dzg;
+                if (dcp)
+                    dcp[r] += dc * f + (hasPeepholes ? peepholeI[r] * dzi + peepholeF[r] * dzf : 0);
+            }
+        }
+
+        // gradient w.r.t. h(t-1) through the recurrent projections
+        // If no sequence has a boundary at this step, the predecessors are exactly the previous step's columns.
+        if (step == 0)
+            continue;
+        const size_t prevFirstCol = (m_direction < 0 ? t - 1 : t + 1) * numParallelSequences;
+        bool allContinue = true;
+        for (size_t s = 0; s < numParallelSequences; s++)
+            allContinue &= m_predecessors[firstCol + s] == (ptrdiff_t) (prevFirstCol + s) || m_predecessors[firstCol + s] == gap;
+        const Matrix<ElemType> stepGateGradients = m_gateGradients->ColumnSlice(firstCol, numParallelSequences);
+        if (allContinue)
+        {
+            Matrix<ElemType> prevHiddenGradient = m_hiddenGradient->ColumnSlice(prevFirstCol, numParallelSequences);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_stackedR, true, stepGateGradients, false, 1, prevHiddenGradient);
+        }
+        else
+        {
+            Matrix<ElemType>::Multiply(m_stackedR, true, stepGateGradients, false, stepHiddenGradient);
+            for (size_t s = 0; s < numParallelSequences; s++)
+            {
+                const ptrdiff_t predecessor = m_predecessors[firstCol + s];
+                if (predecessor < 0)
+                    continue;
+                ElemType* to = dHidden + predecessor * cellDim;
+                const ElemType* from = stepHiddenGradient.Data() + s * cellDim;
+                for (size_t r = 0; r < cellDim; r++)
+                    to[r] += from[r];
+            }
+        }
+    }
+}
+
+template <class ElemType>
+/*virtual*/ void OptimizedLSTMNode<ElemType>::BackpropTo(const size_t inputIndex, const FrameRange& fr) /*override*/
+{
+    // BackpropTo() gets called for the inputs in order; the first call does the actual work
+    bool isFirstCall = true;
+    for (size_t i = 0; i < inputIndex; i++)
+        isFirstCall &= !Input(i)->NeedsGradient();
+    if (isFirstCall)
+        BackpropThroughTime(fr);
+
+    const size_t cellDim = CellDim();
+    const size_t numCols = m_gateGradients->GetNumCols();
+    if (inputIndex == 0) // input: W' * gate gradients
+    {
+        Matrix<ElemType> inputGradient = Input(0)->GradientFor(fr);
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_stackedW, true, *m_gateGradients, false, 1, inputGradient);
+    }
+    else if (inputIndex < numInputsWithoutPeepholes) // W, H, or b of one gate
+    {
+        const size_t gate = (inputIndex - 1) / 3;
+        m_parameterGradient->AssignRowSliceValuesOf(*m_gateGradients, gate * cellDim, cellDim);
+        Matrix<ElemType> gradient = Input(inputIndex)->Gradient().Reshaped(cellDim, Input(inputIndex)->Gradient().GetNumElements() / cellDim);
+        if (inputIndex == WeightInputIndex(gate))
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_parameterGradient, false, Input(0)->ValueFor(fr), true, 1, gradient);
+        else if (inputIndex == RecurrentWeightInputIndex(gate))
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_parameterGradient, false, *m_prevHidden, true, 1, gradient);
+        else // bias: sum over all frames (gaps have zero gradient)
+        {
+            const ElemType* dz = m_parameterGradient->Data();
+            ElemType* db = gradient.Data();
+            for (size_t j = 0; j < numCols; j++)
+                for (size_t r = 0; r < cellDim; r++)
+                    db[r] += dz[j * cellDim + r];
+        }
+    }
+    else // peephole weights: sum over all frames of gate gradient .* the cell value they were applied to
+    {
+        const size_t gate = inputIndex - numInputsWithoutPeepholes;
+        const ElemType* dz = m_gateGradients->Data() + gate * cellDim;
+        const ElemType* c = (gate == outputGate ? m_cell : m_prevCell)->Data();
+        ElemType* dC = Input(inputIndex)->Gradient().Data();
+        for (size_t j = 0; j < numCols; j++)
+            for (size_t r = 0; r < cellDim; r++)
+                dC[r] += dz[j * numGates * cellDim + r] * c[j * cellDim + r];
+    }
+}
+
+// the gate and cell matrices are numGates resp. 1 times our output size; tell the pool
+template <class ElemType>
+/*virtual*/ void OptimizedLSTMNode<ElemType>::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
+{
+    Base::RequestMatricesBeforeForwardProp(matrixPool);
+    RequestMatrixFromPool(m_gates, matrixPool, numGates * CellDim(), true);
+    RequestMatrixFromPool(m_cell, matrixPool);
+    RequestMatrixFromPool(m_prevHidden, matrixPool);
+    RequestMatrixFromPool(m_prevCell, matrixPool);
+}
+
+template <class ElemType>
+/*virtual*/ void OptimizedLSTMNode<ElemType>::RequestMatricesBeforeBackprop(MatrixPool& matrixPool) /*override*/
+{
+    Base::RequestMatricesBeforeBackprop(matrixPool);
+    RequestMatrixFromPool(m_gateGradients, matrixPool, numGates * CellDim(), true);
+    RequestMatrixFromPool(m_hiddenGradient, matrixPool);
+    RequestMatrixFromPool(m_cellGradient, matrixPool);
+    RequestMatrixFromPool(m_parameterGradient, matrixPool);
+}
+
+template <class ElemType>
+/*virtual*/ void OptimizedLSTMNode<ElemType>::ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) /*override*/
+{
+    Base::ReleaseMatricesAfterBackprop(matrixPool);
+    matrixPool.Release<ElemType>(m_gates, this, numGates * CellDim(), true);
+    ReleaseMatrixToPool(m_cell, matrixPool);
+    ReleaseMatrixToPool(m_prevHidden, matrixPool);
+    ReleaseMatrixToPool(m_prevCell, matrixPool);
+    matrixPool.Release<ElemType>(m_gateGradients, this, numGates * CellDim(), true);
+    ReleaseMatrixToPool(m_hiddenGradient, matrixPool);
+    ReleaseMatrixToPool(m_cellGradient, matrixPool);
+    ReleaseMatrixToPool(m_parameterGradient, matrixPool);
+}
+
+// state export/import for sub-minibatching, see DelayedValueNodeBase
+template <class ElemType>
+/*virtual*/ NodeStatePtr OptimizedLSTMNode<ElemType>::ExportState() /*override*/
+{
+    auto pState = make_shared<DelayedValueNodeState<ElemType>>(m_deviceId);
+    if (!m_carriedState.IsEmpty())
+        pState->CacheState(m_carriedState);
+    return pState;
+}
+
+template <class ElemType>
+/*virtual*/ void OptimizedLSTMNode<ElemType>::ImportState(const NodeStatePtr& pImportedState) /*override*/
+{
+    auto pState = dynamic_pointer_cast<DelayedValueNodeState<ElemType>>(pImportedState);
+    if (!pState)
+        LogicError("Expecting DelayValueNodeState after downcasting");
+    if (pState->IsEmpty())
+        m_carriedState.Resize(0, 0);
+    else
+        m_carriedState.SetValue(pState->ExportCachedActivity());
+}
+
+template class OptimizedLSTMNode<float>;
+template class OptimizedLSTMNode<double>;
+
+}}}
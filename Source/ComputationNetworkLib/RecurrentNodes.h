@@ -464,6 +464,10 @@ public:
             LogicError("Unrecognized direction in DelayedValueNodeBase");
     }
 
+    // (used by the LSTM rewrite in ComputationNetwork::FuseLSTMs())
+    int TimeStep() const { return m_timeStep; }
+    ElemType InitialActivationValue() const { return m_initialActivationValue; }
+
 protected:
     ElemType m_initialActivationValue;       // starting value for hidden activation vector at boundary
     Matrix<ElemType> m_delayedValue;         // saves the activation of the previous step that this node points to
@@ -552,6 +556,118 @@ public:
 template class FutureValueNode<float>;
 template class FutureValueNode<double>;
 
+// -----------------------------------------------------------------------
+// OptimizedLSTMNode (x, W_i, H_i, b_i, W_f, H_f, b_f, W_o, H_o, b_o, W_g, H_g, b_g [, C_i, C_f, C_o])
+// -- a complete recurrent LSTM layer in a single node, CPU only
+//
+// Computes, for every frame t of every sequence (with h(t-1), c(t-1) the values of the previous frame
+// in the recurrence direction, or the initial activation values at the sequence boundary):
+//   i = Sigmoid (W_i x + H_i h(t-1) + b_i + C_i .* c(t-1))
+//   f = Sigmoid (W_f x + H_f h(t-1) + b_f + C_f .* c(t-1))
+//   g = Tanh    (W_g x + H_g h(t-1) + b_g)
+//   c = f .* c(t-1) + i .* g
+//   o = Sigmoid (W_o x + H_o h(t-1) + b_o + C_o .* c)
+//   h = o .* Tanh (c)
+// and outputs h. The peephole weights C_* are optional.
+//
+// This is the same function as the LSTM built from individual Times, Plus, Sigmoid, Tanh, ElementTimes
+// and PastValue/FutureValue nodes (e.g. BS.RNNs.RecurrentLSTMP without projection and stabilizer), but
+// instead of running ~20 nodes per time step inside a SEQTraversalFlowControlNode, it does one GEMM for
+// the input projections of all frames, then per time step one GEMM for the recurrent projections and one
+// fused elementwise pass for the gates. It is not created by users directly but by
+// ComputationNetwork::FuseLSTMs(), which replaces recognized LSTM subgraphs with it. The parameter nodes
+// are kept as they are, so the model can be trained and saved as usual.
+//
+// Like PastValueNode, this carries over the state across minibatches for truncated BPTT (left-to-right only).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class OptimizedLSTMNode : public ComputationNode<ElemType>, public IStatefulNode
+{
+    typedef ComputationNode<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"OptimizedLSTM"; }
+
+public:
+    // gates, in the order of their parameters in the input list and of their rows in the stacked weights
+    enum Gate : size_t { inputGate, forgetGate, outputGate, cellInput, numGates };
+    static const size_t numInputsWithoutPeepholes = 1 + 3 * numGates;
+    static const size_t numInputsWithPeepholes = numInputsWithoutPeepholes + 3; // (no peephole for the cell input)
+    static size_t WeightInputIndex(size_t gate)          { return 1 + 3 * gate; }
+    static size_t RecurrentWeightInputIndex(size_t gate) { return 2 + 3 * gate; }
+    static size_t BiasInputIndex(size_t gate)            { return 3 + 3 * gate; }
+    static size_t PeepholeInputIndex(size_t gate)        { return numInputsWithoutPeepholes + gate; }
+
+    OptimizedLSTMNode(DEVICEID_TYPE deviceId, const wstring& name, int direction = -1, ElemType initialHiddenActivation = (ElemType) DEFAULT_HIDDEN_ACTIVATION, ElemType initialCellActivation = (ElemType) DEFAULT_HIDDEN_ACTIVATION)
+        : Base(deviceId, name), m_direction(direction), m_initialHiddenActivation(initialHiddenActivation), m_initialCellActivation(initialCellActivation),
+          m_stackedW(deviceId), m_stackedR(deviceId), m_stackedB(deviceId), m_carriedState(deviceId)
+    {
+    }
+    OptimizedLSTMNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : OptimizedLSTMNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"direction"), configp->Get(L"initialHiddenActivation"), configp->Get(L"initialCellActivation"))
+    {
+        AttachInputsFromConfig(configp);
+    }
+
+    virtual void /*ComputationNodeBase::*/ CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override;
+    virtual void /*ComputationNodeBase::*/ Load(File& fstream, size_t modelVersion) override;
+    virtual void /*ComputationNodeBase::*/ Save(File& fstream) const override;
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override;
+    virtual void /*ComputationNodeBase::*/ EndForwardProp() override;
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override;
+    virtual bool /*ComputationNodeBase::*/ OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool /*ComputationNodeBase::*/ InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex == 0; }
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override;
+
+    virtual void /*ComputationNodeBase::*/ RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override;
+    virtual void /*ComputationNodeBase::*/ RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override;
+    virtual void /*ComputationNodeBase::*/ ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override;
+
+    virtual NodeStatePtr /*IStatefulNode::*/ ExportState() override;
+    virtual void /*IStatefulNode::*/ ImportState(const NodeStatePtr& pImportedState) override;
+
+    int Direction() const { return m_direction; }
+    bool HasPeepholes() const { return GetNumInputs() == numInputsWithPeepholes; }
+
+private:
+    size_t CellDim() const { return GetSampleLayout().GetNumElements(); }
+    void StackParameters();
+    void DeterminePredecessors();
+    void BackpropThroughTime(const FrameRange& fr);
+
+    // special values for m_predecessors[]
+    enum : ptrdiff_t
+    {
+        gap = -1,          // column is a gap
+        initialState = -2, // first frame of a sequence: use the initial activation values
+        carriedState = -3  // sequence started in the previous minibatch: use m_carriedState
+    };
+
+    int m_direction;                    // -1 for left-to-right (like PastValue), +1 for right-to-left (like FutureValue)
+    ElemType m_initialHiddenActivation; // h(t-1) at the sequence boundary
+    ElemType m_initialCellActivation;   // c(t-1) at the sequence boundary
+
+    // parameters, stacked by gate in the order of 'Gate'; updated from the inputs in every ForwardProp() since they may have been changed
+    Matrix<ElemType> m_stackedW; // [4*cellDim x inputDim]
+    Matrix<ElemType> m_stackedR; // [4*cellDim x cellDim]
+    Matrix<ElemType> m_stackedB; // [4*cellDim x 1]
+
+    // per-minibatch state kept from forward to backprop
+    std::vector<ptrdiff_t> m_predecessors;      // for each column, the column that holds h(t-1) and c(t-1), or one of the special values above
+    shared_ptr<Matrix<ElemType>> m_gates;       // [4*cellDim x T*S] gate pre-activations (with input projections), then after the step the gate values i, f, o, g
+    shared_ptr<Matrix<ElemType>> m_cell;        // [cellDim x T*S] c(t)
+    shared_ptr<Matrix<ElemType>> m_prevHidden;  // [cellDim x T*S] h(t-1), resolved for sequence boundaries
+    shared_ptr<Matrix<ElemType>> m_prevCell;    // [cellDim x T*S] c(t-1), resolved for sequence boundaries
+
+    // backprop
+    shared_ptr<Matrix<ElemType>> m_gateGradients;     // [4*cellDim x T*S] gradient w.r.t. the gate pre-activations
+    shared_ptr<Matrix<ElemType>> m_hiddenGradient;    // [cellDim x T*S] gradient w.r.t. h(t) through the recurrence
+    shared_ptr<Matrix<ElemType>> m_cellGradient;      // [cellDim x T*S] gradient w.r.t. c(t) through the recurrence
+    shared_ptr<Matrix<ElemType>> m_parameterGradient; // [cellDim x T*S] one gate's rows of m_gateGradients
+
+    // truncated BPTT: h and c of the last frame of the previous minibatch, stacked as [2*cellDim x S]
+    Matrix<ElemType> m_carriedState;
+};
+
 #ifdef COMING_SOON
 
 // -----------------------------------------------------------------------
@@ -394,12 +394,15 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_prior, matrixPool);
-        RequestMatrixFromPool(m_normedDeviation, matrixPool);
-        RequestMatrixFromPool(m_normedDeviationVectors, matrixPool);
-        RequestMatrixFromPool(m_stddev, matrixPool);
-        RequestMatrixFromPool(m_posterior, matrixPool);
-        RequestMatrixFromPool(m_temp, matrixPool);
+        // these are per mixture component, resp. per component and feature dimension for the deviation vectors
+        size_t numComponent = Input(0)->GetSampleMatrixNumRows();
+        size_t featureDim = Input(3)->GetSampleMatrixNumRows();
+        RequestMatrixFromPool(m_prior, matrixPool, numComponent, true);
+        RequestMatrixFromPool(m_normedDeviation, matrixPool, numComponent, true);
+        RequestMatrixFromPool(m_normedDeviationVectors, matrixPool, numComponent * featureDim, true);
+        RequestMatrixFromPool(m_stddev, matrixPool, numComponent, true);
+        RequestMatrixFromPool(m_posterior, matrixPool, numComponent, true);
+        RequestMatrixFromPool(m_temp, matrixPool, numComponent, true);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -603,9 +606,9 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
-        RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
-        RequestMatrixFromPool(m_gammaFromLattice, matrixPool);
+        RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool, Input(1));
+        RequestMatrixFromPool(m_softmaxOfRight, matrixPool, Input(1));
+        RequestMatrixFromPool(m_gammaFromLattice, matrixPool, Input(1));
     }
 
     // request matrices needed to do node function value evaluation
@@ -83,7 +83,7 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_leftMinusRight, matrixPool);
+        RequestMatrixFromPool(m_leftMinusRight, matrixPool, Input(0));
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -214,8 +214,8 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
-        RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
+        RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool, Input(1));
+        RequestMatrixFromPool(m_softmaxOfRight, matrixPool, Input(1));
     }
 
 protected:
@@ -325,14 +325,14 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_logOfRight, matrixPool);
+        RequestMatrixFromPool(m_logOfRight, matrixPool, Input(1));
     }
 
     // request matrices that are needed for gradient computation
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_leftDivRight, matrixPool);
+        RequestMatrixFromPool(m_leftDivRight, matrixPool, Input(1));
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -425,7 +425,7 @@ public:
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_gradientOfL1Norm, matrixPool);
+        RequestMatrixFromPool(m_gradientOfL1Norm, matrixPool, Input(0));
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -1367,9 +1367,9 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_classZeroLabels, matrixPool);
-        RequestMatrixFromPool(m_result, matrixPool);
-        RequestMatrixFromPool(m_temp, matrixPool);
+        RequestMatrixFromPool(m_classZeroLabels, matrixPool, Input(0));
+        RequestMatrixFromPool(m_result, matrixPool, Input(0));
+        RequestMatrixFromPool(m_temp, matrixPool, Input(0));
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -1820,25 +1820,26 @@ public:
     void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-            RequestMatrixFromPool(m_saveMean, matrixPool);
-            RequestMatrixFromPool(m_saveInvStdDev, matrixPool);
-        }
+        // the saved statistics and the scale/bias derivatives have the shape of the scale parameter, independent of the minibatch
+        RequestMatrixFromPool(m_saveMean, matrixPool, Input(1));
+        RequestMatrixFromPool(m_saveInvStdDev, matrixPool, Input(1));
+    }
 
     void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
     {
         Base::RequestMatricesBeforeBackprop(matrixPool);
-            RequestMatrixFromPool(m_dScale, matrixPool);
-            RequestMatrixFromPool(m_dBias, matrixPool);
-        }
+        RequestMatrixFromPool(m_dScale, matrixPool, Input(1));
+        RequestMatrixFromPool(m_dBias, matrixPool, Input(1));
+    }
 
     void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
-            ReleaseMatrixToPool(m_saveMean, matrixPool);
-            ReleaseMatrixToPool(m_saveInvStdDev, matrixPool);
-            ReleaseMatrixToPool(m_dScale, matrixPool);
-            ReleaseMatrixToPool(m_dBias, matrixPool);
-        }
+        ReleaseMatrixToPool(m_saveMean, matrixPool);
+        ReleaseMatrixToPool(m_saveInvStdDev, matrixPool);
+        ReleaseMatrixToPool(m_dScale, matrixPool);
+        ReleaseMatrixToPool(m_dBias, matrixPool);
+    }
 
     void SetNormalizationTimeConstants(double normalizationTimeConstant, double prevNormalizationTimeConstant,
                                        double blendTimeConstant, double prevBlendTimeConstant)
@@ -1851,6 +1852,42 @@ public:
             m_blendTimeConst = blendTimeConstant;
     }
 
+    bool IsSpatial() const { return m_spatial; }
+
+    // a CPU node with the same inputs and saved state, which, unlike this node's minibatch count, stays put while
+    // training goes on, see ComputationNetwork::CreateSnapshotForSaving()
+    ComputationNodeBasePtr CreateSnapshotForSaving() const
+    {
+        auto node = make_shared<BatchNormalizationNode<ElemType>>(CPUDEVICE, NodeName(), m_spatial, m_normTimeConst, m_blendTimeConst,
+                                                                  m_epsilon, m_useCntkEngine, m_imageLayoutKind);
+        node->m_mbCount = m_mbCount;
+        node->m_inputs = m_inputs;
+        return node;
+    }
+
+    // Get the affine function y = a .* x + b that this node computes in inference mode, one (a, b) pair per scale/bias
+    // element, e.g. for folding it into the weights of the preceding layer.
+    // Note that the cuDNN engine keeps the running variance in place of the running inverse standard deviation.
+    void GetInferenceTransform(std::vector<double>& a, std::vector<double>& b)
+    {
+        size_t n = Input(1)->Value().GetNumElements();
+        if (Input(2)->Value().GetNumElements() != n || Input(3)->Value().GetNumElements() != n || Input(4)->Value().GetNumElements() != n)
+            LogicError("%ls %ls: Scale, bias, and running statistics must have the same dimensions.", NodeName().c_str(), OperationName().c_str());
+        unique_ptr<ElemType[]> scale(Input(1)->Value().CopyToArray());
+        unique_ptr<ElemType[]> bias(Input(2)->Value().CopyToArray());
+        unique_ptr<ElemType[]> runMean(Input(3)->Value().CopyToArray());
+        unique_ptr<ElemType[]> runInvStdDev(Input(4)->Value().CopyToArray());
+        double cudnnMinEps = 1e-5; // CUDNN_BN_MIN_EPSILON
+        a.resize(n);
+        b.resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            double invStdDev = m_useCntkEngine ? runInvStdDev[i] : 1 / sqrt(runInvStdDev[i] + max(m_epsilon, cudnnMinEps));
+            a[i] = scale[i] * invStdDev;
+            b[i] = bias[i] - a[i] * runMean[i];
+        }
+    }
+
 private:
     // Old versioning - do not use. Do not remove until we're sure there are no old models around.
     struct VersionInfo
@@ -62,6 +62,25 @@ void CNTKEvalBase<ElemType>::CreateNetwork(const std::string& networkDescription
     {
         LogicError("Unable to construct network from description");
     }
+
+    // fold batch normalization (and ReLU) into the preceding convolution; on by default since the folding is exact up to rounding
+    if (this->m_config(L"foldBatchNormalization", true))
+        this->m_net->template FoldBatchNormalization<ElemType>();
+
+    // optional fused LSTM nodes (CPU only); must happen before the matrices get allocated
+    if (this->m_config(L"fuseLSTMs", false))
+        this->m_net->template FuseLSTMs<ElemType>();
+
+    // move the loop-invariant part of projections of stacked inputs out of recurrent loops; exact up to rounding
+    if (this->m_config(L"hoistLoopInvariantProjections", true))
+        this->m_net->template HoistLoopInvariantProjections<ElemType>();
+
+    // optional int16 quantized product for Times operations (CPU only); this quantizes the weights once, here
+    if (this->m_config(L"quantizedTimes", false))
+        this->m_net->template SetQuantizedTimes<ElemType>(true);
+
+    // optionally run independent nodes and loops (e.g. the two directions of a bidirectional LSTM) concurrently (CPU only)
+    this->m_net->SetConcurrentScheduling(this->m_config(L"concurrentNodeThreads", (size_t) 0));
 }
 
 
@@ -259,24 +278,94 @@ VariableLayout CNTKEvalExtended<ElemType>::ToVariableLayout(const ComputationNod
 template<typename ElemType>
 void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstring>& outputNodeNames)
 {
-    m_scopedNetworkOperationMode = make_shared<ScopedNetworkOperationMode>(this->m_net, NetworkOperationMode::inferring);
-    m_outputNodes  = this->m_net->OutputNodesByName(outputNodeNames);
-    m_inputNodes = this->m_net->InputNodesForOutputs(outputNodeNames);
-    // allocate memory for forward computation
-    this->m_net->AllocateAllMatrices({}, m_outputNodes, nullptr);
-    this->m_net->StartEvaluateMinibatchLoop(m_outputNodes);
-    m_inputMatrices = DataReaderHelpers::RetrieveInputMatrices(m_inputNodes);
-
-    for (const auto& node : m_outputNodes)
+    size_t numSessions = this->m_config(L"numConcurrentForwardPasses", (size_t) 1);
+    if (numSessions == 0)
+        InvalidArgument("numConcurrentForwardPasses must be at least 1.");
+    m_maxBatchedRequests = this->m_config(L"maxBatchedRequests", (size_t) 1);
+    if (m_maxBatchedRequests == 0)
+        InvalidArgument("maxBatchedRequests must be at least 1.");
+    double maxBatchingDelayMs = this->m_config(L"maxBatchingDelayMs", 1.0);
+    if (!(maxBatchingDelayMs >= 0)) // (also catches NaN)
+        InvalidArgument("maxBatchingDelayMs must not be negative.");
+    m_maxBatchingDelay = std::chrono::microseconds((long long) (maxBatchingDelayMs * 1000));
+    m_statistics = RequestStatistics();
+
+    // all copies must be made before any network is evaluated or has its matrices allocated (they share the parameter nodes)
+    std::vector<ComputationNetworkPtr> nets{ this->m_net };
+    for (size_t k = 1; k < numSessions; k++)
+        nets.push_back(this->m_net->CloneSharingParameters());
+
+    m_sessions.clear();
+    m_idleSessions.clear();
+    for (const auto& net : nets)
     {
-        shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
-        if (outputMatrix->GetMatrixType() != MatrixType::DENSE)
-            RuntimeError("Sparse outputs are not supported by this API.");
+        std::unique_ptr<EvaluationSession> session(new EvaluationSession());
+        session->m_net = net;
+        session->m_scopedNetworkOperationMode = make_shared<ScopedNetworkOperationMode>(net, NetworkOperationMode::inferring);
+        session->m_outputNodes = net->OutputNodesByName(outputNodeNames);
+        session->m_inputNodes = net->InputNodesForOutputs(outputNodeNames);
+        // allocate memory for forward computation
+        net->AllocateAllMatrices({}, session->m_outputNodes, nullptr);
+        net->StartEvaluateMinibatchLoop(session->m_outputNodes);
+        session->m_inputMatrices = DataReaderHelpers::RetrieveInputMatrices(session->m_inputNodes);
+
+        for (const auto& node : session->m_outputNodes)
+        {
+            shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+            if (outputMatrix->GetMatrixType() != MatrixType::DENSE)
+                RuntimeError("Sparse outputs are not supported by this API.");
+        }
+
+        m_idleSessions.push_back(session.get());
+        m_sessions.push_back(std::move(session));
     }
+    m_outputNodes = m_sessions.front()->m_outputNodes;
+    m_inputNodes = m_sessions.front()->m_inputNodes;
 
     m_started = true;
 }
 
+// get an idle session for exclusive use by the calling thread, waiting for one if all are busy
+template<typename ElemType>
+typename CNTKEvalExtended<ElemType>::EvaluationSession* CNTKEvalExtended<ElemType>::AcquireSession()
+{
+    std::unique_lock<std::mutex> lock(m_sessionsMutex);
+    m_sessionReleased.wait(lock, [this] { return !m_idleSessions.empty(); });
+    auto session = m_idleSessions.back();
+    m_idleSessions.pop_back();
+    return session;
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ReleaseSession(EvaluationSession* session)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        m_idleSessions.push_back(session);
+    }
+    m_sessionReleased.notify_one();
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::RecordBatch(const std::vector<std::chrono::steady_clock::time_point>& arrivalTimes, std::chrono::steady_clock::time_point startTime)
+{
+    auto endTime = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(m_statisticsMutex);
+    for (const auto& arrivalTime : arrivalTimes)
+    {
+        m_statistics.m_latency.Add(std::chrono::duration<double, std::micro>(endTime - arrivalTime).count());
+        m_statistics.m_queueLatency.Add(std::chrono::duration<double, std::micro>(startTime - arrivalTime).count());
+    }
+    m_statistics.m_numBatches++;
+}
+
+template<typename ElemType>
+RequestStatistics CNTKEvalExtended<ElemType>::GetRequestStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_statisticsMutex);
+    return m_statistics;
+}
+
 template<typename ElemType>
 VariableSchema CNTKEvalExtended<ElemType>::GetOutputSchema() const
 {
@@ -314,91 +403,306 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
     if (!m_started)
         RuntimeError("ForwardPass() called before StartForwardEvaluation()");
 
-    if (inputs.size() != (size_t)std::distance(m_inputMatrices.begin(), m_inputMatrices.end()))
-        RuntimeError("Expected %d inputs, but got %d.", (int)std::distance(m_inputMatrices.begin(), m_inputMatrices.end()), (int)inputs.size());
+    auto arrivalTime = std::chrono::steady_clock::now();
+    if (m_maxBatchedRequests > 1)
+    {
+        // check the request right away, so that a malformed one does not fail the batch it would end up in
+        VerifyRequest(*m_sessions.front(), inputs, outputs);
+        BatchedForwardPassT(inputs, outputs, arrivalTime);
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(1);
+    auto session = AcquireSession();
+    try
+    {
+        ForwardPassT<ValueContainer>(*session, { &inputs }, { &outputs }, errors);
+    }
+    catch (...)
+    {
+        ReleaseSession(session);
+        throw;
+    }
+    ReleaseSession(session);
+    RecordBatch({ arrivalTime }, arrivalTime);
+    if (errors[0])
+        std::rethrow_exception(errors[0]);
+}
+
+// queue the request, and wait until a batch containing it has been evaluated
+// One of the waiting threads at a time collects the next batch: It waits until either m_maxBatchedRequests are pending
+// or the oldest pending one has waited for m_maxBatchingDelay, takes them off the queue, and then evaluates them all
+// in a single ForwardPass on one of the sessions, while the next thread already starts collecting.
+template<typename ElemType>
+template<template<typename> class ValueContainer>
+void CNTKEvalExtended<ElemType>::BatchedForwardPassT(const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs,
+                                                     std::chrono::steady_clock::time_point arrivalTime)
+{
+    PendingRequest<ValueContainer> request{ &inputs, &outputs, arrivalTime, false, nullptr };
+    auto& queue = QueueFor(inputs);
+
+    std::unique_lock<std::mutex> lock(m_requestsMutex);
+    queue.m_pending.push_back(&request);
+    m_requestsChanged.notify_all();
+    while (!request.m_done)
+    {
+        bool isPending = std::find(queue.m_pending.begin(), queue.m_pending.end(), &request) != queue.m_pending.end();
+        if (!isPending || queue.m_isCollecting)
+        {
+            m_requestsChanged.wait(lock);
+            continue;
+        }
+
+        // collect the next batch
+        queue.m_isCollecting = true;
+        auto deadline = queue.m_pending.front()->m_arrivalTime + m_maxBatchingDelay;
+        m_requestsChanged.wait_until(lock, deadline, [&] { return queue.m_pending.size() >= m_maxBatchedRequests; });
+        size_t batchSize = std::min(queue.m_pending.size(), m_maxBatchedRequests);
+        std::vector<PendingRequest<ValueContainer>*> batch(queue.m_pending.begin(), queue.m_pending.begin() + batchSize);
+        queue.m_pending.erase(queue.m_pending.begin(), queue.m_pending.begin() + batchSize);
+        queue.m_isCollecting = false;
+        m_requestsChanged.notify_all();
+        lock.unlock();
+
+        // evaluate it
+        std::vector<const std::vector<ValueBuffer<ElemType, ValueContainer>>*> batchInputs;
+        std::vector<std::vector<ValueBuffer<ElemType, ValueContainer>>*> batchOutputs;
+        for (const auto& r : batch)
+        {
+            batchInputs.push_back(r->m_inputs);
+            batchOutputs.push_back(r->m_outputs);
+        }
+        std::vector<std::chrono::steady_clock::time_point> arrivalTimes;
+        for (const auto& r : batch)
+            arrivalTimes.push_back(r->m_arrivalTime);
+        std::vector<std::exception_ptr> errors(batchSize);
+        auto startTime = std::chrono::steady_clock::now();
+        auto session = AcquireSession();
+        try
+        {
+            ForwardPassT(*session, batchInputs, batchOutputs, errors);
+        }
+        catch (...)
+        {
+            for (auto& error : errors)
+                error = std::current_exception();
+        }
+        ReleaseSession(session);
+        RecordBatch(arrivalTimes, startTime);
+
+        lock.lock();
+        for (size_t k = 0; k < batchSize; k++)
+        {
+            batch[k]->m_error = errors[k];
+            batch[k]->m_done = true;
+        }
+        m_requestsChanged.notify_all();
+    }
+    lock.unlock();
 
-    if (outputs.size() != m_outputNodes.size())
-        RuntimeError("Expected %d outputs, but got %d.", (int)m_outputNodes.size(), (int)outputs.size());
+    if (request.m_error)
+        std::rethrow_exception(request.m_error);
+}
+
+template<typename ElemType>
+template<template<typename> class ValueContainer>
+void CNTKEvalExtended<ElemType>::VerifyRequest(const EvaluationSession& session, const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, const std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs)
+{
+    if (inputs.size() != (size_t)std::distance(session.m_inputMatrices.begin(), session.m_inputMatrices.end()))
+        RuntimeError("Expected %d inputs, but got %d.", (int)std::distance(session.m_inputMatrices.begin(), session.m_inputMatrices.end()), (int)inputs.size());
+
+    if (outputs.size() != session.m_outputNodes.size())
+        RuntimeError("Expected %d outputs, but got %d.", (int)session.m_outputNodes.size(), (int)outputs.size());
 
     size_t i = 0;
-    for (auto& input : m_inputMatrices)
+    for (const auto& input : session.m_inputMatrices)
     {
-        // const cast: The matrix class takes this over without copying and could theoretically change the contents,
-        // though it doesn't in this case.
-        auto& buffer = const_cast<ValueBuffer<ElemType, ValueContainer>&>(inputs[i]);
-        shared_ptr<Matrix<ElemType>> matrix = dynamic_pointer_cast<Matrix<ElemType>>(input.second.matrix);
-        auto type = matrix->GetMatrixType();
+        const auto& buffer = inputs[i];
+        auto type = dynamic_pointer_cast<Matrix<ElemType>>(input.second.matrix)->GetMatrixType();
         size_t numRows = input.second.sampleLayout.GetNumElements();
 
         if (type == MatrixType::DENSE)
         {
             if (buffer.m_buffer.size() % numRows != 0)
                 RuntimeError("Input %ls: Expected input data to be a multiple of %" PRIu64 ", but it is %" PRIu64 ".", 
-                             m_inputNodes[i]->GetName().c_str(), numRows, buffer.m_buffer.size());
+                             session.m_inputNodes[i]->GetName().c_str(), numRows, buffer.m_buffer.size());
             if (buffer.m_buffer.size() == 0)
-                RuntimeError("Input %ls: Expected at least one element.", m_inputNodes[i]->GetName().c_str());
+                RuntimeError("Input %ls: Expected at least one element.", session.m_inputNodes[i]->GetName().c_str());
         }
         else if (type == MatrixType::SPARSE)
         {
             if (buffer.m_colIndices.size() < 2)
-                RuntimeError("Input %ls: Expected at least one element.", m_inputNodes[i]->GetName().c_str());
+                RuntimeError("Input %ls: Expected at least one element.", session.m_inputNodes[i]->GetName().c_str());
             if (buffer.m_colIndices[0] != 0)
-                RuntimeError("Input %ls: First element of column indices must be 0", m_inputNodes[i]->GetName().c_str());
+                RuntimeError("Input %ls: First element of column indices must be 0", session.m_inputNodes[i]->GetName().c_str());
             if (buffer.m_colIndices[buffer.m_colIndices.size() - 1] != buffer.m_indices.size())
                 RuntimeError("Input %ls: Last element of column indices must be equal to the size of indices (%ld), but was %d", 
-                             m_inputNodes[i]->GetName().c_str(), buffer.m_indices.size(), 
+                             session.m_inputNodes[i]->GetName().c_str(), buffer.m_indices.size(), 
                              buffer.m_colIndices[buffer.m_colIndices.size() - 1]);
         }
+        ++i;
+    }
+}
+
+// evaluate a batch of requests at once
+// Each request becomes one parallel sequence of the minibatch; shorter sequences are padded with gaps.
+// Errors that only concern a single request (such as too small an output buffer) are returned in 'errors'; all others are thrown.
+template<typename ElemType>
+template<template<typename> class ValueContainer>
+void CNTKEvalExtended<ElemType>::ForwardPassT(EvaluationSession& session,
+                                              const std::vector<const std::vector<ValueBuffer<ElemType, ValueContainer>>*>& inputs,
+                                              const std::vector<std::vector<ValueBuffer<ElemType, ValueContainer>>*>& outputs,
+                                              std::vector<std::exception_ptr>& errors)
+{
+    const size_t numSequences = inputs.size();
+    for (size_t s = 0; s < numSequences; s++)
+        VerifyRequest(session, *inputs[s], *outputs[s]);
 
-        int numCols = type == MatrixType::DENSE ? buffer.m_buffer.size() / numRows : buffer.m_colIndices.size() - 1;
-        assert(numCols >= 1);
-        input.second.pMBLayout->Init(1, numCols);
-        input.second.pMBLayout->AddSequence(0, 0, 0, numCols);
+    size_t i = 0;
+    for (auto& input : session.m_inputMatrices)
+    {
+        shared_ptr<Matrix<ElemType>> matrix = dynamic_pointer_cast<Matrix<ElemType>>(input.second.matrix);
+        auto type = matrix->GetMatrixType();
+        size_t numRows = input.second.sampleLayout.GetNumElements();
 
-        if (type == MatrixType::DENSE)
-            matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), buffer.m_buffer.data(), matrixFlagNormal);
+        std::vector<size_t> numCols(numSequences);
+        size_t numTimeSteps = 0;
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            const auto& buffer = (*inputs[s])[i];
+            numCols[s] = type == MatrixType::DENSE ? buffer.m_buffer.size() / numRows : buffer.m_colIndices.size() - 1;
+            numTimeSteps = std::max(numTimeSteps, numCols[s]);
+        }
+        assert(numTimeSteps >= 1);
+        input.second.pMBLayout->Init(numSequences, numTimeSteps);
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            input.second.pMBLayout->AddSequence(s, s, 0, numCols[s]);
+            if (numCols[s] < numTimeSteps)
+                input.second.pMBLayout->AddGap(s, numCols[s], numTimeSteps);
+        }
+
+        if (numSequences == 1)
+        {
+            // const cast: The matrix class takes this over without copying and could theoretically change the contents,
+            // though it doesn't in this case.
+            auto& buffer = const_cast<ValueBuffer<ElemType, ValueContainer>&>((*inputs[0])[i]);
+            if (type == MatrixType::DENSE)
+                matrix->SetValue(numRows, numTimeSteps, matrix->GetDeviceId(), buffer.m_buffer.data(), matrixFlagNormal);
+            else if (type == MatrixType::SPARSE)
+            {
+                // In the sparse case the m_data layout is identical to CUDA's CSC layout
+                // (see http://docs.nvidia.com/cuda/cusparse/#compressed-sparse-column-format-csc).
+                matrix->SetMatrixFromCSCFormat(buffer.m_colIndices.data(), buffer.m_indices.data(), buffer.m_buffer.data(),
+                                               buffer.m_buffer.size(), numRows, numTimeSteps);
+            }
+        }
+        else if (type == MatrixType::DENSE)
+        {
+            // interleave the sequences: column t * numSequences + s holds step t of sequence s
+            std::vector<ElemType> data(numRows * numTimeSteps * numSequences, 0);
+            for (size_t s = 0; s < numSequences; s++)
+            {
+                const auto& buffer = (*inputs[s])[i];
+                for (size_t t = 0; t < numCols[s]; t++)
+                    memcpy(&data[(t * numSequences + s) * numRows], &buffer.m_buffer[t * numRows], sizeof(ElemType) * numRows);
+            }
+            matrix->SetValue(numRows, numTimeSteps * numSequences, matrix->GetDeviceId(), data.data(), matrixFlagNormal);
+        }
         else if (type == MatrixType::SPARSE)
         {
-            // In the sparse case the m_data layout is identical to CUDA's CSC layout
-            // (see http://docs.nvidia.com/cuda/cusparse/#compressed-sparse-column-format-csc).
-            matrix->SetMatrixFromCSCFormat(buffer.m_colIndices.data(), buffer.m_indices.data(), buffer.m_buffer.data(),
-                                           buffer.m_buffer.size(), numRows, numCols);
+            // same for the columns of the CSC format; gaps are empty columns
+            std::vector<CPUSPARSE_INDEX_TYPE> colIndices(1, 0);
+            std::vector<CPUSPARSE_INDEX_TYPE> rowIndices;
+            std::vector<ElemType> values;
+            for (size_t t = 0; t < numTimeSteps; t++)
+            {
+                for (size_t s = 0; s < numSequences; s++)
+                {
+                    const auto& buffer = (*inputs[s])[i];
+                    if (t < numCols[s])
+                    {
+                        rowIndices.insert(rowIndices.end(), &buffer.m_indices[buffer.m_colIndices[t]], &buffer.m_indices[0] + buffer.m_colIndices[t + 1]);
+                        values.insert(values.end(), &buffer.m_buffer[buffer.m_colIndices[t]], &buffer.m_buffer[0] + buffer.m_colIndices[t + 1]);
+                    }
+                    colIndices.push_back((CPUSPARSE_INDEX_TYPE) values.size());
+                }
+            }
+            matrix->SetMatrixFromCSCFormat(colIndices.data(), rowIndices.data(), values.data(), values.size(), numRows, numTimeSteps * numSequences);
         }
 
         ++i;
     }
 
-    ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+    ComputationNetwork::BumpEvalTimeStamp(session.m_inputNodes);
 
-    for (size_t i = 0; i < m_outputNodes.size(); ++i)
+    std::vector<ElemType> outputData;
+    for (size_t i = 0; i < session.m_outputNodes.size(); ++i)
     {
-        auto node = m_outputNodes[i];
-        this->m_net->ForwardProp(node);
+        auto node = session.m_outputNodes[i];
+        session.m_net->ForwardProp(node);
         shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
         auto pMBLayout = node->GetMBLayout();
         if (!pMBLayout)
         {
             pMBLayout = make_shared<MBLayout>();
-            pMBLayout->InitAsFrameMode(1); // treat this as if we have one single sample
+            pMBLayout->InitAsFrameMode(1); // treat this as if we have one single sample, which every request gets
         }
+        size_t numRows = outputMatrix->GetNumRows();
+        size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
 
-        const auto& seq = pMBLayout->GetAllSequences();
-        if (seq.size() != 1)
-            RuntimeError("Only 1 output sequence supported by this API");
-
-        ValueContainer<ElemType>& vec = outputs[i].m_buffer;
-
-        size_t numElements = outputMatrix->GetNumElements();
-
-        if (vec.capacity() < numElements)
+        if (numSequences > 1) // fetch all results at once
         {
-            // Bad luck - we can't reallocate memory of an external object at this point.
-            RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+            outputData.resize(outputMatrix->GetNumElements());
+            ElemType* data = outputData.data();
+            size_t size = outputData.size();
+            outputMatrix->CopyToArray(data, size);
         }
 
-        vec.resize(numElements);
-        ElemType* data = const_cast<ElemType*>(vec.data());
-        outputMatrix->CopyToArray(data, numElements);
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            try
+            {
+                // find the output sequence of this request
+                const MBLayout::SequenceInfo* seq = nullptr;
+                for (const auto& candidate : pMBLayout->GetAllSequences())
+                {
+                    if (candidate.seqId == GAP_SEQUENCE_ID || (numSequences > 1 && node->HasMBLayout() && candidate.seqId != s))
+                        continue;
+                    if (seq)
+                        RuntimeError("Only 1 output sequence supported by this API");
+                    seq = &candidate;
+                }
+                if (!seq)
+                    RuntimeError("Only 1 output sequence supported by this API");
+
+                ValueContainer<ElemType>& vec = (*outputs[s])[i].m_buffer;
+
+                size_t tBegin = (size_t) std::max(seq->tBegin, (ptrdiff_t) 0);
+                size_t tEnd = std::min(seq->tEnd, pMBLayout->GetNumTimeSteps());
+                size_t numElements = numSequences == 1 ? outputMatrix->GetNumElements() : numRows * (tEnd - tBegin);
+
+                if (vec.capacity() < numElements)
+                {
+                    // Bad luck - we can't reallocate memory of an external object at this point.
+                    RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+                }
+
+                vec.resize(numElements);
+                ElemType* data = const_cast<ElemType*>(vec.data());
+                if (numSequences == 1)
+                    outputMatrix->CopyToArray(data, numElements);
+                else
+                {
+                    for (size_t t = tBegin; t < tEnd; t++)
+                        memcpy(data + (t - tBegin) * numRows, &outputData[(t * numParallelSequences + seq->s) * numRows], sizeof(ElemType) * numRows);
+                }
+            }
+            catch (...)
+            {
+                errors[s] = std::current_exception();
+            }
+        }
     }
 }
 
@@ -417,6 +721,8 @@ void CNTKEvalExtended<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs,
 template <typename ElemType>
 void CNTKEvalExtended<ElemType>::Destroy()
 {
+    m_idleSessions.clear();
+    m_sessions.clear();
     CNTKEvalBase<ElemType>::Destroy();
     delete this;
 }
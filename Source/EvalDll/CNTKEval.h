@@ -13,6 +13,11 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <exception>
 
 #include "Eval.h"
 #include "EvalReader.h"
@@ -85,12 +90,18 @@ public:
 
 // ------------------------------------------------------------------------
 // Extended interface
+// ForwardPass() may be called concurrently from multiple threads. Each call runs on one of a fixed set of evaluation
+// sessions (config parameter 'numConcurrentForwardPasses', default 1), and waits if all of them are busy. The first session
+// evaluates the loaded network itself; all others evaluate copies that share its parameters (see CloneSharingParameters()),
+// so that each additional session only costs the memory for its activations.
+// Optionally, concurrent calls are batched into a single ForwardPass (config parameters 'maxBatchedRequests' and
+// 'maxBatchingDelayMs'), to trade a little latency for much better GEMM efficiency than one sample at a time.
 // ------------------------------------------------------------------------
 template <typename ElemType>
 class CNTKEvalExtended : public CNTKEvalBase<ElemType>, public IEvaluateModelExtended<ElemType>
 {
 public:
-    CNTKEvalExtended() : CNTKEvalBase<ElemType>(), m_started(false) {}
+    CNTKEvalExtended() : CNTKEvalBase<ElemType>(), m_maxBatchedRequests(1), m_started(false) {}
 
     virtual VariableSchema GetOutputSchema() const override;
 
@@ -102,6 +113,8 @@ public:
 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output) override;
 
+    virtual RequestStatistics GetRequestStatistics() const override;
+
     virtual void Destroy() override;
 
     virtual void CreateNetwork(const std::string& networkDescription) override
@@ -115,14 +128,72 @@ public:
     }
 private:
     static VariableLayout ToVariableLayout(const ComputationNodeBasePtr n);
-    std::vector<ComputationNodeBasePtr> m_outputNodes;
-    std::shared_ptr<ScopedNetworkOperationMode> m_scopedNetworkOperationMode;
+
+    // the state needed by one ForwardPass() at a time
+    struct EvaluationSession
+    {
+        ComputationNetworkPtr m_net;
+        std::shared_ptr<ScopedNetworkOperationMode> m_scopedNetworkOperationMode;
+        std::vector<ComputationNodeBasePtr> m_outputNodes;
+        std::vector<ComputationNodeBasePtr> m_inputNodes;
+        StreamMinibatchInputs m_inputMatrices;
+    };
+    EvaluationSession* AcquireSession();
+    void ReleaseSession(EvaluationSession* session);
+
+    std::vector<ComputationNodeBasePtr> m_outputNodes; // (of m_net, for the schemas)
     std::vector<ComputationNodeBasePtr> m_inputNodes;
-    StreamMinibatchInputs m_inputMatrices;
+    std::vector<std::unique_ptr<EvaluationSession>> m_sessions;
+    std::vector<EvaluationSession*> m_idleSessions;
+    std::mutex m_sessionsMutex;
+    std::condition_variable m_sessionReleased;
+
+    // a ForwardPass() call waiting for its batch to be evaluated
+    template<template<typename> class ValueContainer>
+    struct PendingRequest
+    {
+        const std::vector<ValueBuffer<ElemType, ValueContainer>>* m_inputs;
+        std::vector<ValueBuffer<ElemType, ValueContainer>>* m_outputs;
+        std::chrono::steady_clock::time_point m_arrivalTime;
+        bool m_done;
+        std::exception_ptr m_error;
+    };
+    template<template<typename> class ValueContainer>
+    struct RequestQueue
+    {
+        std::deque<PendingRequest<ValueContainer>*> m_pending;
+        bool m_isCollecting = false; // whether one of the waiting threads is currently collecting the next batch
+    };
+    RequestQueue<Vector>& QueueFor(const Values<ElemType>&) { return m_requestQueue; }
+    RequestQueue<VectorRef>& QueueFor(const ValueRefs<ElemType>&) { return m_requestRefQueue; }
+
+    size_t m_maxBatchedRequests;
+    std::chrono::microseconds m_maxBatchingDelay;
+    RequestQueue<Vector> m_requestQueue; // (requests with different container types are batched separately)
+    RequestQueue<VectorRef> m_requestRefQueue;
+    std::mutex m_requestsMutex;
+    std::condition_variable m_requestsChanged;
+
+    void RecordBatch(const std::vector<std::chrono::steady_clock::time_point>& arrivalTimes, std::chrono::steady_clock::time_point startTime);
+    RequestStatistics m_statistics;
+    mutable std::mutex m_statisticsMutex;
+
     bool m_started;
 
     template<template<typename> class ValueContainer> 
     void ForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
                       std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs);
+    template<template<typename> class ValueContainer> 
+    void BatchedForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
+                             std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs,
+                             std::chrono::steady_clock::time_point arrivalTime);
+    template<template<typename> class ValueContainer> 
+    void ForwardPassT(EvaluationSession& session,
+                      const std::vector<const std::vector<ValueBuffer<ElemType, ValueContainer>>*>& inputs,
+                      const std::vector<std::vector<ValueBuffer<ElemType, ValueContainer>>*>& outputs,
+                      std::vector<std::exception_ptr>& errors);
+    template<template<typename> class ValueContainer> 
+    static void VerifyRequest(const EvaluationSession& session, const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
+                              const std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs);
 };
 } } }
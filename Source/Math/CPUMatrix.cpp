@@ -11,6 +11,7 @@
 
 #include "CPUMatrix.h"
 #include "TensorOps.h"
+#include "TensorOpsVectorized.h"
 #include <assert.h>
 #include <stdexcept>
 #include <omp.h>
@@ -886,7 +887,8 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
         // free previous array allocation if any before overwriting
-		delete[] Buffer();
+        if (!HasExternalBuffer())
+            delete[] Buffer();
 
         m_numRows = numRows;
         m_numCols = numCols;
@@ -1361,6 +1363,229 @@ ElemType CPUMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& gradients,
         return 1;
 }
 
+// Fused updates of many parameters (see MultiTensorSegment).
+// All parameters are covered by a single parallel loop over chunks of similar size, instead of one or more parallel loops
+// per parameter, whose fork/join overhead dominates the update of models with many small parameters.
+// The per-weight updates are those of NormalGrad() etc. above, with the gradient processing of SGD::UpdateWeightsS() around them.
+
+static const size_t multiTensorChunkSize = 16384;
+
+// split the segments into chunks: (segment, first element of the chunk in the segment)
+static std::vector<std::pair<size_t, size_t>> GetMultiTensorChunks(const std::vector<MultiTensorSegment>& segments)
+{
+    std::vector<std::pair<size_t, size_t>> chunks;
+    for (size_t s = 0; s < segments.size(); s++)
+        for (size_t begin = 0; begin < segments[s].numElements; begin += multiTensorChunkSize)
+            chunks.push_back(make_pair(s, begin));
+    return chunks;
+}
+
+static size_t GetMultiTensorChunkEnd(const std::vector<MultiTensorSegment>& segments, const std::pair<size_t, size_t>& chunk)
+{
+    return min(chunk.second + multiTensorChunkSize, segments[chunk.first].numElements);
+}
+
+// gradient clipping and L2 regularization
+template <class ElemType>
+static inline ElemType RegularizeGradient(ElemType g, ElemType w, ElemType clippingThreshold, ElemType L2RegWeight)
+{
+    if (g > clippingThreshold)
+        g = clippingThreshold;
+    else if (g < -clippingThreshold)
+        g = -clippingThreshold;
+    if (L2RegWeight > 0)
+        g += L2RegWeight * w;
+    return g;
+}
+
+// L1 regularization (soft thresholding)
+template <class ElemType>
+static inline ElemType RegularizeWeight(ElemType w, ElemType L1Threshold)
+{
+    if (L1Threshold > 0)
+    {
+        if (w > L1Threshold)
+            w -= L1Threshold;
+        else if (w < -L1Threshold)
+            w += L1Threshold;
+        else
+            w = 0;
+    }
+    return w;
+}
+
+// update(s, i, g, learnRatePerSample) updates the state of the i-th weight of segment s and returns the amount to subtract from it
+template <class ElemType, class ElementUpdate>
+static void MultiTensorUpdate(ElemType* grad, ElemType* val, const std::vector<MultiTensorSegment>& segments,
+                              const MultiTensorRegularization& regularization, const ElementUpdate& update)
+{
+    auto chunks = GetMultiTensorChunks(segments);
+    const ElemType clippingThreshold = (ElemType) fabs(regularization.clippingThreshold);
+    const ElemType L2RegWeight = (ElemType) regularization.L2RegWeight;
+#pragma omp parallel for schedule(dynamic)
+    for (long c = 0; c < (long) chunks.size(); c++)
+    {
+        size_t s = chunks[c].first;
+        const MultiTensorSegment& segment = segments[s];
+        const ElemType learnRatePerSample = (ElemType) segment.learnRatePerSample;
+        const ElemType L1Threshold = (ElemType) (regularization.L1RegWeight * segment.learnRatePerSample);
+        size_t end = GetMultiTensorChunkEnd(segments, chunks[c]);
+        for (size_t i = chunks[c].second; i < end; i++)
+        {
+            size_t k = segment.offset + i;
+            ElemType g = RegularizeGradient(grad[k], val[k], clippingThreshold, L2RegWeight);
+            val[k] = RegularizeWeight(val[k] - update(s, i, g, learnRatePerSample), L1Threshold);
+        }
+    }
+}
+
+// for updates that scale the gradients: update(s, i, g) updates the state of the i-th weight of segment s and returns the scale,
+// which is normalized by its average over the parameter if needAveMultiplier (the only case that needs a second pass)
+template <class ElemType, class ElementUpdate>
+static void MultiTensorScaledUpdate(ElemType* grad, ElemType* val, const std::vector<MultiTensorSegment>& segments,
+                                    const MultiTensorRegularization& regularization, bool needAveMultiplier, const ElementUpdate& update)
+{
+    auto chunks = GetMultiTensorChunks(segments);
+    const ElemType clippingThreshold = (ElemType) fabs(regularization.clippingThreshold);
+    const ElemType L2RegWeight = (ElemType) regularization.L2RegWeight;
+    std::vector<double> chunkMultiplierSums(chunks.size(), 0);
+#pragma omp parallel for schedule(dynamic)
+    for (long c = 0; c < (long) chunks.size(); c++)
+    {
+        size_t s = chunks[c].first;
+        const MultiTensorSegment& segment = segments[s];
+        const ElemType learnRatePerSample = (ElemType) segment.learnRatePerSample;
+        const ElemType L1Threshold = (ElemType) (regularization.L1RegWeight * segment.learnRatePerSample);
+        size_t end = GetMultiTensorChunkEnd(segments, chunks[c]);
+        double multiplierSum = 0;
+        for (size_t i = chunks[c].second; i < end; i++)
+        {
+            size_t k = segment.offset + i;
+            ElemType g = RegularizeGradient(grad[k], val[k], clippingThreshold, L2RegWeight);
+            ElemType a = update(s, i, g);
+            if (needAveMultiplier)
+            {
+                grad[k] = g * a; // applied below
+                multiplierSum += a;
+            }
+            else
+                val[k] = RegularizeWeight(val[k] - learnRatePerSample * g * a, L1Threshold);
+        }
+        chunkMultiplierSums[c] = multiplierSum;
+    }
+    if (!needAveMultiplier)
+        return;
+
+    std::vector<double> aveMultipliers(segments.size(), 0);
+    for (size_t c = 0; c < chunks.size(); c++)
+        aveMultipliers[chunks[c].first] += chunkMultiplierSums[c];
+    for (size_t s = 0; s < segments.size(); s++)
+        aveMultipliers[s] = segments[s].numElements > 0 ? aveMultipliers[s] / segments[s].numElements : 1;
+#pragma omp parallel for schedule(dynamic)
+    for (long c = 0; c < (long) chunks.size(); c++)
+    {
+        size_t s = chunks[c].first;
+        const MultiTensorSegment& segment = segments[s];
+        const ElemType learnRate = (ElemType) (segment.learnRatePerSample / aveMultipliers[s]);
+        const ElemType L1Threshold = (ElemType) (regularization.L1RegWeight * segment.learnRatePerSample);
+        size_t end = GetMultiTensorChunkEnd(segments, chunks[c]);
+        for (size_t i = chunks[c].second; i < end; i++)
+        {
+            size_t k = segment.offset + i;
+            val[k] = RegularizeWeight(val[k] - learnRate * grad[k], L1Threshold);
+        }
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::MultiTensorNormalGrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues,
+                                                const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                                                ElemType momentum, bool useNesterovMomentum)
+{
+    ElemType* smoothed = Data();
+    MultiTensorUpdate(gradients.Data(), functionValues.Data(), segments, regularization, [&](size_t s, size_t i, ElemType g, ElemType learnRatePerSample)
+    {
+        ElemType& sg = smoothed[segments[s].offset + i];
+        sg = (1 - momentum) * learnRatePerSample * g + momentum * sg;
+        return useNesterovMomentum ? momentum * sg + (1 - momentum) * learnRatePerSample * g : sg;
+    });
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::MultiTensorAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues,
+                                             const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                                             const bool needAveMultiplier)
+{
+    const ElemType floor = 1e-16f;
+    ElemType* a = Data();
+    MultiTensorScaledUpdate(gradients.Data(), functionValues.Data(), segments, regularization, needAveMultiplier, [&](size_t s, size_t i, ElemType g)
+    {
+        ElemType& ai = a[segments[s].offset + i];
+        ai += g * g;
+        return 1 / sqrt(ai + floor);
+    });
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::MultiTensorFSAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues,
+                                               const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                                               ElemType momentum, ElemType adaWeight, const std::vector<ElemType>& adaMuls)
+{
+    ElemType* state = Data();
+    MultiTensorUpdate(gradients.Data(), functionValues.Data(), segments, regularization, [&](size_t s, size_t i, ElemType g, ElemType learnRatePerSample)
+    {
+        ElemType* smoothAda = state + 2 * segments[s].offset;
+        ElemType* smoothMom = smoothAda + segments[s].numElements;
+
+        ElemType adaSqr = adaWeight * smoothAda[i] + (1.0f - adaWeight) * g * g;
+        smoothAda[i] = adaSqr;
+        if (adaSqr != 0.0f)
+        {
+            ElemType w = adaMuls[s] * ((ElemType) 1.0 / sqrt(adaSqr));
+            if (w > 10.0f)
+                w = 10.0f;
+            g *= w;
+        }
+
+        if (momentum > 0.0f)
+        {
+            g = momentum * smoothMom[i] + (1.0f - momentum) * g;
+            smoothMom[i] = g;
+        }
+
+        return g * learnRatePerSample;
+    });
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::MultiTensorRmsProp(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues,
+                                             const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                                             ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                                             const bool needAveMultiplier)
+{
+    const ElemType floor = 1e-6f;
+    const ElemType ONE_MINUS_GAMMA = ElemType(1.0) - RMS_GAMMA;
+    ElemType* state = Data();
+    MultiTensorScaledUpdate(gradients.Data(), functionValues.Data(), segments, regularization, needAveMultiplier, [&](size_t s, size_t i, ElemType g)
+    {
+        size_t n = segments[s].numElements;
+        ElemType* avars = state + 3 * segments[s].offset; // accumulated variances for RMS scaling
+        ElemType* signs = avars + n;                      // sign of previous gradient
+        ElemType* steps = avars + 2 * n;                  // current step size
+
+        avars[i] = RMS_GAMMA * avars[i] + ONE_MINUS_GAMMA * (g * g);
+        const int grad_sign = (ElemType(0) < g) - (g < ElemType(0));
+
+        if (signs[i] * grad_sign > 0)
+            steps[i] = std::min(steps[i] * RMS_WGT_INC, RMS_WGT_MAX);
+        else
+            steps[i] = std::max(steps[i] * RMS_WGT_DEC, RMS_WGT_MIN);
+        signs[i] = (ElemType) grad_sign;
+
+        return steps[i] / sqrt(avars[i] + floor);
+    });
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1457,10 +1682,13 @@ size_t CPUMatrix<ElemType>::CopyToArray(ElemType*& arrayCopyTo, size_t& currentA
 }
 
 template <typename ElemType>
-void CPUMatrix<ElemType>::CopySection(size_t /*numRows*/, size_t /*numCols*/, ElemType* /*dst*/, size_t /*colStride*/) const
+void CPUMatrix<ElemType>::CopySection(size_t numRows, size_t numCols, ElemType* dst, size_t colStride) const
 {
-    // REVIEW alexeyk: currently not used by CPU, but implement when possible.
-    RuntimeError("Not implemented.");
+    if (numRows > GetNumRows() || numCols > GetNumCols())
+        InvalidArgument("CopySection: The section exceeds the matrix dimensions.");
+
+    for (size_t j = 0; j < numCols; j++)
+        memcpy(dst + j * colStride, Data() + LocateColumn(j), sizeof(ElemType) * numRows);
 }
 
 template <class ElemType>
@@ -4413,40 +4641,243 @@ void CPUMatrix<ElemType>::AveragePoolingBackward(const CPUMatrix<int>& mpRowCol,
     }
 }
 
+// -----------------------------------------------------------------------
+// batch normalization
+// This is the CPU counterpart of CntkBatchNormalization.cuh and uses the same conventions: the input is
+// [vectorSize x batchSize], one sample per column. In the spatial case each column is a CHW image, i.e.
+// consecutive runs of spatialSize values share one map's mean, inverse std dev, scale and bias; otherwise
+// spatialSize == 1 and every row is its own map.
+// Statistics are computed in a single pass over the input, each chunk of columns on its own thread, and the
+// per-chunk results are merged with the pairwise update of Chan et al. All inner loops run over contiguous
+// memory without a loop-carried dependency (reductions keep several independent partial sums), so that the
+// compiler can vectorize them.
+// -----------------------------------------------------------------------
+
+static const size_t c_minParallelBatchNormElements = 32768; // below this, OMP overhead outweighs the gain
+static const size_t c_batchNormSumLanes = 8;                // independent partial sums in the reductions below
+
+// number of column chunks that a batch normalization pass splits the minibatch into (at most one per thread)
+static size_t BatchNormalizationChunks(size_t vectorSize, size_t batchSize)
+{
+    if (omp_in_parallel() || vectorSize * batchSize < c_minParallelBatchNormElements)
+        return 1;
+    return std::min((size_t) omp_get_max_threads(), batchSize);
+}
+
+// returns sum(x[k] - shift) and sum((x[k] - shift)^2) over k = 0..n-1
+template <class ElemType>
+static void BatchNormalizationSums(const ElemType* x, size_t n, ElemType shift, ElemType& sum, ElemType& sqrSum)
+{
+    ElemType s[c_batchNormSumLanes] = {};
+    ElemType s2[c_batchNormSumLanes] = {};
+    size_t k = 0;
+    for (; k + c_batchNormSumLanes <= n; k += c_batchNormSumLanes)
+    {
+        for (size_t l = 0; l < c_batchNormSumLanes; l++)
+        {
+            ElemType d = x[k + l] - shift;
+            s[l] += d;
+            s2[l] += d * d;
+        }
+    }
+    for (; k < n; k++)
+    {
+        ElemType d = x[k] - shift;
+        s[0] += d;
+        s2[0] += d * d;
+    }
+    sum = sqrSum = 0;
+    for (size_t l = 0; l < c_batchNormSumLanes; l++)
+    {
+        sum += s[l];
+        sqrSum += s2[l];
+    }
+}
+
+// returns sum(dy[k]) and sum(dy[k] * (x[k] - shift)) over k = 0..n-1
+template <class ElemType>
+static void BatchNormalizationGradientSums(const ElemType* x, const ElemType* dy, size_t n, ElemType shift, ElemType& sum, ElemType& prodSum)
+{
+    ElemType s[c_batchNormSumLanes] = {};
+    ElemType sp[c_batchNormSumLanes] = {};
+    size_t k = 0;
+    for (; k + c_batchNormSumLanes <= n; k += c_batchNormSumLanes)
+    {
+        for (size_t l = 0; l < c_batchNormSumLanes; l++)
+        {
+            s[l] += dy[k + l];
+            sp[l] += dy[k + l] * (x[k + l] - shift);
+        }
+    }
+    for (; k < n; k++)
+    {
+        s[0] += dy[k];
+        sp[0] += dy[k] * (x[k] - shift);
+    }
+    sum = prodSum = 0;
+    for (size_t l = 0; l < c_batchNormSumLanes; l++)
+    {
+        sum += s[l];
+        prodSum += sp[l];
+    }
+}
+
+// Computes the mean and M2 (sum of squared deviations from the mean) of each map over the columns [firstCol, endCol).
+// Non-spatial: Welford's update, which is vectorized across rows since all rows have seen the same number of values.
+// Spatial: mean and M2 of each map's run of spatialSize values are computed while the run is in cache (relative to the
+// current mean, to avoid cancellation), then merged into the statistics of the previous columns.
+template <class ElemType>
+static void BatchNormalizationStatistics(const ElemType* x, size_t vectorSize, size_t spatialSize, size_t firstCol, size_t endCol,
+                                         ElemType* mean, ElemType* m2)
+{
+    const size_t numMaps = vectorSize / spatialSize;
+    std::fill(mean, mean + numMaps, (ElemType) 0);
+    std::fill(m2, m2 + numMaps, (ElemType) 0);
+    for (size_t j = firstCol; j < endCol; j++)
+    {
+        const ElemType* px = x + j * vectorSize;
+        const size_t n = j - firstCol; // number of columns accumulated so far
+        const ElemType w = (ElemType) (1.0 / (n + 1));
+        if (spatialSize == 1)
+        {
+            for (size_t i = 0; i < vectorSize; i++)
+            {
+                ElemType d = px[i] - mean[i];
+                mean[i] += d * w;
+                m2[i] += d * (px[i] - mean[i]);
+            }
+        }
+        else
+        {
+            // merging n * spatialSize values with a run of spatialSize values: the run's weight is 1 / (n + 1)
+            const ElemType invSpatialSize = (ElemType) (1.0 / spatialSize);
+            const ElemType prevCount = (ElemType) (n * spatialSize);
+            for (size_t c = 0; c < numMaps; c++)
+            {
+                ElemType sum, sqrSum;
+                if (n == 0) // no previous estimate of the mean to shift by
+                {
+                    BatchNormalizationSums(px + c * spatialSize, spatialSize, (ElemType) 0, sum, sqrSum);
+                    mean[c] = sum * invSpatialSize;
+                }
+                BatchNormalizationSums(px + c * spatialSize, spatialSize, mean[c], sum, sqrSum);
+                ElemType d = sum * invSpatialSize; // run mean minus current mean
+                mean[c] += d * w;
+                m2[c] += (sqrSum - d * sum) + d * d * prevCount * w;
+            }
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::BatchNormalizationForward(const CPUMatrix<ElemType>& scale, const CPUMatrix<ElemType>& bias, double expAvgFactor, double blendFactor,
                                                     CPUMatrix<ElemType>& runMean, CPUMatrix<ElemType>& runInvStdDev, CPUMatrix<ElemType>& out, double epsilon,
                                                     CPUMatrix<ElemType>& saveMean, CPUMatrix<ElemType>& saveInvStdDev) const
 {
-    UNUSED(epsilon); UNUSED(saveMean); UNUSED(saveInvStdDev);
-
     assert((GetNumRows() % scale.GetNumRows()) == 0);
 
-    if (expAvgFactor != 0 || blendFactor != 1)
-        RuntimeError("Batch normalization training on CPU is not yet implemented.");
+    const size_t vectorSize = GetNumRows();
+    const size_t numMaps = scale.GetNumRows();
+    const size_t spatialSize = vectorSize / numMaps;
+    const size_t batchSize = GetNumCols();
+    const ElemType* x = Data();
 
-    bool spatial = GetNumRows() != scale.GetNumRows();
-    if (spatial)
+    // If expAvgFactor == 0 && blendFactor == 1 then we don't need to compute current minibatch statistics.
+    if (expAvgFactor > 0 || blendFactor < 1)
     {
-        size_t spatialSize = GetNumRows() / scale.GetNumRows();
-#pragma omp parallel for
-        for (long icol = 0; icol < out.GetNumCols(); icol++)
+        // per-chunk means and M2 values, [numMaps x 2 * numChunks]
+        const size_t numChunks = BatchNormalizationChunks(vectorSize, batchSize);
+        std::vector<ElemType> partials(2 * numMaps * numChunks);
+#pragma omp parallel for if (numChunks > 1)
+        for (long chunk = 0; chunk < (long) numChunks; chunk++)
         {
-            for (long irow = 0; irow < out.GetNumRows(); irow++)
+            BatchNormalizationStatistics(x, vectorSize, spatialSize, batchSize * chunk / numChunks, batchSize * (chunk + 1) / numChunks,
+                                         &partials[2 * chunk * numMaps], &partials[(2 * chunk + 1) * numMaps]);
+        }
+
+        ElemType* mean = saveMean.Data();
+        ElemType* invStdDev = saveInvStdDev.Data();
+        ElemType* rMean = runMean.Data();
+        ElemType* rInvStdDev = runInvStdDev.Data();
+        for (size_t i = 0; i < numMaps; i++)
+        {
+            double n = 0; // number of values merged so far
+            double m = 0;
+            double m2 = 0;
+            for (size_t chunk = 0; chunk < numChunks; chunk++)
+            {
+                double nb = (double) ((batchSize * (chunk + 1) / numChunks - batchSize * chunk / numChunks) * spatialSize);
+                if (nb == 0)
+                    continue;
+                double d = partials[2 * chunk * numMaps + i] - m;
+                double w = nb / (n + nb);
+                m += d * w;
+                m2 += partials[(2 * chunk + 1) * numMaps + i] + d * d * n * w;
+                n += nb;
+            }
+            mean[i] = (ElemType) m;
+            invStdDev[i] = (ElemType) (1 / sqrt(m2 / n + epsilon));
+            if (expAvgFactor == 1)
             {
-                size_t imap = irow / spatialSize;
-                out(irow, icol) = scale(imap, 0) * ((*this)(irow, icol) - runMean(imap, 0)) * runInvStdDev(imap, 0) + bias(imap, 0);
+                rMean[i] = mean[i];
+                rInvStdDev[i] = invStdDev[i];
+            }
+            else
+            {
+                rMean[i] = (ElemType) (expAvgFactor * mean[i] + (1.0 - expAvgFactor) * rMean[i]);
+                rInvStdDev[i] = (ElemType) (expAvgFactor * invStdDev[i] + (1.0 - expAvgFactor) * rInvStdDev[i]);
             }
         }
     }
-    else
+
+    // When:
+    //     blendFactor == 1 - use running mean/var instead of the current minibatch mean/var.
+    // 0 < blendFactor <  1 - blend running mean/var with mean/var of the current minibatch: saveMean = (1 - blendFactor) * saveMean + blendFactor * runMean
+    //     blendFactor == 0 - use mean/var of the current minibatch.
+    const CPUMatrix<ElemType>* normMean = &runMean;
+    const CPUMatrix<ElemType>* normInvStdDev = &runInvStdDev;
+    if (blendFactor < 1)
     {
-#pragma omp parallel for
-        for (long icol = 0; icol < out.GetNumCols(); icol++)
+        if (blendFactor > 0)
         {
-            for (long irow = 0; irow < out.GetNumRows(); irow++)
+            for (size_t i = 0; i < numMaps; i++)
             {
-                out(irow, icol) = scale(irow, 0) * ((*this)(irow, icol) - runMean(irow, 0)) * runInvStdDev(irow, 0) + bias(irow, 0);
+                saveMean(i, 0) = (ElemType) ((1 - blendFactor) * saveMean(i, 0) + blendFactor * runMean(i, 0));
+                saveInvStdDev(i, 0) = (ElemType) ((1 - blendFactor) * saveInvStdDev(i, 0) + blendFactor * runInvStdDev(i, 0));
+            }
+        }
+        normMean = &saveMean;
+        normInvStdDev = &saveInvStdDev;
+    }
+
+    // normalize, scale and shift in one pass: out = (x - mean) * (scale * invStdDev) + bias
+    std::vector<ElemType> factor(numMaps);
+    for (size_t i = 0; i < numMaps; i++)
+        factor[i] = scale(i, 0) * (*normInvStdDev)(i, 0);
+    const ElemType* pmean = normMean->Data();
+    const ElemType* pbias = bias.Data();
+    ElemType* y = out.Data();
+#pragma omp parallel for if (vectorSize * batchSize >= c_minParallelBatchNormElements)
+    for (long j = 0; j < (long) batchSize; j++)
+    {
+        const ElemType* px = x + j * vectorSize;
+        ElemType* py = y + j * vectorSize;
+        if (spatialSize == 1)
+        {
+            for (size_t i = 0; i < vectorSize; i++)
+                py[i] = (px[i] - pmean[i]) * factor[i] + pbias[i];
+        }
+        else
+        {
+            for (size_t c = 0; c < numMaps; c++)
+            {
+                const ElemType m = pmean[c];
+                const ElemType f = factor[c];
+                const ElemType b = pbias[c];
+                const ElemType* pxc = px + c * spatialSize;
+                ElemType* pyc = py + c * spatialSize;
+                for (size_t k = 0; k < spatialSize; k++)
+                    pyc[k] = (pxc[k] - m) * f + b;
             }
         }
     }
@@ -4456,8 +4887,102 @@ template <class ElemType>
 void CPUMatrix<ElemType>::BatchNormalizationBackward(const CPUMatrix<ElemType>& in, CPUMatrix<ElemType>& grad, const CPUMatrix<ElemType>& scale, const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev,
                                                      CPUMatrix<ElemType>& scaleGrad, CPUMatrix<ElemType>& biasGrad) const
 {
-    UNUSED(in); UNUSED(grad); UNUSED(scale); UNUSED(saveMean); UNUSED(saveInvStdDev); UNUSED(scaleGrad); UNUSED(biasGrad);
-    RuntimeError("Batch normalization training on CPU is not yet implemented.");
+    assert((GetNumRows() % scale.GetNumRows()) == 0);
+
+    const size_t vectorSize = GetNumRows();
+    const size_t numMaps = scale.GetNumRows();
+    const size_t spatialSize = vectorSize / numMaps;
+    const size_t batchSize = GetNumCols();
+    const ElemType* x = in.Data();
+    const ElemType* dy = Data();
+    const ElemType* mean = saveMean.Data();
+    const ElemType* invStdDev = saveInvStdDev.Data();
+
+    // scale and bias gradients: per-chunk sums of dy * (x - mean) and dy, [numMaps x 2 * numChunks]
+    const size_t numChunks = BatchNormalizationChunks(vectorSize, batchSize);
+    std::vector<ElemType> partials(2 * numMaps * numChunks);
+#pragma omp parallel for if (numChunks > 1)
+    for (long chunk = 0; chunk < (long) numChunks; chunk++)
+    {
+        ElemType* ds = &partials[2 * chunk * numMaps];
+        ElemType* db = &partials[(2 * chunk + 1) * numMaps];
+        for (size_t j = batchSize * chunk / numChunks; j < batchSize * (chunk + 1) / numChunks; j++)
+        {
+            const ElemType* px = x + j * vectorSize;
+            const ElemType* pdy = dy + j * vectorSize;
+            if (spatialSize == 1)
+            {
+                for (size_t i = 0; i < vectorSize; i++)
+                {
+                    ds[i] += pdy[i] * (px[i] - mean[i]);
+                    db[i] += pdy[i];
+                }
+            }
+            else
+            {
+                for (size_t c = 0; c < numMaps; c++)
+                {
+                    ElemType sum, prodSum;
+                    BatchNormalizationGradientSums(px + c * spatialSize, pdy + c * spatialSize, spatialSize, mean[c], sum, prodSum);
+                    ds[c] += prodSum;
+                    db[c] += sum;
+                }
+            }
+        }
+    }
+
+    // From the BN paper, dL/dxi = (scale * invStdDev) * (dL/dyi - (xHat * dL/dScale + dL/dBias) / m), which is
+    // dx += f * dy + g * (x - mean) + h with the per-map factors below.
+    const ElemType m = (ElemType) (batchSize * spatialSize);
+    std::vector<ElemType> factors(3 * numMaps);
+    ElemType* f = &factors[0];
+    ElemType* g = &factors[numMaps];
+    ElemType* h = &factors[2 * numMaps];
+    for (size_t i = 0; i < numMaps; i++)
+    {
+        ElemType ds = 0;
+        ElemType db = 0;
+        for (size_t chunk = 0; chunk < numChunks; chunk++)
+        {
+            ds += partials[2 * chunk * numMaps + i];
+            db += partials[(2 * chunk + 1) * numMaps + i];
+        }
+        ds *= invStdDev[i];
+        scaleGrad(i, 0) = ds;
+        biasGrad(i, 0) = db;
+        f[i] = scale(i, 0) * invStdDev[i];
+        g[i] = -f[i] * invStdDev[i] * ds / m;
+        h[i] = -f[i] * db / m;
+    }
+
+    ElemType* dx = grad.Data();
+#pragma omp parallel for if (vectorSize * batchSize >= c_minParallelBatchNormElements)
+    for (long j = 0; j < (long) batchSize; j++)
+    {
+        const ElemType* px = x + j * vectorSize;
+        const ElemType* pdy = dy + j * vectorSize;
+        ElemType* pdx = dx + j * vectorSize;
+        if (spatialSize == 1)
+        {
+            for (size_t i = 0; i < vectorSize; i++)
+                pdx[i] += f[i] * pdy[i] + g[i] * (px[i] - mean[i]) + h[i];
+        }
+        else
+        {
+            for (size_t c = 0; c < numMaps; c++)
+            {
+                const ElemType mc = mean[c];
+                const ElemType fc = f[c];
+                const ElemType gc = g[c];
+                const ElemType hc = h[c];
+                const ElemType* pxc = px + c * spatialSize;
+                const ElemType* pdyc = pdy + c * spatialSize;
+                ElemType* pdxc = pdx + c * spatialSize;
+                for (size_t k = 0; k < spatialSize; k++)
+                    pdxc[k] += fc * pdyc[k] + gc * (pxc[k] - mc) + hc;
+            }
+        }
+    }
 }
 
 
@@ -6183,6 +6708,152 @@ struct TensorOpIteration<ElemType, OPFN, N, vectorizable, m, -1>
     }
 };
 
+// -----------------------------------------------------------------------
+// parallel execution of reductions
+// -----------------------------------------------------------------------
+
+// Reductions (e.g. bias gradients or ReduceElements) cannot use the parallel innermost loop above, which only
+// exists for the non-reducing case. Instead, they are parallelized at the top level:
+//  - if there are at least as many output elements as threads, threads compute disjoint sets of output elements
+//    (split along the outermost regular dimension if that is large enough, else along the flattened output);
+//  - otherwise (tiny output, e.g. a bias gradient of a few elements or a reduction to a scalar), the outermost
+//    reducing dimension is split across threads, each thread reduces its range into a private buffer of partial
+//    results, and the partial results are then combined into the output, again in parallel over the outputs.
+// Small operations are executed serially since the OMP overhead would dominate.
+static const size_t c_minParallelTensorReductionWork = 32768; // number of opfn() invocations below which we run serially
+
+// call fn(j, offsets) for all output elements j of a tensor of dimensions 'dims' in parallel, where 'offsets'
+// are the element offsets for the given 'strides'. Each thread walks a contiguous range of j, so that the
+// offsets are incremented rather than recomputed from j for each element.
+template <size_t N, typename FN>
+static void ParallelForEachTensorElement(size_t numElements, const SmallVector<size_t>& dims, const array<SmallVector<ptrdiff_t>, N>& strides, const FN& fn)
+{
+    const size_t numBlocks = std::min((size_t) omp_get_max_threads(), numElements);
+#pragma omp parallel for
+    for (int block = 0; block < (int) numBlocks; block++)
+    {
+        const size_t begin = numElements * block / numBlocks;
+        const size_t end = numElements * (block + 1) / numBlocks;
+        // locate the first element of the range
+        SmallVector<size_t> index(dims.size(), 0);
+        array<ptrdiff_t, N> offsets;
+        offsets.fill(0);
+        for (size_t d = 0, rest = begin; d < dims.size(); d++)
+        {
+            index[d] = rest % dims[d];
+            rest /= dims[d];
+            for (size_t i = 0; i < N; i++)
+                offsets[i] += (ptrdiff_t) index[d] * strides[i][d];
+        }
+        for (size_t j = begin; j < end; j++)
+        {
+            fn(j, offsets);
+            // step to the next element
+            for (size_t d = 0; d < dims.size(); d++)
+            {
+                for (size_t i = 0; i < N; i++)
+                    offsets[i] += strides[i][d];
+                if (++index[d] < dims[d])
+                    break;
+                for (size_t i = 0; i < N; i++)
+                    offsets[i] -= (ptrdiff_t) dims[d] * strides[i][d];
+                index[d] = 0;
+            }
+        }
+    }
+}
+
+template <class ElemType, typename OPFN, size_t N, int m, int k>
+static void ParallelTensorOpReduction(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn,
+                                      const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                      const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    typedef TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, m, k> SerialIteration;
+    typedef TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, m, -1> ElementIteration;
+
+    size_t numOutputs = 1;
+    for (auto dim : regularOpDims)
+        numOutputs *= dim;
+    size_t reductionSize = 1;
+    for (auto dim : reducingOpDims)
+        reductionSize *= dim;
+    const size_t numThreads = (size_t) omp_get_max_threads();
+    if (numThreads <= 1 || omp_in_parallel() || numOutputs * reductionSize < c_minParallelTensorReductionWork)
+        return SerialIteration::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    // enough output elements in the outermost regular dimension: split that across threads
+    if (k >= 0 && regularOpDims[(size_t) k] >= numThreads)
+    {
+        const int outerDim = (int) regularOpDims[(size_t) k];
+#pragma omp parallel for
+        for (int j = 0; j < outerDim; j++)
+        {
+            array<ElemType*, N> threadPointers;
+            for (size_t i = 0; i < N; i++)
+                threadPointers[i] = pointers[i] + j * regularStrides[i][(size_t) k];
+            // (the k > 0 guard only keeps the template argument valid; this branch is not taken for k = -1)
+            TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, m, (k > 0 ? k - 1 : -1)>::Loop(beta, threadPointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        }
+        return;
+    }
+
+    // enough output elements overall, but spread over several regular dimensions: split the flattened output
+    if (numOutputs >= numThreads)
+    {
+        ParallelForEachTensorElement<N>(numOutputs, regularOpDims, regularStrides, [&](size_t, const array<ptrdiff_t, N>& offsets)
+        {
+            array<ElemType*, N> elementPointers;
+            for (size_t i = 0; i < N; i++)
+                elementPointers[i] = pointers[i] + offsets[i];
+            ElementIteration::Loop(beta, elementPointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        });
+        return;
+    }
+
+    // tiny output: split the outermost reducing dimension across threads
+    const size_t reducedDim = reducingOpDims[(size_t) m];
+    const size_t numChunks = std::min(numThreads, reducedDim);
+    if (numChunks <= 1)
+        return SerialIteration::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    // each chunk writes its partial results densely into its own slice of 'partials'
+    array<SmallVector<ptrdiff_t>, N> partialStrides = regularStrides;
+    ptrdiff_t partialStride = 1;
+    for (size_t d = 0; d < regularOpDims.size(); d++)
+    {
+        partialStrides[N - 1][d] = partialStride;
+        partialStride *= (ptrdiff_t) regularOpDims[d];
+    }
+    vector<ElemType> partials(numChunks * numOutputs);
+#pragma omp parallel for
+    for (int chunk = 0; chunk < (int) numChunks; chunk++)
+    {
+        const size_t begin = reducedDim * chunk / numChunks;
+        const size_t end = reducedDim * (chunk + 1) / numChunks;
+        SmallVector<size_t> chunkReducingOpDims = reducingOpDims;
+        chunkReducingOpDims[(size_t) m] = end - begin;
+        array<ElemType*, N> chunkPointers;
+        for (size_t i = 0; i < N - 1; i++)
+            chunkPointers[i] = pointers[i] + (ptrdiff_t) begin * reducingStrides[i][(size_t) m];
+        chunkPointers[N - 1] = partials.data() + chunk * numOutputs;
+        SerialIteration::Loop(0, chunkPointers, 1, opfn, regularOpDims, partialStrides, chunkReducingOpDims, reducingStrides);
+    }
+
+    // combine the partial results, then scale and write out like TensorOpIteration<..., -1> does
+    const array<SmallVector<ptrdiff_t>, 1> outputStrides{ { regularStrides[N - 1] } };
+    ParallelForEachTensorElement<1>(numOutputs, regularOpDims, outputStrides, [&](size_t j, const array<ptrdiff_t, 1>& offsets)
+    {
+        double /*ElemType*/ aggregate = 0;
+        for (size_t chunk = 0; chunk < numChunks; chunk++)
+            aggregate += partials[chunk * numOutputs + j];
+        ElemType val = (ElemType) aggregate * alpha;
+        auto* pout = pointers.back() + offsets[0];
+        if (beta != 0)
+            val += beta * *pout;
+        *pout = val;
+    });
+}
+
 // -----------------------------------------------------------------------
 // map runtime parameters N to template parameters
 // -----------------------------------------------------------------------
@@ -6197,9 +6868,9 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
     switch (dims)
     {
     case 2:
-        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return ParallelTensorOpReduction<ElemType, OPFN, N, 1, k>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 1:
-        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 0, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return ParallelTensorOpReduction<ElemType, OPFN, N, 0, k>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 0:
     {
         // if all leading dimensions are 1, we can let the compiler do some unrolling
@@ -6244,6 +6915,77 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
     }
 }
 
+// -----------------------------------------------------------------------
+// hand-vectorized kernels for contiguous float tensors (see TensorOpsVectorized.h)
+// -----------------------------------------------------------------------
+
+static const size_t c_minParallelVectorizedElements = 65536; // below this, OMP overhead outweighs the gain
+
+static inline bool HasVectorizedTensorOp(ElementWiseOperator op, const array<float*, 2>&) { return HasVectorizedUnaryTensorOp(op); }
+static inline bool HasVectorizedTensorOp(ElementWiseOperator op, const array<float*, 3>&) { return HasVectorizedBinaryTensorOp(op); }
+
+static inline void VectorizedTensorOp(ElementWiseOperator op, float beta, const array<float*, 2>& pointers, float alpha, size_t n)
+{
+    VectorizedUnaryTensorOp(op, beta, pointers[0], pointers[1], alpha, n);
+}
+static inline void VectorizedTensorOp(ElementWiseOperator op, float beta, const array<float*, 3>& pointers, float alpha, size_t n)
+{
+    VectorizedBinaryTensorOp(op, beta, pointers[0], pointers[1], pointers[2], alpha, n);
+}
+
+// run the op through a vectorized kernel if there is one and all operands are contiguous in the leading dimension
+// Returns false if the generic code must be used. The generic version is for non-float types.
+template <class ElemType, size_t N>
+static bool TryVectorizedTensorOp(ElemType, array<ElemType*, N>, ElemType, ElementWiseOperator,
+                                  const array<size_t, N>&, const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&, const SmallVector<size_t>&)
+{
+    return false;
+}
+template <size_t N>
+static bool TryVectorizedTensorOp(float beta, array<float*, N> pointers, float alpha, ElementWiseOperator op,
+                                  const array<size_t, N>& offsets, const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                  const SmallVector<size_t>& reducingOpDims)
+{
+    // TensorView flattens consecutive dimensions, so contiguous tensors of matching shapes arrive here as 1D
+    // (or 2D, e.g. when one operand is a column slice). Anything else goes to the generic code.
+    if (!reducingOpDims.empty() || regularOpDims.empty() || regularOpDims.size() > 2 || !HasVectorizedTensorOp(op, pointers))
+        return false;
+    for (size_t i = 0; i < N; i++)
+        if (regularStrides[i][0] != 1)
+            return false;
+    for (size_t i = 0; i < N; i++)
+        pointers[i] += offsets[i];
+
+    const size_t n = regularOpDims[0];
+    const size_t numRows = regularOpDims.size() > 1 ? regularOpDims[1] : 1;
+    if (numRows == 1) // split a long vector into one chunk per thread
+    {
+        const size_t numChunks = n < c_minParallelVectorizedElements ? 1 : (size_t) omp_get_max_threads();
+#pragma omp parallel for if (numChunks > 1)
+        for (int chunk = 0; chunk < (int) numChunks; chunk++)
+        {
+            const size_t begin = n * chunk / numChunks;
+            const size_t end = n * (chunk + 1) / numChunks;
+            array<float*, N> chunkPointers;
+            for (size_t i = 0; i < N; i++)
+                chunkPointers[i] = pointers[i] + begin;
+            VectorizedTensorOp(op, beta, chunkPointers, alpha, end - begin);
+        }
+    }
+    else
+    {
+#pragma omp parallel for if (n * numRows >= c_minParallelVectorizedElements)
+        for (int row = 0; row < (int) numRows; row++)
+        {
+            array<float*, N> rowPointers;
+            for (size_t i = 0; i < N; i++)
+                rowPointers[i] = pointers[i] + row * regularStrides[i][1];
+            VectorizedTensorOp(op, beta, rowPointers, alpha, n);
+        }
+    }
+    return true;
+}
+
 // -----------------------------------------------------------------------
 // entry points from Matrix.cpp; also map op to a lambda
 // -----------------------------------------------------------------------
@@ -6269,6 +7011,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 2> pointers = {a.Data(), Data()};
+    if (TryVectorizedTensorOp(beta, pointers, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims))
+        return;
     switch (op)
     {
         ForAllUnaryOps(CaseUnaryTensorOp);
@@ -6297,6 +7041,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 3> pointers = {a.Data(), b.Data(), Data()};
+    if (TryVectorizedTensorOp(beta, pointers, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims))
+        return;
     switch (op)
     {
         ForAllBinaryOps(CaseBinaryTensorOp);
@@ -100,6 +100,22 @@ public:
                      ElemType RMS_WGT_MIN,
                      const bool needAveMultiplier);
 
+    // fused updates of many parameters stored in arenas (see MultiTensorSegment); 'this' are the smoothed gradients.
+    // Unlike above, these apply the update to functionValues themselves.
+    void MultiTensorNormalGrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues,
+                               const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                               ElemType momentum, bool useNesterovMomentum);
+    void MultiTensorAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues,
+                            const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                            const bool needAveMultiplier);
+    void MultiTensorFSAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues,
+                              const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                              ElemType momentum, ElemType adaWeight, const std::vector<ElemType>& adaMuls);
+    void MultiTensorRmsProp(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues,
+                            const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                            ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                            const bool needAveMultiplier);
+
 
     void Reshape(const size_t numRows, const size_t numCols);
 
@@ -1002,39 +1002,67 @@ template <class ElemType>
     return result;
 }
 
-// normal update for smoothed gradients c and current gradients (this)
-// TODO: comment seems wrong; cf. SGD.cpp: smoothedGradient.NormalGrad(gradientValues, functionValues,...)
+// Lazy updates of smoothed gradients:
+// The optimizer state of a weight whose gradient is not part of the block-sparse gradient would only decay in that step.
+// Rather than touching all of the state in every step, the decaying state is stored divided by a scale factor, which
+// the decay of each step is applied to instead. Hence each step only touches the state of the blocks in the gradient,
+// and the decay of the steps a block was skipped in is applied when it is next used. Once the scale factor gets too small,
+// it is multiplied into the state (this is the only operation on the full state, and a rare one).
+// The scale factors are stored in extra columns after the state; a value of 0 (state just reset to 0) means 1.
+static const double lazyStateScaleFloor = 1e-10;
+
+// advance a scale factor by one step; returns the new scale
 template <class ElemType>
-void CPUSparseMatrix<ElemType>::NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum)
+static ElemType AdvanceLazyStateScale(ElemType& scale, ElemType decay, ElemType* state, size_t stateSize)
 {
-    if (c.IsEmpty())
+    if (scale == 0)
+        scale = 1;
+    if (scale * decay < lazyStateScaleFloor)
     {
-        c.RequireSize(GetNumRows(), GetNumCols());
+        for (size_t i = 0; i < stateSize; i++)
+            state[i] *= scale;
+        scale = 1;
+    }
+    scale *= decay;
+    return scale;
+}
+
+// Momentum update of the smoothed gradients c with the current gradients (this), which are replaced by the smoothed gradients
+// (or, with Nesterov momentum, by the look-ahead of the update), for the caller to apply them to the weights.
+// Only the blocks in this gradient are updated (see above); the weights of the others do not move in this step.
+// c has one extra column for the scale factor; smoothed gradients in any other shape (e.g. reset ones) are discarded.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum, const bool useNesterovMomentum)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol && GetFormat() != MatrixFormat::matrixFormatSparseBlockRow)
+        RuntimeError("CPUSparseMatrix:: NormalGrad() only support block sparse format");
+    if (momentum == 0)
+        return; // the gradients are the smoothed gradients
+
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != GetNumCols() + 1)
+    {
+        c.RequireSize(GetNumRows(), GetNumCols() + 1);
         c.SetValue(0.0);
     }
-    // BUGBUG: dimension/ownbuffer check?
 
-    if (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol || GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
+    ElemType scale = AdvanceLazyStateScale(c(0, GetNumCols()), momentum, c.Data(), GetNumElements());
+
+    size_t len = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? GetNumRows() : GetNumCols();
+#pragma omp parallel for
+    for (long j = 0; j < (long) GetBlockSize(); j++)
     {
-        for (size_t j = 0; j < GetBlockSize(); j++)
+        size_t i = GetBlockIds()[j] - GetBlockIdShift();
+        size_t start = j * len;
+        for (size_t p = start; p < start + len; p++)
         {
-            size_t i = GetBlockIds()[j] - GetBlockIdShift();
-            size_t len = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? GetNumRows() : GetNumCols();
-            size_t start = j * len;
-            for (size_t p = start; p < start + len; p++)
-            {
-                ElemType val = Buffer()[p];
-                size_t row = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? (p - start) : i;
-                size_t col = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? i : (p - start);
-                c(row, col) = (1 - momentum) * val + momentum * c(row, col);
-                Buffer()[p] = c(row, col);
-            }
+            ElemType val = Buffer()[p];
+            size_t row = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? (p - start) : i;
+            size_t col = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? i : (p - start);
+            ElemType smoothed = (1 - momentum) * val + scale * c(row, col); // (the scale includes this step's momentum)
+            c(row, col) = smoothed / scale;
+            Buffer()[p] = useNesterovMomentum ? momentum * smoothed + (1 - momentum) * val : smoothed;
         }
     }
-    else
-    {
-        RuntimeError("CPUSparseMatrix:: NormalGrad() only support block sparse format");
-    }
 }
 
 // update smoothed gradients c and current gradients (this)
@@ -1106,6 +1134,65 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
         return 1;
 }
 
+// FSAdaGrad update of the weights (functionValues) with the current gradients (this), lazily for the blocks in the gradient (see above).
+// Cf. CPUMatrix::FSAdagrad(); like there, c holds the smoothed squared gradients followed by the smoothed gradients,
+// here followed by the two scale factors in two extra columns.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues,
+                                          ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol && GetFormat() != MatrixFormat::matrixFormatSparseBlockRow)
+        RuntimeError("CPUSparseMatrix:: FSAdagrad() only support block sparse format");
+
+    size_t numCols = GetNumCols();
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != 2 * numCols + 2)
+    {
+        c.RequireSize(GetNumRows(), 2 * numCols + 2);
+        c.SetValue(0.0);
+    }
+
+    size_t n = GetNumElements();
+    ElemType* smoothAda = c.Data();
+    ElemType* smoothMom = c.Data() + n;
+    ElemType adaScale = AdvanceLazyStateScale(c(0, 2 * numCols), adaWeight, smoothAda, n);
+    ElemType momScale = momentum > 0 ? AdvanceLazyStateScale(c(0, 2 * numCols + 1), momentum, smoothMom, n) : 1;
+
+    size_t len = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? GetNumRows() : numCols;
+#pragma omp parallel for
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        size_t i = GetBlockIds()[j] - GetBlockIdShift();
+        size_t start = j * len;
+        for (size_t p = start; p < start + len; p++)
+        {
+            size_t row = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? (p - start) : i;
+            size_t col = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? i : (p - start);
+            size_t k = col * GetNumRows() + row;
+
+            ElemType g = Buffer()[p];
+            ElemType adaSqr = adaScale * smoothAda[k] + (1.0f - adaWeight) * g * g; // (the scale includes this step's adaWeight)
+            smoothAda[k] = adaSqr / adaScale;
+            if (adaSqr != 0.0f)
+            {
+                ElemType ada = sqrt(adaSqr);
+                ElemType w = adaMul * ((ElemType) 1.0 / ada);
+
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+
+            if (momentum > 0.0f)
+            {
+                g = momScale * smoothMom[k] + (1.0f - momentum) * g;
+                smoothMom[k] = g / momScale;
+            }
+
+            functionValues.Data()[k] -= g * learnRatePerSample;
+        }
+    }
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
@@ -17,6 +17,7 @@
 #include <string>
 #include <stdint.h>
 #include <memory>
+#include <limits>
 
 #pragma warning( disable: 4251 )
 typedef unsigned char byte;
@@ -90,6 +91,7 @@ enum ElementWiseOperator
     opElementwiseProductWithCosDerivative, opElementwiseProductWithSinDerivative,
     opElementwiseProductWithAbsDerivative, opElementwiseProductWithSqrtDerivative,
     opElementwiseProductWithReciprocalDerivative, opSqrOfDifference,
+    opLinearRectifierOfSum,
     // binary ops for indexing
     // opIndex,
     // ternary
@@ -151,6 +153,7 @@ enum ElementWiseOperator
     Macro(ElementwiseProductWithReciprocalDerivative);                \
     Macro(ElementwiseProductWithSqrtDerivative);                      \
     Macro(SqrOfDifference);                                           \
+    Macro(LinearRectifierOfSum);                                      \
     //Macro(Index);
 
 #define ForAllTernaryOps(Macro)                         \
@@ -200,6 +203,28 @@ enum MatrixFlags
     matrixFlagSetValueOnDevice = 1 << bitPosSetValueOnDevice, // SetValue() call has a buffer that is already on the device
 };
 
+// -----------------------------------------------------------------------
+// fused optimizer steps over many parameters (Matrix::MultiTensor*())
+// -----------------------------------------------------------------------
+
+// The values, gradients and smoothed gradients of the parameters are stored back to back in three arenas.
+// A segment is one parameter: its values and gradients are the elements [offset, offset + numElements) of their arenas,
+// its smoothed gradients the k times larger range for an update that keeps k values per weight (e.g. 2 for FSAdagrad).
+struct MultiTensorSegment
+{
+    size_t offset;
+    size_t numElements;
+    double learnRatePerSample; // including the parameter's learning-rate multiplier
+};
+
+// the processing of each weight's gradient around the update, cf. SGD::UpdateWeightsS()
+struct MultiTensorRegularization
+{
+    double clippingThreshold = std::numeric_limits<double>::infinity(); // gradients are truncated to +-clippingThreshold
+    double L2RegWeight = 0;                                             // L2RegWeight * weight is added to the gradient
+    double L1RegWeight = 0;                                             // the weight is soft-thresholded by L1RegWeight * learnRatePerSample after the update
+};
+
 // -----------------------------------------------------------------------
 // BaseMatrixStorage -- base class for all matrix types (CPU, GPU) x (dense, sparse)
 // -----------------------------------------------------------------------
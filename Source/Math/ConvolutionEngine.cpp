@@ -6,6 +6,7 @@
 #include "stdafx.h"
 #include "ConvolutionEngine.h"
 #include "CuDnnFactories.h"
+#include "DirectConvolution.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -847,6 +848,129 @@ public:
     }
 };
 
+//------------------------------------------------------------------
+// Direct convolution engine implementation.
+// This engine supports 2D (and 1D) convolutions with full sharing on CPU, where the kernel spans
+// all input channels. It computes them directly rather than through an unrolled input workspace;
+// 3x3 kernels with stride 1 use Winograd's F(2x2, 3x3) algorithm. See DirectConvolution.h.
+// Uses reference engine for pooling operations.
+//------------------------------------------------------------------
+template <class ElemType>
+class DirectConvolutionEngine : public ReferenceConvolutionEngine<ElemType>
+{
+public:
+    using Base = ReferenceConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    DirectConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind)
+    {
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+
+    void EnsureCompatible() override
+    {
+        if (m_imageLayout != ImageLayoutKind::CHW)
+            LogicError("Direct convolution engine supports only CHW/cudnn layout.");
+        if (!IsSupported(m_deviceId, m_geometry))
+            LogicError("Direct convolution engine does not support this convolution configuration. Geometry: %s", ((string)*m_geometry).c_str());
+    }
+
+    void EnsureConvolutionInitialized() override
+    {
+        // The maps of the reference engine are not needed.
+        m_shape = GetShape(*m_geometry);
+    }
+
+    // The workspace holds the padded input and the packed kernels (about the size of the input).
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        EnsureDense(in);
+        ElemType* ws = GetWorkspace(workspace, DirectConvolutionOp::Forward, in.GetNumCols());
+        DirectConvolutionForward(m_shape, in.Data(), kernel.Data(), out.Data(), in.GetNumCols(), ws);
+    }
+
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, Mat& workspace) override
+    {
+        EnsureDense(srcGrad);
+        ElemType* ws = GetWorkspace(workspace, DirectConvolutionOp::BackwardData, srcGrad.GetNumCols());
+        DirectConvolutionBackwardData(m_shape, srcGrad.Data(), kernel.Data(), grad.Data(), srcGrad.GetNumCols(), ws);
+    }
+
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool /*allowReuse*/, Mat& workspace) override
+    {
+        EnsureDense(srcGrad);
+        EnsureDense(in);
+        ElemType* ws = GetWorkspace(workspace, DirectConvolutionOp::BackwardKernel, in.GetNumCols());
+        DirectConvolutionBackwardKernel(m_shape, srcGrad.Data(), in.Data(), kernelGrad.Data(), in.GetNumCols(), ws);
+    }
+
+private:
+    ElemType* GetWorkspace(Mat& workspace, DirectConvolutionOp op, size_t numSamples) const
+    {
+        workspace.Resize(DirectConvolutionWorkspaceSize<ElemType>(op, m_shape, numSamples), 1);
+        return workspace.Data();
+    }
+
+    static void EnsureDense(const Mat& m)
+    {
+        if (m.GetMatrixType() != MatrixType::DENSE)
+            RuntimeError("Direct convolution engine supports only dense inputs.");
+    }
+
+    static DirectConvolutionShape GetShape(const ConvolveGeometry& g)
+    {
+        const auto& inT = g.InputShape();
+        const auto& outT = g.OutputShape();
+        const auto& kernT = g.KernelShape();
+        size_t last = inT.GetRank() - 1;
+        bool is2D = last == 2;
+
+        DirectConvolutionShape shape;
+        shape.inWidth = inT[0];
+        shape.inHeight = is2D ? inT[1] : 1;
+        shape.inChannels = inT[last];
+        shape.outWidth = outT[0];
+        shape.outHeight = is2D ? outT[1] : 1;
+        shape.outChannels = outT[last];
+        shape.kernelWidth = kernT[0];
+        shape.kernelHeight = is2D ? kernT[1] : 1;
+        shape.strideX = g.GetStride(0);
+        shape.strideY = is2D ? g.GetStride(1) : 1;
+        shape.offsetX = g.GetInputOffset(0);
+        shape.offsetY = is2D ? g.GetInputOffset(1) : 0;
+        return shape;
+    }
+
+    DirectConvolutionShape m_shape;
+
+public:
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        const auto& inT = geometry->InputShape();
+        size_t rank = inT.GetRank();
+        if (deviceId >= 0 || (rank != 2 && rank != 3) ||
+            find(begin(geometry->Sharing()), end(geometry->Sharing()), false) != end(geometry->Sharing()))
+            return false;
+
+        // The kernel must cover all input channels at a single position, so that the last output dimension holds the maps.
+        size_t last = rank - 1;
+        for (size_t i = 0; i < last; i++)
+        {
+            if (geometry->GetMapCount(i) != 1)
+                return false;
+        }
+        return geometry->KernelShape()[last] == inT[last] &&
+               geometry->OutputShape()[last] == geometry->GetMapCount(last) &&
+               geometry->GetInputOffset(last) == 0;
+    }
+};
+
 template <class ElemType>
 std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
                                                                                  ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
@@ -878,6 +1002,12 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
     }
 
+    if (isEnabled(ConvolutionEngineKind::Direct) && DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+    {
+        fprintf(stderr, "\n%lsusing direct convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+        return std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+    }
+
     if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
     {
         fprintf(stderr, "\n%lsusing GEMM convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
@@ -427,6 +427,14 @@ public:
         return -(center - (kernSize - 1) / 2);
     }
 
+    // Index of the input cell under the first kernel cell when computing the first output cell along dimension 'dim'.
+    // Negative if the input is padded.
+    int GetInputOffset(size_t dim) const
+    {
+        assert(dim < m_start.size());
+        return m_start[dim] - ((int)m_kernelShape[dim] - 1) / 2;
+    }
+
     // Computes output shape given input shape and other convolution parameters.
     static TensorShape ComputeOutputShape(const TensorShape& inputShape, const TensorShape& kernelShape, const TensorShape& mapCount, const TensorShape& stride,
                                           const BoolVec& sharing, const BoolVec& autoPad, const TensorShape& lowerPad, const TensorShape& upperPad)
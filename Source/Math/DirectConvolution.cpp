@@ -0,0 +1,122 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DirectConvolution.cpp -- runtime selection of the direct convolution kernels (see DirectConvolution.h)
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "DirectConvolution.h"
+#include "DirectConvolutionKernels.h"
+#include "TensorOpsVectorized.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// implemented in TensorOpsAVX2.cpp and TensorOpsAVX512.cpp, which are compiled with the respective instruction set enabled
+bool AVX2DirectConvolutionWorkspaceSize(DirectConvolutionOp op, const DirectConvolutionShape& shape, size_t numSamples, size_t& sizeInBytes);
+bool AVX2DirectConvolutionForward(const DirectConvolutionShape& shape, const float* in, const float* kernel, float* out, size_t numSamples, float* workspace);
+bool AVX2DirectConvolutionBackwardData(const DirectConvolutionShape& shape, const float* srcGrad, const float* kernel, float* grad, size_t numSamples, float* workspace);
+bool AVX2DirectConvolutionBackwardKernel(const DirectConvolutionShape& shape, const float* srcGrad, const float* in, float* kernelGrad, size_t numSamples, float* workspace);
+bool AVX512DirectConvolutionWorkspaceSize(DirectConvolutionOp op, const DirectConvolutionShape& shape, size_t numSamples, size_t& sizeInBytes);
+bool AVX512DirectConvolutionForward(const DirectConvolutionShape& shape, const float* in, const float* kernel, float* out, size_t numSamples, float* workspace);
+bool AVX512DirectConvolutionBackwardData(const DirectConvolutionShape& shape, const float* srcGrad, const float* kernel, float* grad, size_t numSamples, float* workspace);
+bool AVX512DirectConvolutionBackwardKernel(const DirectConvolutionShape& shape, const float* srcGrad, const float* in, float* kernelGrad, size_t numSamples, float* workspace);
+
+bool IsWinogradConvolution(const DirectConvolutionShape& shape)
+{
+    return shape.kernelWidth == 3 && shape.kernelHeight == 3 && shape.strideX == 1 && shape.strideY == 1;
+}
+
+template <class ElemType>
+static size_t BytesToElements(size_t sizeInBytes)
+{
+    return (sizeInBytes + sizeof(ElemType) - 1) / sizeof(ElemType);
+}
+
+// The workspace size depends on the vector width, so it is selected like the kernels themselves.
+template <>
+size_t DirectConvolutionWorkspaceSize<float>(DirectConvolutionOp op, const DirectConvolutionShape& shape, size_t numSamples)
+{
+    size_t sizeInBytes = 0;
+    bool done = false;
+    switch (GetVectorInstructionSet())
+    {
+    case VectorInstructionSet::AVX512: done = AVX512DirectConvolutionWorkspaceSize(op, shape, numSamples, sizeInBytes); break;
+    case VectorInstructionSet::AVX2:   done = AVX2DirectConvolutionWorkspaceSize(op, shape, numSamples, sizeInBytes); break;
+    default: break;
+    }
+    if (!done)
+        sizeInBytes = DirectConvolutionKernels<float, ScalarConvolutionTraits<float>>::WorkspaceSize(op, shape, numSamples);
+    return BytesToElements<float>(sizeInBytes);
+}
+
+template <>
+void DirectConvolutionForward<float>(const DirectConvolutionShape& shape, const float* in, const float* kernel, float* out, size_t numSamples, float* workspace)
+{
+    bool done = false;
+    switch (GetVectorInstructionSet())
+    {
+    case VectorInstructionSet::AVX512: done = AVX512DirectConvolutionForward(shape, in, kernel, out, numSamples, workspace); break;
+    case VectorInstructionSet::AVX2:   done = AVX2DirectConvolutionForward(shape, in, kernel, out, numSamples, workspace); break;
+    default: break;
+    }
+    if (!done)
+        DirectConvolutionKernels<float, ScalarConvolutionTraits<float>>::Forward(shape, in, kernel, out, numSamples, /*accumulate=*/false, workspace);
+}
+
+template <>
+void DirectConvolutionBackwardData<float>(const DirectConvolutionShape& shape, const float* srcGrad, const float* kernel, float* grad, size_t numSamples, float* workspace)
+{
+    bool done = false;
+    switch (GetVectorInstructionSet())
+    {
+    case VectorInstructionSet::AVX512: done = AVX512DirectConvolutionBackwardData(shape, srcGrad, kernel, grad, numSamples, workspace); break;
+    case VectorInstructionSet::AVX2:   done = AVX2DirectConvolutionBackwardData(shape, srcGrad, kernel, grad, numSamples, workspace); break;
+    default: break;
+    }
+    if (!done)
+        DirectConvolutionKernels<float, ScalarConvolutionTraits<float>>::BackwardData(shape, srcGrad, kernel, grad, numSamples, workspace);
+}
+
+template <>
+void DirectConvolutionBackwardKernel<float>(const DirectConvolutionShape& shape, const float* srcGrad, const float* in, float* kernelGrad, size_t numSamples, float* workspace)
+{
+    bool done = false;
+    switch (GetVectorInstructionSet())
+    {
+    case VectorInstructionSet::AVX512: done = AVX512DirectConvolutionBackwardKernel(shape, srcGrad, in, kernelGrad, numSamples, workspace); break;
+    case VectorInstructionSet::AVX2:   done = AVX2DirectConvolutionBackwardKernel(shape, srcGrad, in, kernelGrad, numSamples, workspace); break;
+    default: break;
+    }
+    if (!done)
+        DirectConvolutionKernels<float, ScalarConvolutionTraits<float>>::BackwardKernel(shape, srcGrad, in, kernelGrad, numSamples, workspace);
+}
+
+// there are no vectorized kernels for double
+
+template <>
+size_t DirectConvolutionWorkspaceSize<double>(DirectConvolutionOp op, const DirectConvolutionShape& shape, size_t numSamples)
+{
+    return BytesToElements<double>(DirectConvolutionKernels<double, ScalarConvolutionTraits<double>>::WorkspaceSize(op, shape, numSamples));
+}
+
+template <>
+void DirectConvolutionForward<double>(const DirectConvolutionShape& shape, const double* in, const double* kernel, double* out, size_t numSamples, double* workspace)
+{
+    DirectConvolutionKernels<double, ScalarConvolutionTraits<double>>::Forward(shape, in, kernel, out, numSamples, /*accumulate=*/false, workspace);
+}
+
+template <>
+void DirectConvolutionBackwardData<double>(const DirectConvolutionShape& shape, const double* srcGrad, const double* kernel, double* grad, size_t numSamples, double* workspace)
+{
+    DirectConvolutionKernels<double, ScalarConvolutionTraits<double>>::BackwardData(shape, srcGrad, kernel, grad, numSamples, workspace);
+}
+
+template <>
+void DirectConvolutionBackwardKernel<double>(const DirectConvolutionShape& shape, const double* srcGrad, const double* in, double* kernelGrad, size_t numSamples, double* workspace)
+{
+    DirectConvolutionKernels<double, ScalarConvolutionTraits<double>>::BackwardKernel(shape, srcGrad, in, kernelGrad, numSamples, workspace);
+}
+
+}}}
@@ -0,0 +1,75 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DirectConvolution.h -- 2D convolution on CPU without unrolling the input (used by the direct convolution engine)
+//
+
+#pragma once
+
+#include <stddef.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// The GEMM convolution engine unrolls the input into a workspace that is kernelWidth * kernelHeight times
+// larger than the input, and then spends most of its time streaming that workspace through memory.
+// The functions declared here instead compute the convolution directly, with a register-blocked micro-kernel
+// that keeps a block of output maps times a run of output pixels in vector registers while it accumulates
+// over input channels and kernel cells. The only temporary copy is a zero-padded version of the input
+// (about the size of the input itself), in which strided columns are split by phase so that the micro-kernel
+// reads contiguous memory for any stride.
+//
+// 3x3 kernels with stride 1 use Winograd's minimal filtering algorithm F(2x2, 3x3) instead, which needs 16
+// instead of 36 multiplications per 2x2 output tile and input channel (Lavin and Gray, Fast Algorithms for
+// Convolutional Neural Networks). The data backprop of such kernels is itself a 3x3 stride 1 convolution and
+// uses the same path.
+//
+// For float, the micro-kernels are compiled for AVX2 and AVX-512 (in TensorOpsAVX2.cpp and TensorOpsAVX512.cpp)
+// and selected at runtime like the vectorized tensor ops (see TensorOpsVectorized.h); otherwise portable scalar
+// code is used.
+//
+// All images are column-major [W x H x C] tensors, one per sample, stored consecutively. The kernel of each
+// output map is a [kernelWidth x kernelHeight x inChannels] tensor, stored consecutively for all output maps
+// (which is the CNTK CHW ("cudnn") kernel layout).
+//
+// Temporary memory (the padded input, packed kernels, and per-thread buffers) is provided by the caller as a
+// workspace of DirectConvolutionWorkspaceSize() elements, which it can keep across minibatches.
+// -----------------------------------------------------------------------
+
+struct DirectConvolutionShape
+{
+    size_t inWidth, inHeight, inChannels;
+    size_t outWidth, outHeight, outChannels; // outChannels is the number of output maps (kernels)
+    size_t kernelWidth, kernelHeight;        // the kernel always spans all input channels
+    size_t strideX, strideY;
+    int offsetX, offsetY;                    // input coordinates of the first kernel cell of output pixel (0, 0); negative for padding
+};
+
+enum class DirectConvolutionOp
+{
+    Forward,
+    BackwardData,
+    BackwardKernel
+};
+
+// whether DirectConvolutionForward() uses Winograd's algorithm for this shape
+bool IsWinogradConvolution(const DirectConvolutionShape& shape);
+
+// number of elements of the workspace needed by the function for 'op' (valid for the current number of OpenMP threads)
+template <class ElemType>
+size_t DirectConvolutionWorkspaceSize(DirectConvolutionOp op, const DirectConvolutionShape& shape, size_t numSamples);
+
+// out = convolution of 'in' with 'kernel'
+template <class ElemType>
+void DirectConvolutionForward(const DirectConvolutionShape& shape, const ElemType* in, const ElemType* kernel, ElemType* out, size_t numSamples, ElemType* workspace);
+
+// grad += gradient of the convolution wrt. its input, given the gradient 'srcGrad' wrt. its output
+template <class ElemType>
+void DirectConvolutionBackwardData(const DirectConvolutionShape& shape, const ElemType* srcGrad, const ElemType* kernel, ElemType* grad, size_t numSamples, ElemType* workspace);
+
+// kernelGrad += gradient of the convolution wrt. the kernel, given the gradient 'srcGrad' wrt. its output
+template <class ElemType>
+void DirectConvolutionBackwardKernel(const DirectConvolutionShape& shape, const ElemType* srcGrad, const ElemType* in, ElemType* kernelGrad, size_t numSamples, ElemType* workspace);
+
+}}}
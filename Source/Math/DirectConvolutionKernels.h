@@ -0,0 +1,675 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DirectConvolutionKernels.h -- instruction-set independent implementation of the direct convolution in DirectConvolution.h
+//
+// This is included by DirectConvolution.cpp, which instantiates it with ScalarConvolutionTraits (portable code, and double),
+// and by TensorOpsAVX2.cpp and TensorOpsAVX512.cpp, which instantiate it for float with the traits classes of the
+// vectorized tensor ops (see TensorOpsVectorizedKernels.h). Of those, only Reg, Width, Load, Store, Set and FMA are used.
+//
+// Like TensorOpsVectorizedKernels.h, this must not instantiate anything that other source files may instantiate too,
+// hence no C++ standard library (temporary memory comes from the caller's workspace), and an anonymous namespace.
+//
+
+#pragma once
+
+#include "DirectConvolution.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <omp.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace {
+
+template <class T>
+inline T Min(T a, T b) { return a < b ? a : b; }
+
+// Carves the buffers of one call out of the caller's workspace, each aligned to a cache line. Without a workspace, it
+// only adds up their sizes; that is how WorkspaceSize() gets them from the code that uses them.
+class WorkspaceAllocator
+{
+public:
+    explicit WorkspaceAllocator(void* workspace) : m_next((char*) workspace), m_size(0) { }
+
+    bool HasMemory() const { return m_next != nullptr; }
+    size_t Size() const { return m_size; } // in bytes
+
+    template <class T>
+    T* Allocate(size_t n)
+    {
+        m_size += n * sizeof(T) + Alignment - 1;
+        if (!m_next)
+            return nullptr;
+        char* p = m_next + (Alignment - (uintptr_t) m_next % Alignment) % Alignment;
+        m_next = p + n * sizeof(T);
+        return (T*) p;
+    }
+
+private:
+    enum : size_t { Alignment = 64 };
+    char* m_next;
+    size_t m_size;
+};
+
+template <class ElemType>
+struct ScalarConvolutionTraits
+{
+    typedef ElemType Reg;
+    static const size_t Width = 1;
+
+    static inline Reg Load(const ElemType* p) { return *p; }
+    static inline void Store(ElemType* p, Reg x) { *p = x; }
+    static inline Reg Set(ElemType x) { return x; }
+    static inline Reg FMA(Reg a, Reg b, Reg c) { return a * b + c; }
+};
+
+template <class ElemType, class V>
+class DirectConvolutionKernels
+{
+    typedef typename V::Reg Reg;
+
+    // register blocking: the micro-kernels keep MapBlock output maps times PixelVectors vectors of pixels
+    // (resp. times TermBlock kernel cells for the kernel gradient) in registers
+    enum : size_t
+    {
+        MapBlock = 4,
+        PixelVectors = 2,
+        PixelBlock = PixelVectors * V::Width,
+        TermBlock = 2,
+        TileBlock = PixelBlock > 32 ? PixelBlock : 32 // Winograd tiles transformed at once; a multiple of PixelBlock
+    };
+
+public:
+    // bytes of workspace needed by the function for 'op', with the current number of OpenMP threads
+    static size_t WorkspaceSize(DirectConvolutionOp op, const DirectConvolutionShape& s, size_t numSamples)
+    {
+        WorkspaceAllocator ws(nullptr);
+        switch (op)
+        {
+        case DirectConvolutionOp::Forward:        Forward(s, nullptr, nullptr, nullptr, numSamples, /*accumulate=*/false, ws); break;
+        case DirectConvolutionOp::BackwardData:   BackwardData(s, nullptr, nullptr, nullptr, numSamples, ws); break;
+        case DirectConvolutionOp::BackwardKernel: BackwardKernel(s, nullptr, nullptr, nullptr, numSamples, ws); break;
+        }
+        return ws.Size();
+    }
+
+    static void Forward(const DirectConvolutionShape& s, const ElemType* in, const ElemType* kernel, ElemType* out, size_t numSamples, bool accumulate, void* workspace)
+    {
+        WorkspaceAllocator ws(workspace);
+        Forward(s, in, kernel, out, numSamples, accumulate, ws);
+    }
+
+    static void BackwardData(const DirectConvolutionShape& s, const ElemType* srcGrad, const ElemType* kernel, ElemType* grad, size_t numSamples, void* workspace)
+    {
+        WorkspaceAllocator ws(workspace);
+        BackwardData(s, srcGrad, kernel, grad, numSamples, ws);
+    }
+
+    static void BackwardKernel(const DirectConvolutionShape& s, const ElemType* srcGrad, const ElemType* in, ElemType* kernelGrad, size_t numSamples, void* workspace)
+    {
+        WorkspaceAllocator ws(workspace);
+        BackwardKernel(s, srcGrad, in, kernelGrad, numSamples, ws);
+    }
+
+private:
+    // Each of these first takes all of its buffers from 'ws', and returns right after if it has no memory (see WorkspaceSize()).
+
+    static void Forward(const DirectConvolutionShape& s, const ElemType* in, const ElemType* kernel, ElemType* out, size_t numSamples, bool accumulate, WorkspaceAllocator& ws)
+    {
+        if (IsWinogradConvolution(s))
+            ForwardWinograd(s, in, kernel, out, numSamples, accumulate, ws);
+        else
+            ForwardDirect(s, in, kernel, out, numSamples, accumulate, ws);
+    }
+
+    static void BackwardData(const DirectConvolutionShape& s, const ElemType* srcGrad, const ElemType* kernel, ElemType* grad, size_t numSamples, WorkspaceAllocator& ws)
+    {
+        if (s.strideX == 1 && s.strideY == 1)
+        {
+            // With stride 1, the data gradient is itself a convolution: that of srcGrad with the kernels mirrored
+            // in x and y, and input and output maps swapped.
+            DirectConvolutionShape t;
+            t.inWidth = s.outWidth;
+            t.inHeight = s.outHeight;
+            t.inChannels = s.outChannels;
+            t.outWidth = s.inWidth;
+            t.outHeight = s.inHeight;
+            t.outChannels = s.inChannels;
+            t.kernelWidth = s.kernelWidth;
+            t.kernelHeight = s.kernelHeight;
+            t.strideX = t.strideY = 1;
+            t.offsetX = -s.offsetX - (int) (s.kernelWidth - 1);
+            t.offsetY = -s.offsetY - (int) (s.kernelHeight - 1);
+
+            const size_t kernelSize = s.kernelWidth * s.kernelHeight;
+            ElemType* mirrored = ws.Allocate<ElemType>(kernelSize * s.inChannels * s.outChannels);
+            if (ws.HasMemory())
+            {
+                for (size_t k = 0; k < s.outChannels; k++)
+                    for (size_t c = 0; c < s.inChannels; c++)
+                    {
+                        const ElemType* src = kernel + (k * s.inChannels + c) * kernelSize;
+                        ElemType* dst = mirrored + (c * s.outChannels + k) * kernelSize;
+                        for (size_t j = 0; j < kernelSize; j++)
+                            dst[j] = src[kernelSize - 1 - j];
+                    }
+            }
+            Forward(t, srcGrad, mirrored, grad, numSamples, /*accumulate=*/true, ws);
+        }
+        else
+            BackwardDataStrided(s, srcGrad, kernel, grad, numSamples, ws);
+    }
+
+    static void BackwardKernel(const DirectConvolutionShape& s, const ElemType* srcGrad, const ElemType* in, ElemType* kernelGrad, size_t numSamples, WorkspaceAllocator& ws)
+    {
+        PaddedLayout p(s);
+        ElemType* padded = ws.Allocate<ElemType>(numSamples * p.sampleSize);
+        // srcGrad with its rows padded with zeros to a multiple of the vector width, so that DotMicroKernel() needs no
+        // scalar remainder loop (the padded input has a block of slack after its last row, so it can be read that far)
+        const size_t rowLength = (s.outWidth + V::Width - 1) / V::Width * V::Width;
+        const size_t outPlane = rowLength * s.outHeight;
+        ElemType* paddedSrcGrad = ws.Allocate<ElemType>(numSamples * s.outChannels * outPlane);
+        const size_t numTerms = s.inChannels * s.kernelHeight * s.kernelWidth;
+        ptrdiff_t* offsets = ws.Allocate<ptrdiff_t>(numTerms);
+        if (!ws.HasMemory())
+            return;
+
+        PadInput(s, p, in, padded, numSamples);
+#pragma omp parallel for
+        for (long i = 0; i < (long) (numSamples * s.outChannels * s.outHeight); i++)
+        {
+            const ElemType* src = srcGrad + i * s.outWidth;
+            ElemType* dst = paddedSrcGrad + i * rowLength;
+            for (size_t j = 0; j < s.outWidth; j++)
+                dst[j] = src[j];
+            for (size_t j = s.outWidth; j < rowLength; j++)
+                dst[j] = 0;
+        }
+        p.GetOffsets(s, offsets);
+
+        const size_t numMapBlocks = (s.outChannels + MapBlock - 1) / MapBlock;
+        const size_t numTermBlocks = (numTerms + TermBlock - 1) / TermBlock;
+
+        // Each work item owns MapBlock x TermBlock kernel gradients and sums over all samples and output pixels.
+        // Consecutive items share their maps, so that a thread reuses the same srcGrad rows from its cache.
+#pragma omp parallel for
+        for (long i = 0; i < (long) (numMapBlocks * numTermBlocks); i++)
+        {
+            const size_t k0 = (i / numTermBlocks) * MapBlock;
+            const size_t r0 = (i % numTermBlocks) * TermBlock;
+            const size_t numMaps = Min((size_t) MapBlock, s.outChannels - k0);
+            const size_t numBlockTerms = Min((size_t) TermBlock, numTerms - r0);
+
+            // missing maps and terms repeat the last one; their results are dropped
+            ptrdiff_t mapOffsets[MapBlock];
+            ptrdiff_t termOffsets[TermBlock];
+            for (size_t m = 0; m < MapBlock; m++)
+                mapOffsets[m] = (ptrdiff_t) ((k0 + Min(m, numMaps - 1)) * outPlane);
+            for (size_t r = 0; r < TermBlock; r++)
+                termOffsets[r] = offsets[r0 + Min(r, numBlockTerms - 1)];
+
+            ElemType acc[MapBlock * TermBlock] = {};
+            for (size_t n = 0; n < numSamples; n++)
+                DotMicroKernel(paddedSrcGrad + n * s.outChannels * outPlane, mapOffsets, rowLength,
+                               padded + n * p.sampleSize, termOffsets, s.strideY * p.rowLength,
+                               s.outHeight, rowLength, acc);
+
+            for (size_t m = 0; m < numMaps; m++)
+                for (size_t r = 0; r < numBlockTerms; r++)
+                    kernelGrad[(k0 + m) * numTerms + r0 + r] += acc[m * TermBlock + r];
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // micro-kernels
+    // -----------------------------------------------------------------------
+
+    // acc[m * PixelBlock + j] = sum_r w[r * MapBlock + m] * in[offsets[r] + j] for m < MapBlock, j < PixelBlock
+    static inline void MicroKernel(const ElemType* in, const ptrdiff_t* offsets, size_t numTerms, const ElemType* w, ElemType* acc)
+    {
+        Reg sum[MapBlock][PixelVectors];
+        for (size_t m = 0; m < MapBlock; m++)
+            for (size_t v = 0; v < PixelVectors; v++)
+                sum[m][v] = V::Set(0);
+
+        for (size_t r = 0; r < numTerms; r++, w += MapBlock)
+        {
+            const ElemType* x = in + offsets[r];
+            Reg xv[PixelVectors];
+            for (size_t v = 0; v < PixelVectors; v++)
+                xv[v] = V::Load(x + v * V::Width);
+            for (size_t m = 0; m < MapBlock; m++)
+            {
+                const Reg wm = V::Set(w[m]);
+                for (size_t v = 0; v < PixelVectors; v++)
+                    sum[m][v] = V::FMA(wm, xv[v], sum[m][v]);
+            }
+        }
+
+        for (size_t m = 0; m < MapBlock; m++)
+            for (size_t v = 0; v < PixelVectors; v++)
+                V::Store(acc + m * PixelBlock + v * V::Width, sum[m][v]);
+    }
+
+    // acc[m * TermBlock + r] += sum_{row < numRows, j < n} g[mapOffsets[m] + row * gRowStride + j] * in[termOffsets[r] + row * inRowStride + j]
+    // where n is a multiple of the vector width
+    static inline void DotMicroKernel(const ElemType* g, const ptrdiff_t* mapOffsets, size_t gRowStride,
+                                      const ElemType* in, const ptrdiff_t* termOffsets, size_t inRowStride,
+                                      size_t numRows, size_t n, ElemType* acc)
+    {
+        Reg sum[MapBlock][TermBlock];
+        for (size_t m = 0; m < MapBlock; m++)
+            for (size_t r = 0; r < TermBlock; r++)
+                sum[m][r] = V::Set(0);
+
+        for (size_t row = 0; row < numRows; row++, g += gRowStride, in += inRowStride)
+        {
+            for (size_t j = 0; j < n; j += V::Width)
+            {
+                Reg xv[TermBlock];
+                for (size_t r = 0; r < TermBlock; r++)
+                    xv[r] = V::Load(in + termOffsets[r] + j);
+                for (size_t m = 0; m < MapBlock; m++)
+                {
+                    const Reg gm = V::Load(g + mapOffsets[m] + j);
+                    for (size_t r = 0; r < TermBlock; r++)
+                        sum[m][r] = V::FMA(gm, xv[r], sum[m][r]);
+                }
+            }
+        }
+
+        ElemType lanes[V::Width];
+        for (size_t m = 0; m < MapBlock; m++)
+            for (size_t r = 0; r < TermBlock; r++)
+            {
+                V::Store(lanes, sum[m][r]);
+                ElemType total = 0;
+                for (size_t l = 0; l < V::Width; l++)
+                    total += lanes[l];
+                acc[m * TermBlock + r] += total;
+            }
+    }
+
+    // dst[m * mapStride + j] (+)= acc[m * PixelBlock + j] for m < numMaps, j < numPixels
+    static inline void StoreBlock(const ElemType* acc, size_t numMaps, size_t numPixels, ElemType* dst, size_t mapStride, bool accumulate)
+    {
+        for (size_t m = 0; m < numMaps; m++, dst += mapStride, acc += PixelBlock)
+        {
+            if (accumulate)
+                for (size_t j = 0; j < numPixels; j++)
+                    dst[j] += acc[j];
+            else
+                for (size_t j = 0; j < numPixels; j++)
+                    dst[j] = acc[j];
+        }
+    }
+
+    // kernel weights, reordered for MicroKernel() as [map block][term][MapBlock], with missing maps set to 0
+    static void PackWeights(const ElemType* kernel, size_t numMaps, size_t numTerms, ElemType* packed)
+    {
+        const size_t numMapBlocks = (numMaps + MapBlock - 1) / MapBlock;
+        for (size_t j = 0; j < numMapBlocks * numTerms * MapBlock; j++)
+            packed[j] = 0;
+        for (size_t k = 0; k < numMaps; k++)
+            for (size_t r = 0; r < numTerms; r++)
+                packed[((k / MapBlock) * numTerms + r) * MapBlock + k % MapBlock] = kernel[k * numTerms + r];
+    }
+
+    // -----------------------------------------------------------------------
+    // padded input
+    // -----------------------------------------------------------------------
+
+    // The input region read by the convolution, with zeros where it extends beyond the input. For each channel and
+    // row, the columns of each phase (column mod strideX) are stored contiguously, so that the kernel column kx of
+    // output pixels ox, ox + 1, ... is found at consecutive elements (phase kx mod strideX, element ox + kx div strideX).
+    struct PaddedLayout
+    {
+        size_t width, height; // size of the region
+        size_t phaseLength;   // elements per phase of a row
+        size_t rowLength;     // strideX * phaseLength
+        size_t sampleSize;
+
+        PaddedLayout(const DirectConvolutionShape& s)
+        {
+            width = (s.outWidth - 1) * s.strideX + s.kernelWidth;
+            height = (s.outHeight - 1) * s.strideY + s.kernelHeight;
+            phaseLength = (width + s.strideX - 1) / s.strideX;
+            rowLength = s.strideX * phaseLength;
+            sampleSize = s.inChannels * height * rowLength + PixelBlock; // (MicroKernel() reads up to a block beyond the last pixel)
+        }
+
+        // offset of each kernel cell (term) for output pixel (0, 0)
+        void GetOffsets(const DirectConvolutionShape& s, ptrdiff_t* offsets) const
+        {
+            for (size_t c = 0; c < s.inChannels; c++)
+                for (size_t ky = 0; ky < s.kernelHeight; ky++)
+                    for (size_t kx = 0; kx < s.kernelWidth; kx++)
+                        *offsets++ = (ptrdiff_t) ((c * height + ky) * rowLength + (kx % s.strideX) * phaseLength + kx / s.strideX);
+        }
+    };
+
+    static void PadInput(const DirectConvolutionShape& s, const PaddedLayout& p, const ElemType* in, ElemType* padded, size_t numSamples)
+    {
+        const size_t inPlane = s.inWidth * s.inHeight;
+#pragma omp parallel for
+        for (long i = 0; i < (long) (numSamples * s.inChannels * p.height); i++)
+        {
+            const size_t y = i % p.height;
+            const size_t c = (i / p.height) % s.inChannels;
+            const size_t n = i / (p.height * s.inChannels);
+            ElemType* dst = padded + n * p.sampleSize + (c * p.height + y) * p.rowLength;
+            if (y == p.height - 1 && c == s.inChannels - 1)
+                for (size_t j = 0; j < PixelBlock; j++)
+                    dst[p.rowLength + j] = 0;
+
+            const ptrdiff_t iy = (ptrdiff_t) y + s.offsetY;
+            if (iy < 0 || iy >= (ptrdiff_t) s.inHeight)
+            {
+                for (size_t j = 0; j < p.rowLength; j++)
+                    dst[j] = 0;
+                continue;
+            }
+            const ElemType* src = in + (n * s.inChannels + c) * inPlane + iy * s.inWidth;
+            for (size_t phase = 0; phase < s.strideX; phase++, dst += p.phaseLength)
+                for (size_t j = 0; j < p.phaseLength; j++)
+                {
+                    const ptrdiff_t ix = (ptrdiff_t) (j * s.strideX + phase) + s.offsetX;
+                    dst[j] = ix >= 0 && ix < (ptrdiff_t) s.inWidth ? src[ix] : 0;
+                }
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // forward
+    // -----------------------------------------------------------------------
+
+    static void ForwardDirect(const DirectConvolutionShape& s, const ElemType* in, const ElemType* kernel, ElemType* out, size_t numSamples, bool accumulate, WorkspaceAllocator& ws)
+    {
+        PaddedLayout p(s);
+        const size_t numTerms = s.inChannels * s.kernelHeight * s.kernelWidth;
+        const size_t outPlane = s.outWidth * s.outHeight;
+        const size_t numMapBlocks = (s.outChannels + MapBlock - 1) / MapBlock;
+        ElemType* padded = ws.Allocate<ElemType>(numSamples * p.sampleSize);
+        ptrdiff_t* offsets = ws.Allocate<ptrdiff_t>(numTerms);
+        ElemType* weights = ws.Allocate<ElemType>(numMapBlocks * numTerms * MapBlock);
+        if (!ws.HasMemory())
+            return;
+
+        PadInput(s, p, in, padded, numSamples);
+        p.GetOffsets(s, offsets);
+        PackWeights(kernel, s.outChannels, numTerms, weights);
+
+        // one work item computes one output row of MapBlock maps
+#pragma omp parallel for
+        for (long i = 0; i < (long) (numSamples * numMapBlocks * s.outHeight); i++)
+        {
+            const size_t oy = i % s.outHeight;
+            const size_t mapBlock = (i / s.outHeight) % numMapBlocks;
+            const size_t n = i / (s.outHeight * numMapBlocks);
+            const size_t numMaps = Min((size_t) MapBlock, s.outChannels - mapBlock * MapBlock);
+
+            const ElemType* src = padded + n * p.sampleSize + oy * s.strideY * p.rowLength;
+            const ElemType* w = weights + mapBlock * numTerms * MapBlock;
+            ElemType* dst = out + (n * s.outChannels + mapBlock * MapBlock) * outPlane + oy * s.outWidth;
+            ElemType acc[MapBlock * PixelBlock];
+            for (size_t ox = 0; ox < s.outWidth; ox += PixelBlock)
+            {
+                MicroKernel(src + ox, offsets, numTerms, w, acc);
+                StoreBlock(acc, numMaps, Min((size_t) PixelBlock, s.outWidth - ox), dst + ox, outPlane, accumulate);
+            }
+        }
+    }
+
+    // Winograd F(2x2, 3x3): each 2x2 output tile is computed from a 4x4 input tile d as A^T [sum_c (G g G^T) .* (B^T d B)] A.
+    // The elementwise products, summed over input channels, are 16 independent matrix products
+    // [maps x channels] * [channels x tiles], which are done by MicroKernel().
+    static void ForwardWinograd(const DirectConvolutionShape& s, const ElemType* in, const ElemType* kernel, ElemType* out, size_t numSamples, bool accumulate, WorkspaceAllocator& ws)
+    {
+        const size_t C = s.inChannels;
+        const size_t K = s.outChannels;
+        const size_t numMapBlocks = (K + MapBlock - 1) / MapBlock;
+        const size_t uSize = 16 * numMapBlocks * C * MapBlock;
+        const size_t vSize = 16 * C * TileBlock;
+        const int numThreads = omp_get_max_threads();
+        ElemType* u = ws.Allocate<ElemType>(uSize);
+        ptrdiff_t* offsets = ws.Allocate<ptrdiff_t>(C);
+        ElemType* vs = ws.Allocate<ElemType>(numThreads * vSize);
+        if (!ws.HasMemory())
+            return;
+
+        // transformed kernels U = G g G^T, packed as [element][map block][channel][MapBlock]
+        for (size_t j = 0; j < uSize; j++)
+            u[j] = 0;
+        for (size_t k = 0; k < K; k++)
+            for (size_t c = 0; c < C; c++)
+            {
+                const ElemType* g = kernel + (k * C + c) * 9; // g[ky * 3 + kx]
+                ElemType gg[4][3], ggg[4][4];
+                for (size_t kx = 0; kx < 3; kx++)
+                    KernelTransform(g[kx], g[3 + kx], g[6 + kx], gg[0][kx], gg[1][kx], gg[2][kx], gg[3][kx]);
+                for (size_t i = 0; i < 4; i++)
+                    KernelTransform(gg[i][0], gg[i][1], gg[i][2], ggg[i][0], ggg[i][1], ggg[i][2], ggg[i][3]);
+                for (size_t e = 0; e < 16; e++)
+                    u[((e * numMapBlocks + k / MapBlock) * C + c) * MapBlock + k % MapBlock] = ggg[e / 4][e % 4];
+            }
+
+        for (size_t c = 0; c < C; c++)
+            offsets[c] = (ptrdiff_t) (c * TileBlock);
+
+        const size_t tilesX = (s.outWidth + 1) / 2;
+        const size_t tilesY = (s.outHeight + 1) / 2;
+        const size_t numTiles = tilesX * tilesY;
+        const size_t numTileBlocks = (numTiles + TileBlock - 1) / TileBlock;
+        const size_t inPlane = s.inWidth * s.inHeight;
+        const size_t outPlane = s.outWidth * s.outHeight;
+
+#pragma omp parallel num_threads(numThreads)
+        {
+            // transformed input tiles B^T d B as [element][channel][tile]; unused tiles of the last block are never stored to
+            ElemType* v = vs + omp_get_thread_num() * vSize;
+            for (size_t j = 0; j < vSize; j++)
+                v[j] = 0;
+            ElemType acc[16][MapBlock * PixelBlock];
+
+#pragma omp for
+            for (long i = 0; i < (long) (numSamples * numTileBlocks); i++)
+            {
+                const size_t n = i / numTileBlocks;
+                const size_t t0 = (i % numTileBlocks) * TileBlock;
+                const size_t blockTiles = Min((size_t) TileBlock, numTiles - t0);
+
+                for (size_t c = 0; c < C; c++)
+                {
+                    const ElemType* src = in + (n * C + c) * inPlane;
+                    for (size_t t = 0; t < blockTiles; t++)
+                    {
+                        const ptrdiff_t y0 = (ptrdiff_t) (2 * ((t0 + t) / tilesX)) + s.offsetY;
+                        const ptrdiff_t x0 = (ptrdiff_t) (2 * ((t0 + t) % tilesX)) + s.offsetX;
+                        ElemType d[4][4], bd[4][4];
+                        for (ptrdiff_t y = 0; y < 4; y++)
+                            for (ptrdiff_t x = 0; x < 4; x++)
+                            {
+                                const ptrdiff_t iy = y0 + y, ix = x0 + x;
+                                d[y][x] = iy >= 0 && iy < (ptrdiff_t) s.inHeight && ix >= 0 && ix < (ptrdiff_t) s.inWidth ? src[iy * s.inWidth + ix] : 0;
+                            }
+                        for (size_t x = 0; x < 4; x++)
+                            InputTransform(d[0][x], d[1][x], d[2][x], d[3][x], bd[0][x], bd[1][x], bd[2][x], bd[3][x]);
+                        ElemType* dst = v + c * TileBlock + t;
+                        for (size_t y = 0; y < 4; y++)
+                        {
+                            ElemType r0, r1, r2, r3;
+                            InputTransform(bd[y][0], bd[y][1], bd[y][2], bd[y][3], r0, r1, r2, r3);
+                            dst[(4 * y + 0) * C * TileBlock] = r0;
+                            dst[(4 * y + 1) * C * TileBlock] = r1;
+                            dst[(4 * y + 2) * C * TileBlock] = r2;
+                            dst[(4 * y + 3) * C * TileBlock] = r3;
+                        }
+                    }
+                }
+
+                for (size_t mapBlock = 0; mapBlock < numMapBlocks; mapBlock++)
+                {
+                    const size_t numMaps = Min((size_t) MapBlock, K - mapBlock * MapBlock);
+                    for (size_t j0 = 0; j0 < blockTiles; j0 += PixelBlock)
+                    {
+                        for (size_t e = 0; e < 16; e++)
+                            MicroKernel(v + e * C * TileBlock + j0, offsets, C,
+                                        u + (e * numMapBlocks + mapBlock) * C * MapBlock, acc[e]);
+
+                        // output transform A^T M A
+                        for (size_t m = 0; m < numMaps; m++)
+                        {
+                            ElemType* dst = out + (n * K + mapBlock * MapBlock + m) * outPlane;
+                            for (size_t j = 0; j < Min((size_t) PixelBlock, blockTiles - j0); j++)
+                            {
+                                const size_t a = m * PixelBlock + j;
+                                ElemType am[2][4];
+                                for (size_t x = 0; x < 4; x++)
+                                    OutputTransform(acc[x][a], acc[4 + x][a], acc[8 + x][a], acc[12 + x][a], am[0][x], am[1][x]);
+                                const size_t tile = t0 + j0 + j;
+                                const size_t oy0 = 2 * (tile / tilesX);
+                                const size_t ox0 = 2 * (tile % tilesX);
+                                for (size_t y = 0; y < 2 && oy0 + y < s.outHeight; y++)
+                                {
+                                    ElemType r[2];
+                                    OutputTransform(am[y][0], am[y][1], am[y][2], am[y][3], r[0], r[1]);
+                                    for (size_t x = 0; x < 2 && ox0 + x < s.outWidth; x++)
+                                    {
+                                        ElemType& o = dst[(oy0 + y) * s.outWidth + ox0 + x];
+                                        o = accumulate ? o + r[x] : r[x];
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // G g for a kernel column g
+    static inline void KernelTransform(ElemType g0, ElemType g1, ElemType g2, ElemType& r0, ElemType& r1, ElemType& r2, ElemType& r3)
+    {
+        r0 = g0;
+        r1 = (g0 + g1 + g2) / 2;
+        r2 = (g0 - g1 + g2) / 2;
+        r3 = g2;
+    }
+
+    // B^T d for an input column d
+    static inline void InputTransform(ElemType d0, ElemType d1, ElemType d2, ElemType d3, ElemType& r0, ElemType& r1, ElemType& r2, ElemType& r3)
+    {
+        r0 = d0 - d2;
+        r1 = d1 + d2;
+        r2 = d2 - d1;
+        r3 = d1 - d3;
+    }
+
+    // A^T m for a column m
+    static inline void OutputTransform(ElemType m0, ElemType m1, ElemType m2, ElemType m3, ElemType& r0, ElemType& r1)
+    {
+        r0 = m0 + m1 + m2;
+        r1 = m1 - m2 - m3;
+    }
+
+    // -----------------------------------------------------------------------
+    // data gradient with stride > 1
+    // -----------------------------------------------------------------------
+
+    // For each kernel cell (kx, ky), MicroKernel() computes the contribution sum_k w[k, c, ky, kx] srcGrad[k, oy, ox] of each
+    // output pixel to input pixel (oy * strideY + ky, ox * strideX + kx), which is then scattered into a padded gradient buffer.
+    static void BackwardDataStrided(const DirectConvolutionShape& s, const ElemType* srcGrad, const ElemType* kernel, ElemType* grad, size_t numSamples, WorkspaceAllocator& ws)
+    {
+        const size_t C = s.inChannels;
+        const size_t K = s.outChannels;
+        const size_t kernelSize = s.kernelWidth * s.kernelHeight;
+        const size_t outPlane = s.outWidth * s.outHeight;
+        const size_t inPlane = s.inWidth * s.inHeight;
+        const size_t numChannelBlocks = (C + MapBlock - 1) / MapBlock;
+        const size_t srcSize = numSamples * K * outPlane;
+        const size_t wSize = numChannelBlocks * kernelSize * K * MapBlock;
+        const size_t width = (s.outWidth - 1) * s.strideX + s.kernelWidth;
+        const size_t height = (s.outHeight - 1) * s.strideY + s.kernelHeight;
+        const size_t bufferSize = MapBlock * height * width;
+        const int numThreads = omp_get_max_threads();
+        ElemType* src = ws.Allocate<ElemType>(srcSize + PixelBlock); // (MicroKernel() reads up to a block beyond the last pixel)
+        ElemType* w = ws.Allocate<ElemType>(wSize);
+        ptrdiff_t* offsets = ws.Allocate<ptrdiff_t>(K);
+        ElemType* buffers = ws.Allocate<ElemType>(numThreads * bufferSize);
+        if (!ws.HasMemory())
+            return;
+
+        for (size_t j = 0; j < srcSize; j++)
+            src[j] = srcGrad[j];
+        for (size_t j = srcSize; j < srcSize + PixelBlock; j++)
+            src[j] = 0;
+
+        // weights as [channel block][kernel cell][map][MapBlock]
+        for (size_t j = 0; j < wSize; j++)
+            w[j] = 0;
+        for (size_t k = 0; k < K; k++)
+            for (size_t c = 0; c < C; c++)
+                for (size_t cell = 0; cell < kernelSize; cell++)
+                    w[(((c / MapBlock) * kernelSize + cell) * K + k) * MapBlock + c % MapBlock] = kernel[(k * C + c) * kernelSize + cell];
+
+        for (size_t k = 0; k < K; k++)
+            offsets[k] = (ptrdiff_t) (k * outPlane);
+
+#pragma omp parallel num_threads(numThreads)
+        {
+            ElemType* buffer = buffers + omp_get_thread_num() * bufferSize;
+            ElemType acc[MapBlock * PixelBlock];
+
+#pragma omp for
+            for (long i = 0; i < (long) (numSamples * numChannelBlocks); i++)
+            {
+                const size_t n = i / numChannelBlocks;
+                const size_t c0 = (i % numChannelBlocks) * MapBlock;
+                const size_t numChannels = Min((size_t) MapBlock, C - c0);
+                for (size_t j = 0; j < bufferSize; j++)
+                    buffer[j] = 0;
+
+                for (size_t oy = 0; oy < s.outHeight; oy++)
+                    for (size_t ky = 0; ky < s.kernelHeight; ky++)
+                        for (size_t kx = 0; kx < s.kernelWidth; kx++)
+                        {
+                            const ElemType* wc = w + (((c0 / MapBlock) * kernelSize + ky * s.kernelWidth + kx) * K) * MapBlock;
+                            for (size_t ox = 0; ox < s.outWidth; ox += PixelBlock)
+                            {
+                                MicroKernel(src + n * K * outPlane + oy * s.outWidth + ox, offsets, K, wc, acc);
+                                const size_t numPixels = Min((size_t) PixelBlock, s.outWidth - ox);
+                                for (size_t m = 0; m < numChannels; m++)
+                                {
+                                    ElemType* dst = buffer + (m * height + oy * s.strideY + ky) * width + ox * s.strideX + kx;
+                                    for (size_t j = 0; j < numPixels; j++)
+                                        dst[j * s.strideX] += acc[m * PixelBlock + j];
+                                }
+                            }
+                        }
+
+                for (size_t m = 0; m < numChannels; m++)
+                {
+                    ElemType* dst = grad + (n * C + c0 + m) * inPlane;
+                    for (size_t y = 0; y < height; y++)
+                    {
+                        const ptrdiff_t iy = (ptrdiff_t) y + s.offsetY;
+                        if (iy < 0 || iy >= (ptrdiff_t) s.inHeight)
+                            continue;
+                        for (size_t x = 0; x < width; x++)
+                        {
+                            const ptrdiff_t ix = (ptrdiff_t) x + s.offsetX;
+                            if (ix >= 0 && ix < (ptrdiff_t) s.inWidth)
+                                dst[iy * s.inWidth + ix] += buffer[(m * height + y) * width + x];
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+} // anonymous namespace
+
+}}}
@@ -1471,14 +1471,9 @@ void Matrix<ElemType>::NormalGrad(Matrix<ElemType>& gradients,
                 ScaleAndAdd(-(1 - momentum) * learnRatePerSample, gradients, functionValues);
             },
             { /* CPU sparse */
-                if (momentum != 0)
-                {
-                    Matrix<ElemType> gradientCache(gradients.GetDeviceId());
-                    gradientCache.AssignValuesOf(gradients);
-                    gradients.m_CPUSparseMatrix->NormalGrad(*m_CPUMatrix, momentum);
-                    ScaleAndAdd(-momentum, *this, functionValues);
-                    ScaleAndAdd(-(1 - momentum) * learnRatePerSample, gradientCache, functionValues);
-                }
+                // (lazy: only the weights with gradients are updated)
+                gradients.m_CPUSparseMatrix->NormalGrad(*m_CPUMatrix, momentum, /*useNesterovMomentum=*/true);
+                ScaleAndAdd(-learnRatePerSample, gradients, functionValues);
             },
             { /* GPU sparse */
                 if (momentum != 0)
@@ -1507,23 +1502,32 @@ ElemType Matrix<ElemType>::Adagrad(Matrix<ElemType>& gradients, const bool needA
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
+// FSAdagrad's weight of the smoothed squared gradients, and its multiplier, which depends on the running average of the minibatch size
+// (advanced by each call)
 template <class ElemType>
-void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum)
+static void GetFSAdagradParameters(size_t mbSize, ElemType& adagradkeepweight, ElemType& targetadagradavdenom_x_sqrtadagradsqrframes)
 {
     // TODO: The values of 'adagradT' and 'targetadagradavdenom' are currently hardcoded constants taken from DBN (empirically determined).
     // These should be made configurable if needed
     const size_t adagradT = 2 * 3600 * 100;
     const ElemType targetadagradavdenom = 0.0025; // 1/400 magic constant
-    const ElemType adagradkeepweight = static_cast<ElemType>(exp(-1.0 * mbSize / adagradT));
+    adagradkeepweight = static_cast<ElemType>(exp(-1.0 * mbSize / adagradT));
 
     static ElemType aggadagradsqrframes = 0;
     aggadagradsqrframes = adagradkeepweight * aggadagradsqrframes + (1.0f - adagradkeepweight) * mbSize;
-    const ElemType targetadagradavdenom_x_sqrtadagradsqrframes = static_cast<ElemType>(targetadagradavdenom * sqrt(aggadagradsqrframes));
+    targetadagradavdenom_x_sqrtadagradsqrframes = static_cast<ElemType>(targetadagradavdenom * sqrt(aggadagradsqrframes));
+}
+
+template <class ElemType>
+void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum)
+{
+    ElemType adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes;
+    GetFSAdagradParameters(mbSize, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes);
 
     DISPATCH_MATRIX_ON_FLAG(&gradients, &gradients,
         { m_CPUMatrix->FSAdagrad(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes); SetDataLocation(CPU); },
         { m_GPUMatrix->FSAdagrad(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes); SetDataLocation(GPU); },
-        { NOT_IMPLEMENTED; },
+        { gradients.m_CPUSparseMatrix->FSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes); SetDataLocation(CPU); },
         { NOT_IMPLEMENTED; });
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
@@ -1547,6 +1551,62 @@ ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
+// fused updates of many parameters; 'this' (the smoothed gradients) and functionValues are changed
+template <class ElemType>
+void Matrix<ElemType>::MultiTensorNormalGrad(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues,
+                                             const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                                             const ElemType momentum, const bool useNAG)
+{
+    DISPATCH_MATRIX_ON_FLAG(&gradients, this,
+        { m_CPUMatrix->MultiTensorNormalGrad(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, segments, regularization, momentum, useNAG); functionValues.SetDataLocation(CPU); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::MultiTensorAdagrad(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues,
+                                          const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                                          const bool needAveMultiplier)
+{
+    DISPATCH_MATRIX_ON_FLAG(&gradients, this,
+        { m_CPUMatrix->MultiTensorAdagrad(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, segments, regularization, needAveMultiplier); functionValues.SetDataLocation(CPU); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
+// Like FSAdagrad(), this advances the running average of the minibatch size once for each parameter.
+template <class ElemType>
+void Matrix<ElemType>::MultiTensorFSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues,
+                                            const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                                            const ElemType momentum)
+{
+    ElemType adagradkeepweight = 0;
+    std::vector<ElemType> adaMuls(segments.size());
+    for (auto& adaMul : adaMuls)
+        GetFSAdagradParameters(mbSize, adagradkeepweight, adaMul);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients, this,
+        { m_CPUMatrix->MultiTensorFSAdagrad(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, segments, regularization, momentum, adagradkeepweight, adaMuls); functionValues.SetDataLocation(CPU); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::MultiTensorRmsProp(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues,
+                                          const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                                          ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                                          const bool needAveMultiplier)
+{
+    DISPATCH_MATRIX_ON_FLAG(&gradients, this,
+        { m_CPUMatrix->MultiTensorRmsProp(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, segments, regularization, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier); functionValues.SetDataLocation(CPU); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -195,6 +195,13 @@ public:
     void FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum);
     ElemType RmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
+    // fused versions of the above for many parameters stored in arenas, see MultiTensorSegment (CPU only)
+    void MultiTensorNormalGrad(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization, const ElemType momentum, const bool useNAG);
+    void MultiTensorAdagrad(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization, const bool needAveMultiplier);
+    void MultiTensorFSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization, const ElemType momentum);
+    void MultiTensorRmsProp(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const std::vector<MultiTensorSegment>& segments, const MultiTensorRegularization& regularization,
+                            ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
+
     void Resize(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve = 10000, bool growOnly = true); // by default we only reallocate if need to grow
     void Resize(const Matrix<ElemType>& other) // TODO: Should this carry over numNZElemToReserve for sparse matrices?
     {
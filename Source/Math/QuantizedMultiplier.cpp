@@ -0,0 +1,159 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizedMultiplier.cpp -- 16-bit quantized matrix product for CPU inference
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "QuantizedMultiplier.h"
+#include "BlockMultiplier.h"
+#include <omp.h>
+#include <vector>
+#include <cstdint>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef SUPPORT_AVX2
+typedef BlockMultiplier<BlockHandlerAVX> QuantizedBlockMultiplier;
+#else
+typedef BlockMultiplier<BlockHandlerSSE> QuantizedBlockMultiplier;
+#endif
+typedef QuantizedBlockMultiplier::ScalarAT QuantizedInputT;
+typedef QuantizedBlockMultiplier::ScalarBT QuantizedWeightT;
+
+// values are quantized to at most [-c_maxQuantizationRange, c_maxQuantizationRange], which is BlockMultiplier::MAXRANGE
+static const int c_maxQuantizationRange = 1 << 13;
+
+// The int32 accumulators of BlockMultiplier wrap around on overflow. A dot product of length k of
+// values in [-range, range] is bounded by k * range^2, so we shrink the range for long inner dimensions.
+static int QuantizationRange(size_t innerDim)
+{
+    int range = (int) sqrt((double) INT32_MAX / std::max(innerDim, (size_t) 1));
+    return std::min(range, c_maxQuantizationRange);
+}
+
+// BlockMultiplier works on row-major matrices A [m x k] * B [k x n] = C [m x n].
+// Our matrices are column-major, so we compute output' = input' * weights' instead:
+//  - the column-major input [inputDim x N] is, as-is, the row-major A [N x inputDim]
+//  - the column-major weights [outputDim x inputDim] are, as-is, the row-major B [inputDim x outputDim]
+//  - the row-major C [N x outputDim] is, as-is, the column-major output [outputDim x N]
+// Only transposed weights [inputDim x outputDim] need to be physically transposed to get B.
+template <class ElemType>
+struct QuantizedMultiplier<ElemType>::BlockMultiplierState
+{
+    QuantizedBlockMultiplier m_multiplier;
+    QuantizedWeightT* m_preparedWeights; // quantized weights, rewritten in block order by PrepareB()
+
+    BlockMultiplierState()
+        : m_multiplier(omp_get_max_threads()), m_preparedWeights(nullptr)
+    {
+    }
+    ~BlockMultiplierState()
+    {
+        if (m_preparedWeights)
+            QuantizedBlockMultiplier::FreeMatrix(m_preparedWeights);
+    }
+};
+
+// largest absolute value of an array; 0 if all values are 0
+template <class ElemType>
+static ElemType MaxAbs(const ElemType* data, size_t numElements)
+{
+    ElemType maxAbs = 0;
+    for (size_t i = 0; i < numElements; i++)
+        maxAbs = std::max(maxAbs, (ElemType) fabs(data[i]));
+    return maxAbs;
+}
+
+// scale that maps [-maxAbs, maxAbs] onto [-range, range]
+template <class ElemType>
+static ElemType QuantizationScale(ElemType maxAbs, int range)
+{
+    return maxAbs > 0 ? (ElemType) range / maxAbs : (ElemType) 1;
+}
+
+template <class ElemType, class QuantizedT>
+static inline QuantizedT Quantize(ElemType value, ElemType scale, ElemType range)
+{
+    ElemType scaled = value * scale;
+    scaled = std::max(-range, std::min(range, scaled)); // (guard against rounding beyond the range)
+    return (QuantizedT) (scaled < 0 ? scaled - (ElemType) 0.5 : scaled + (ElemType) 0.5);
+}
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::QuantizedMultiplier(const Matrix<ElemType>& weights, bool transposeWeights)
+    : m_state(new BlockMultiplierState())
+{
+    if (!IsSupported(weights))
+        LogicError("QuantizedMultiplier: Weights must be a dense matrix on the CPU.");
+
+    m_outputDim = transposeWeights ? weights.GetNumCols() : weights.GetNumRows();
+    m_inputDim  = transposeWeights ? weights.GetNumRows() : weights.GetNumCols();
+
+    m_quantizationRange = QuantizationRange(m_inputDim);
+
+    const ElemType* data = weights.Data();
+    m_weightsScale = QuantizationScale(MaxAbs(data, weights.GetNumElements()), m_quantizationRange);
+
+    // quantize into row-major B [inputDim x outputDim] (see comment on BlockMultiplierState)
+    int k = (int) m_inputDim;
+    int n = (int) m_outputDim;
+    QuantizedWeightT* quantizedWeights = QuantizedBlockMultiplier::CreateMatrixB(k, n);
+    for (int row = 0; row < k; row++)
+        for (int col = 0; col < n; col++)
+        {
+            size_t index = transposeWeights ? (size_t) col * k + row : (size_t) row * n + col;
+            quantizedWeights[(size_t) row * n + col] = Quantize<ElemType, QuantizedWeightT>(data[index], m_weightsScale, (ElemType) m_quantizationRange);
+        }
+
+    m_state->m_preparedWeights = m_state->m_multiplier.PrepareB(quantizedWeights, k, n);
+    QuantizedBlockMultiplier::FreeMatrix(quantizedWeights);
+}
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::~QuantizedMultiplier()
+{
+}
+
+template <class ElemType>
+void QuantizedMultiplier<ElemType>::Multiply(const Matrix<ElemType>& input, Matrix<ElemType>& output) const
+{
+    if (!IsSupported(input) || !IsSupported(output))
+        LogicError("QuantizedMultiplier: Input and output must be dense matrices on the CPU.");
+    if (input.GetNumRows() != m_inputDim || output.GetNumRows() != m_outputDim || output.GetNumCols() != input.GetNumCols())
+        LogicError("QuantizedMultiplier: Dimension mismatch: [%d x %d] * [%d x %d] -> [%d x %d].",
+                   (int) m_outputDim, (int) m_inputDim, (int) input.GetNumRows(), (int) input.GetNumCols(), (int) output.GetNumRows(), (int) output.GetNumCols());
+
+    const size_t numInputElements = input.GetNumElements();
+    const size_t numOutputElements = output.GetNumElements();
+    if (numOutputElements == 0)
+        return;
+
+    // quantize the input with its own scale; the column-major input is the row-major A [N x inputDim]
+    const ElemType* inputData = input.Data();
+    const ElemType inputScale = QuantizationScale(MaxAbs(inputData, numInputElements), m_quantizationRange);
+    const ElemType range = (ElemType) m_quantizationRange;
+    std::vector<QuantizedInputT> quantizedInput(numInputElements);
+#pragma omp parallel for
+    for (long i = 0; i < (long) numInputElements; i++)
+        quantizedInput[i] = Quantize<ElemType, QuantizedInputT>(inputData[i], inputScale, range);
+
+    // multiply; BlockMultiplier expects C to be zeroed
+    std::vector<int32_t> quantizedOutput(numOutputElements, 0);
+    m_state->m_multiplier.MultiplyMatrices(quantizedInput.data(), (int) input.GetNumCols(), (int) m_inputDim,
+                                           m_state->m_preparedWeights, (int) m_outputDim, quantizedOutput.data());
+
+    // unquantize; the row-major C [N x outputDim] is the column-major output
+    ElemType* outputData = output.Data();
+    const ElemType unquantizeScale = 1 / (m_weightsScale * inputScale);
+#pragma omp parallel for
+    for (long i = 0; i < (long) numOutputElements; i++)
+        outputData[i] = quantizedOutput[i] * unquantizeScale;
+}
+
+template class QuantizedMultiplier<float>;
+template class QuantizedMultiplier<double>;
+
+}}}
@@ -0,0 +1,56 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizedMultiplier.h -- 16-bit quantized matrix product for CPU inference, implemented on top of BlockMultiplier
+//
+
+#pragma once
+
+#include "Matrix.h"
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// QuantizedMultiplier -- computes output = weights * input (or weights' * input)
+// for a fixed 'weights' matrix, by linearly quantizing both operands to int16 and
+// running the product through BlockMultiplier (SSE, or AVX2 if built with SUPPORT_AVX2).
+// The weights are quantized and rewritten in block order once, at construction time.
+// The input is quantized on each call, with a scale derived from its own max abs value.
+// Results are approximate, so this is meant for inference only. Dense CPU matrices only.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class MATH_API QuantizedMultiplier
+{
+public:
+    QuantizedMultiplier(const Matrix<ElemType>& weights, bool transposeWeights);
+    ~QuantizedMultiplier();
+
+    // dimensions of the (possibly transposed) weights, i.e. output = [GetOutputDim() x N] and input = [GetInputDim() x N]
+    size_t GetOutputDim() const { return m_outputDim; }
+    size_t GetInputDim() const { return m_inputDim; }
+
+    // output = weights * input (resp. weights' * input); output must already have the right dimensions (it may be a column slice)
+    void Multiply(const Matrix<ElemType>& input, Matrix<ElemType>& output) const;
+
+    // whether a matrix can be an operand of the quantized product
+    static bool IsSupported(const Matrix<ElemType>& m)
+    {
+        return m.GetDeviceId() == CPUDEVICE && m.GetMatrixType() == DENSE;
+    }
+
+private:
+    QuantizedMultiplier(const QuantizedMultiplier&) = delete;
+    QuantizedMultiplier& operator=(const QuantizedMultiplier&) = delete;
+
+    struct BlockMultiplierState; // keeps BlockMultiplier and its SIMD headers out of this header
+    std::unique_ptr<BlockMultiplierState> m_state;
+    size_t m_outputDim;
+    size_t m_inputDim;
+    int m_quantizationRange;     // both operands are quantized to [-m_quantizationRange, m_quantizationRange]
+    ElemType m_weightsScale;     // quantized weight = round(weight * m_weightsScale)
+};
+
+}}}
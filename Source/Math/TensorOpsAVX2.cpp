@@ -0,0 +1,118 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TensorOpsAVX2.cpp -- AVX2 + FMA instantiation of the vectorized elementwise and convolution kernels (see TensorOpsVectorized.h, DirectConvolution.h)
+//
+// This file must be compiled with AVX2 and FMA enabled (-mavx2 -mfma, resp. /arch:AVX2). It is only
+// called into after GetVectorInstructionSet() has verified through CPUID that the CPU supports them.
+//
+
+// This file must not include anything that defines inline functions or templates which other source files may use
+// too (see TensorOpsVectorizedKernels.h), hence no stdafx.h.
+
+#include "TensorOpsVectorizedKernels.h"
+#include "DirectConvolutionKernels.h"
+#include <cfloat>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef __AVX2__
+
+namespace {
+
+struct AVX2Traits
+{
+    typedef __m256 Reg;
+    typedef __m256 Mask;
+    static const size_t Width = 8;
+
+    static inline Reg Load(const float* p) { return _mm256_loadu_ps(p); }
+    static inline void Store(float* p, Reg x) { _mm256_storeu_ps(p, x); }
+    static inline Reg Set(float x) { return _mm256_set1_ps(x); }
+    static inline Reg Add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+    static inline Reg Sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+    static inline Reg Mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+    static inline Reg Div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+    static inline Reg FMA(Reg a, Reg b, Reg c) { return _mm256_fmadd_ps(a, b, c); }
+    static inline Reg Min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+    static inline Reg Max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+    static inline Mask Less(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static inline Mask Greater(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static inline Mask IsInfOrNaN(Reg x) { return _mm256_cmp_ps(Abs(x), Set(FLT_MAX), _CMP_NLE_UQ); }
+    static inline Reg Select(Mask m, Reg a, Reg b) { return _mm256_blendv_ps(b, a, m); }
+    static inline Reg Abs(Reg x) { return _mm256_andnot_ps(Set(-0.0f), x); }
+    static inline Reg CopySign(Reg mag, Reg sign) { return _mm256_or_ps(_mm256_and_ps(Set(-0.0f), sign), Abs(mag)); }
+    static inline Reg Round(Reg x) { return _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static inline Reg Pow2(Reg n)
+    {
+        __m256i biased = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(biased, 23));
+    }
+    static inline Reg Infinity() { return _mm256_castsi256_ps(_mm256_set1_epi32(0x7f800000)); }
+    static inline Reg Exponent(Reg x)
+    {
+        __m256i e = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+        return _mm256_cvtepi32_ps(_mm256_sub_epi32(e, _mm256_set1_epi32(126)));
+    }
+    static inline Reg Mantissa(Reg x)
+    {
+        __m256i m = _mm256_and_si256(_mm256_castps_si256(x), _mm256_set1_epi32(0x807fffff));
+        return _mm256_castsi256_ps(_mm256_or_si256(m, _mm256_set1_epi32(0x3f000000)));
+    }
+};
+
+} // anonymous namespace
+
+bool AVX2UnaryTensorOp(VectorizedOp op, float beta, const float* a, float* c, float alpha, size_t n, bool fast)
+{
+    return VectorizedUnaryTensorOpImpl<AVX2Traits>(op, beta, a, c, alpha, n, fast);
+}
+
+bool AVX2BinaryTensorOp(VectorizedOp op, float beta, const float* a, const float* b, float* c, float alpha, size_t n)
+{
+    return VectorizedBinaryTensorOpImpl<AVX2Traits>(op, beta, a, b, c, alpha, n);
+}
+
+bool AVX2DirectConvolutionWorkspaceSize(DirectConvolutionOp op, const DirectConvolutionShape& shape, size_t numSamples, size_t& sizeInBytes)
+{
+    sizeInBytes = DirectConvolutionKernels<float, AVX2Traits>::WorkspaceSize(op, shape, numSamples);
+    return true;
+}
+
+bool AVX2DirectConvolutionForward(const DirectConvolutionShape& shape, const float* in, const float* kernel, float* out, size_t numSamples, float* workspace)
+{
+    DirectConvolutionKernels<float, AVX2Traits>::Forward(shape, in, kernel, out, numSamples, /*accumulate=*/false, workspace);
+    return true;
+}
+
+bool AVX2DirectConvolutionBackwardData(const DirectConvolutionShape& shape, const float* srcGrad, const float* kernel, float* grad, size_t numSamples, float* workspace)
+{
+    DirectConvolutionKernels<float, AVX2Traits>::BackwardData(shape, srcGrad, kernel, grad, numSamples, workspace);
+    return true;
+}
+
+bool AVX2DirectConvolutionBackwardKernel(const DirectConvolutionShape& shape, const float* srcGrad, const float* in, float* kernelGrad, size_t numSamples, float* workspace)
+{
+    DirectConvolutionKernels<float, AVX2Traits>::BackwardKernel(shape, srcGrad, in, kernelGrad, numSamples, workspace);
+    return true;
+}
+
+bool AVX2KernelsCompiled() { return true; }
+
+#else // compiler does not support AVX2: GetVectorInstructionSet() will not select these
+
+bool AVX2UnaryTensorOp(VectorizedOp, float, const float*, float*, float, size_t, bool) { return false; }
+bool AVX2BinaryTensorOp(VectorizedOp, float, const float*, const float*, float*, float, size_t) { return false; }
+bool AVX2DirectConvolutionWorkspaceSize(DirectConvolutionOp, const DirectConvolutionShape&, size_t, size_t&) { return false; }
+bool AVX2DirectConvolutionForward(const DirectConvolutionShape&, const float*, const float*, float*, size_t, float*) { return false; }
+bool AVX2DirectConvolutionBackwardData(const DirectConvolutionShape&, const float*, const float*, float*, size_t, float*) { return false; }
+bool AVX2DirectConvolutionBackwardKernel(const DirectConvolutionShape&, const float*, const float*, float*, size_t, float*) { return false; }
+bool AVX2KernelsCompiled() { return false; }
+
+#endif
+
+}}}
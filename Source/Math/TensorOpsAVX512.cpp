@@ -0,0 +1,127 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TensorOpsAVX512.cpp -- AVX-512F instantiation of the vectorized elementwise and convolution kernels (see TensorOpsVectorized.h, DirectConvolution.h)
+//
+// This file must be compiled with AVX-512F enabled (-mavx512f, resp. /arch:AVX512 where the compiler supports it);
+// otherwise it compiles to stubs and the AVX2 kernels are used. It is only called into after
+// GetVectorInstructionSet() has verified through CPUID that the CPU supports AVX-512F.
+//
+
+// This file must not include anything that defines inline functions or templates which other source files may use
+// too (see TensorOpsVectorizedKernels.h), hence no stdafx.h.
+
+#include "TensorOpsVectorizedKernels.h"
+#include "DirectConvolutionKernels.h"
+#include <cfloat>
+#ifdef __AVX512F__
+#include <immintrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef __AVX512F__
+
+namespace {
+
+struct AVX512Traits
+{
+    typedef __m512 Reg;
+    typedef __mmask16 Mask;
+    static const size_t Width = 16;
+
+    static inline Reg Load(const float* p) { return _mm512_loadu_ps(p); }
+    static inline void Store(float* p, Reg x) { _mm512_storeu_ps(p, x); }
+    static inline Reg Set(float x) { return _mm512_set1_ps(x); }
+    static inline Reg Add(Reg a, Reg b) { return _mm512_add_ps(a, b); }
+    static inline Reg Sub(Reg a, Reg b) { return _mm512_sub_ps(a, b); }
+    static inline Reg Mul(Reg a, Reg b) { return _mm512_mul_ps(a, b); }
+    static inline Reg Div(Reg a, Reg b) { return _mm512_div_ps(a, b); }
+    static inline Reg FMA(Reg a, Reg b, Reg c) { return _mm512_fmadd_ps(a, b, c); }
+    static inline Reg Min(Reg a, Reg b) { return _mm512_min_ps(a, b); }
+    static inline Reg Max(Reg a, Reg b) { return _mm512_max_ps(a, b); }
+    static inline Mask Less(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static inline Mask Greater(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static inline Mask IsInfOrNaN(Reg x) { return _mm512_cmp_ps_mask(Abs(x), Set(FLT_MAX), _CMP_NLE_UQ); }
+    static inline Reg Select(Mask m, Reg a, Reg b) { return _mm512_mask_blend_ps(m, b, a); }
+    // (the floating-point and/andnot/or are AVX-512DQ, so these go through the integer versions)
+    static inline Reg Abs(Reg x)
+    {
+        return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32(0x7fffffff)));
+    }
+    static inline Reg CopySign(Reg mag, Reg sign)
+    {
+        __m512i signBit = _mm512_and_si512(_mm512_castps_si512(sign), _mm512_set1_epi32((int) 0x80000000));
+        return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(Abs(mag)), signBit));
+    }
+    static inline Reg Round(Reg x) { return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static inline Reg Pow2(Reg n)
+    {
+        __m512i biased = _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(biased, 23));
+    }
+    static inline Reg Infinity() { return _mm512_castsi512_ps(_mm512_set1_epi32(0x7f800000)); }
+    static inline Reg Exponent(Reg x)
+    {
+        __m512i e = _mm512_srli_epi32(_mm512_castps_si512(x), 23);
+        return _mm512_cvtepi32_ps(_mm512_sub_epi32(e, _mm512_set1_epi32(126)));
+    }
+    static inline Reg Mantissa(Reg x)
+    {
+        __m512i m = _mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32((int) 0x807fffff));
+        return _mm512_castsi512_ps(_mm512_or_si512(m, _mm512_set1_epi32(0x3f000000)));
+    }
+};
+
+} // anonymous namespace
+
+bool AVX512UnaryTensorOp(VectorizedOp op, float beta, const float* a, float* c, float alpha, size_t n, bool fast)
+{
+    return VectorizedUnaryTensorOpImpl<AVX512Traits>(op, beta, a, c, alpha, n, fast);
+}
+
+bool AVX512BinaryTensorOp(VectorizedOp op, float beta, const float* a, const float* b, float* c, float alpha, size_t n)
+{
+    return VectorizedBinaryTensorOpImpl<AVX512Traits>(op, beta, a, b, c, alpha, n);
+}
+
+bool AVX512DirectConvolutionWorkspaceSize(DirectConvolutionOp op, const DirectConvolutionShape& shape, size_t numSamples, size_t& sizeInBytes)
+{
+    sizeInBytes = DirectConvolutionKernels<float, AVX512Traits>::WorkspaceSize(op, shape, numSamples);
+    return true;
+}
+
+bool AVX512DirectConvolutionForward(const DirectConvolutionShape& shape, const float* in, const float* kernel, float* out, size_t numSamples, float* workspace)
+{
+    DirectConvolutionKernels<float, AVX512Traits>::Forward(shape, in, kernel, out, numSamples, /*accumulate=*/false, workspace);
+    return true;
+}
+
+bool AVX512DirectConvolutionBackwardData(const DirectConvolutionShape& shape, const float* srcGrad, const float* kernel, float* grad, size_t numSamples, float* workspace)
+{
+    DirectConvolutionKernels<float, AVX512Traits>::BackwardData(shape, srcGrad, kernel, grad, numSamples, workspace);
+    return true;
+}
+
+bool AVX512DirectConvolutionBackwardKernel(const DirectConvolutionShape& shape, const float* srcGrad, const float* in, float* kernelGrad, size_t numSamples, float* workspace)
+{
+    DirectConvolutionKernels<float, AVX512Traits>::BackwardKernel(shape, srcGrad, in, kernelGrad, numSamples, workspace);
+    return true;
+}
+
+bool AVX512KernelsCompiled() { return true; }
+
+#else // compiler does not support AVX-512: GetVectorInstructionSet() will not select these
+
+bool AVX512UnaryTensorOp(VectorizedOp, float, const float*, float*, float, size_t, bool) { return false; }
+bool AVX512BinaryTensorOp(VectorizedOp, float, const float*, const float*, float*, float, size_t) { return false; }
+bool AVX512DirectConvolutionWorkspaceSize(DirectConvolutionOp, const DirectConvolutionShape&, size_t, size_t&) { return false; }
+bool AVX512DirectConvolutionForward(const DirectConvolutionShape&, const float*, const float*, float*, size_t, float*) { return false; }
+bool AVX512DirectConvolutionBackwardData(const DirectConvolutionShape&, const float*, const float*, float*, size_t, float*) { return false; }
+bool AVX512DirectConvolutionBackwardKernel(const DirectConvolutionShape&, const float*, const float*, float*, size_t, float*) { return false; }
+bool AVX512KernelsCompiled() { return false; }
+
+#endif
+
+}}}
@@ -0,0 +1,229 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TensorOpsVectorized.cpp -- runtime selection of the vectorized elementwise kernels (see TensorOpsVectorized.h)
+//
+// This file is compiled without any special instruction set flags, since it runs before we know what the CPU supports.
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "TensorOpsVectorized.h"
+#include "TensorOpsVectorizedKernels.h" // (for VectorizedOp)
+#include <algorithm>
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// implemented in TensorOpsAVX2.cpp and TensorOpsAVX512.cpp, which are compiled with the respective instruction set enabled
+bool AVX2UnaryTensorOp(VectorizedOp op, float beta, const float* a, float* c, float alpha, size_t n, bool fast);
+bool AVX2BinaryTensorOp(VectorizedOp op, float beta, const float* a, const float* b, float* c, float alpha, size_t n);
+bool AVX2KernelsCompiled();
+bool AVX512UnaryTensorOp(VectorizedOp op, float beta, const float* a, float* c, float alpha, size_t n, bool fast);
+bool AVX512BinaryTensorOp(VectorizedOp op, float beta, const float* a, const float* b, float* c, float alpha, size_t n);
+bool AVX512KernelsCompiled();
+
+// -----------------------------------------------------------------------
+// CPUID
+// -----------------------------------------------------------------------
+
+static void CpuId(unsigned int leaf, unsigned int subLeaf, unsigned int regs[4])
+{
+#ifdef _WIN32
+    int r[4];
+    __cpuidex(r, (int) leaf, (int) subLeaf);
+    for (size_t i = 0; i < 4; i++)
+        regs[i] = (unsigned int) r[i];
+#else
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// which register states the OS saves on context switches (XCR0)
+static unsigned long long GetEnabledRegisterStates()
+{
+#ifdef _WIN32
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long) edx << 32) | eax;
+#endif
+}
+
+static VectorInstructionSet DetectVectorInstructionSet()
+{
+    unsigned int regs[4]; // eax, ebx, ecx, edx
+    CpuId(0, 0, regs);
+    const unsigned int maxLeaf = regs[0];
+    if (maxLeaf < 7)
+        return VectorInstructionSet::None;
+
+    CpuId(1, 0, regs);
+    const bool hasFMA = (regs[2] & (1u << 12)) != 0;
+    const bool hasOSXSAVE = (regs[2] & (1u << 27)) != 0;
+    const bool hasAVX = (regs[2] & (1u << 28)) != 0;
+    if (!hasFMA || !hasOSXSAVE || !hasAVX)
+        return VectorInstructionSet::None;
+
+    const unsigned long long xcr0 = GetEnabledRegisterStates();
+    const bool osSavesYmm = (xcr0 & 0x6) == 0x6;    // SSE and AVX state
+    const bool osSavesZmm = (xcr0 & 0xe6) == 0xe6;  // ... plus opmask and upper ZMM state
+    CpuId(7, 0, regs);
+    const bool hasAVX2 = (regs[1] & (1u << 5)) != 0;
+    const bool hasAVX512F = (regs[1] & (1u << 16)) != 0;
+
+    if (hasAVX512F && osSavesZmm && AVX512KernelsCompiled())
+        return VectorInstructionSet::AVX512;
+    if (hasAVX2 && osSavesYmm && AVX2KernelsCompiled())
+        return VectorInstructionSet::AVX2;
+    return VectorInstructionSet::None;
+}
+
+// -----------------------------------------------------------------------
+// settings
+// -----------------------------------------------------------------------
+
+static VectorMathMode s_vectorMathMode = VectorMathMode::Off;
+static VectorInstructionSet s_maxVectorInstructionSet = VectorInstructionSet::AVX512;
+
+VectorInstructionSet GetVectorInstructionSet()
+{
+    static const VectorInstructionSet detected = DetectVectorInstructionSet();
+    return std::min(detected, s_maxVectorInstructionSet);
+}
+
+void SetMaxVectorInstructionSet(VectorInstructionSet instructionSet)
+{
+    s_maxVectorInstructionSet = instructionSet;
+}
+
+void SetMaxVectorInstructionSet(const std::string& instructionSet)
+{
+    if (instructionSet == "avx512")
+        SetMaxVectorInstructionSet(VectorInstructionSet::AVX512);
+    else if (instructionSet == "avx2")
+        SetMaxVectorInstructionSet(VectorInstructionSet::AVX2);
+    else if (instructionSet == "none")
+        SetMaxVectorInstructionSet(VectorInstructionSet::None);
+    else
+        InvalidArgument("vectorInstructionSet: Invalid value '%s'; must be 'avx512', 'avx2', or 'none'.", instructionSet.c_str());
+}
+
+const char* VectorInstructionSetName(VectorInstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case VectorInstructionSet::AVX2:   return "AVX2";
+    case VectorInstructionSet::AVX512: return "AVX-512";
+    default:                           return "none";
+    }
+}
+
+void SetVectorMathMode(VectorMathMode mode)
+{
+    s_vectorMathMode = mode;
+}
+
+void SetVectorMathMode(const std::string& mode)
+{
+    if (mode == "off")
+        SetVectorMathMode(VectorMathMode::Off);
+    else if (mode == "accurate")
+        SetVectorMathMode(VectorMathMode::Accurate);
+    else if (mode == "fast")
+        SetVectorMathMode(VectorMathMode::Fast);
+    else
+        InvalidArgument("vectorMathMode: Invalid value '%s'; must be 'off', 'accurate', or 'fast'.", mode.c_str());
+}
+
+VectorMathMode GetVectorMathMode()
+{
+    return s_vectorMathMode;
+}
+
+// -----------------------------------------------------------------------
+// dispatch
+// -----------------------------------------------------------------------
+
+// the kernel for 'op', if there is one that may be used in the current mode
+// Exp, Log, Sigmoid and Tanh are approximations, which are only used if the mode asks for them.
+static bool GetVectorizedUnaryOp(ElementWiseOperator op, VectorizedOp& vectorizedOp)
+{
+    const bool approximate = s_vectorMathMode != VectorMathMode::Off;
+    switch (op)
+    {
+    case ElementWiseOperator::opCopy:            vectorizedOp = VectorizedOp::Copy;            return true;
+    case ElementWiseOperator::opLinearRectifier: vectorizedOp = VectorizedOp::LinearRectifier; return true;
+    case ElementWiseOperator::opExp:             vectorizedOp = VectorizedOp::Exp;             return approximate;
+    case ElementWiseOperator::opLog:             vectorizedOp = VectorizedOp::Log;             return approximate;
+    case ElementWiseOperator::opSigmoid:         vectorizedOp = VectorizedOp::Sigmoid;         return approximate;
+    case ElementWiseOperator::opTanh:            vectorizedOp = VectorizedOp::Tanh;            return approximate;
+    default:                                                                                   return false;
+    }
+}
+
+static bool GetVectorizedBinaryOp(ElementWiseOperator op, VectorizedOp& vectorizedOp)
+{
+    switch (op)
+    {
+    case ElementWiseOperator::opSum:                vectorizedOp = VectorizedOp::Sum;                return true;
+    case ElementWiseOperator::opDifference:         vectorizedOp = VectorizedOp::Difference;         return true;
+    case ElementWiseOperator::opElementwiseProduct: vectorizedOp = VectorizedOp::ElementwiseProduct; return true;
+    default:                                                                                         return false;
+    }
+}
+
+bool HasVectorizedUnaryTensorOp(ElementWiseOperator op)
+{
+    VectorizedOp vectorizedOp;
+    return GetVectorInstructionSet() != VectorInstructionSet::None && GetVectorizedUnaryOp(op, vectorizedOp);
+}
+
+bool HasVectorizedBinaryTensorOp(ElementWiseOperator op)
+{
+    VectorizedOp vectorizedOp;
+    return GetVectorInstructionSet() != VectorInstructionSet::None && GetVectorizedBinaryOp(op, vectorizedOp);
+}
+
+void VectorizedUnaryTensorOp(ElementWiseOperator op, float beta, const float* a, float* c, float alpha, size_t n)
+{
+    const bool fast = s_vectorMathMode == VectorMathMode::Fast;
+    VectorizedOp vectorizedOp;
+    bool done = false;
+    if (GetVectorizedUnaryOp(op, vectorizedOp))
+    {
+        switch (GetVectorInstructionSet())
+        {
+        case VectorInstructionSet::AVX512: done = AVX512UnaryTensorOp(vectorizedOp, beta, a, c, alpha, n, fast); break;
+        case VectorInstructionSet::AVX2:   done = AVX2UnaryTensorOp(vectorizedOp, beta, a, c, alpha, n, fast); break;
+        default: break;
+        }
+    }
+    if (!done)
+        LogicError("VectorizedUnaryTensorOp: No vectorized kernel for op code %d.", (int) op);
+}
+
+void VectorizedBinaryTensorOp(ElementWiseOperator op, float beta, const float* a, const float* b, float* c, float alpha, size_t n)
+{
+    VectorizedOp vectorizedOp;
+    bool done = false;
+    if (GetVectorizedBinaryOp(op, vectorizedOp))
+    {
+        switch (GetVectorInstructionSet())
+        {
+        case VectorInstructionSet::AVX512: done = AVX512BinaryTensorOp(vectorizedOp, beta, a, b, c, alpha, n); break;
+        case VectorInstructionSet::AVX2:   done = AVX2BinaryTensorOp(vectorizedOp, beta, a, b, c, alpha, n); break;
+        default: break;
+        }
+    }
+    if (!done)
+        LogicError("VectorizedBinaryTensorOp: No vectorized kernel for op code %d.", (int) op);
+}
+
+}}}
@@ -0,0 +1,66 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TensorOpsVectorized.h -- hand-vectorized (AVX2/AVX-512) CPU kernels for the hottest elementwise tensor operations
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <string>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// The generic CPU TensorOp code applies the ops of TensorOps.h one element at a time through a lambda,
+// which compilers do not vectorize. For contiguous float tensors, CPUMatrix::TensorOp() instead calls the
+// kernels declared here, which process 8 (AVX2) or 16 (AVX-512) elements at a time.
+// The instruction set is determined once at runtime through CPUID; on older CPUs the generic code is used.
+//
+// Supported ops:
+//  - unary:  Copy (i.e. scaled add c = beta * c + alpha * a), Sigmoid, Tanh, Exp, Log, LinearRectifier
+//  - binary: Sum, Difference, ElementwiseProduct
+// Copy, LinearRectifier and the binary ops give bit-identical results to the generic code, and are vectorized whenever
+// the CPU allows (see SetMaxVectorInstructionSet() to prevent that). Exp, Log, Sigmoid and Tanh use polynomial
+// approximations, which change results slightly, so they are only vectorized if VectorMathMode asks for it.
+// -----------------------------------------------------------------------
+
+enum class VectorInstructionSet
+{
+    None,  // no supported vector instruction set, or the kernels were not compiled in
+    AVX2,  // AVX2 + FMA
+    AVX512 // AVX-512F
+};
+
+enum class VectorMathMode
+{
+    Off,      // Exp, Log, Sigmoid and Tanh use the generic code; results are identical to the generic code (default)
+    Accurate, // Cephes-style polynomials, within a few ulps of the C runtime functions
+    Fast      // lower-degree polynomials: relative error up to about 6e-5 for exp() and sigmoid, 4e-6 for log(); absolute error up to 3e-5 for tanh()
+};
+
+// instruction set used by the vectorized kernels on this machine
+MATH_API VectorInstructionSet GetVectorInstructionSet();
+MATH_API const char* VectorInstructionSetName(VectorInstructionSet instructionSet);
+
+// caps the instruction set used, e.g. to avoid AVX-512 clock throttling; "avx512", "avx2", or "none" as a string
+// (e.g. from the 'vectorInstructionSet' config parameter)
+MATH_API void SetMaxVectorInstructionSet(VectorInstructionSet instructionSet);
+MATH_API void SetMaxVectorInstructionSet(const std::string& instructionSet);
+
+// global accuracy mode; "off", "accurate", or "fast" as a string (e.g. from the 'vectorMathMode' config parameter)
+MATH_API void SetVectorMathMode(VectorMathMode mode);
+MATH_API void SetVectorMathMode(const std::string& mode);
+MATH_API VectorMathMode GetVectorMathMode();
+
+// whether VectorizedUnaryTensorOp() resp. VectorizedBinaryTensorOp() can be used for 'op' in the current mode on this machine
+bool HasVectorizedUnaryTensorOp(ElementWiseOperator op);
+bool HasVectorizedBinaryTensorOp(ElementWiseOperator op);
+
+// c[i] = beta * c[i] + alpha * op(a[i]) for i < n (with c[i] not being read if beta == 0), resp. op(a[i], b[i])
+// Only valid if the corresponding Has...() function returned true. The arrays may be unaligned and c may alias a or b.
+void VectorizedUnaryTensorOp(ElementWiseOperator op, float beta, const float* a, float* c, float alpha, size_t n);
+void VectorizedBinaryTensorOp(ElementWiseOperator op, float beta, const float* a, const float* b, float* c, float alpha, size_t n);
+
+}}}
@@ -0,0 +1,265 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TensorOpsVectorizedKernels.h -- instruction-set independent implementation of the kernels in TensorOpsVectorized.h
+//
+// This is included by one source file per instruction set (TensorOpsAVX2.cpp, TensorOpsAVX512.cpp), each of which is
+// compiled with that instruction set enabled and defines a 'traits' class V that maps the operations used below to intrinsics:
+//   Reg, Mask, Width, Load, Store, Set, Add, Sub, Mul, Div, FMA (a * b + c), Min, Max, Less, Greater, IsInfOrNaN,
+//   Select (mask ? a : b), Abs, CopySign, Round (to nearest integer), Pow2 (2^n for integral n in [-126, 127]), Infinity,
+//   Exponent and Mantissa (x = Mantissa(x) * 2^Exponent(x), Mantissa in [0.5, 1), for positive normal x).
+// Min/Max must follow the x86 convention of returning the second operand if either operand is NaN.
+//
+// Everything compiled in those source files may end up as instruction-set specific code, including inline functions and
+// template instantiations of shared headers, which the compiler emits as weak (COMDAT) symbols. The linker keeps just one
+// of the copies from all object files, which may be the AVX-512 one, and generic code calling it would then crash on
+// CPUs without AVX-512. Hence this header includes nothing but C type definitions (in particular no C++ standard library
+// or CNTK headers), and the kernels are in an anonymous namespace. Only the entry points in the instruction-set specific
+// files are visible to the linker, and they are only called after the CPU has been checked.
+//
+
+#pragma once
+
+#include <stddef.h> // (size_t only)
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// the ops that have vectorized kernels (TensorOpsVectorized.cpp maps ElementWiseOperator to these)
+enum class VectorizedOp
+{
+    // unary
+    Copy, LinearRectifier, Exp, Log, Sigmoid, Tanh,
+    // binary
+    Sum, Difference, ElementwiseProduct
+};
+
+namespace {
+
+// EPS_IN_LOG and LOG_OF_EPS_IN_LOG from CommonMatrix.h, which cannot be included here
+const float c_epsInLog = 1e-37f;
+const float c_logOfEpsInLog = -85.1f;
+
+template <class V>
+struct VectorizedMath
+{
+    typedef typename V::Reg Reg;
+    typedef typename V::Mask Mask;
+
+    // exp(x), based on Cephes expf(): exp(x) = 2^n * exp(r) with r = x - n * log(2) in [-log(2)/2, log(2)/2]
+    // Results that would be denormal are flushed to 0.
+    static inline Reg Exp(Reg x, bool fast)
+    {
+        const Reg maxX = V::Set(88.7228391117f);   // log(FLT_MAX)
+        const Reg minX = V::Set(-87.3365447504f);  // log(FLT_MIN)
+        Reg xc = V::Max(minX, V::Min(maxX, x));    // (operand order lets a NaN in x pass through)
+        Reg n = V::Round(V::Mul(xc, V::Set(1.44269504088896341f)));
+        // r = x - n * log(2), with log(2) split into two parts for precision
+        Reg r = V::FMA(n, V::Set(-0.693359375f), xc);
+        r = V::FMA(n, V::Set(2.12194440e-4f), r);
+        Reg p;
+        if (fast) // Taylor series up to r^4
+        {
+            p = V::FMA(V::Set(1.0f / 24), r, V::Set(1.0f / 6));
+            p = V::FMA(p, r, V::Set(0.5f));
+        }
+        else // Cephes minimax polynomial
+        {
+            p = V::FMA(V::Set(1.9875691500E-4f), r, V::Set(1.3981999507E-3f));
+            p = V::FMA(p, r, V::Set(8.3334519073E-3f));
+            p = V::FMA(p, r, V::Set(4.1665795894E-2f));
+            p = V::FMA(p, r, V::Set(1.6666665459E-1f));
+            p = V::FMA(p, r, V::Set(5.0000001201E-1f));
+        }
+        p = V::FMA(p, V::Mul(r, r), V::Add(r, V::Set(1.0f)));
+        // scale by 2^n; n can be 128 near maxX, which is not representable by Pow2(), so scale by 2^(n-1) * 2 in that case
+        Reg n1 = V::Min(n, V::Set(127.0f));
+        Reg result = V::Mul(V::Mul(p, V::Pow2(n1)), V::Add(V::Set(1.0f), V::Sub(n, n1)));
+        // overflow and underflow
+        result = V::Select(V::Greater(x, maxX), V::Infinity(), result);
+        result = V::Select(V::Less(x, minX), V::Set(0.0f), result);
+        return result;
+    }
+
+    // log(x) for x > 0, based on Cephes logf(); inf and NaN are passed through
+    static inline Reg Log(Reg x, bool fast)
+    {
+        // x = m * 2^e with m in [sqrt(0.5), sqrt(2))
+        Reg e = V::Exponent(x);
+        Reg m = V::Mantissa(x);
+        Mask small = V::Less(m, V::Set(0.707106781186547524f));
+        e = V::Sub(e, V::Select(small, V::Set(1.0f), V::Set(0.0f)));
+        m = V::Add(m, V::Select(small, m, V::Set(0.0f)));
+        Reg result;
+        if (fast) // log(m) = 2 atanh(s) with s = (m - 1) / (m + 1), |s| < 0.172; series up to s^5
+        {
+            Reg s = V::Div(V::Sub(m, V::Set(1.0f)), V::Add(m, V::Set(1.0f)));
+            Reg s2 = V::Mul(s, s);
+            Reg p = V::FMA(s2, V::Set(2.0f / 5), V::Set(2.0f / 3));
+            p = V::FMA(p, s2, V::Set(2.0f));
+            result = V::FMA(e, V::Set(0.693147180559945f), V::Mul(p, s));
+        }
+        else // Cephes minimax polynomial for log(1 + y)
+        {
+            Reg y = V::Sub(m, V::Set(1.0f));
+            Reg z = V::Mul(y, y);
+            Reg p = V::FMA(V::Set(7.0376836292E-2f), y, V::Set(-1.1514610310E-1f));
+            p = V::FMA(p, y, V::Set(1.1676998740E-1f));
+            p = V::FMA(p, y, V::Set(-1.2420140846E-1f));
+            p = V::FMA(p, y, V::Set(1.4249322787E-1f));
+            p = V::FMA(p, y, V::Set(-1.6668057665E-1f));
+            p = V::FMA(p, y, V::Set(2.0000714765E-1f));
+            p = V::FMA(p, y, V::Set(-2.4999993993E-1f));
+            p = V::FMA(p, y, V::Set(3.3333331174E-1f));
+            Reg t = V::Mul(V::Mul(p, y), z);
+            t = V::FMA(e, V::Set(-2.12194440e-4f), t);
+            t = V::FMA(z, V::Set(-0.5f), t);
+            result = V::FMA(e, V::Set(0.693359375f), V::Add(y, t));
+        }
+        return V::Select(V::IsInfOrNaN(x), x, result);
+    }
+
+    // log(x), clipped like ClippedLog() in TensorOps.h
+    static inline Reg ClippedLog(Reg x, bool fast)
+    {
+        return V::Select(V::Less(x, V::Set(c_epsInLog)), V::Set(c_logOfEpsInLog), Log(x, fast));
+    }
+
+    // 1 / (1 + exp(-x)), same formula as Sigmoid() in TensorOps.h
+    static inline Reg Sigmoid(Reg x, bool fast)
+    {
+        const Reg one = V::Set(1.0f);
+        return V::Div(one, V::Add(Exp(V::Sub(V::Set(0.0f), x), fast), one));
+    }
+
+    // tanh(x) = 1 - 2 / (exp(2|x|) + 1) with the sign of x; near 0 (where this cancels) the Cephes tanhf() polynomial is used
+    static inline Reg Tanh(Reg x, bool fast)
+    {
+        const Reg one = V::Set(1.0f);
+        Reg ax = V::Abs(x);
+        Reg e = Exp(V::Add(ax, ax), fast);
+        Reg large = V::CopySign(V::Sub(one, V::Div(V::Set(2.0f), V::Add(e, one))), x);
+        if (fast)
+            return large;
+        Reg z = V::Mul(x, x);
+        Reg p = V::FMA(V::Set(-5.70498872745E-3f), z, V::Set(2.06390887954E-2f));
+        p = V::FMA(p, z, V::Set(-5.37397155531E-2f));
+        p = V::FMA(p, z, V::Set(1.33314422036E-1f));
+        p = V::FMA(p, z, V::Set(-3.33332819422E-1f));
+        Reg small = V::FMA(V::Mul(p, z), x, x);
+        return V::Select(V::Less(ax, V::Set(0.625f)), small, large);
+    }
+};
+
+// c = beta * c + alpha * opfn(a), in the same order of operations as TensorOpIteration<..., -1>
+template <class V>
+inline typename V::Reg ScaleAndAddResult(typename V::Reg val, float beta, const float* c, typename V::Reg alphaReg, typename V::Reg betaReg)
+{
+    val = V::Mul(val, alphaReg);
+    if (beta != 0)
+        val = V::Add(val, V::Mul(betaReg, V::Load(c)));
+    return val;
+}
+
+template <class V, typename OPFN>
+void VectorizedUnaryLoop(float beta, const float* a, float* c, float alpha, size_t n, const OPFN& opfn)
+{
+    typedef typename V::Reg Reg;
+    const Reg alphaReg = V::Set(alpha);
+    const Reg betaReg = V::Set(beta);
+    size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width)
+        V::Store(c + i, ScaleAndAddResult<V>(opfn(V::Load(a + i)), beta, c + i, alphaReg, betaReg));
+    if (i < n) // remainder: go through a padded buffer, so that it gets the same approximations as the rest
+    {
+        float bufA[V::Width], bufC[V::Width];
+        for (size_t j = 0; j < V::Width; j++)
+        {
+            bufA[j] = i + j < n ? a[i + j] : 1.0f;
+            bufC[j] = i + j < n && beta != 0 ? c[i + j] : 0.0f;
+        }
+        V::Store(bufC, ScaleAndAddResult<V>(opfn(V::Load(bufA)), beta, bufC, alphaReg, betaReg));
+        for (size_t j = 0; i + j < n; j++)
+            c[i + j] = bufC[j];
+    }
+}
+
+template <class V, typename OPFN>
+void VectorizedBinaryLoop(float beta, const float* a, const float* b, float* c, float alpha, size_t n, const OPFN& opfn)
+{
+    typedef typename V::Reg Reg;
+    const Reg alphaReg = V::Set(alpha);
+    const Reg betaReg = V::Set(beta);
+    size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width)
+        V::Store(c + i, ScaleAndAddResult<V>(opfn(V::Load(a + i), V::Load(b + i)), beta, c + i, alphaReg, betaReg));
+    if (i < n)
+    {
+        float bufA[V::Width], bufB[V::Width], bufC[V::Width];
+        for (size_t j = 0; j < V::Width; j++)
+        {
+            bufA[j] = i + j < n ? a[i + j] : 1.0f;
+            bufB[j] = i + j < n ? b[i + j] : 1.0f;
+            bufC[j] = i + j < n && beta != 0 ? c[i + j] : 0.0f;
+        }
+        V::Store(bufC, ScaleAndAddResult<V>(opfn(V::Load(bufA), V::Load(bufB)), beta, bufC, alphaReg, betaReg));
+        for (size_t j = 0; i + j < n; j++)
+            c[i + j] = bufC[j];
+    }
+}
+
+// entry points, to be called by the instruction-set specific source file
+// These return false if 'op' is not supported.
+template <class V>
+bool VectorizedUnaryTensorOpImpl(VectorizedOp op, float beta, const float* a, float* c, float alpha, size_t n, bool fast)
+{
+    typedef typename V::Reg Reg;
+    typedef VectorizedMath<V> M;
+    switch (op)
+    {
+    case VectorizedOp::Copy:
+        VectorizedUnaryLoop<V>(beta, a, c, alpha, n, [](Reg x) { return x; });
+        return true;
+    case VectorizedOp::LinearRectifier:
+        VectorizedUnaryLoop<V>(beta, a, c, alpha, n, [](Reg x) { return V::Max(x, V::Set(0.0f)); }); // (NaN -> 0 like 'a > 0 ? a : 0')
+        return true;
+    case VectorizedOp::Exp:
+        VectorizedUnaryLoop<V>(beta, a, c, alpha, n, [fast](Reg x) { return M::Exp(x, fast); });
+        return true;
+    case VectorizedOp::Log:
+        VectorizedUnaryLoop<V>(beta, a, c, alpha, n, [fast](Reg x) { return M::ClippedLog(x, fast); });
+        return true;
+    case VectorizedOp::Sigmoid:
+        VectorizedUnaryLoop<V>(beta, a, c, alpha, n, [fast](Reg x) { return M::Sigmoid(x, fast); });
+        return true;
+    case VectorizedOp::Tanh:
+        VectorizedUnaryLoop<V>(beta, a, c, alpha, n, [fast](Reg x) { return M::Tanh(x, fast); });
+        return true;
+    default:
+        return false;
+    }
+}
+
+template <class V>
+bool VectorizedBinaryTensorOpImpl(VectorizedOp op, float beta, const float* a, const float* b, float* c, float alpha, size_t n)
+{
+    typedef typename V::Reg Reg;
+    switch (op)
+    {
+    case VectorizedOp::Sum:
+        VectorizedBinaryLoop<V>(beta, a, b, c, alpha, n, [](Reg x, Reg y) { return V::Add(x, y); });
+        return true;
+    case VectorizedOp::Difference:
+        VectorizedBinaryLoop<V>(beta, a, b, c, alpha, n, [](Reg x, Reg y) { return V::Sub(x, y); });
+        return true;
+    case VectorizedOp::ElementwiseProduct:
+        VectorizedBinaryLoop<V>(beta, a, b, c, alpha, n, [](Reg x, Reg y) { return V::Mul(x, y); });
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // anonymous namespace
+
+}}}
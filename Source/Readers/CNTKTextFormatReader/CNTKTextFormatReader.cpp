@@ -21,7 +21,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // TODO: Currently preserving this for backward compatibility with current configs.
 CNTKTextFormatReader::CNTKTextFormatReader(MemoryProviderPtr provider,
     const ConfigParameters& config) :
-    m_provider(provider)
+    m_provider(provider),
+    m_bucketingLookahead(0)
 {
     TextConfigHelper configHelper(config);
 
@@ -46,7 +47,10 @@ CNTKTextFormatReader::CNTKTextFormatReader(MemoryProviderPtr provider,
         {
             // Verbosity is a general config parameter, not specific to the text format reader.
             int verbosity = config(L"verbosity", 0);
-            m_randomizer = make_shared<BlockRandomizer>(verbosity, window, m_deserializer);
+            // Background chunk loading, also a general config parameter.
+            size_t prefetchThreads = config(L"prefetchThreads", (size_t)0);
+            size_t prefetchChunks = config(L"prefetchChunks", prefetchThreads);
+            m_randomizer = make_shared<BlockRandomizer>(verbosity, window, m_deserializer, BlockRandomizer::DecimationMode::chunk, false, false, prefetchThreads, prefetchChunks);
         }
         else
         {
@@ -62,10 +66,13 @@ CNTKTextFormatReader::CNTKTextFormatReader(MemoryProviderPtr provider,
         }
         else
         {
-        m_packer = std::make_shared<SequencePacker>(
-            m_provider,
-            m_randomizer,
-            GetStreamDescriptions());
+            // Lookahead in minibatches for grouping sequences of similar length, a general config parameter.
+            m_bucketingLookahead = config(L"bucketingLookahead", (size_t)0);
+            m_packer = std::make_shared<SequencePacker>(
+                m_provider,
+                m_randomizer,
+                GetStreamDescriptions(),
+                m_bucketingLookahead);
         }
     }
     catch (const std::runtime_error& e)
@@ -95,4 +102,22 @@ Minibatch CNTKTextFormatReader::ReadMinibatch()
     assert(m_packer != nullptr);
     return m_packer->ReadMinibatch();
 }
+
+// With bucketing, each worker reports the position of its own oldest buffered sequence.
+bool CNTKTextFormatReader::IsSamplePositionSharedByWorkers() const
+{
+    return m_bucketingLookahead == 0;
+}
+
+size_t CNTKTextFormatReader::GetCurrentSamplePosition()
+{
+    assert(m_packer != nullptr);
+    return m_packer->GetCurrentSamplePosition();
+}
+
+void CNTKTextFormatReader::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    assert(m_packer != nullptr);
+    m_packer->SetCurrentSamplePosition(currentSamplePosition);
+}
 } } }
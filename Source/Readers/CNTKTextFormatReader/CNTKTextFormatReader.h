@@ -30,6 +30,11 @@ public:
     // Reads a single minibatch.
     Minibatch ReadMinibatch() override;
 
+    // Gets/sets the sample position of the next minibatch, used to resume an epoch from a checkpoint.
+    bool IsSamplePositionSharedByWorkers() const override;
+    size_t GetCurrentSamplePosition() override;
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
 private:
     IDataDeserializerPtr m_deserializer;
 
@@ -39,6 +44,9 @@ private:
     // Packer.
     PackerPtr m_packer;
 
+    // Number of minibatches worth of sequences to look ahead for bucketing, 0 if bucketing is off.
+    size_t m_bucketingLookahead;
+
     // Memory provider (TODO: this will possibly change in the near future.)
     MemoryProviderPtr m_provider;
 };
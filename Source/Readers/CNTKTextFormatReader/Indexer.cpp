@@ -6,15 +6,46 @@
 #include "stdafx.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
 #include "Indexer.h"
 #include "TextReaderConstants.h"
+#include "fileutil.h"
 
 using std::string;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Index cache file format: a header (tag, version, input file size and modification time,
+// whether sequence ids were skipped during indexing, whether the input has sequence ids),
+// followed by the number of sequences and one CachedSequence record per sequence.
+static const char* c_indexCacheTag = "CTFI";
+static const uint32_t c_indexCacheVersion = 2;
+
+// Retrieves the size and the modification time of a file, returns false if they cannot be determined.
+static bool TryGetFileStamp(const wstring& path, int64_t& size, int64_t& modificationTime)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attributes))
+        return false;
+    size = ((int64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    modificationTime = ((int64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat buf;
+    if (stat(wtocharpath(path.c_str()).c_str(), &buf) != 0)
+        return false;
+    size = buf.st_size;
+    modificationTime = (int64_t)buf.st_mtim.tv_sec * 1000000000 + buf.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
 Indexer::Indexer(FILE* file, bool skipSequenceIds, size_t chunkSize) :
     m_file(file),
+    m_mappedData(nullptr),
+    m_mappedSize(0),
     m_fileOffsetStart(0),
     m_fileOffsetEnd(0),
     m_buffer(new char[BUFFER_SIZE + 1]),
@@ -22,6 +53,7 @@ Indexer::Indexer(FILE* file, bool skipSequenceIds, size_t chunkSize) :
     m_bufferEnd(nullptr),
     m_pos(nullptr),
     m_done(false),
+    m_skipSequenceIds(skipSequenceIds),
     m_hasSequenceIds(!skipSequenceIds),
     m_index(chunkSize)
 {
@@ -31,9 +63,45 @@ Indexer::Indexer(FILE* file, bool skipSequenceIds, size_t chunkSize) :
     }
 }
 
+Indexer::Indexer(const char* data, size_t size, bool skipSequenceIds, size_t chunkSize) :
+    m_file(nullptr),
+    m_mappedData(data),
+    m_mappedSize(size),
+    m_fileOffsetStart(0),
+    m_fileOffsetEnd(0),
+    m_bufferStart(nullptr),
+    m_bufferEnd(nullptr),
+    m_pos(nullptr),
+    m_done(false),
+    m_skipSequenceIds(skipSequenceIds),
+    m_hasSequenceIds(!skipSequenceIds),
+    m_index(chunkSize)
+{
+    if (m_mappedData == nullptr && m_mappedSize != 0)
+    {
+        RuntimeError("Input file not mapped into memory");
+    }
+}
+
 void Indexer::RefillBuffer()
 {
-    if (!m_done)
+    if (m_file == nullptr)
+    {
+        // The whole file is already in memory, it is 'read' in one go.
+        if (m_done || m_fileOffsetEnd == (int64_t)m_mappedSize)
+        {
+            m_done = true;
+        }
+        else
+        {
+            m_fileOffsetStart = 0;
+            m_fileOffsetEnd = m_mappedSize;
+            m_bufferStart = m_mappedData;
+            m_pos = m_bufferStart;
+            m_bufferEnd = m_bufferStart + m_mappedSize;
+        }
+    }
+    else if (!m_done)
     {
         size_t bytesRead = fread(m_buffer.get(), 1, BUFFER_SIZE, m_file);
         if (bytesRead == (size_t)-1)
@@ -98,7 +166,24 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
         return;
     }
 
-    m_index.Reserve(filesize(m_file));
+    if (!m_inputFilePath.empty() && TryLoadCache(corpus))
+    {
+        return;
+    }
+
+    BuildFromInput(corpus);
+
+    if (!m_inputFilePath.empty())
+    {
+        SaveCache();
+        m_cachedSequences.clear();
+        m_cachedSequences.shrink_to_fit();
+    }
+}
+
+void Indexer::BuildFromInput(CorpusDescriptorPtr corpus)
+{
+    m_index.Reserve(m_file ? filesize(m_file) : m_mappedSize);
 
     RefillBuffer(); // read the first block of data
     if (m_done)
@@ -160,6 +245,11 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
 
 void Indexer::AddSequenceIfIncluded(CorpusDescriptorPtr corpus, size_t sequenceKey, SequenceDescriptor& sd)
 {
+    if (!m_inputFilePath.empty())
+    {
+        m_cachedSequences.push_back({ sequenceKey, sd.m_fileOffsetBytes, sd.m_byteSize, sd.m_numberOfSamples });
+    }
+
     auto& stringRegistry = corpus->GetStringRegistry();
     auto key = std::to_string(sequenceKey);
     if (corpus->IsIncluded(key))
@@ -170,6 +260,123 @@ void Indexer::AddSequenceIfIncluded(CorpusDescriptorPtr corpus, size_t sequenceK
     }
 }
 
+bool Indexer::TryLoadCache(CorpusDescriptorPtr corpus)
+{
+    int64_t inputSize, inputModificationTime;
+    if (!TryGetFileStamp(m_inputFilePath, inputSize, inputModificationTime))
+    {
+        return false;
+    }
+
+    const wstring cachePath = GetCacheFilePath(m_inputFilePath);
+    FILE* f = _wfopen(cachePath.c_str(), L"rb");
+    if (f == nullptr)
+    {
+        return false;
+    }
+
+    vector<CachedSequence> sequences;
+    bool hasSequenceIds = false;
+    bool valid = false;
+    try
+    {
+        char tag[4];
+        uint32_t version;
+        int64_t size, modificationTime;
+        uint8_t skipIds, hasIds;
+        uint64_t numberOfSequences;
+        freadOrDie(tag, sizeof(tag), 1, f);
+        fget(f, version);
+        fget(f, size);
+        fget(f, modificationTime);
+        fget(f, skipIds);
+        fget(f, hasIds);
+        fget(f, numberOfSequences);
+
+        // The cached index is only valid for the same input file, indexed in the same mode:
+        // with sequence ids a sequence can span several lines, without them every line
+        // is a sequence of its own. The chunk layout is not cached,
+        // it is recomputed from the sequences below (the chunk size might have changed).
+        valid = memcmp(tag, c_indexCacheTag, sizeof(tag)) == 0 &&
+                version == c_indexCacheVersion &&
+                size == inputSize &&
+                modificationTime == inputModificationTime &&
+                (skipIds != 0) == m_skipSequenceIds &&
+                numberOfSequences <= (uint64_t)inputSize;
+
+        if (valid)
+        {
+            sequences.resize(numberOfSequences);
+            freadOrDie(sequences, sequences.size(), f);
+            hasSequenceIds = hasIds != 0;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Could not read the index cache file (%ls), the index will be rebuilt: %s\n", cachePath.c_str(), e.what());
+        valid = false;
+    }
+    fclose(f);
+
+    if (!valid || sequences.empty())
+    {
+        return false;
+    }
+
+    m_hasSequenceIds = hasSequenceIds;
+    m_index.Reserve(inputSize);
+    for (const auto& s : sequences)
+    {
+        SequenceDescriptor sd = {};
+        sd.m_fileOffsetBytes = s.m_fileOffsetBytes;
+        sd.m_byteSize = s.m_byteSize;
+        sd.m_numberOfSamples = s.m_numberOfSamples;
+        AddSequenceIfIncluded(corpus, s.m_key, sd);
+    }
+
+    m_cachedSequences.clear();
+    m_cachedSequences.shrink_to_fit();
+    return true;
+}
+
+void Indexer::SaveCache()
+{
+    int64_t inputSize, inputModificationTime;
+    if (!TryGetFileStamp(m_inputFilePath, inputSize, inputModificationTime) || inputSize != m_fileOffsetEnd)
+    {
+        return; // the input file changed while it was indexed
+    }
+
+    // Write to a temporary file first, so that a concurrent reader never sees a partially written cache.
+    const wstring cachePath = GetCacheFilePath(m_inputFilePath);
+    const wstring tempPath = cachePath + L".tmp";
+    FILE* f = nullptr;
+    try
+    {
+        f = fopenOrDie(tempPath, L"wb");
+        fwriteOrDie(c_indexCacheTag, 4, 1, f);
+        fput(f, c_indexCacheVersion);
+        fput(f, inputSize);
+        fput(f, inputModificationTime);
+        fput(f, (uint8_t)(m_skipSequenceIds ? 1 : 0));
+        fput(f, (uint8_t)(m_hasSequenceIds ? 1 : 0));
+        fput(f, (uint64_t)m_cachedSequences.size());
+        fwriteOrDie(m_cachedSequences, f);
+        fcloseOrDie(f);
+        f = nullptr;
+        renameOrDie(tempPath, cachePath);
+    }
+    catch (const std::exception& e)
+    {
+        if (f != nullptr)
+        {
+            fclose(f);
+            _wunlink(tempPath.c_str());
+        }
+        fprintf(stderr, "WARNING: Could not write the index cache file (%ls): %s\n", cachePath.c_str(), e.what());
+    }
+}
+
 void Indexer::SkipLine()
 {
     while (!m_done)
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <string>
 #include <vector>
 #include "Descriptors.h"
 #include "CorpusDescriptor.h"
@@ -22,10 +23,25 @@ class Indexer
 public:
     Indexer(FILE* file, bool skipSequenceIds = false, size_t chunkSize = 32 * 1024 * 1024);
 
+    // Same as above, but indexes the input file contents mapped into memory
+    // (size bytes starting at data), without copying them into an intermediate buffer.
+    Indexer(const char* data, size_t size, bool skipSequenceIds = false, size_t chunkSize = 32 * 1024 * 1024);
+
     // Reads the input file, building and index of chunks and corresponding
-    // sequences.
+    // sequences. If a cache file was specified (see SetCacheFile), the index is
+    // restored from it when it is up to date, otherwise the index is built
+    // as usual and then written to the cache file.
     void Build(CorpusDescriptorPtr corpus);
 
+    // Enables persisting the index in a sidecar file next to the given input file
+    // (see GetCacheFilePath). The cache file is only reused if the size and
+    // the modification time of the input file match the ones recorded in it,
+    // and if it was built with the same skipSequenceIds setting.
+    void SetCacheFile(const std::wstring& inputFilePath) { m_inputFilePath = inputFilePath; }
+
+    // Returns the path of the index cache file for the given input file.
+    static std::wstring GetCacheFilePath(const std::wstring& inputFilePath) { return inputFilePath + L".idx"; }
+
     // Returns input data index (chunk and sequence metadata)
     const Index& GetIndex() const { return m_index; }
 
@@ -37,6 +53,10 @@ public:
 private:
     FILE* m_file;
 
+    // input file contents, when the file is mapped into memory (m_file is nullptr then).
+    const char* m_mappedData;
+    size_t m_mappedSize;
+
     int64_t m_fileOffsetStart;
     int64_t m_fileOffsetEnd;
 
@@ -47,12 +67,38 @@ private:
 
     bool m_done; // true, when all input was processed
 
+    const bool m_skipSequenceIds; // the indexing mode, as passed to the constructor
+
     bool m_hasSequenceIds; // true, when input contains one sequence per line 
                            // or when sequence id column was ignored during indexing.
 
     // a collection of chunk descriptors and sequence keys.
     Index m_index;
 
+    // A sequence as found in the input file, before the corpus filtering is applied.
+    // This is what is written to the index cache file (one record per sequence).
+    struct CachedSequence
+    {
+        uint64_t m_key;
+        int64_t m_fileOffsetBytes;
+        uint64_t m_byteSize;
+        uint64_t m_numberOfSamples;
+    };
+
+    // Path of the input file, whose index should be cached (empty if caching is disabled).
+    std::wstring m_inputFilePath;
+
+    // All sequences found in the input file, only collected if caching is enabled.
+    std::vector<CachedSequence> m_cachedSequences;
+
+    // Restores the index from the cache file, returns false if the file
+    // does not exist, cannot be read or is out of date.
+    bool TryLoadCache(CorpusDescriptorPtr corpus);
+
+    // Writes the sequences collected during Build() into the cache file.
+    // Failures are not fatal, the index is simply rebuilt next time.
+    void SaveCache();
+
     // Same function as above but with check that the sequence is included in the corpus descriptor.
     void AddSequenceIfIncluded(CorpusDescriptorPtr corpus, size_t sequenceKey, SequenceDescriptor& sd);
 
@@ -78,6 +124,9 @@ private:
     // Returns current offset in the input file (in bytes). 
     int64_t GetFileOffset() const { return m_fileOffsetStart + (m_pos - m_bufferStart); }
 
+    // Builds the index by scanning the input file.
+    void BuildFromInput(CorpusDescriptorPtr corpus);
+
     DISABLE_COPY_AND_MOVE(Indexer);
 };
 
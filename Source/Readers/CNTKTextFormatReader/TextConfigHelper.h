@@ -39,6 +39,10 @@ public:
 
     bool IsInFrameMode() const { return m_frameMode; }
 
+    bool ShouldUseMemoryMapping() const { return m_useMemoryMapping; }
+
+    bool ShouldCacheIndex() const { return m_cacheIndex; }
+
     ElementType GetElementType() const { return m_elementType; }
 
     DISABLE_COPY_AND_MOVE(TextConfigHelper);
@@ -54,6 +58,8 @@ private:
     size_t m_chunkSizeBytes; // chunks size in bytes
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
+    bool m_useMemoryMapping; // if true, the input file is mapped into memory and parsed in place.
+    bool m_cacheIndex; // if true, the index of the input file is persisted in a sidecar file.
 };
 
 } } }
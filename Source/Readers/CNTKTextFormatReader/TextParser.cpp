@@ -21,6 +21,42 @@ inline bool IsDigit(char c)
     return '0' <= c && c <= '9';
 }
 
+// Returns true if the 8 characters starting at p are all decimal digits (SWAR, i.e.,
+// all 8 characters are checked at once within a 64-bit register).
+inline bool IsEightDigits(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return ((v & 0xF0F0F0F0F0F0F0F0ULL) | (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL;
+}
+
+// Converts 8 decimal digits starting at p to their value (SWAR, 3 multiplications instead of 8).
+inline uint64_t ParseEightDigits(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v)); // (little-endian: p[0], the most significant digit, is the lowest byte)
+    v -= 0x3030303030303030ULL;
+    v = (v * 10) + (v >> 8); // pairs of digits
+    return (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+            (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+}
+
+// Given the first digit of a number at p, accumulates the 8 characters following it in one go
+// (number = number * 10^8 + digits), if they are all digits within [p + 1, end).
+// Integers below 2^53 are exact in double precision, so the result is bit-exact with accumulating
+// the digits one by one (number = number * 10 + digit), as done by TextParser::TryReadRealNumber.
+// Returns the number of characters consumed (0 or 8).
+inline size_t TryAccumulateEightDigits(const char* p, const char* end, double& number)
+{
+    if (end - p <= 8 || !IsEightDigits(p + 1))
+    {
+        return 0;
+    }
+
+    number = number * 1e8 + (double)ParseEightDigits(p + 1);
+    return 8;
+}
+
 enum State
 {
     Init = 0,
@@ -72,6 +108,8 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams())
     SetMaxAllowedErrors(helper.GetMaxAllowedErrors());
     SetChunkSize(helper.GetChunkSize());
     SetSkipSequenceIds(helper.ShouldSkipSequenceIds());
+    SetMemoryMapping(helper.ShouldUseMemoryMapping());
+    SetCacheIndex(helper.ShouldCacheIndex());
 
     Initialize();
 }
@@ -95,6 +133,8 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_numAllowedErrors(0),
     m_skipSequenceIds(false),
     m_numRetries(5),
+    m_useMemoryMapping(false),
+    m_cacheIndex(false),
     m_corpus(corpus)
 {
     assert(streams.size() > 0);
@@ -151,6 +191,12 @@ void TextParser<ElemType>::Initialize()
         return;
     }
 
+    if (m_useMemoryMapping)
+    {
+        InitializeMemoryMapped();
+        return;
+    }
+
     attempt(m_numRetries, [this]()
     {
         if (m_file == nullptr)
@@ -172,6 +218,10 @@ void TextParser<ElemType>::Initialize()
         }
 
         m_indexer = make_unique<Indexer>(m_file, m_skipSequenceIds, m_chunkSizeBytes);
+        if (m_cacheIndex)
+        {
+            m_indexer->SetCacheFile(m_filename);
+        }
 
         m_indexer->Build(m_corpus);
     });
@@ -188,6 +238,41 @@ void TextParser<ElemType>::Initialize()
     m_fileOffsetEnd = position;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::InitializeMemoryMapped()
+{
+    attempt(m_numRetries, [this]()
+    {
+        m_mappedFile = make_unique<MemoryMappedFile>(m_filename);
+
+        const char* data = m_mappedFile->Data();
+        if (m_mappedFile->Size() >= 2 && data[0] == '\xFF' && data[1] == '\xFE')
+        {
+            // Retrying won't help here, the file is UTF-16 encoded.
+            m_numRetries = 0;
+            RuntimeError("Found a UTF-16 BOM at the beginning of the input file (%ls). "
+                "UTF-16 encoding is currently not supported.", m_filename.c_str());
+        }
+
+        m_indexer = make_unique<Indexer>(data, m_mappedFile->Size(), m_skipSequenceIds, m_chunkSizeBytes);
+        if (m_cacheIndex)
+        {
+            m_indexer->SetCacheFile(m_filename);
+        }
+
+        m_indexer->Build(m_corpus);
+    });
+
+    assert(m_indexer != nullptr);
+
+    // The whole file is the buffer, no refills or seeks are ever needed.
+    m_fileOffsetStart = 0;
+    m_fileOffsetEnd = m_mappedFile->Size();
+    m_bufferStart = m_mappedFile->Data();
+    m_bufferEnd = m_bufferStart + m_mappedFile->Size();
+    m_pos = m_bufferStart;
+}
+
 template <class ElemType>
 ChunkDescriptions TextParser<ElemType>::GetChunkDescriptions()
 {
@@ -252,6 +337,20 @@ ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
     const auto& chunkDescriptor = m_indexer->GetIndex().m_chunks[chunkId];
     auto textChunk = make_shared<TextDataChunk>(chunkDescriptor, this);
 
+    if (m_mappedFile)
+    {
+        // Ask the OS to page in the whole chunk upfront rather than faulting on every page.
+        if (!chunkDescriptor.m_sequences.empty())
+        {
+            const auto& last = chunkDescriptor.m_sequences.back();
+            int64_t start = chunkDescriptor.m_sequences.front().m_fileOffsetBytes;
+            m_mappedFile->WillNeed(start, last.m_fileOffsetBytes + last.m_byteSize - start);
+        }
+
+        LoadChunk(textChunk, chunkDescriptor);
+        return textChunk;
+    }
+
     attempt(m_numRetries, [this, &textChunk, &chunkDescriptor]()
     {
         if (ferror(m_file) != 0)
@@ -291,6 +390,12 @@ void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 template <class ElemType>
 bool TextParser<ElemType>::TryRefillBuffer()
 {
+    if (m_mappedFile)
+    {
+        // The whole file is mapped, there is nothing left to read.
+        return false;
+    }
+
     size_t bytesRead = fread(m_buffer.get(), 1, BUFFER_SIZE, m_file);
 
     if (bytesRead == (size_t)-1)
@@ -315,6 +420,13 @@ bool TextParser<ElemType>::TryRefillBuffer()
 template <class ElemType>
 void TextParser<ElemType>::SetFileOffset(int64_t offset)
 {
+    if (m_mappedFile)
+    {
+        // All offsets are within the buffer, see LoadSequence.
+        assert(offset >= m_fileOffsetStart && offset <= m_fileOffsetEnd);
+        return;
+    }
+
     int rc = _fseeki64(m_file, offset, SEEK_SET);
     if (rc)
     {
@@ -918,31 +1030,53 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
     bool found = false;
     while (bytesToRead && CanRead())
     {
-        char c = *m_pos;
+        // Parse straight from the buffer up to its end or the end of the sequence (whichever comes first),
+        // m_pos and bytesToRead are only updated when leaving this range.
+        const char* pos = m_pos;
+        const char* end = m_pos + std::min(bytesToRead, (size_t)(m_bufferEnd - m_pos));
+        auto commit = [&]()
+        {
+            bytesToRead -= pos - m_pos;
+            m_pos = pos;
+        };
 
-        if (!IsDigit(c))
+        if (!found && end - pos > 8 && IsEightDigits(pos))
         {
-            return found;
+            // a value of up to 19 digits cannot overflow, so the first 8 can be taken in one go.
+            value = ParseEightDigits(pos);
+            found = true;
+            pos += 8;
         }
 
-        found |= true;
-
-        size_t temp = value;
-        value = value * 10 + (c - '0');
-        if (temp > value)
+        for (; pos != end; ++pos)
         {
-            if (ShouldWarn())
+            char c = *pos;
+
+            if (!IsDigit(c))
             {
-                fprintf(stderr,
-                    "WARNING: Overflow while reading a uint64 value %ls.\n",
-                    GetFileInfo().c_str());
+                commit();
+                return found;
             }
 
-            return false;
+            found |= true;
+
+            size_t temp = value;
+            value = value * 10 + (c - '0');
+            if (temp > value)
+            {
+                commit();
+                if (ShouldWarn())
+                {
+                    fprintf(stderr,
+                        "WARNING: Overflow while reading a uint64 value %ls.\n",
+                        GetFileInfo().c_str());
+                }
+
+                return false;
+            }
         }
 
-        ++m_pos;
-        --bytesToRead;
+        commit();
     }
 
     if (ShouldWarn())
@@ -972,177 +1106,208 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
 
     while (bytesToRead && CanRead())
     {
-        char c = *m_pos;
+        // Parse straight from the buffer up to its end or the end of the sequence (whichever comes first),
+        // m_pos and bytesToRead are only updated when leaving this range.
+        const char* pos = m_pos;
+        const char* end = m_pos + std::min(bytesToRead, (size_t)(m_bufferEnd - m_pos));
+        auto commit = [&]()
+        {
+            bytesToRead -= pos - m_pos;
+            m_pos = pos;
+        };
 
-        switch (state)
+        for (; pos != end; ++pos)
         {
-        case State::Init:
-            // the number must either start with a number or a sign
-            if (IsDigit(c))
-            {
-                state = IntegralPart;
-                number = (c - '0');
-            }
-            else if (isSign(c))
-            {
-                state = Sign;
-                negative = (c == '-');
-            }
-            else
+            char c = *pos;
+
+            switch (state)
             {
-                if (ShouldWarn())
+            case State::Init:
+                // the number must either start with a number or a sign
+                if (IsDigit(c))
                 {
-                    fprintf(stderr,
-                        "WARNING: Unexpected character ('%c')"
-                        " in a floating point value %ls.\n",
-                        c, GetFileInfo().c_str());
+                    state = IntegralPart;
+                    number = (c - '0');
+                    // take the following digits in one go, if possible.
+                    pos += TryAccumulateEightDigits(pos, end, number);
                 }
-                return false;
-            }
-            break;
-        case Sign:
-            // the sign must be followed by a number
-            if (IsDigit(c))
-            {
-                state = IntegralPart;
-                number = (c - '0');
-            }
-            else
-            {
-                if (ShouldWarn())
+                else if (isSign(c))
                 {
-                    fprintf(stderr,
-                        "WARNING: A sign symbol is followed by an invalid character('%c')"
-                        " in a floating point value %ls.\n",
-                        c, GetFileInfo().c_str());
+                    state = Sign;
+                    negative = (c == '-');
                 }
-                return false;
-            }
-            break;
-        case IntegralPart:
-            if (IsDigit(c))
-            {
-                number = number * 10 + (c - '0');
-            }
-            else if (c == '.')
-            {
-                state = Period;
-            }
-            else if (isE(c))
-            {
-                state = TheLetterE;
-                coefficient = (negative) ? -number : number;
-                number = 0;
-            }
-            else
-            {
-                value = static_cast<ElemType>((negative) ? -number : number);
-                return true;
-            }
-            break;
-        case Period:
-            if (IsDigit(c))
-            {
-                state = FractionalPart;
-                coefficient = number;
-                number = (c - '0');
-                divider = 10;
-            }
-            else
-            {
-                value = static_cast<ElemType>((negative) ? -number : number);
-                return true;
-            }
-            break;
-        case FractionalPart:
-            if (IsDigit(c))
-            {
-                // TODO: ignore if number of precision digits > FLT_[MANT_]DIG/DBL_[MANT_]DIG
-                // no state change
-                number = number * 10 + (c - '0');
-                divider *= 10;
-            }
-            else if (isE(c))
-            {
-                state = TheLetterE;
-                coefficient += (number / divider);
-                if (negative)
+                else
                 {
-                    coefficient = -coefficient;
+                    commit();
+                    if (ShouldWarn())
+                    {
+                        fprintf(stderr,
+                            "WARNING: Unexpected character ('%c')"
+                            " in a floating point value %ls.\n",
+                            c, GetFileInfo().c_str());
+                    }
+                    return false;
                 }
-            }
-            else
-            {
-                coefficient += (number / divider);
-                value = static_cast<ElemType>((negative) ? -coefficient : coefficient);
-                return true;
-            }
-            break;
-        case TheLetterE:
-            // followed with optional minus or plus sign and nonempty sequence of decimal digits
-            if (IsDigit(c))
-            {
-                state = Exponent;
-                negative = false;
-                number = (c - '0');
-            }
-            else if (isSign(c))
-            {
-                state = ExponentSign;
-                negative = (c == '-');
-            }
-            else
-            {
-                if (ShouldWarn())
+                break;
+            case Sign:
+                // the sign must be followed by a number
+                if (IsDigit(c))
                 {
-                    fprintf(stderr,
-                        "WARNING: An exponent symbol is followed by"
-                        " an invalid character('%c')"
-                        " in a floating point value %ls.\n", c, GetFileInfo().c_str());
+                    state = IntegralPart;
+                    number = (c - '0');
+                    // take the following digits in one go, if possible.
+                    pos += TryAccumulateEightDigits(pos, end, number);
                 }
-                return false;
-            }
-            break;
-        case ExponentSign:
-            // exponent sign must be followed by a number
-            if (IsDigit(c))
-            {
-                state = Exponent;
-                number = (c - '0');
-            }
-            else
-            {
-                if (ShouldWarn())
+                else
                 {
-                    fprintf(stderr,
-                        "WARNING: An exponent sign symbol followed by"
-                        " an unexpected character('%c')"
-                        " in a floating point value %ls.\n", c, GetFileInfo().c_str());
+                    commit();
+                    if (ShouldWarn())
+                    {
+                        fprintf(stderr,
+                            "WARNING: A sign symbol is followed by an invalid character('%c')"
+                            " in a floating point value %ls.\n",
+                            c, GetFileInfo().c_str());
+                    }
+                    return false;
                 }
-                return false;
-            }
-            break;
-        case Exponent:
-            if (IsDigit(c))
-            {
-                // no state change
-                number = number * 10 + (c - '0');
-            }
-            else
-            {
-                // TODO: check the exponent value (see FLT_[MAX/MIN]_10_EXP).
-                double exponent = (negative) ? -number : number;
-                value = static_cast<ElemType>(coefficient * pow(10.0, exponent));
-                return true;
+                break;
+            case IntegralPart:
+                if (IsDigit(c))
+                {
+                    number = number * 10 + (c - '0');
+                }
+                else if (c == '.')
+                {
+                    state = Period;
+                }
+                else if (isE(c))
+                {
+                    state = TheLetterE;
+                    coefficient = (negative) ? -number : number;
+                    number = 0;
+                }
+                else
+                {
+                    commit();
+                    value = static_cast<ElemType>((negative) ? -number : number);
+                    return true;
+                }
+                break;
+            case Period:
+                if (IsDigit(c))
+                {
+                    state = FractionalPart;
+                    coefficient = number;
+                    number = (c - '0');
+                    divider = 10;
+                    // take the following digits in one go, if possible.
+                    if (TryAccumulateEightDigits(pos, end, number))
+                    {
+                        divider *= 1e8; // (exact, same as multiplying by 10 eight times)
+                        pos += 8;
+                    }
+                }
+                else
+                {
+                    commit();
+                    value = static_cast<ElemType>((negative) ? -number : number);
+                    return true;
+                }
+                break;
+            case FractionalPart:
+                if (IsDigit(c))
+                {
+                    // TODO: ignore if number of precision digits > FLT_[MANT_]DIG/DBL_[MANT_]DIG
+                    // no state change
+                    number = number * 10 + (c - '0');
+                    divider *= 10;
+                }
+                else if (isE(c))
+                {
+                    state = TheLetterE;
+                    coefficient += (number / divider);
+                    if (negative)
+                    {
+                        coefficient = -coefficient;
+                    }
+                }
+                else
+                {
+                    commit();
+                    coefficient += (number / divider);
+                    value = static_cast<ElemType>((negative) ? -coefficient : coefficient);
+                    return true;
+                }
+                break;
+            case TheLetterE:
+                // followed with optional minus or plus sign and nonempty sequence of decimal digits
+                if (IsDigit(c))
+                {
+                    state = Exponent;
+                    negative = false;
+                    number = (c - '0');
+                }
+                else if (isSign(c))
+                {
+                    state = ExponentSign;
+                    negative = (c == '-');
+                }
+                else
+                {
+                    commit();
+                    if (ShouldWarn())
+                    {
+                        fprintf(stderr,
+                            "WARNING: An exponent symbol is followed by"
+                            " an invalid character('%c')"
+                            " in a floating point value %ls.\n", c, GetFileInfo().c_str());
+                    }
+                    return false;
+                }
+                break;
+            case ExponentSign:
+                // exponent sign must be followed by a number
+                if (IsDigit(c))
+                {
+                    state = Exponent;
+                    number = (c - '0');
+                }
+                else
+                {
+                    commit();
+                    if (ShouldWarn())
+                    {
+                        fprintf(stderr,
+                            "WARNING: An exponent sign symbol followed by"
+                            " an unexpected character('%c')"
+                            " in a floating point value %ls.\n", c, GetFileInfo().c_str());
+                    }
+                    return false;
+                }
+                break;
+            case Exponent:
+                if (IsDigit(c))
+                {
+                    // no state change
+                    number = number * 10 + (c - '0');
+                }
+                else
+                {
+                    commit();
+                    // TODO: check the exponent value (see FLT_[MAX/MIN]_10_EXP).
+                    double exponent = (negative) ? -number : number;
+                    value = static_cast<ElemType>(coefficient * pow(10.0, exponent));
+                    return true;
+                }
+                break;
+            default:
+                commit();
+                LogicError("Reached an invalid state while reading a floating point value %ls.\n",
+                    GetFileInfo().c_str());
             }
-            break;
-        default:
-            LogicError("Reached an invalid state while reading a floating point value %ls.\n",
-                GetFileInfo().c_str());
         }
 
-        ++m_pos;
-        --bytesToRead;
+        commit();
     }
 
     if (ShouldWarn())
@@ -1185,6 +1350,18 @@ void TextParser<ElemType>::SetNumRetries(unsigned int numRetries)
     m_numRetries = numRetries;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::SetMemoryMapping(bool useMemoryMapping)
+{
+    m_useMemoryMapping = useMemoryMapping;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetCacheIndex(bool cacheIndex)
+{
+    m_cacheIndex = cacheIndex;
+}
+
 template <class ElemType>
 std::wstring TextParser<ElemType>::GetFileInfo()
 {
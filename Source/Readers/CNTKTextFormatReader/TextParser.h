@@ -10,6 +10,7 @@
 #include "TextConfigHelper.h"
 #include "Indexer.h"
 #include "CorpusDescriptor.h"
+#include "MemoryMappedFile.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -42,6 +43,9 @@ private:
     // Builds an index of the input data.
     void Initialize();
 
+    // Same as above, but maps the input file into memory first.
+    void InitializeMemoryMapped();
+
     struct DenseInputStreamBuffer : DenseSequenceData
     {
         // capacity = expected number of samples * sample size
@@ -85,6 +89,10 @@ private:
     const std::wstring m_filename;
     FILE* m_file;
 
+    // The input file mapped into memory (when memory mapping is enabled, m_file is not used then).
+    // The whole file then constitutes the buffer, sequences are parsed directly from the mapped pages.
+    std::unique_ptr<MemoryMappedFile> m_mappedFile;
+
     // An internal structure to assist with copying from input stream buffers into
     // into sequence data in a proper format.
     struct StreamInfo;
@@ -113,6 +121,8 @@ private:
     bool m_skipSequenceIds;
     unsigned int m_numRetries; // specifies the number of times an unsuccessful
     // file operation should be repeated (default value is 5).
+    bool m_useMemoryMapping; // if true, the input file is mapped into memory instead of being read with fread
+    bool m_cacheIndex; // if true, the index is persisted in a sidecar file and reused when up to date
 
     // Corpus descriptor.
     CorpusDescriptorPtr m_corpus;
@@ -185,6 +195,10 @@ private:
 
     void SetNumRetries(unsigned int numRetries);
 
+    void SetMemoryMapping(bool useMemoryMapping);
+
+    void SetCacheIndex(bool cacheIndex);
+
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
 
     const std::string& GetSequenceKey(const SequenceDescriptor& s) const;
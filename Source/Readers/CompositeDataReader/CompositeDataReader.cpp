@@ -65,6 +65,14 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config, MemoryP
         m_packingMode = PackingMode::sequence;
     }
 
+    // Number of minibatches worth of sequences the sequence packer looks ahead to group sequences
+    // of similar length into minibatches, 0 to pack sequences in the randomized order.
+    m_bucketingLookahead = config(L"bucketingLookahead", (size_t)0);
+    if (m_bucketingLookahead > 0 && m_packingMode != PackingMode::sequence)
+    {
+        InvalidArgument("bucketingLookahead is only supported for sequence packing (not in frameMode or truncated BPTT).");
+    }
+
     m_precision = config("precision", "float");
 
     // Creating deserializers.
@@ -100,7 +108,10 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config, MemoryP
         size_t randomizationWindow = config(L"randomizationWindow", requestDataSize);
         // By default using STL random number generator.
         bool useLegacyRandomization = config(L"useLegacyRandomization", false);
-        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, BlockRandomizer::DecimationMode::chunk, useLegacyRandomization, multiThreadedDeserialization);
+        // By default chunks are loaded when the randomization window reaches them.
+        size_t prefetchThreads = config(L"prefetchThreads", (size_t)0);
+        size_t prefetchChunks = config(L"prefetchChunks", prefetchThreads);
+        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, BlockRandomizer::DecimationMode::chunk, useLegacyRandomization, multiThreadedDeserialization, prefetchThreads, prefetchChunks);
     }
     else
     {
@@ -134,6 +145,28 @@ Minibatch CompositeDataReader::ReadMinibatch()
     return m_packer->ReadMinibatch();
 }
 
+// The truncated BPTT packer cannot resume an epoch in the middle.
+bool CompositeDataReader::SupportsSamplePosition() const
+{
+    return m_packingMode != PackingMode::truncated;
+}
+
+// With bucketing, each worker reports the position of its own oldest buffered sequence.
+bool CompositeDataReader::IsSamplePositionSharedByWorkers() const
+{
+    return m_bucketingLookahead == 0;
+}
+
+size_t CompositeDataReader::GetCurrentSamplePosition()
+{
+    return m_packer->GetCurrentSamplePosition();
+}
+
+void CompositeDataReader::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    m_packer->SetCurrentSamplePosition(currentSamplePosition);
+}
+
 // Create deserializers based on the specified configuration. 
 // deserializers = [
 //        [ type = "ImageDataDeserializer" module = "ImageReader" ...]
@@ -269,7 +302,8 @@ void CompositeDataReader::StartEpoch(const EpochConfiguration& cfg)
         m_packer = std::make_shared<SequencePacker>(
             m_provider,
             m_sequenceEnumerator,
-            m_streams);
+            m_streams,
+            m_bucketingLookahead);
         break;
     case PackingMode::truncated:
     {
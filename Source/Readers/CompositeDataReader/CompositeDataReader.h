@@ -66,6 +66,12 @@ public:
     // Reads a minibatch that contains data across all streams.
     Minibatch ReadMinibatch() override;
 
+    // Gets/sets the sample position of the next minibatch, used to resume an epoch from a checkpoint.
+    bool SupportsSamplePosition() const override;
+    bool IsSamplePositionSharedByWorkers() const override;
+    size_t GetCurrentSamplePosition() override;
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
 private:
     void CreateDeserializers(const ConfigParameters& readerConfig);
     void CreateTransforms(const ConfigParameters& deserializerConfig);
@@ -127,6 +133,9 @@ private:
 
     // Truncation length for BPTT mode.
     size_t m_truncationLength;
+
+    // Lookahead in minibatches for length bucketing in sequence mode, 0 if off.
+    size_t m_bucketingLookahead;
 };
 
 }}}
@@ -34,6 +34,12 @@ public:
     // Retrieves data for a chunk.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
 
+    // Each chunk reads its own files, so different chunks can be loaded concurrently.
+    virtual bool IsGetChunkThreadSafe() const override
+    {
+        return true;
+    }
+
     // Gets sequence description by its key.
     virtual bool GetSequenceDescriptionByKey(const KeyType&, SequenceDescription&) override;
 
@@ -94,6 +94,14 @@ HTKMLFReader::HTKMLFReader(MemoryProviderPtr provider,
     // If nbruttsineachrecurrentiter is specified we assume that the truncation size is mbSize
     // and the real minibatch size in mbSize * nbruttsineachrecurrentiter[epochIndex]
     m_truncationLength = readerConfig(L"truncationLength", 0);
+
+    // Lookahead in minibatches for grouping utterances of similar length in sequence mode, 0 if off.
+    m_bucketingLookahead = readerConfig(L"bucketingLookahead", (size_t)0);
+    if (m_bucketingLookahead > 0 && m_packingMode != PackingMode::sequence)
+    {
+        InvalidArgument("bucketingLookahead is only supported for sequence packing (not in frameMode or truncated BPTT).");
+    }
+
     m_numParallelSequencesForAllEpochs =
         readerConfig(L"nbruttsineachrecurrentiter", ConfigParameters::Array(intargvector(vector<int> { 1 })));
 
@@ -113,7 +121,9 @@ HTKMLFReader::HTKMLFReader(MemoryProviderPtr provider,
     // TODO: this should be bool. Change when config per deserializer is allowed.
     if (AreEqualIgnoreCase(readMethod, std::wstring(L"blockRandomize")))
     {
-        m_randomizer = std::make_shared<BlockRandomizer>(verbosity, window, bundler, BlockRandomizer::DecimationMode::chunk, true /* useLegacyRandomization */);
+        size_t prefetchThreads = readerConfig(L"prefetchThreads", (size_t)0);
+        size_t prefetchChunks = readerConfig(L"prefetchChunks", prefetchThreads);
+        m_randomizer = std::make_shared<BlockRandomizer>(verbosity, window, bundler, BlockRandomizer::DecimationMode::chunk, true /* useLegacyRandomization */, false, prefetchThreads, prefetchChunks);
     }
     else if (AreEqualIgnoreCase(readMethod, std::wstring(L"none")))
     {
@@ -150,7 +160,7 @@ HTKMLFReader::HTKMLFReader(MemoryProviderPtr provider,
         m_packer = std::make_shared<FramePacker>(m_provider, m_randomizer, m_streams);
         break;
     case PackingMode::sequence:
-        m_packer = std::make_shared<SequencePacker>(m_provider, m_randomizer, m_streams);
+        m_packer = std::make_shared<SequencePacker>(m_provider, m_randomizer, m_streams, m_bucketingLookahead);
         break;
     case PackingMode::truncated:
         m_packer = std::make_shared<TruncatedBPTTPacker>(m_provider, m_randomizer, m_streams);
@@ -214,4 +224,28 @@ Minibatch HTKMLFReader::ReadMinibatch()
     return m_packer->ReadMinibatch();
 }
 
+// The truncated BPTT packer cannot resume an epoch in the middle.
+bool HTKMLFReader::SupportsSamplePosition() const
+{
+    return m_packingMode != PackingMode::truncated;
+}
+
+// With bucketing, each worker reports the position of its own oldest buffered sequence.
+bool HTKMLFReader::IsSamplePositionSharedByWorkers() const
+{
+    return m_bucketingLookahead == 0;
+}
+
+size_t HTKMLFReader::GetCurrentSamplePosition()
+{
+    assert(m_packer != nullptr);
+    return m_packer->GetCurrentSamplePosition();
+}
+
+void HTKMLFReader::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    assert(m_packer != nullptr);
+    m_packer->SetCurrentSamplePosition(currentSamplePosition);
+}
+
 }}}
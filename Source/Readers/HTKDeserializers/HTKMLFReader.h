@@ -32,6 +32,12 @@ public:
     // Reads a single minibatch.
     Minibatch ReadMinibatch() override;
 
+    // Gets/sets the sample position of the next minibatch, used to resume an epoch from a checkpoint.
+    bool SupportsSamplePosition() const override;
+    bool IsSamplePositionSharedByWorkers() const override;
+    size_t GetCurrentSamplePosition() override;
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
 private:
     enum class PackingMode
     {
@@ -60,6 +66,9 @@ private:
     // Truncation length for BPTT mode.
     size_t m_truncationLength;
 
+    // Lookahead in minibatches for length bucketing in sequence mode, 0 if off.
+    size_t m_bucketingLookahead;
+
     // Parallel sequences, used for legacy configs.
     intargvector m_numParallelSequencesForAllEpochs;
 };
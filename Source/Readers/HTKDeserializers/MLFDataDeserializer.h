@@ -37,6 +37,12 @@ public:
     // TODO: After we switch the timeline to work in chunks, we will also introduce chunking of labels.
     virtual ChunkPtr GetChunk(ChunkIdType) override;
 
+    // All labels are already in memory, so getting the chunk does not touch any shared state.
+    virtual bool IsGetChunkThreadSafe() const override
+    {
+        return true;
+    }
+
 private:
     class MLFChunk;
     DISABLE_COPY_AND_MOVE(MLFDataDeserializer);
@@ -101,4 +101,16 @@ Minibatch ImageReader::ReadMinibatch()
     assert(m_packer != nullptr);
     return m_packer->ReadMinibatch();
 }
+
+size_t ImageReader::GetCurrentSamplePosition()
+{
+    assert(m_packer != nullptr);
+    return m_packer->GetCurrentSamplePosition();
+}
+
+void ImageReader::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    assert(m_packer != nullptr);
+    m_packer->SetCurrentSamplePosition(currentSamplePosition);
+}
 } } }
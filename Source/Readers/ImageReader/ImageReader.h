@@ -29,6 +29,10 @@ public:
     // Reads a single minibatch.
     Minibatch ReadMinibatch() override;
 
+    // Gets/sets the sample position of the next minibatch, used to resume an epoch from a checkpoint.
+    size_t GetCurrentSamplePosition() override;
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
 private:
     // All streams this reader provides.
     std::vector<StreamDescriptionPtr> m_streams;
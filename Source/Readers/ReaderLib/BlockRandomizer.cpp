@@ -11,6 +11,8 @@
 #include <algorithm>
 #include <utility>
 #include <deque>
+#include <set>
+#include <chrono>
 
 #include "DataReader.h"
 #include "ExceptionCapture.h"
@@ -23,7 +25,9 @@ BlockRandomizer::BlockRandomizer(
     IDataDeserializerPtr deserializer,
     DecimationMode decimationMode,
     bool useLegacyRandomization,
-    bool multithreadedGetNextSequence)
+    bool multithreadedGetNextSequence,
+    size_t prefetchThreads,
+    size_t prefetchChunks)
     : m_verbosity(verbosity),
       m_deserializer(deserializer),
       m_decimationMode(decimationMode),
@@ -34,7 +38,9 @@ BlockRandomizer::BlockRandomizer(
       m_sweepTotalNumberOfSamples(0),
       m_lastSeenChunkId(CHUNKID_MAX),
       m_chunkRandomizer(std::make_shared<ChunkRandomizer>(deserializer, randomizationRangeInSamples, useLegacyRandomization)),
-      m_multithreadedGetNextSequences(multithreadedGetNextSequence)
+      m_multithreadedGetNextSequences(multithreadedGetNextSequence),
+      m_prefetchThreads(prefetchThreads),
+      m_prefetchChunks(prefetchChunks)
 {
     assert(deserializer != nullptr);
 
@@ -49,6 +55,15 @@ BlockRandomizer::BlockRandomizer(
     }
 }
 
+BlockRandomizer::~BlockRandomizer()
+{
+    // Background loaders use the deserializer, so wait for them.
+    for (auto& worker : m_prefetchWorkers)
+    {
+        worker.wait();
+    }
+}
+
 // Start a new epoch.
 void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
 {
@@ -64,15 +79,9 @@ void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
         m_epochSize = config.m_totalEpochSizeInSamples;
     }
 
-    // Calculates starts of the epoch, prepares a new sweep if needed.
+    // Calculates starts of the epoch and moves the sequence cursor there.
     m_epochStartPosition = m_epochSize * config.m_epochIndex;
-    PrepareNewSweepIfNeeded(m_epochStartPosition);
-
-    // Sets sequence cursor to the sequence that corresponds to the epoch start position.
-    // If last epoch ended in the middle of a sequence, the cursor is moved to the next sequence in the sweep.
-    size_t offsetInSweep = m_epochStartPosition % m_sweepTotalNumberOfSamples;
-    size_t newOffset = m_sequenceRandomizer->Seek(offsetInSweep, m_sweep);
-    m_globalSamplePosition = m_sweep * m_sweepTotalNumberOfSamples + newOffset;
+    SetCurrentSamplePosition(m_epochStartPosition);
 
     size_t epochStartFrame = config.m_epochIndex * m_epochSize;
     fprintf(stderr, "BlockRandomizer::StartEpoch: epoch %" PRIu64 ": frames [%" PRIu64 "..%" PRIu64 "] (first sequence at sample %" PRIu64 "), data subset %" PRIu64 " of %" PRIu64 "\n",
@@ -84,6 +93,25 @@ void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
             config.m_numberOfWorkers);
 }
 
+// Moves the cursor to the given position inside of the current epoch, prepares a new sweep if needed.
+void BlockRandomizer::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    if (currentSamplePosition < m_epochStartPosition || currentSamplePosition > m_epochStartPosition + m_epochSize)
+    {
+        InvalidArgument("BlockRandomizer: sample position %" PRIu64 " is outside of the current epoch [%" PRIu64 "..%" PRIu64 "].",
+                        currentSamplePosition, m_epochStartPosition, m_epochStartPosition + m_epochSize);
+    }
+
+    m_lastSeenChunkId = CHUNKID_MAX;
+    PrepareNewSweepIfNeeded(currentSamplePosition);
+
+    // Sets sequence cursor to the sequence that corresponds to the position.
+    // If the position is in the middle of a sequence (e.g. the last epoch ended there), the cursor is moved to the next sequence in the sweep.
+    size_t offsetInSweep = currentSamplePosition % m_sweepTotalNumberOfSamples;
+    size_t newOffset = m_sequenceRandomizer->Seek(offsetInSweep, m_sweep);
+    m_globalSamplePosition = m_sweep * m_sweepTotalNumberOfSamples + newOffset;
+}
+
 // Prepares a new sweep if needed.
 void BlockRandomizer::PrepareNewSweepIfNeeded(size_t samplePosition)
 {
@@ -239,7 +267,12 @@ void BlockRandomizer::RetrieveDataChunks()
     const auto& window = m_sequenceRandomizer->GetChunkWindow(randomizedEnd);
     if (window[randomizedEnd - 1].m_chunkId == m_lastSeenChunkId)
     {
-        return; // nothing to retrieve.
+        // nothing to retrieve, but loaders may have become available since the last call.
+        if (m_prefetchThreads > 0)
+        {
+            PrefetchChunks(window[randomizedEnd - 1]);
+        }
+        return;
     }
 
     m_lastSeenChunkId = window[randomizedEnd - 1].m_chunkId;
@@ -284,15 +317,33 @@ void BlockRandomizer::RetrieveDataChunks()
         if (needed[i])
         {
             auto const& chunk = window[i];
-            m_chunks[chunk.m_original->m_id] = m_deserializer->GetChunk(chunk.m_original->m_id);
+            auto prefetched = m_prefetchedChunks.find(chunk.m_original->m_id);
+            bool wasPrefetched = prefetched != m_prefetchedChunks.end();
+            if (wasPrefetched)
+            {
+                // Waits if the chunk is still being loaded, and rethrows if loading failed.
+                m_chunks[chunk.m_original->m_id] = prefetched->second.get();
+                m_prefetchedChunks.erase(prefetched);
+            }
+            else
+            {
+                m_chunks[chunk.m_original->m_id] = LoadChunk(chunk.m_original->m_id);
+            }
+
             if (m_verbosity >= Information)
-                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
+                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u)%s, now %" PRIu64 " chunks in memory\n",
                 chunk.m_chunkId,
                 chunk.m_original->m_id,
+                wasPrefetched ? " prefetched" : "",
                 ++numLoadedChunks);
         }
     }
 
+    if (m_prefetchThreads > 0)
+    {
+        PrefetchChunks(window[randomizedEnd - 1]);
+    }
+
     if (m_verbosity >= Notification)
         fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: %" PRIu64 " chunks paged-in from chunk window [%u..%u]\n",
                 m_chunks.size(),
@@ -300,4 +351,99 @@ void BlockRandomizer::RetrieveDataChunks()
                 window.back().m_chunkId);
 }
 
+// Gets a chunk from the deserializer. Called from the main thread and from the background loaders.
+ChunkPtr BlockRandomizer::LoadChunk(ChunkIdType originalChunkId)
+{
+    if (m_deserializer->IsGetChunkThreadSafe())
+    {
+        return m_deserializer->GetChunk(originalChunkId);
+    }
+
+    std::lock_guard<std::mutex> lock(m_getChunkLock);
+    return m_deserializer->GetChunk(originalChunkId);
+}
+
+// Makes sure that the next m_prefetchChunks chunks of this worker after the window are loaded or being loaded
+// in the background, by at most m_prefetchThreads threads. Chunks of the next sweep are not prefetched,
+// because the next sweep is randomized differently.
+void BlockRandomizer::PrefetchChunks(const RandomizedChunk& lastChunkInWindow)
+{
+    const auto& randomizedChunks = m_chunkRandomizer->GetRandomizedChunks();
+
+    // Chunks that should be prefetched, and those of them that are not yet.
+    std::set<ChunkIdType> lookahead;
+    std::vector<ChunkIdType> toLoad;
+    for (size_t i = lastChunkInWindow.m_chunkId + 1; i < randomizedChunks.size() && lookahead.size() < m_prefetchChunks; ++i)
+    {
+        if (m_decimationMode == DecimationMode::chunk && i % m_config.m_numberOfWorkers != m_config.m_workerRank)
+        {
+            continue;
+        }
+
+        ChunkIdType originalChunkId = randomizedChunks[i].m_original->m_id;
+        lookahead.insert(originalChunkId);
+        if (m_chunks.find(originalChunkId) == m_chunks.end() && m_prefetchedChunks.find(originalChunkId) == m_prefetchedChunks.end())
+        {
+            toLoad.push_back(originalChunkId);
+        }
+    }
+
+    // Drop prefetched chunks that are not going to be needed soon anymore, e.g. after a new sweep or epoch.
+    // The ones still being loaded are kept; a deserializer may not support loading a chunk that is already loaded.
+    auto isReady = [](const std::shared_future<ChunkPtr>& f) { return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready; };
+    for (auto it = m_prefetchedChunks.begin(); it != m_prefetchedChunks.end();)
+    {
+        if (lookahead.find(it->first) == lookahead.end() && isReady(it->second))
+        {
+            it = m_prefetchedChunks.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // Forget finished loaders.
+    m_prefetchWorkers.erase(std::remove_if(m_prefetchWorkers.begin(), m_prefetchWorkers.end(),
+        [](std::future<void>& f) { return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }),
+        m_prefetchWorkers.end());
+
+    size_t numWorkers = std::min(m_prefetchThreads - m_prefetchWorkers.size(), toLoad.size());
+    if (numWorkers == 0)
+    {
+        return;
+    }
+
+    // Distribute round robin, so that the chunks needed first are loaded first.
+    typedef std::vector<std::pair<ChunkIdType, std::shared_ptr<std::promise<ChunkPtr>>>> ChunksToLoad;
+    std::vector<ChunksToLoad> work(numWorkers);
+    for (size_t i = 0; i < toLoad.size(); ++i)
+    {
+        auto promise = std::make_shared<std::promise<ChunkPtr>>();
+        m_prefetchedChunks[toLoad[i]] = promise->get_future().share();
+        work[i % numWorkers].push_back(std::make_pair(toLoad[i], promise));
+    }
+
+    for (auto& chunksToLoad : work)
+    {
+        m_prefetchWorkers.push_back(std::async(std::launch::async, [this, chunksToLoad]() mutable
+        {
+            for (auto& chunk : chunksToLoad)
+            {
+                try
+                {
+                    chunk.second->set_value(LoadChunk(chunk.first));
+                }
+                catch (...)
+                {
+                    chunk.second->set_exception(std::current_exception());
+                }
+
+                // Do not keep the chunk alive beyond its consumer.
+                chunk.second.reset();
+            }
+        }));
+    }
+}
+
 }}}
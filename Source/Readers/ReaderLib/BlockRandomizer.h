@@ -6,6 +6,9 @@
 #pragma once
 
 #include <vector>
+#include <map>
+#include <future>
+#include <mutex>
 
 #include "SequenceEnumerator.h"
 #include "DataDeserializer.h"
@@ -28,6 +31,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 //         5) decimate sequence descriptions based on the worker rank
 //         6) request chunks of data based on decimated sequences and return sequence data
 //
+// Optionally, chunks that are about to enter the randomization window are loaded ahead of time by background threads
+// (see prefetchThreads and prefetchChunks), so that deserializing big chunks does not stall minibatch delivery.
+//
 // This class is responsible for decimation and loading the data chunks in to memory.
 // Actual randomization happens in ChunkRandomizer and SequenceRandomizer.
 // TODO: The behavior can be simplified by only randomizing sequences forward.
@@ -47,7 +53,11 @@ public:
         IDataDeserializerPtr deserializer,
         DecimationMode decimationMode = DecimationMode::chunk,
         bool useLegacyRandomization = false,
-        bool multithreadedGetNextSequences = false);
+        bool multithreadedGetNextSequences = false,
+        size_t prefetchThreads = 0,
+        size_t prefetchChunks = 0);
+
+    ~BlockRandomizer();
 
     // Starts a new epoch.
     virtual void StartEpoch(const EpochConfiguration& config) override;
@@ -55,6 +65,14 @@ public:
     // Gets next sequences.
     virtual Sequences GetNextSequences(size_t sampleCount) override;
 
+    // Gets/sets the global sample position of the next sequence.
+    virtual size_t GetCurrentSamplePosition() override
+    {
+        return m_globalSamplePosition;
+    }
+
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
     // Gets stream descriptions.
     virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
     {
@@ -75,6 +93,12 @@ private:
     // Prepares a new sweep if needed.
     void PrepareNewSweepIfNeeded(size_t samplePosition);
 
+    // Gets a chunk from the deserializer, serializing the calls if the deserializer requires it.
+    ChunkPtr LoadChunk(ChunkIdType originalChunkId);
+
+    // Starts loading the chunks that follow the current window in the background.
+    void PrefetchChunks(const RandomizedChunk& lastChunkInWindow);
+
     // Global sample position on the timeline.
     size_t m_globalSamplePosition;
 
@@ -120,6 +144,21 @@ private:
     // TODO temporary; should go away when transformers are moved closer to the deserializer
     bool m_multithreadedGetNextSequences;
 
+    // Maximum number of background threads loading chunks; 0 disables prefetching.
+    size_t m_prefetchThreads;
+
+    // Number of chunks beyond the randomization window to load ahead of time.
+    size_t m_prefetchChunks;
+
+    // Chunks that are being or have been loaded ahead of time, by original chunk id.
+    std::map<ChunkIdType, std::shared_future<ChunkPtr>> m_prefetchedChunks;
+
+    // Background loaders, each loading a list of chunks.
+    std::vector<std::future<void>> m_prefetchWorkers;
+
+    // Serializes GetChunk() calls for deserializers that do not allow concurrent ones.
+    std::mutex m_getChunkLock;
+
     // General configuration
     // TODO generalize those for ReaderLib / Reader / CNTK
     enum VerbosityLevel
@@ -302,4 +302,16 @@ ChunkPtr Bundler::GetChunk(ChunkIdType chunkId)
     return std::make_shared<BundlingChunk>(m_streams.size(), this, chunkId);
 }
 
+bool Bundler::IsGetChunkThreadSafe() const
+{
+    for (const auto& deserializer : m_deserializers)
+    {
+        if (!deserializer->IsGetChunkThreadSafe())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 }}}
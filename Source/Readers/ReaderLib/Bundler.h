@@ -28,6 +28,9 @@ public:
     // Gets a chunk with data.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
 
+    // Bundled chunks can be loaded concurrently if the chunks of all underlying deserializers can.
+    virtual bool IsGetChunkThreadSafe() const override;
+
 private:
     DISABLE_COPY_AND_MOVE(Bundler);
 
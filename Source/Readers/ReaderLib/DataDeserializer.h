@@ -170,6 +170,13 @@ public:
     // Gets chunk data given its id.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId) = 0;
 
+    // Whether GetChunk() can be called for different chunks from several threads at the same time.
+    // Used to load chunks ahead of time on background threads; otherwise, these calls get serialized.
+    virtual bool IsGetChunkThreadSafe() const
+    {
+        return false;
+    }
+
     virtual ~IDataDeserializer() {};
 };
 
@@ -4,6 +4,9 @@
 //
 
 #define _CRT_SECURE_NO_WARNINGS
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
 #include <algorithm>
 
 #include "NoRandomizer.h"
@@ -58,8 +61,21 @@ void NoRandomizer::StartEpoch(const EpochConfiguration& config)
         m_config.m_totalEpochSizeInSamples = m_totalNumberOfSamples;
     }
 
-    m_samplePositionInEpoch = 0;
-    m_globalSamplePosition = m_config.m_totalEpochSizeInSamples * config.m_epochIndex;
+    SetCurrentSamplePosition(m_config.m_totalEpochSizeInSamples * config.m_epochIndex);
+}
+
+// Moves the cursor to the given position inside of the current epoch.
+void NoRandomizer::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    size_t epochStartPosition = m_config.m_totalEpochSizeInSamples * m_config.m_epochIndex;
+    if (currentSamplePosition < epochStartPosition || currentSamplePosition > epochStartPosition + m_config.m_totalEpochSizeInSamples)
+    {
+        InvalidArgument("NoRandomizer: sample position %" PRIu64 " is outside of the current epoch [%" PRIu64 "..%" PRIu64 "].",
+                        currentSamplePosition, epochStartPosition, epochStartPosition + m_config.m_totalEpochSizeInSamples);
+    }
+
+    m_samplePositionInEpoch = currentSamplePosition - epochStartPosition;
+    m_globalSamplePosition = currentSamplePosition;
     size_t sweepSamplePosition = m_globalSamplePosition % m_totalNumberOfSamples;
 
     ChunkIdType chunkIndex = GetChunkIndexOf(sweepSamplePosition);
@@ -81,7 +97,7 @@ void NoRandomizer::StartEpoch(const EpochConfiguration& config)
     size_t numberOfSamples = 0;
     size_t sequenceId = 0;
 
-    // Currently linear, happens only at the border of epochs.
+    // Currently linear, happens only at the border of epochs or when an epoch is resumed.
     for (size_t i = 0; i < m_sequenceWindow.size(); ++i)
     {
         size_t sequenceSize = m_sequenceWindow[i].m_numberOfSamples;
@@ -22,6 +22,13 @@ public:
 
     virtual void StartEpoch(const EpochConfiguration& config) override;
     virtual Sequences GetNextSequences(size_t sampleCount) override;
+
+    virtual size_t GetCurrentSamplePosition() override
+    {
+        return m_globalSamplePosition;
+    }
+
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override;
     virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
     {
         return m_deserializer->GetStreamDescriptions();
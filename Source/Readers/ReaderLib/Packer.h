@@ -19,6 +19,13 @@ public:
     virtual void StartEpoch(const EpochConfiguration& config) = 0;
 
     virtual Minibatch ReadMinibatch() = 0;
+
+    // Gets the sample position of the data the next minibatch will be read from (see SequenceEnumerator).
+    virtual size_t GetCurrentSamplePosition() = 0;
+
+    // Sets the sample position from which the next minibatch will be read.
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) = 0;
+
     virtual ~Packer() {}
 };
 
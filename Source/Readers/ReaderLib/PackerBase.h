@@ -73,6 +73,17 @@ protected:
 public:
     // Sets current epoch configuration.
     virtual void StartEpoch(const EpochConfiguration& config) override;
+
+    // Packers that do not keep sequences between minibatches are at the position of the sequence enumerator.
+    virtual size_t GetCurrentSamplePosition() override
+    {
+        return m_sequenceEnumerator->GetCurrentSamplePosition();
+    }
+
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override
+    {
+        m_sequenceEnumerator->SetCurrentSamplePosition(currentSamplePosition);
+    }
 };
 
 inline void PackerBase::PackSparseSampleAsDense(char* destination, SparseSequenceDataPtr sequence,
@@ -90,6 +90,18 @@ struct Minibatch
     Minibatch(bool endOfEpoch) : m_endOfEpoch(endOfEpoch)
     {
     }
+
+    // Fraction of the columns of all streams that hold samples rather than gaps (1 if there is no padding).
+    double GetPaddingEfficiency() const
+    {
+        size_t numSamples = 0, numColumns = 0;
+        for (const auto& stream : m_data)
+        {
+            numSamples += stream->m_layout->GetActualNumSamples();
+            numColumns += stream->m_layout->GetNumCols();
+        }
+        return numColumns == 0 ? 1.0 : (double)numSamples / numColumns;
+    }
 };
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -108,6 +120,25 @@ public:
     // Reads a minibatch that contains data across all streams.
     virtual Minibatch ReadMinibatch() = 0;
 
+    // Tells if GetCurrentSamplePosition() and SetCurrentSamplePosition() are supported.
+    virtual bool SupportsSamplePosition() const
+    {
+        return true;
+    }
+
+    // Tells if the position is the same on all workers of a distributed read (see IDataReader).
+    virtual bool IsSamplePositionSharedByWorkers() const
+    {
+        return true;
+    }
+
+    // Gets the position of the next minibatch in samples since the beginning of the first epoch.
+    // Together with SetCurrentSamplePosition() this allows resuming an epoch from a checkpoint.
+    virtual size_t GetCurrentSamplePosition() = 0;
+
+    // Sets the position from which the next minibatch will be read, as returned by GetCurrentSamplePosition().
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) = 0;
+
     virtual ~Reader() {};
 };
 
@@ -22,7 +22,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 template <class ElemType>
 ReaderShim<ElemType>::ReaderShim(ReaderFactory factory)
-    : m_factory(factory)
+    : m_factory(factory),
+      m_currentSamplePosition(0)
 {
 }
 
@@ -77,6 +78,33 @@ void ReaderShim<ElemType>::StartDistributedMinibatchLoop(
     m_reader->StartEpoch(config);
     m_endOfEpoch = false;
 
+    StartPrefetch();
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    // Drop the minibatch that is being prefetched, and read from the new position instead.
+    if (m_prefetchTask.valid())
+    {
+        m_prefetchTask.wait();
+    }
+
+    m_reader->SetCurrentSamplePosition(currentSamplePosition);
+    m_endOfEpoch = false;
+
+    StartPrefetch();
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::StartPrefetch()
+{
+    // No read is in flight here, so the reader is at the position of the minibatch it reads next.
+    if (m_reader->SupportsSamplePosition())
+    {
+        m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
+    }
+
     // Starting the prefetch task. There is always a single async read in flight.
     // When the network requests a new minibatch, we wait for the current async to finish,
     // return the result and kick off a new one.
@@ -189,13 +217,7 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
 
     if (!m_endOfEpoch)
     {
-        // Starting the prefetch task. There is always a single async read in flight.
-        // When the network requests a new minibatch, we wait for the current async to finish,
-        // return the result and kick off a new one.
-        m_prefetchTask = std::async(m_launchType, [this]()
-        {
-            return m_reader->ReadMinibatch();
-        });
+        StartPrefetch();
     }
 
     return !minibatch.m_data.empty();
@@ -51,6 +51,23 @@ public:
         return true;
     }
 
+    virtual bool SupportsSamplePosition() const override
+    {
+        return m_reader->SupportsSamplePosition();
+    }
+
+    virtual bool IsSamplePositionSharedByWorkers() const override
+    {
+        return m_reader->IsSamplePositionSharedByWorkers();
+    }
+
+    virtual size_t GetCurrentSamplePosition() override
+    {
+        return m_currentSamplePosition;
+    }
+
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
     virtual bool GetMinibatch(StreamMinibatchInputs& matrices) override;
 
     virtual bool DataEnd() override;
@@ -71,6 +88,13 @@ private:
     std::vector<StreamDescriptionPtr> m_streams;
     launch m_launchType;
 
+    // Position of the minibatch the prefetch task is reading, i.e. of the one GetMinibatch() returns next.
+    // The reader itself may be ahead already, because of the prefetch.
+    size_t m_currentSamplePosition;
+
+    // Starts reading the next minibatch in the background.
+    void StartPrefetch();
+
     void FillMatrixFromStream(StorageType type, Matrix<ElemType>* matrix, size_t numRows, const StreamMinibatchPtr& stream);
 };
 
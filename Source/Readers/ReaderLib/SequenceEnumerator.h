@@ -44,6 +44,14 @@ public:
     // Gets next sequences up to a maximum count of samples.
     virtual Sequences GetNextSequences(size_t sampleCount) = 0;
 
+    // Gets the position of the next sequence in the sample stream of all workers,
+    // i.e. the number of samples the enumerator has gone through since the beginning of the first epoch.
+    virtual size_t GetCurrentSamplePosition() = 0;
+
+    // Moves the enumerator to a position inside of the current epoch, as returned by GetCurrentSamplePosition().
+    // Used to resume an epoch from a checkpoint.
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) = 0;
+
     virtual ~SequenceEnumerator()
     {
     }
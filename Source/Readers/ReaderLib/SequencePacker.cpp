@@ -7,6 +7,8 @@
 #define _SCL_SECURE_NO_WARNINGS
 
 #include <numeric>
+#include <algorithm>
+#include <map>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include "SequencePacker.h"
@@ -16,6 +18,11 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 MBLayoutPtr SequencePacker::CreateMBLayout(const StreamBatch& batch)
 {
+    if (m_bucketingLookahead > 0)
+    {
+        return CreateBestFitMBLayout(batch);
+    }
+
     vector<MBLayout::SequenceInfo> infos;
     for (size_t index = 0; index < batch.size(); ++index)
     {
@@ -36,9 +43,217 @@ MBLayoutPtr SequencePacker::CreateMBLayout(const StreamBatch& batch)
     return pMBLayout;
 }
 
+// Fills parallel sequences of the given width one after the other: each one is started with the longest
+// remaining sequence, and the space left behind it is filled with the longest remaining sequences that fit.
+// Sequences are taken as long as the total number of samples stays within maxSamples; the sequence with index
+// 'first' (if any) is taken before all others. Returns (parallel sequence, begin) per sequence, or
+// (SIZE_MAX, 0) for sequences that are not taken.
+static vector<pair<size_t, size_t>> FillParallelSequences(const vector<size_t>& lengths, size_t width, size_t maxSamples, size_t first)
+{
+    vector<pair<size_t, size_t>> placement(lengths.size(), make_pair(SIZE_MAX, (size_t)0));
+
+    // multimap keeps equal lengths in the order of insertion, i.e. in the order of the sequences
+    multimap<size_t, size_t> remaining;
+    for (size_t index = 0; index < lengths.size(); ++index)
+    {
+        if (index != first && lengths[index] <= width)
+        {
+            remaining.insert(make_pair(lengths[index], index));
+        }
+    }
+
+    size_t numSamples = 0;
+    for (size_t row = 0;; ++row)
+    {
+        size_t used = 0;
+        bool taken = false;
+        if (row == 0 && first < lengths.size())
+        {
+            placement[first] = make_pair(row, used);
+            used = numSamples = lengths[first];
+            taken = true;
+        }
+
+        for (;;)
+        {
+            size_t space = min(width - used, numSamples < maxSamples ? maxSamples - numSamples : 0);
+            auto next = remaining.upper_bound(space);
+            if (next == remaining.begin())
+            {
+                break;
+            }
+
+            next = remaining.lower_bound((--next)->first);
+            placement[next->second] = make_pair(row, used);
+            used += next->first;
+            numSamples += next->first;
+            remaining.erase(next);
+            taken = true;
+        }
+
+        if (!taken)
+        {
+            break;
+        }
+    }
+
+    return placement;
+}
+
+MBLayoutPtr SequencePacker::CreateBestFitMBLayout(const StreamBatch& batch)
+{
+    size_t width = 0;
+    vector<size_t> lengths;
+    for (const auto& sequence : batch)
+    {
+        lengths.push_back(sequence->m_numberOfSamples);
+        width = max(width, lengths.back());
+    }
+
+    auto placement = FillParallelSequences(lengths, width, SIZE_MAX, SIZE_MAX);
+    vector<size_t> rowAllocations;
+    for (size_t index = 0; index < batch.size(); ++index)
+    {
+        size_t row = placement[index].first;
+        if (rowAllocations.size() <= row)
+        {
+            rowAllocations.resize(row + 1, 0);
+        }
+
+        rowAllocations[row] = max(rowAllocations[row], placement[index].second + lengths[index]);
+    }
+
+    MBLayoutPtr pMBLayout = make_shared<MBLayout>();
+    pMBLayout->Init(rowAllocations.size(), width);
+    for (size_t index = 0; index < batch.size(); ++index)
+    {
+        size_t row = placement[index].first, begin = placement[index].second;
+        pMBLayout->AddSequence(index, row, (ptrdiff_t)begin, begin + lengths[index]);
+    }
+
+    for (size_t row = 0; row < rowAllocations.size(); ++row)
+    {
+        pMBLayout->AddGap(row, rowAllocations[row], width);
+    }
+
+    return pMBLayout;
+}
+
+void SequencePacker::StartEpoch(const EpochConfiguration& config)
+{
+    PackerBase::StartEpoch(config);
+
+    // The sequence enumerator starts the new epoch from its own position,
+    // so whatever is left from an unfinished epoch is dropped.
+    m_buffer.clear();
+    m_bufferedSamples = 0;
+    m_endOfEpochBuffered = false;
+    m_epochSamples = 0;
+    m_epochColumns = 0;
+}
+
+size_t SequencePacker::GetCurrentSamplePosition()
+{
+    // The buffer is kept in the order the sequences were read, so the front sequence is the oldest one.
+    return m_buffer.empty() ?
+        m_sequenceEnumerator->GetCurrentSamplePosition() :
+        m_buffer.front().m_samplePosition;
+}
+
+void SequencePacker::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    m_buffer.clear();
+    m_bufferedSamples = 0;
+    m_endOfEpochBuffered = false;
+    m_sequenceEnumerator->SetCurrentSamplePosition(currentSamplePosition);
+}
+
+// Takes the next minibatch out of the bucketing buffer, after topping the buffer up.
+// The oldest buffered sequence is always taken, so that every sequence gets packed eventually. Its length
+// determines the width of the minibatch (unless the shorter buffered sequences are not enough to fill the
+// minibatch, then the width grows), and the parallel sequences of that width are filled with the buffered
+// sequences that fit best, as long as they fit into the minibatch size.
+Sequences SequencePacker::GetNextBucket()
+{
+    size_t bufferSize = m_minibatchSize * m_bucketingLookahead;
+    while (!m_endOfEpochBuffered && m_bufferedSamples < bufferSize)
+    {
+        size_t samplePosition = m_sequenceEnumerator->GetCurrentSamplePosition();
+        auto sequences = m_sequenceEnumerator->GetNextSequences(m_minibatchSize);
+        m_endOfEpochBuffered = sequences.m_endOfEpoch;
+        if (sequences.m_data.empty())
+        {
+            break;
+        }
+
+        for (size_t index = 0; index < sequences.m_data.front().size(); ++index)
+        {
+            BufferedSequence sequence;
+            sequence.m_length = 0;
+            sequence.m_samplePosition = samplePosition;
+            for (const auto& streamBatch : sequences.m_data)
+            {
+                sequence.m_data.push_back(streamBatch[index]);
+                sequence.m_length = max(sequence.m_length, (size_t)streamBatch[index]->m_numberOfSamples);
+            }
+
+            m_bufferedSamples += sequence.m_length;
+            m_buffer.push_back(move(sequence));
+        }
+    }
+
+    Sequences result;
+    if (m_buffer.empty())
+    {
+        result.m_endOfEpoch = m_endOfEpochBuffered;
+        return result;
+    }
+
+    vector<size_t> lengths;
+    for (const auto& sequence : m_buffer)
+    {
+        lengths.push_back(sequence.m_length);
+    }
+
+    vector<size_t> sortedLengths(lengths);
+    sort(sortedLengths.begin(), sortedLengths.end());
+    size_t width = lengths.front();
+    for (size_t index = 0, shorterSamples = 0; index < sortedLengths.size() && shorterSamples < m_minibatchSize; ++index)
+    {
+        shorterSamples += sortedLengths[index];
+        width = max(width, sortedLengths[index]);
+    }
+
+    // As with the sequence enumerator, the first sequence is taken even if it exceeds the minibatch size.
+    auto placement = FillParallelSequences(lengths, width, m_minibatchSize, 0);
+
+    result.m_data.resize(m_buffer.front().m_data.size());
+    deque<BufferedSequence> remaining;
+    for (size_t index = 0; index < m_buffer.size(); ++index)
+    {
+        if (placement[index].first == SIZE_MAX)
+        {
+            remaining.push_back(move(m_buffer[index]));
+            continue;
+        }
+
+        for (size_t streamIndex = 0; streamIndex < result.m_data.size(); ++streamIndex)
+        {
+            result.m_data[streamIndex].push_back(m_buffer[index].m_data[streamIndex]);
+        }
+
+        m_bufferedSamples -= m_buffer[index].m_length;
+    }
+
+    m_buffer.swap(remaining);
+    result.m_endOfEpoch = m_endOfEpochBuffered && m_buffer.empty();
+    return result;
+}
+
 Minibatch SequencePacker::ReadMinibatch()
 {
-    auto sequences = m_sequenceEnumerator->GetNextSequences(m_minibatchSize);
+    auto sequences = m_bucketingLookahead > 0 ?
+        GetNextBucket() : m_sequenceEnumerator->GetNextSequences(m_minibatchSize);
     const auto& batch = sequences.m_data;
 
     Minibatch minibatch(sequences.m_endOfEpoch);
@@ -64,6 +279,21 @@ Minibatch SequencePacker::ReadMinibatch()
         minibatch.m_data.push_back(streamMinibatch);
     }
 
+    if (m_bucketingLookahead > 0)
+    {
+        for (const auto& streamMinibatch : minibatch.m_data)
+        {
+            m_epochSamples += streamMinibatch->m_layout->GetActualNumSamples();
+            m_epochColumns += streamMinibatch->m_layout->GetNumCols();
+        }
+
+        if (minibatch.m_endOfEpoch)
+        {
+            fprintf(stderr, "SequencePacker: padding efficiency %.1f%% (%" PRIu64 " samples in %" PRIu64 " columns) with a bucketing lookahead of %" PRIu64 " minibatches\n",
+                    100.0 * m_epochSamples / max(m_epochColumns, (size_t)1), m_epochSamples, m_epochColumns, m_bucketingLookahead);
+        }
+    }
+
     return minibatch;
 }
 
@@ -5,26 +5,50 @@
 
 #pragma once
 
+#include <deque>
 #include "PackerBase.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-// This packer generates minibatches containing full sequences packed for 
+// This packer generates minibatches containing full sequences packed for
 // efficient (concurrent) consumption on a GPU.
+//
+// By default sequences are packed in the order the sequence enumerator returns them.
+// With a bucketing lookahead of N > 0, the packer keeps up to N minibatches worth of
+// randomized sequences in a buffer, and fills each minibatch with the buffered sequences
+// that fill its parallel sequences best: the oldest buffered sequence sets the width, and
+// the longest sequences that fit are placed first. This reduces the number of gap columns
+// for corpora of variable-length sequences, at the price of minibatches that are less
+// random with respect to sequence length.
 class SequencePacker : public PackerBase
 {
 public:
     SequencePacker(
         MemoryProviderPtr memoryProvider,
         SequenceEnumeratorPtr sequenceEnumerator,
-        const std::vector<StreamDescriptionPtr>& streams) :
-        PackerBase(memoryProvider, sequenceEnumerator, streams)
+        const std::vector<StreamDescriptionPtr>& streams,
+        size_t bucketingLookahead = 0) :
+        PackerBase(memoryProvider, sequenceEnumerator, streams),
+        m_bucketingLookahead(bucketingLookahead),
+        m_bufferedSamples(0),
+        m_endOfEpochBuffered(false),
+        m_epochSamples(0),
+        m_epochColumns(0)
     {
 
     }
 
+    virtual void StartEpoch(const EpochConfiguration& config) override;
+
     virtual Minibatch ReadMinibatch() override;
 
+    // With bucketing, the position is the one of the oldest buffered sequence, so that no sequence is skipped
+    // when an epoch is resumed from it. The sequences read after it that were packed already are read, and trained on,
+    // again then. This position is the worker's own, since each worker buffers its own sequences.
+    virtual size_t GetCurrentSamplePosition() override;
+
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
 protected:
     virtual MBLayoutPtr PackDenseStream(const StreamBatch& batch, size_t streamIndex);
 
@@ -33,6 +57,33 @@ protected:
     // Given a number of sequences, creates an MB layout that is used to guide
     // the actual packing.
     virtual MBLayoutPtr CreateMBLayout(const StreamBatch& batch);
+
+private:
+    // A sequence in the bucketing buffer, with its data for all streams.
+    struct BufferedSequence
+    {
+        std::vector<SequenceDataPtr> m_data; // [stream]
+        size_t m_length;                     // maximum number of samples over all streams
+        size_t m_samplePosition;             // position of the sequence enumerator before the sequence was read
+    };
+
+    // Gets the sequences of the next minibatch from the bucketing buffer.
+    Sequences GetNextBucket();
+
+    // Packs the sequences so that the parallel sequences are filled as far as possible.
+    MBLayoutPtr CreateBestFitMBLayout(const StreamBatch& batch);
+
+    // Number of minibatches worth of sequences to look ahead for bucketing, 0 if bucketing is off.
+    size_t m_bucketingLookahead;
+
+    // Randomized sequences not packed yet, in the order of the sequence enumerator.
+    std::deque<BufferedSequence> m_buffer;
+    size_t m_bufferedSamples;
+    bool m_endOfEpochBuffered; // the sequence enumerator has reached the end of the epoch
+
+    // Samples and columns (including gaps) packed in this epoch, for reporting the padding efficiency.
+    size_t m_epochSamples;
+    size_t m_epochColumns;
 };
 
 typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
@@ -88,6 +88,18 @@ public:
         return sequences;
     }
 
+    virtual size_t GetCurrentSamplePosition() override
+    {
+        assert(m_sequenceProvider != nullptr);
+        return m_sequenceProvider->GetCurrentSamplePosition();
+    }
+
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override
+    {
+        assert(m_sequenceProvider != nullptr);
+        m_sequenceProvider->SetCurrentSamplePosition(currentSamplePosition);
+    }
+
 private:
     size_t GetStreamId(const std::wstring streamName, const std::vector<StreamDescriptionPtr>& streams) const
     {
@@ -207,6 +207,16 @@ Minibatch TruncatedBPTTPacker::ReadMinibatch()
     return result;
 }
 
+size_t TruncatedBPTTPacker::GetCurrentSamplePosition()
+{
+    RuntimeError("Resuming an epoch in the middle is not supported in truncated BPTT mode.");
+}
+
+void TruncatedBPTTPacker::SetCurrentSamplePosition(size_t)
+{
+    RuntimeError("Resuming an epoch in the middle is not supported in truncated BPTT mode.");
+}
+
 // Packs a slot of sequences into the minibatch.
 void TruncatedBPTTPacker::PackSlot(size_t streamIndex, size_t slotIndex, size_t& sequenceId)
 {
@@ -29,6 +29,11 @@ public:
 
     virtual void StartEpoch(const EpochConfiguration& config) override;
 
+    // Not supported: sequences are split across minibatches, and the network carries its state
+    // from one minibatch to the next, so an epoch cannot be resumed in the middle.
+    virtual size_t GetCurrentSamplePosition() override;
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
 private:
     // Reads sequences to slot with the specified index.
     // Number of slots = m_parallelNumberOfSequences
@@ -0,0 +1,440 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CompressedDistGradAggregator.h -- data-parallel gradient aggregation that exchanges compressed gradients
+//
+
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "ColumnQuantizer.h"
+#include "QuantizedMatrix.h"
+#include "TimerUtility.h"
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <cmath>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// CompressedDistGradAggregator -- aggregates the gradients of all workers by a reduce-scatter followed by an all-gather,
+// exchanging compressed instead of full-precision gradients to save network bandwidth.
+//
+// Each gradient is split into one stripe per worker. In the reduce-scatter step, every worker sends each stripe of its
+// compressed gradient to the worker owning that stripe, which adds up all contributions. In the all-gather step, the
+// owners send the aggregated stripes back to everyone.
+//
+// There are two compression modes:
+//  - quantization: every column is quantized to 'numGradientBits' bits by ColumnQuantizer (e.g. 1-bit SGD).
+//    Stripes are ranges of columns. The owner quantizes the aggregated stripe again for the all-gather.
+//  - top-k sparsification: of each gradient, only the fraction 'topKRatio' of the elements with the largest magnitude is
+//    sent, as (index, value) pairs. Stripes are ranges of the elements of all gradients concatenated. The owner sends the
+//    non-zero elements of the aggregated stripe, without further loss.
+// In both modes, what was not transmitted is kept as a residual and added to the gradient of the next minibatch
+// (error feedback), so gradient information is delayed rather than lost.
+//
+// Gradients must be dense CPU matrices.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class CompressedDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    // Uses quantization if 'topKRatio' is 0, and top-k sparsification otherwise (then 'numGradientBits' must be 8 * sizeof(ElemType)).
+    CompressedDistGradAggregator(const MPIWrapperPtr& mpi, size_t numGradientBits, bool zeroThresholdFor1Bit, double topKRatio, int syncStatsTrace)
+        : IDistGradAggregator<ElemType>(mpi), m_numGradientBits(numGradientBits), m_zeroThresholdFor1Bit(zeroThresholdFor1Bit), m_topKRatio(topKRatio), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_numBytesScattered(0), m_numBytesGathered(0)
+    {
+        const size_t numElemTypeBits = 8 * sizeof(ElemType);
+        if (m_topKRatio != 0)
+        {
+            if (m_topKRatio < 0 || m_topKRatio >= 1)
+                InvalidArgument("CompressedDistGradAggregator: The top-k ratio must be in the range (0, 1).");
+            if (m_numGradientBits != numElemTypeBits)
+                InvalidArgument("CompressedDistGradAggregator: Gradient quantization and top-k sparsification cannot be combined.");
+        }
+        else if (m_numGradientBits == 0 || m_numGradientBits >= numElemTypeBits || (m_numGradientBits & (m_numGradientBits - 1)) != 0)
+            InvalidArgument("CompressedDistGradAggregator: The number of gradient bits must be a power of 2 less than %d.", (int) numElemTypeBits);
+    }
+
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int /*epochNumber*/) override
+    {
+        if (m_residuals.empty())
+            Initialize(gradients);
+
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        m_iterationCount++;
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        if (headerCPU->numSamples == 0)
+        {
+            headerCPU->criterion = 0.0;
+            for (int i = 0; i < headerCPU->numEvalNode; ++i)
+                headerCPU->evalErrors[i] = { 0.0, 0 };
+
+            // If the current node did not process any samples, the gradients should be zero'd
+            for (auto gradient : gradients)
+                gradient->SetValue(0);
+        }
+
+        AggregateHeaders(headerCPU);
+
+        if (m_topKRatio != 0)
+            AggregateTopK(gradients);
+        else
+            AggregateQuantized(gradients);
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Actual gradient aggregation time: %.6g (%d bytes sent in reduce-scatter, %d in all-gather)\n",
+                    aggregationTimer.ElapsedSeconds(), (int) m_numBytesScattered, (int) m_numBytesGathered);
+        }
+
+        return (headerCPU->numSamples != 0);
+    }
+
+private:
+    // (index, value) pair of the top-k mode; the index is into the concatenation of all gradients
+    struct SparseEntry
+    {
+        uint32_t m_index;
+        ElemType m_value;
+    };
+
+    void Initialize(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        size_t totalNumElements = 0;
+        for (auto gradient : gradients)
+        {
+            if (gradient->GetMatrixType() != DENSE || gradient->GetDeviceId() != CPUDEVICE)
+                RuntimeError("CompressedDistGradAggregator: Only dense gradient matrices on the CPU are currently supported.");
+
+            m_residuals.push_back(std::make_shared<Matrix<ElemType>>(gradient->GetNumRows(), gradient->GetNumCols(), CPUDEVICE));
+            m_residuals.back()->SetValue(0);
+
+            m_gradientOffsets.push_back(totalNumElements);
+            totalNumElements += gradient->GetNumElements();
+        }
+        m_gradientOffsets.push_back(totalNumElements);
+
+        if (m_topKRatio != 0)
+        {
+            if (totalNumElements > UINT32_MAX)
+                RuntimeError("CompressedDistGradAggregator: Top-k sparsification supports at most %u gradient elements.", (unsigned int) UINT32_MAX);
+            auto stripe = StripeRange(totalNumElements, MyRank());
+            m_aggregatedStripe.resize(stripe.second - stripe.first);
+        }
+        else
+        {
+            // residuals of the second quantization, of the stripes we aggregate
+            for (auto gradient : gradients)
+            {
+                auto stripe = StripeRange(gradient->GetNumCols(), MyRank());
+                m_stripeResiduals.push_back(std::vector<ElemType>(gradient->GetNumRows() * (stripe.second - stripe.first), 0));
+            }
+        }
+
+        fprintf(stderr, "CompressedDistGradAggregator: Aggregating %d gradient matrices with %s.\n", (int) gradients.size(),
+                m_topKRatio != 0 ? msra::strfun::strprintf("top-k sparsification (ratio %g)", m_topKRatio).c_str()
+                                 : msra::strfun::strprintf("%d-bit quantization", (int) m_numGradientBits).c_str());
+    }
+
+    // the range of stripe 'rank' of 'numItems' items (columns resp. elements)
+    std::pair<size_t, size_t> StripeRange(size_t numItems, size_t rank)
+    {
+        return std::make_pair(numItems * rank / NumProc(), numItems * (rank + 1) / NumProc());
+    }
+
+    // Aggregate the headers on all workers; they are summed up in rank order so that all get the same result.
+    void AggregateHeaders(DistGradHeader* headerCPU)
+    {
+        size_t headerSize = headerCPU->Size();
+        m_headerBuffer.resize(headerSize * NumProc());
+        MPI_Allgather(headerCPU, (int) headerSize, MPI_CHAR, m_headerBuffer.data(), (int) headerSize, MPI_CHAR, m_mpi->Communicator()) || MpiFail("MPI_Allgather");
+        for (size_t rank = 0; rank < NumProc(); rank++)
+            headerCPU->Aggregate((DistGradHeader*) &m_headerBuffer[rank * headerSize], /*add=*/rank > 0);
+    }
+
+    // -----------------------------------------------------------------------
+    // exchange of variable-size buffers
+    // -----------------------------------------------------------------------
+
+    // Sends sendBuffers[r] to worker r, and receives what worker r sent us into recvBuffers[r].
+    template <class T>
+    void ReduceScatterExchange(const std::vector<std::vector<T>>& sendBuffers, std::vector<std::vector<T>>& recvBuffers)
+    {
+        size_t numProc = NumProc();
+        std::vector<int> sendCounts(numProc), recvCounts(numProc), sendDispls(numProc), recvDispls(numProc);
+        m_sendBytes.clear();
+        for (size_t r = 0; r < numProc; r++)
+        {
+            sendDispls[r] = (int) m_sendBytes.size();
+            sendCounts[r] = (int) (sendBuffers[r].size() * sizeof(T));
+            m_sendBytes.insert(m_sendBytes.end(), (const char*) sendBuffers[r].data(), (const char*) (sendBuffers[r].data() + sendBuffers[r].size()));
+        }
+
+        MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, m_mpi->Communicator()) || MpiFail("MPI_Alltoall");
+
+        size_t totalRecvCount = 0;
+        for (size_t r = 0; r < numProc; r++)
+        {
+            recvDispls[r] = (int) totalRecvCount;
+            totalRecvCount += recvCounts[r];
+        }
+        m_recvBytes.resize(totalRecvCount);
+
+        MPI_Alltoallv(m_sendBytes.data(), sendCounts.data(), sendDispls.data(), MPI_CHAR,
+                      m_recvBytes.data(), recvCounts.data(), recvDispls.data(), MPI_CHAR, m_mpi->Communicator()) || MpiFail("MPI_Alltoallv");
+        m_numBytesScattered = m_sendBytes.size();
+
+        UnpackReceivedBuffers(recvCounts, recvDispls, recvBuffers);
+    }
+
+    // Sends sendBuffer to all workers, and receives what worker r sent into recvBuffers[r].
+    template <class T>
+    void AllGatherExchange(const std::vector<T>& sendBuffer, std::vector<std::vector<T>>& recvBuffers)
+    {
+        size_t numProc = NumProc();
+        std::vector<int> recvCounts(numProc), recvDispls(numProc);
+        int sendCount = (int) (sendBuffer.size() * sizeof(T));
+
+        MPI_Allgather(&sendCount, 1, MPI_INT, recvCounts.data(), 1, MPI_INT, m_mpi->Communicator()) || MpiFail("MPI_Allgather");
+
+        size_t totalRecvCount = 0;
+        for (size_t r = 0; r < numProc; r++)
+        {
+            recvDispls[r] = (int) totalRecvCount;
+            totalRecvCount += recvCounts[r];
+        }
+        m_recvBytes.resize(totalRecvCount);
+
+        MPI_Allgatherv((void*) sendBuffer.data(), sendCount, MPI_CHAR,
+                       m_recvBytes.data(), recvCounts.data(), recvDispls.data(), MPI_CHAR, m_mpi->Communicator()) || MpiFail("MPI_Allgatherv");
+        m_numBytesGathered = sendCount * (numProc - 1);
+
+        UnpackReceivedBuffers(recvCounts, recvDispls, recvBuffers);
+    }
+
+    template <class T>
+    void UnpackReceivedBuffers(const std::vector<int>& recvCounts, const std::vector<int>& recvDispls, std::vector<std::vector<T>>& recvBuffers)
+    {
+        recvBuffers.resize(NumProc());
+        for (size_t r = 0; r < NumProc(); r++)
+        {
+            recvBuffers[r].resize(recvCounts[r] / sizeof(T));
+            memcpy(recvBuffers[r].data(), m_recvBytes.data() + recvDispls[r], recvCounts[r]);
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // quantization mode
+    // -----------------------------------------------------------------------
+
+    size_t QuantizedColumnSize(size_t numRows) const
+    {
+        return QuantizedColumn<ElemType>::QuantizedColumnSize(m_numGradientBits, numRows);
+    }
+
+    // Quantize columns [colBegin, colEnd) of 'data' + 'residual' into consecutive QuantizedColumns at 'out', and update the residual.
+    void QuantizeColumns(const ElemType* data, ElemType* residual, size_t numRows, size_t colBegin, size_t colEnd, char* out) const
+    {
+        const size_t ldNumBits = ValueQuantizer<ElemType>::ld(m_numGradientBits);
+        for (size_t j = colBegin; j < colEnd; j++)
+        {
+            auto& qcol = *(QuantizedColumn<ElemType>*) (out + (j - colBegin) * QuantizedColumnSize(numRows));
+            // Explicit use of 'template' keyword is needed to compile with GCC
+            if (m_zeroThresholdFor1Bit)
+            {
+                ColumnQuantizer<ElemType>::template ComputeRangeStatColj<true>(data, residual, (long) numRows, j, m_numGradientBits, qcol.lower, qcol.upper);
+                ColumnQuantizer<ElemType>(ldNumBits, qcol.lower, qcol.upper).template Quantize<true>(data, residual, (long) numRows, j, qcol.bits, residual);
+            }
+            else
+            {
+                ColumnQuantizer<ElemType>::template ComputeRangeStatColj<false>(data, residual, (long) numRows, j, m_numGradientBits, qcol.lower, qcol.upper);
+                ColumnQuantizer<ElemType>(ldNumBits, qcol.lower, qcol.upper).template Quantize<false>(data, residual, (long) numRows, j, qcol.bits, residual);
+            }
+        }
+    }
+
+    // Unquantize consecutive QuantizedColumns at 'in' into columns [colBegin, colEnd) of 'data', or add them to it.
+    void UnquantizeColumns(const char* in, size_t numRows, size_t colBegin, size_t colEnd, ElemType* data, bool add) const
+    {
+        const size_t ldNumBits = ValueQuantizer<ElemType>::ld(m_numGradientBits);
+        for (size_t j = colBegin; j < colEnd; j++)
+        {
+            const auto& qcol = *(const QuantizedColumn<ElemType>*) (in + (j - colBegin) * QuantizedColumnSize(numRows));
+            ColumnQuantizer<ElemType>(ldNumBits, qcol.lower, qcol.upper).Unquantize(data, (long) numRows, j, qcol.bits, add);
+        }
+    }
+
+    void AggregateQuantized(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        size_t numProc = NumProc();
+
+        // reduce-scatter: quantize our gradients, and send stripe r of each to worker r
+        m_sendBuffers.resize(numProc);
+        for (size_t r = 0; r < numProc; r++)
+        {
+            m_sendBuffers[r].clear();
+            for (size_t i = 0; i < gradients.size(); i++)
+            {
+                size_t numRows = gradients[i]->GetNumRows();
+                auto stripe = StripeRange(gradients[i]->GetNumCols(), r);
+                size_t offset = m_sendBuffers[r].size();
+                m_sendBuffers[r].resize(offset + (stripe.second - stripe.first) * QuantizedColumnSize(numRows));
+                QuantizeColumns(gradients[i]->Data(), m_residuals[i]->Data(), numRows, stripe.first, stripe.second, m_sendBuffers[r].data() + offset);
+            }
+        }
+        ReduceScatterExchange(m_sendBuffers, m_recvBuffers);
+
+        // sum up all contributions to our stripes, and quantize the sums for the all-gather
+        std::vector<size_t> recvOffsets(numProc, 0);
+        m_sendBuffer.clear();
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            size_t numRows = gradients[i]->GetNumRows();
+            auto stripe = StripeRange(gradients[i]->GetNumCols(), MyRank());
+            size_t numStripeCols = stripe.second - stripe.first;
+            size_t numStripeBytes = numStripeCols * QuantizedColumnSize(numRows);
+
+            m_aggregatedStripe.resize(numRows * numStripeCols);
+            for (size_t r = 0; r < numProc; r++)
+            {
+                UnquantizeColumns(m_recvBuffers[r].data() + recvOffsets[r], numRows, 0, numStripeCols, m_aggregatedStripe.data(), /*add=*/r > 0);
+                recvOffsets[r] += numStripeBytes;
+            }
+
+            size_t offset = m_sendBuffer.size();
+            m_sendBuffer.resize(offset + numStripeBytes);
+            QuantizeColumns(m_aggregatedStripe.data(), m_stripeResiduals[i].data(), numRows, 0, numStripeCols, m_sendBuffer.data() + offset);
+        }
+
+        // all-gather: every worker receives all aggregated stripes
+        AllGatherExchange(m_sendBuffer, m_recvBuffers);
+        for (size_t r = 0; r < numProc; r++)
+        {
+            size_t offset = 0;
+            for (size_t i = 0; i < gradients.size(); i++)
+            {
+                size_t numRows = gradients[i]->GetNumRows();
+                auto stripe = StripeRange(gradients[i]->GetNumCols(), r);
+                UnquantizeColumns(m_recvBuffers[r].data() + offset, numRows, stripe.first, stripe.second, gradients[i]->Data(), /*add=*/false);
+                offset += (stripe.second - stripe.first) * QuantizedColumnSize(numRows);
+            }
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // top-k sparsification mode
+    // -----------------------------------------------------------------------
+
+    void AggregateTopK(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        size_t numProc = NumProc();
+        size_t totalNumElements = m_gradientOffsets.back();
+
+        // reduce-scatter: send the largest elements of each gradient (plus residual) to the workers owning them
+        m_sparseSendBuffers.resize(numProc);
+        for (auto& buffer : m_sparseSendBuffers)
+            buffer.clear();
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            const ElemType* gradient = gradients[i]->Data();
+            ElemType* residual = m_residuals[i]->Data();
+            size_t numElements = gradients[i]->GetNumElements();
+            if (numElements == 0)
+                continue;
+            for (size_t k = 0; k < numElements; k++)
+                residual[k] += gradient[k];
+
+            size_t numSelected = std::min(numElements, std::max((size_t) 1, (size_t) ceil(m_topKRatio * numElements)));
+            m_selection.resize(numElements);
+            std::iota(m_selection.begin(), m_selection.end(), (uint32_t) 0);
+            if (numSelected < numElements)
+            {
+                std::nth_element(m_selection.begin(), m_selection.begin() + numSelected, m_selection.end(), [residual](uint32_t a, uint32_t b)
+                {
+                    return fabs(residual[a]) > fabs(residual[b]);
+                });
+                m_selection.resize(numSelected);
+                std::sort(m_selection.begin(), m_selection.end());
+            }
+
+            // the selected elements are sent, and thus no longer part of the residual
+            size_t owner = 0;
+            for (uint32_t k : m_selection)
+            {
+                size_t index = m_gradientOffsets[i] + k;
+                while (index >= StripeRange(totalNumElements, owner).second)
+                    owner++;
+                m_sparseSendBuffers[owner].push_back(SparseEntry{ (uint32_t) index, residual[k] });
+                residual[k] = 0;
+            }
+        }
+        ReduceScatterExchange(m_sparseSendBuffers, m_sparseRecvBuffers);
+
+        // sum up all contributions to our stripe, and send its non-zeroes to everyone
+        auto stripe = StripeRange(totalNumElements, MyRank());
+        std::fill(m_aggregatedStripe.begin(), m_aggregatedStripe.end(), (ElemType) 0);
+        for (const auto& buffer : m_sparseRecvBuffers)
+        {
+            for (const auto& entry : buffer)
+                m_aggregatedStripe[entry.m_index - stripe.first] += entry.m_value;
+        }
+
+        m_sparseSendBuffer.clear();
+        for (size_t k = 0; k < m_aggregatedStripe.size(); k++)
+        {
+            if (m_aggregatedStripe[k] != 0)
+                m_sparseSendBuffer.push_back(SparseEntry{ (uint32_t) (stripe.first + k), m_aggregatedStripe[k] });
+        }
+        AllGatherExchange(m_sparseSendBuffer, m_sparseRecvBuffers);
+
+        // the aggregated gradient is zero except for the elements received
+        for (auto gradient : gradients)
+            gradient->SetValue(0);
+        for (const auto& buffer : m_sparseRecvBuffers)
+        {
+            for (const auto& entry : buffer)
+            {
+                size_t i = std::upper_bound(m_gradientOffsets.begin(), m_gradientOffsets.end(), (size_t) entry.m_index) - m_gradientOffsets.begin() - 1;
+                gradients[i]->Data()[entry.m_index - m_gradientOffsets[i]] = entry.m_value;
+            }
+        }
+    }
+
+private:
+    size_t m_numGradientBits;
+    bool m_zeroThresholdFor1Bit;
+    double m_topKRatio;
+
+    // compression error of each gradient, carried over to the next minibatch
+    std::vector<std::shared_ptr<Matrix<ElemType>>> m_residuals;
+    // quantization mode: compression error of the aggregated stripe of each gradient
+    std::vector<std::vector<ElemType>> m_stripeResiduals;
+    // offset of each gradient in the concatenation of all gradients, plus the total number of elements
+    std::vector<size_t> m_gradientOffsets;
+
+    // buffers, kept across minibatches to avoid reallocation
+    std::vector<ElemType> m_aggregatedStripe;
+    std::vector<std::vector<char>> m_sendBuffers, m_recvBuffers;
+    std::vector<char> m_sendBuffer;
+    std::vector<std::vector<SparseEntry>> m_sparseSendBuffers, m_sparseRecvBuffers;
+    std::vector<SparseEntry> m_sparseSendBuffer;
+    std::vector<uint32_t> m_selection;
+    std::vector<char> m_sendBytes, m_recvBytes;
+    std::vector<char> m_headerBuffer;
+
+    int m_syncStatsTrace;
+    size_t m_iterationCount;
+    size_t m_numBytesScattered;
+    size_t m_numBytesGathered;
+};
+} } }
@@ -104,6 +104,12 @@ struct CriterionAccumulator
         else
             return EpochCriterion(m_aggregateCriterionValues->GetValue(0, i), m_aggregateSampleCounts[i]);
     }
+    // set an accumulated result, e.g. to continue accumulating where an epoch was left off
+    void SetCriterion(size_t i, const EpochCriterion& value)
+    {
+        m_aggregateCriterionValues->SetValue(0, i, (ElemType)value.first);
+        m_aggregateSampleCounts[i] = value.second;
+    }
 
 private:
     // shared part of Add() and Assign()
@@ -21,6 +21,13 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int epochNumber) = 0;
 
+    // Optionally called during backprop for each of the gradients as soon as its value for the current minibatch is final,
+    // so that the aggregator can start communicating it while the remaining gradients are still being computed.
+    // AggregateGradients() is still called with all gradients afterwards, and completes the aggregation.
+    virtual void GradientReady(Matrix<ElemType>* /*gradient*/)
+    {
+    }
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
@@ -0,0 +1,383 @@
+//
+// <copyright file="ParameterServerSGD.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "MASGD.h"
+#include "Matrix.h"
+#include "MPIWrapper.h"
+#include "TimerUtility.h"
+#include <vector>
+#include <list>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+    // The staleness bookkeeping of a parameter server: a pull of a worker can be answered unless the worker is more than
+    // 'maxStaleness' pushes ahead of another worker that is still active, i.e. that has not yet reached the end of the epoch.
+    class BoundedStalenessClock
+    {
+    public:
+        BoundedStalenessClock(size_t numWorkers, size_t maxStaleness)
+            : m_clock(numWorkers, 0), m_isActive(numWorkers, true), m_maxStaleness(maxStaleness)
+        {
+        }
+
+        void OnPush(size_t worker)
+        {
+            m_clock[worker]++;
+        }
+
+        // the worker will not push before the next epoch (or ever again), so it must not hold back the others
+        void Deactivate(size_t worker)
+        {
+            m_isActive[worker] = false;
+        }
+
+        // All workers have reached the end of the epoch and start the next one with the same model.
+        // The pushes of the past epochs are forgotten, as the workers may have processed different numbers of minibatches.
+        void OnEpochEnd()
+        {
+            m_clock.assign(m_clock.size(), 0);
+            m_isActive.assign(m_isActive.size(), true);
+        }
+
+        bool MayAnswer(size_t worker) const
+        {
+            for (size_t w = 0; w < m_clock.size(); w++)
+            {
+                if (m_isActive[w] && m_clock[worker] > m_clock[w] && m_clock[worker] - m_clock[w] > m_maxStaleness)
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        std::vector<size_t> m_clock;  // number of pushes per worker in the current epoch
+        std::vector<bool> m_isActive; // whether a worker counts for the staleness bound
+        size_t m_maxStaleness;
+    };
+
+    // Asynchronous parameter-server training.
+    // The last 'numServers' MPI ranks are set aside as parameter servers (see MPIWrapper::SetAsideRanks()); each owns a contiguous
+    // shard of the concatenated learnable parameters. The other ranks are workers that train with their local SGD as usual and, at
+    // each sync point, push the change of their model since their last pull to the servers, which add it to their shard, and pull
+    // the current parameters back. Workers do not wait for each other, except that a server holds back the reply to a pull
+    // while the pulling worker is more than 'maxStaleness' pushes ahead of the slowest worker (bounded staleness);
+    // with maxStaleness = SIZE_MAX, workers never wait for each other.
+    // At the end of each epoch, all workers wait for each other, so that they all end the epoch with the same model.
+    template<typename ElemType>
+    class ParameterServerSGD : public IMASGD<ElemType>
+    {
+        typedef IMASGD<ElemType> Base;
+        using Base::m_pMPI;
+        using Base::m_numWorkers;
+        using Base::m_myRank;
+        using Base::m_numSyncPerformed;
+        using Base::m_perfReporter;
+        using Base::DownCast;
+
+        // message tags
+        enum : int
+        {
+            TagInit = 1,     // worker 0 -> server: initial values of the shard
+            TagPush,         // worker -> server: change of the shard since the worker's last pull
+            TagPull,         // worker -> server: request for the current values of the shard
+            TagPullAtEpochEnd, // worker -> server: like TagPull, but answered only once all workers have reached the end of the epoch
+            TagShutdown,     // worker -> server: the worker is done with training
+            TagAbort,        // worker -> server: training failed on the worker
+            TagParameters    // server -> worker: current values of the shard
+        };
+
+    public:
+        // Must be called by all ranks, after the servers have been set aside.
+        ParameterServerSGD(const MPIWrapperPtr& pMPI, size_t numServers, size_t maxStaleness, size_t reportFreq, DEVICEID_TYPE devID)
+            : Base(pMPI, reportFreq, devID), m_numServers(numServers), m_maxStaleness(maxStaleness), m_numElements(0),
+              m_secondsOnCommunication(0), m_numSyncsInEpoch(0)
+        {
+            int numRanks;
+            MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+            if (m_numServers == 0 || m_numWorkers + m_numServers != (size_t) numRanks)
+                LogicError("ParameterServerSGD: The servers must have been set aside from the MPI ranks.");
+            MPI_Comm_dup(MPI_COMM_WORLD, &m_serverComm) || MpiFail("ParameterServerSGD: MPI_Comm_dup");
+            if (!IsServer())
+            {
+                if (m_maxStaleness == SIZE_MAX)
+                    fprintf(stderr, "Parallel training (%d workers) using %d parameter servers without staleness bound\n", (int) m_numWorkers, (int) m_numServers);
+                else
+                    fprintf(stderr, "Parallel training (%d workers) using %d parameter servers with maxStaleness = %d\n", (int) m_numWorkers, (int) m_numServers, (int) m_maxStaleness);
+            }
+        }
+
+        ~ParameterServerSGD()
+        {
+            // release the servers; if we are unwinding from an error, they must not wait for our pushes either
+            if (!IsServer())
+            {
+                int tag = std::uncaught_exception() ? TagAbort : TagShutdown;
+                for (size_t s = 0; s < m_numServers; s++)
+                    MPI_Send(nullptr, 0, MPI_CHAR, ServerRank(s), tag, m_serverComm); // (no MpiFail, as this may be during stack unwinding)
+            }
+        }
+
+        bool IsServer() const
+        {
+            return m_pMPI->IsIdle();
+        }
+
+        void OnEpochStart(const std::list<ComputationNodeBasePtr>& learnableNodes) override
+        {
+            Base::OnEpochStart(learnableNodes);
+            m_secondsOnCommunication = 0;
+            m_numSyncsInEpoch = 0;
+
+            // the first time, the servers are initialized with the model of the main node, which all workers then pull
+            if (m_pulledModel.empty())
+            {
+                m_numElements = GetModel(learnableNodes, m_model);
+                m_pulledModel.resize(m_numElements);
+                Exchange(m_pMPI->IsMainNode() ? TagInit : 0, TagPull);
+                SetModel(learnableNodes, m_pulledModel);
+            }
+        }
+
+        void OnEpochEnd(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                        std::list<Matrix<ElemType>>& /*smoothedGradient*/,
+                        size_t /*samplesSinceLastSync*/) override
+        {
+            PushAndPull(learnableNodes, TagPullAtEpochEnd);
+            m_pMPI->WaitAll();
+            m_perfReporter.OnEpochEnd();
+            fprintf(stderr, "\t\t(parameter server stats): %d syncs in this epoch, %.2f seconds spent on communication with the servers\n",
+                    (int) m_numSyncsInEpoch, m_secondsOnCommunication);
+        }
+
+        bool OnArrivingAtSyncPoint(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                   std::list<Matrix<ElemType>>& smoothedGradient,
+                                   size_t samplesSinceLastSync) override
+        {
+            size_t totalSamplesProcessed;
+            float secondsOnCommunication;
+            ModelAggregationProcessing(samplesSinceLastSync, learnableNodes, smoothedGradient, totalSamplesProcessed, secondsOnCommunication);
+            return true;
+        }
+
+        void ModelAggregationProcessing(
+            size_t samplesSinceLastSync,                                       /* in */
+            const std::list<ComputationNodeBasePtr>&  learnableNodes,          /* in/out */
+            std::list<Matrix<ElemType>>&              /*smoothedGradient*/,    /* in/out */
+            size_t&                                   totalSamplesProcessed,   /* out: only this worker's, the servers do not count samples */
+            float&                                    secondsOnCommunication   /* out */) override
+        {
+            Timer commTimer;
+            commTimer.Start();
+            PushAndPull(learnableNodes, TagPull);
+            commTimer.Stop();
+
+            totalSamplesProcessed = samplesSinceLastSync;
+            secondsOnCommunication = (float) commTimer.ElapsedSeconds();
+            m_secondsOnCommunication += secondsOnCommunication;
+        }
+
+        // The main loop of a server rank: serve the workers until all of them have shut down.
+        void RunServer()
+        {
+            if (!IsServer())
+                LogicError("RunServer: This rank is not a parameter server.");
+
+            size_t numWorkers = m_numWorkers;
+            std::vector<ElemType> shard, received;
+            BoundedStalenessClock clock(numWorkers, m_maxStaleness);
+            std::vector<int> pendingPulls, pendingEpochEndPulls;
+            size_t numShutDown = 0, numPushes = 0, numPulls = 0, numDelayedPulls = 0;
+            bool isInitialized = false;
+            MPI_Datatype dataType = MPIWrapper::GetDataType((ElemType*) nullptr);
+
+            fprintf(stderr, "ParameterServerSGD: rank %d serving %d workers\n", (int) m_myRank, (int) numWorkers);
+
+            auto mayAnswer = [&](int worker)
+            {
+                return isInitialized && clock.MayAnswer(worker);
+            };
+
+            while (numShutDown < numWorkers)
+            {
+                MPI_Status status;
+                MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, m_serverComm, &status) || MpiFail("RunServer: MPI_Probe");
+                int worker = status.MPI_SOURCE;
+                if (worker >= (int) numWorkers)
+                    LogicError("RunServer: Unexpected message from rank %d.", worker);
+
+                switch (status.MPI_TAG)
+                {
+                case TagInit:
+                {
+                    int count;
+                    MPI_Get_count(&status, dataType, &count) || MpiFail("RunServer: MPI_Get_count");
+                    shard.resize(count);
+                    received.resize(count);
+                    MPI_Recv(shard.data(), count, dataType, worker, TagInit, m_serverComm, MPI_STATUS_IGNORE) || MpiFail("RunServer: MPI_Recv");
+                    isInitialized = true;
+                    fprintf(stderr, "ParameterServerSGD: rank %d holds a shard of %d parameters\n", (int) m_myRank, count);
+                    break;
+                }
+                case TagPush:
+                    if (!isInitialized)
+                        LogicError("RunServer: Received a push before the initial parameters.");
+                    MPI_Recv(received.data(), (int) received.size(), dataType, worker, TagPush, m_serverComm, MPI_STATUS_IGNORE) || MpiFail("RunServer: MPI_Recv");
+                    for (size_t i = 0; i < shard.size(); i++)
+                        shard[i] += received[i];
+                    clock.OnPush(worker);
+                    numPushes++;
+                    break;
+                case TagPull:
+                    MPI_Recv(nullptr, 0, MPI_CHAR, worker, TagPull, m_serverComm, MPI_STATUS_IGNORE) || MpiFail("RunServer: MPI_Recv");
+                    pendingPulls.push_back(worker);
+                    numPulls++;
+                    if (!mayAnswer(worker))
+                        numDelayedPulls++;
+                    break;
+                case TagPullAtEpochEnd:
+                    // the worker will not push again before all workers have reached the end of the epoch, so it must not hold back the others
+                    MPI_Recv(nullptr, 0, MPI_CHAR, worker, TagPullAtEpochEnd, m_serverComm, MPI_STATUS_IGNORE) || MpiFail("RunServer: MPI_Recv");
+                    pendingEpochEndPulls.push_back(worker);
+                    clock.Deactivate(worker);
+                    break;
+                case TagShutdown:
+                    MPI_Recv(nullptr, 0, MPI_CHAR, worker, TagShutdown, m_serverComm, MPI_STATUS_IGNORE) || MpiFail("RunServer: MPI_Recv");
+                    clock.Deactivate(worker);
+                    numShutDown++;
+                    break;
+                case TagAbort:
+                    // the other workers cannot complete the epoch without this one, so fail rather than wait for them forever
+                    MPI_Recv(nullptr, 0, MPI_CHAR, worker, TagAbort, m_serverComm, MPI_STATUS_IGNORE) || MpiFail("RunServer: MPI_Recv");
+                    RuntimeError("RunServer: Training failed on worker rank %d.", worker);
+                default:
+                    LogicError("RunServer: Unexpected message tag %d from rank %d.", status.MPI_TAG, worker);
+                }
+
+                // answer all pulls that the staleness bound permits now
+                for (size_t i = 0; i < pendingPulls.size();)
+                {
+                    if (mayAnswer(pendingPulls[i]))
+                    {
+                        MPI_Send(shard.data(), (int) shard.size(), dataType, pendingPulls[i], TagParameters, m_serverComm) || MpiFail("RunServer: MPI_Send");
+                        pendingPulls.erase(pendingPulls.begin() + i);
+                    }
+                    else
+                        i++;
+                }
+                if (pendingEpochEndPulls.size() == numWorkers)
+                {
+                    for (int w : pendingEpochEndPulls)
+                        MPI_Send(shard.data(), (int) shard.size(), dataType, w, TagParameters, m_serverComm) || MpiFail("RunServer: MPI_Send");
+                    pendingEpochEndPulls.clear();
+                    clock.OnEpochEnd();
+                }
+            }
+
+            fprintf(stderr, "ParameterServerSGD: rank %d done; %d pushes, %d pulls, of which %d were delayed by the staleness bound\n",
+                    (int) m_myRank, (int) numPushes, (int) numPulls, (int) numDelayedPulls);
+        }
+
+    private:
+        int ServerRank(size_t s) const
+        {
+            return (int) (m_numWorkers + s);
+        }
+        size_t ShardBegin(size_t s) const
+        {
+            return m_numElements * s / m_numServers;
+        }
+        size_t ShardSize(size_t s) const
+        {
+            return ShardBegin(s + 1) - ShardBegin(s);
+        }
+
+        // concatenate the parameters to update into 'model'; returns the total number of elements
+        size_t GetModel(const std::list<ComputationNodeBasePtr>& learnableNodes, std::vector<ElemType>& model)
+        {
+            size_t numElements = 0;
+            for (auto& node : learnableNodes)
+            {
+                if (node->IsParameterUpdateRequired())
+                    numElements += DownCast(node)->Value().GetNumElements();
+            }
+            model.resize(numElements);
+
+            size_t offset = 0;
+            for (auto& node : learnableNodes)
+            {
+                if (!node->IsParameterUpdateRequired())
+                    continue;
+                const Matrix<ElemType>& value = DownCast(node)->Value();
+                value.CopySection(value.GetNumRows(), value.GetNumCols(), model.data() + offset, value.GetNumRows());
+                offset += value.GetNumElements();
+            }
+            return numElements;
+        }
+
+        void SetModel(const std::list<ComputationNodeBasePtr>& learnableNodes, std::vector<ElemType>& model)
+        {
+            size_t offset = 0;
+            for (auto& node : learnableNodes)
+            {
+                if (!node->IsParameterUpdateRequired())
+                    continue;
+                Matrix<ElemType>& value = DownCast(node)->Value();
+                value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), model.data() + offset);
+                offset += value.GetNumElements();
+            }
+        }
+
+        // push the change of the model since the last pull, and pull the current parameters
+        void PushAndPull(const std::list<ComputationNodeBasePtr>& learnableNodes, int pullTag)
+        {
+            GetModel(learnableNodes, m_model);
+            for (size_t i = 0; i < m_numElements; i++)
+                m_model[i] -= m_pulledModel[i];
+            Exchange(TagPush, pullTag);
+            SetModel(learnableNodes, m_pulledModel);
+            m_numSyncPerformed++;
+            m_numSyncsInEpoch++;
+        }
+
+        // send m_model to the servers with 'sendTag' (unless 0), and receive their parameters into m_pulledModel
+        void Exchange(int sendTag, int pullTag)
+        {
+            MPI_Datatype dataType = MPIWrapper::GetDataType(m_model.data());
+            std::vector<MPI_Request> requests;
+            requests.reserve(3 * m_numServers);
+            // the receives are posted first, so that the servers' replies never have to wait for them
+            for (size_t s = 0; s < m_numServers; s++)
+            {
+                requests.push_back(MPI_REQUEST_NULL);
+                MPI_Irecv(m_pulledModel.data() + ShardBegin(s), (int) ShardSize(s), dataType, ServerRank(s), TagParameters, m_serverComm, &requests.back()) || MpiFail("ParameterServerSGD: MPI_Irecv");
+            }
+            for (size_t s = 0; s < m_numServers; s++)
+            {
+                if (sendTag != 0)
+                {
+                    requests.push_back(MPI_REQUEST_NULL);
+                    MPI_Isend(m_model.data() + ShardBegin(s), (int) ShardSize(s), dataType, ServerRank(s), sendTag, m_serverComm, &requests.back()) || MpiFail("ParameterServerSGD: MPI_Isend");
+                }
+                requests.push_back(MPI_REQUEST_NULL);
+                MPI_Isend(nullptr, 0, MPI_CHAR, ServerRank(s), pullTag, m_serverComm, &requests.back()) || MpiFail("ParameterServerSGD: MPI_Isend");
+            }
+            MPI_Waitall((int) requests.size(), requests.data(), MPI_STATUSES_IGNORE) || MpiFail("ParameterServerSGD: MPI_Waitall");
+        }
+
+        size_t m_numServers;
+        size_t m_maxStaleness;
+        MPI_Comm m_serverComm;             // duplicate of MPI_COMM_WORLD, so that our messages cannot be confused with others
+        size_t m_numElements;              // total number of parameters
+        std::vector<ElemType> m_model;     // the local model, or its change since the last pull
+        std::vector<ElemType> m_pulledModel; // the parameters last pulled from the servers
+        double m_secondsOnCommunication;
+        size_t m_numSyncsInEpoch;
+    };
+
+} } }
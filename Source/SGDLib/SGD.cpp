@@ -17,6 +17,8 @@
 #endif
 
 #include "SimpleDistGradAggregator.h"
+#include "CompressedDistGradAggregator.h"
+#include "ParameterServerSGD.h"
 #include "ProgressTracing.h"
 
 #include <map>
@@ -80,6 +82,17 @@ void SGD<ElemType>::Train(function<ComputationNetworkPtr(DEVICEID_TYPE)> createN
     // set tracing flags
     net->EnableNodeTracing(m_traceNodeNamesReal, m_traceNodeNamesCategory, m_traceNodeNamesSparse);
 
+    // optionally replace LSTM subgraphs by fused LSTM nodes (checkpoints hold the original subgraphs, so this applies to them as well)
+    if (m_fuseLSTMs)
+        net->FuseLSTMs<ElemType>();
+
+    // optionally split projections of stacked inputs inside recurrent loops (a no-op for checkpoints, which were saved split)
+    if (m_hoistLoopInvariantProjections)
+        net->HoistLoopInvariantProjections<ElemType>();
+
+    // optionally run independent nodes and loops concurrently; this must be known before the matrices get allocated
+    net->SetConcurrentScheduling(m_concurrentNodeThreads);
+
     TrainOrAdaptModel(startEpoch, net, loadNetworkFromCheckpoint, net, nullptr, trainSetDataReader, validationSetDataReader);
 }
 
@@ -288,6 +301,18 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     {
         InitModelAggregationHandler(m_syncStatsTrace, net->GetDeviceId());
     }
+    else if (GetParallelizationMethod() == ParallelizationMethod::parameterServerSGD)
+    {
+        InitModelAggregationHandler(m_syncStatsTrace, net->GetDeviceId());
+
+        // the parameter servers do nothing but serve the workers until they are done
+        auto parameterServerSGD = dynamic_pointer_cast<ParameterServerSGD<ElemType>>(m_pMASGDHelper);
+        if (parameterServerSGD->IsServer())
+        {
+            parameterServerSGD->RunServer();
+            return;
+        }
+    }
     
     // precompute mean and invStdDev nodes and save initial model
     // When no precompute, only save if we did not load the model from a 
@@ -323,6 +348,24 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             prevLearnRates[startEpoch % m_numPrevLearnRates] = learnRatePerSample;
     }
 
+    // With numMBsToCheckPoint, a checkpoint taken in the middle of the first epoch (more recent than the model the epoch
+    // started from) lets us resume that epoch where it was left off.
+    bool resumePartialEpoch = false;
+    if (m_numMBsToCheckPoint > 0)
+    {
+        if (!trainSetDataReader->SupportsSamplePosition())
+            InvalidArgument("numMBsToCheckPoint: The reader does not support resuming an epoch in the middle; use a reader based on the new reader architecture, and no truncated BPTT.");
+        if (m_pMASGDHelper)
+            InvalidArgument("numMBsToCheckPoint is not supported with model averaging, block momentum, or parameter servers.");
+        // only the main node's position is saved
+        if (m_mpi && m_mpi->NumNodesInUse() > 1 && !trainSetDataReader->IsSamplePositionSharedByWorkers())
+            InvalidArgument("numMBsToCheckPoint is not supported for parallel training with a reader whose position differs between workers, e.g. with bucketingLookahead.");
+        // The .ckp file is written after the model (see SaveCheckPoint()), so one that is older than the model belongs to another checkpoint.
+        resumePartialEpoch = networkLoadedFromCheckpoint &&
+                             msra::files::fuptodate(GetPartialEpochCheckPointFileName(startEpoch), GetPartialEpochModelName(startEpoch), true) &&
+                             msra::files::fuptodate(GetPartialEpochModelName(startEpoch), GetModelNameForEpoch(startEpoch - 1), false);
+    }
+
     if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch &&
         !learnRateInitialized && m_learningRatesParam.size() <= startEpoch)
     {
@@ -364,6 +407,24 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         Timer timer;
         timer.Start();
 
+        // resume the epoch from a checkpoint taken in its middle
+        bool resumingEpoch = resumePartialEpoch && i == startEpoch;
+        PartialEpochInfo partialEpoch;
+        double resumedLearnRatePerSample = 0;
+        size_t resumedMinibatchSize = 0;
+        if (resumingEpoch)
+        {
+            LOGPRINTF(stderr, "Resuming epoch %d from checkpoint '%ls'.\n", i + 1, GetPartialEpochModelName(i).c_str());
+            net->RereadPersistableParameters<ElemType>(GetPartialEpochModelName(i));
+            LoadCheckPointInfo(i,
+                               /*out*/ totalTrainingSamplesSeen,
+                               /*out*/ resumedLearnRatePerSample,
+                               smoothedGradients,
+                               /*out*/ prevCriterion,
+                               /*out*/ resumedMinibatchSize,
+                               /*out*/ &partialEpoch);
+        }
+
         // set dropout rate for this epoch
         // We use the same seed across workers until parallel training kicks in to ensure that the workers have identical models
         size_t parallelWorkerIdx = ((m_mpi == nullptr) || !UsingParallelTrain(i)) ? 0 : m_mpi->CurrentNodeRank();
@@ -374,7 +435,11 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                                                          m_batchNormalizationBlendTimeConstant[i], prevNormalizationBlendTimeConstant);
         
         // learning rate adjustment
-        if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::None || i < m_learningRatesParam.size())
+        if (resumingEpoch)
+        {
+            learnRatePerSample = resumedLearnRatePerSample; // as it was when the checkpoint was taken
+        }
+        else if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::None || i < m_learningRatesParam.size())
         {
             // BUGBUG: GetNumParallelSequences() returns 1 under certain situations; it seems when restarting from checkpoint
             learnRatePerSample = GetLearningRatePerSample(i /*BUGBUG workaround:*/, trainSetDataReader->GetNumParallelSequencesForFixingBPTTMode());
@@ -423,7 +488,11 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // basis for a set number of epochs.  For epochs after that point, m_mbSize.size(), either
         // we just keep using
         // the last minibatch size, or we use tuning to try and find a better one.
-        if (m_autoAdjustMinibatch && i >= m_mbSize.size())
+        if (resumingEpoch)
+        {
+            chosenMinibatchSize = resumedMinibatchSize;
+        }
+        else if (m_autoAdjustMinibatch && i >= m_mbSize.size())
         {
             size_t numFramesToUseInSearch = m_numMiniBatch4LRSearch[i] * m_mbSize[i];
             if (m_epochSize != requestDataSize)
@@ -475,7 +544,15 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                       evaluationNodes,
                       inputMatrices,
                       learnableNodes, smoothedGradients,
-                      epochCriterion, epochEvalErrors);
+                      epochCriterion, epochEvalErrors,
+                      /*prefixMsg=*/ "",
+                      resumingEpoch ? &partialEpoch : nullptr,
+                      [&](const PartialEpochInfo& partialEpochNow)
+                      {
+                          SaveCheckPoint(net, GetPartialEpochModelName(i), GetPartialEpochCheckPointFileName(i),
+                                         totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize,
+                                         &partialEpochNow);
+                      });
         totalTrainingSamplesSeen += epochCriterion.second; // aggregate #training samples, for logging purposes only
 
         timer.Stop();
@@ -493,6 +570,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         for (size_t j = 0; j < epochEvalErrors.size(); j++)
             epochEvalErrors[j].LogCriterion(evaluationNodes[j]->NodeName());
         fprintf(stderr, "totalSamplesSeen = %d; learningRatePerSample = %.8g; epochTime=%.6gs\n", (int)totalTrainingSamplesSeen, learnRatePerSample, epochTime);
+        if (i == startEpoch && net->GetMBLayoutPtrOfNetwork())
+            net->PrintMemoryUsage(net->GetMBLayoutPtrOfNetwork()->GetNumCols()); // (sized by the last minibatch, which is typically a full one)
 #if 0
         // TODO: This was only printed if >1 eval criterion. Why? Needed?
         LOGPRINTF(stderr, "Finished Epoch[%2d of %d]:     Criterion Node [%ls] Per Sample = %.8g\n",
@@ -538,7 +617,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // broadcast epochCriterion to make sure each processor will have the same learning rate schedule
         if ((GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD 
             ||
-            GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD) 
+            GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD
+            ||
+            GetParallelizationMethod() == ParallelizationMethod::parameterServerSGD) 
             && (m_mpi->NumNodesInUse() > 1))
         {
             m_mpi->Bcast(&epochCriterion.first,  1, m_mpi->MainNodeRank());
@@ -570,6 +651,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     // roll back
                     auto bestModelPath = GetModelNameForEpoch(i - m_learnRateAdjustInterval);
                     LOGPRINTF(stderr, "Loading (rolling back to) previous model with best training-criterion value: %ls.\n", bestModelPath.c_str());
+                    WaitForCheckPointWriter(/*synchronizeWorkers=*/true);
                     net->RereadPersistableParameters<ElemType>(bestModelPath);
                     LoadCheckPointInfo(i - m_learnRateAdjustInterval,
                                        /*out*/ totalTrainingSamplesSeen,
@@ -665,14 +747,12 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 // Set i back to the loaded model
                 i -= m_learnRateAdjustInterval;
                 LOGPRINTF(stderr, "SGD: revoke back to and update checkpoint file for epoch %d\n", i+1); // report 1 based epoch number
-                SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize);
+                SaveCheckPoint(nullptr, L"", GetCheckPointFileNameForEpoch(i), totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize);
             }
             else
             {
-                SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize);
-                auto modelName = GetModelNameForEpoch(i);
-                LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
-                net->Save(modelName);
+                // files that are superseded once the new ones are written
+                vector<wstring> filesToDelete{ GetPartialEpochModelName(i), GetPartialEpochCheckPointFileName(i) };
                 if (!m_keepCheckPointFiles)
                 {
                     // delete previous checkpoint file to save space
@@ -680,18 +760,22 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     {
                         if (epochsSinceLastLearnRateAdjust != 1)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                            filesToDelete.push_back(GetCheckPointFileNameForEpoch(i - 1));
                         }
                         if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval).c_str());
+                            filesToDelete.push_back(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval));
                         }
                     }
                     else
                     {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                        filesToDelete.push_back(GetCheckPointFileNameForEpoch(i - 1));
                     }
                 }
+                auto modelName = GetModelNameForEpoch(i);
+                LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
+                SaveCheckPoint(net, modelName, GetCheckPointFileNameForEpoch(i), totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize,
+                               /*partialEpoch=*/nullptr, filesToDelete);
             }
         }
         else
@@ -713,6 +797,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
     // Synchronize all ranks before proceeding to ensure that
     // rank 0 has finished writing the model file
+    WaitForCheckPointWriter(/*synchronizeWorkers=*/false);
     if (m_mpi != nullptr)
     {
         m_mpi->WaitAll();
@@ -757,7 +842,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                                     std::list<Matrix<ElemType>>& smoothedGradients,
                                     /*out*/ EpochCriterion& epochCriterion,
                                     /*out*/ std::vector<EpochCriterion>& epochEvalErrors,
-                                    const std::string& prefixMsg)
+                                    const std::string& prefixMsg,
+                                    const PartialEpochInfo* resumeFrom,
+                                    const std::function<void(const PartialEpochInfo&)>& saveCheckPoint)
 {
     ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
 
@@ -786,6 +873,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     }
 
     std::vector<Matrix<ElemType>*> learnParamsGradients;
+    // the arenas of the fused update are kept from earlier epochs, unless the parameters got new matrices in between (e.g. from reloading the model)
+    if (m_fusedParameterUpdate && !IsFusedParameterUpdateValid(*m_fusedParameterUpdate, learnableNodes, smoothedGradients))
+        m_fusedParameterUpdate.reset();
     Profiler profiler(m_numMBsToCUDAProfile);
 
     // resetting this, so profiling is performed for one epoch only
@@ -804,6 +894,14 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         trainSetDataReader->StartMinibatchLoop(tunedMBSize, epochNumber, epochSize);
     }
 
+    // when resuming the epoch from a checkpoint, skip what was trained on already
+    if (resumeFrom)
+    {
+        trainSetDataReader->SetCurrentSamplePosition(resumeFrom->m_samplePosition);
+        numMBsRun = (int)resumeFrom->m_numMBsRun;
+        totalEpochSamples = resumeFrom->m_numSamples;
+    }
+
     net->StartEvaluateMinibatchLoop(evaluationNodes);
     net->StartEvaluateMinibatchLoop(criterionNodes);
     if (m_needAdaptRegularization && m_adaptationRegType == AdaptationRegType::KL && refNode)
@@ -839,6 +937,11 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         {
             fprintf(stderr, ", BufferedAsyncGradientAggregation is ENABLED");
         }
+
+        if (m_overlapGradientAggregation)
+        {
+            fprintf(stderr, ", OverlapGradientAggregation is ENABLED");
+        }
     }
 
     if (useDistributedMBReading)
@@ -863,6 +966,17 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     // The criterion values are accumulated here over the minibatches (without having to pull them off the GPU).
     CriterionAccumulator<ElemType> localEpochCriterion(1, net->GetDeviceId());
     CriterionAccumulator<ElemType> localEpochEvalErrors(epochEvalErrors.size(), net->GetDeviceId());
+    if (resumeFrom)
+    {
+        epochCriterion = resumeFrom->m_criterion;
+        epochEvalErrors = resumeFrom->m_evalErrors;
+        if (!useGradientAggregation)
+        {
+            localEpochCriterion.SetCriterion(0, epochCriterion);
+            for (size_t i = 0; i < epochEvalErrors.size(); i++)
+                localEpochEvalErrors.SetCriterion(i, epochEvalErrors[i]);
+        }
+    }
 
     // --- MAIN MINIBATCH LOOP
 
@@ -957,8 +1071,19 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 // backprop
                 // ===========================================================
 
+                // With overlapped gradient aggregation, we hand each gradient to the aggregator as soon as backprop has finalized it.
+                // Not with sub-minibatches, where the gradients are only final after the last one has been accumulated.
+                ComputationNetwork::GradientReadyCallback gradientReadyCallback;
+                if (useGradientAggregation && m_overlapGradientAggregation && actualNumSubminibatches == 1)
+                {
+                    gradientReadyCallback = [this](const ComputationNodeBasePtr& node)
+                    {
+                        m_distGradAgg->GradientReady(&dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient());
+                    };
+                }
+
                 if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                    net->Backprop(criterionNodes[0], gradientReadyCallback);
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
@@ -994,8 +1119,23 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             // distributed gradient aggregation
             if (learnParamsGradients.size() == 0)
             {
-                learnParamsGradients.reserve(learnableNodes.size());
-                for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+                // The overlapped aggregator all-reduces the gradients in the order of the list, so give them to it in the order
+                // backprop finalizes them, which is reverse evaluation order. (The same on all workers.)
+                std::list<ComputationNodeBasePtr> gradientNodes;
+                if (m_overlapGradientAggregation)
+                {
+                    std::set<ComputationNodeBasePtr> learnableNodeSet(learnableNodes.begin(), learnableNodes.end());
+                    const auto& evalOrder = net->GetEvalOrder(criterionNodes[0]);
+                    std::copy_if(evalOrder.rbegin(), evalOrder.rend(), std::back_inserter(gradientNodes), [&](const ComputationNodeBasePtr& node)
+                    {
+                        return learnableNodeSet.find(node) != learnableNodeSet.end();
+                    });
+                }
+                else
+                    gradientNodes = learnableNodes;
+
+                learnParamsGradients.reserve(gradientNodes.size());
+                for (auto nodeIter = gradientNodes.begin(); nodeIter != gradientNodes.end(); nodeIter++)
                 {
                     ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
                     if (node->IsParameterUpdateRequired())
@@ -1050,20 +1190,25 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             if (numSamplesInMinibatch != aggregateNumSamples)
                 fprintf(stderr, "SGD: using true #samples %d instead of MB size %d\n", (int)numSamplesInMinibatch, (int)aggregateNumSamples);
 #endif
+            // BUGBUG (Issue #95): Access to net MBLayout can no longer be done if we have multiple input layouts
+            double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences());
+            if (m_fusedParameterUpdate)
+                UpdateWeightsFused(*m_fusedParameterUpdate, learnableNodes, smoothedGradients, learnRatePerSample, momentumPerSample, numSamplesInMinibatch);
+
             auto smoothedGradientIter = smoothedGradients.begin();
-            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+            size_t nodeIndex = 0;
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++, nodeIndex++)
             {
                 ComputationNodeBasePtr node = *nodeIter;
-                if (node->IsParameterUpdateRequired())
+                if (node->IsParameterUpdateRequired() && !(m_fusedParameterUpdate && m_fusedParameterUpdate->isFused[nodeIndex]))
                 {
                     Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
 #ifdef _DEBUG
                     if (smoothedGradient.HasNan("TrainOneEpoch/UpdateWeights(): "))
                         LogicError("%ls %ls operation has NaNs in smoothedGradient.", node->NodeName().c_str(), node->OperationName().c_str());
 #endif
-                    // BUGBUG (Issue #95): Access to net MBLayout can no longer be done if we have multiple input layouts
                     UpdateWeights(node, smoothedGradient, learnRatePerSample,
-                                  GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences()), numSamplesInMinibatch,
+                                  momentumPerSample, numSamplesInMinibatch,
                                   m_L2RegWeight, m_L1RegWeight,
                                   m_needAveMultiplier, m_useNesterovMomentum);
 #ifdef _DEBUG
@@ -1072,6 +1217,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 #endif
                 }
             }
+
+            if (m_fuseParameterUpdates && !m_fusedParameterUpdate && numMBsRun == (resumeFrom ? (int)resumeFrom->m_numMBsRun : 0)) // first minibatch of this call
+                m_fusedParameterUpdate = SetUpFusedParameterUpdate(net, learnableNodes, smoothedGradients);
         }
 
         // aggregation by model averaging or block momentum 
@@ -1178,6 +1326,29 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         timer.Restart();
         totalEpochSamples += aggregateNumSamplesWithLabel;
 
+        // checkpoint in the middle of the epoch
+        // The reader position is the one of the next minibatch; the main node saves, as the position is the same for all workers.
+        if (saveCheckPoint && m_numMBsToCheckPoint > 0 && numMBsRun % m_numMBsToCheckPoint == 0 &&
+            ((m_mpi == nullptr) || m_mpi->IsMainNode()))
+        {
+            PartialEpochInfo partialEpoch;
+            partialEpoch.m_samplePosition = trainSetDataReader->GetCurrentSamplePosition();
+            partialEpoch.m_numMBsRun = numMBsRun;
+            partialEpoch.m_numSamples = totalEpochSamples;
+            if (!useGradientAggregation)
+            {
+                partialEpoch.m_criterion = localEpochCriterion.GetCriterion(0);
+                for (size_t i = 0; i < epochEvalErrors.size(); i++)
+                    partialEpoch.m_evalErrors.push_back(localEpochEvalErrors.GetCriterion(i));
+            }
+            else
+            {
+                partialEpoch.m_criterion = epochCriterion;
+                partialEpoch.m_evalErrors = epochEvalErrors;
+            }
+            saveCheckPoint(partialEpoch);
+        }
+
         // call DataEnd function
         // This signals something from SGD to the reader.
         // DataEnd does reader specific process if sentence ending is reached
@@ -1386,6 +1557,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     }
 
     int baseModelEpoch = epochNumber - 1;
+    WaitForCheckPointWriter(/*synchronizeWorkers=*/true);
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
     double learnRate = learnRatePerSample;
@@ -1745,6 +1917,7 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
 
     // go back to where we came from
     int baseModelEpoch = epochNumber - 1;
+    WaitForCheckPointWriter(/*synchronizeWorkers=*/true);
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
     double dummyLearnRate;
@@ -1801,12 +1974,17 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
 #ifdef CNTK_PARALLEL_TRAINING_SUPPORT
             m_distGradAgg = std::make_shared<AllReduceDistGradAggregator<ElemType>>(m_mpi, m_numGradientBits, m_zeroThresholdFor1Bit, true /*useQuantizationForSelfStripe*/, m_bufferedAsyncGradientAggregation, traceLevel, m_syncStatsTrace);
 #else
-            if (m_numGradientBits != (8 * sizeof(ElemType)))
+            if (m_numGradientBits != (8 * sizeof(ElemType)) || m_topKGradientRatio > 0)
             {
-                RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support!");
-            }
+                if (m_bufferedAsyncGradientAggregation)
+                    InvalidArgument("useBufferedAsyncGradientAggregation is not supported with gradient quantization or topKGradientRatio.");
+                if (m_gradientFusionBucketSizeInBytes > 0 || m_overlapGradientAggregation)
+                    InvalidArgument("gradientFusionBucketSizeInKB and overlapGradientAggregation are not supported with gradient quantization or topKGradientRatio.");
 
-            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace);
+                m_distGradAgg = std::make_shared<CompressedDistGradAggregator<ElemType>>(m_mpi, m_numGradientBits, m_zeroThresholdFor1Bit, m_topKGradientRatio, m_syncStatsTrace);
+            }
+            else
+                m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace, m_gradientFusionBucketSizeInBytes, m_overlapGradientAggregation);
 #endif // !CNTK_PARALLEL_TRAINING_SUPPORT
         }
 
@@ -1841,6 +2019,12 @@ void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE de
                                                                  m_modelAggregationBlockSize);
 #endif 
     }
+    else if (GetParallelizationMethod() == ParallelizationMethod::parameterServerSGD)
+    {
+        // the last ranks become the servers, the others the workers
+        m_mpi->SetAsideRanks(m_numParameterServers);
+        m_pMASGDHelper = make_shared<ParameterServerSGD<ElemType>>(m_mpi, m_numParameterServers, m_parameterServerMaxStaleness, traceLevel, devID);
+    }
 }
 // public:
 // UpdateWeightsS - static version of UpdateWeights()
@@ -1900,9 +2084,9 @@ template <class ElemType>
     }
     else if (adpType == GradientsUpdateType::AdaGrad ||
              (adpType == GradientsUpdateType::RmsProp && gradientValues.GetMatrixType() == MatrixType::SPARSE) ||
-             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE))
+             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE && gradientValues.GetDeviceId() != CPUDEVICE))
     {
-        // rmsprop for sparse is not implemented yet, delegate it with adagrad
+        // rmsprop for sparse, and fsadagrad for sparse on GPU, are not implemented yet, delegate them with adagrad
 
         double aveMultiplier = smoothedGradient.Adagrad(gradientValues, needAveMultiplier);
         Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
@@ -1963,6 +2147,153 @@ void SGD<ElemType>::UpdateWeights(const ComputationNodeBasePtr& node,
     node->BumpEvalTimeStamp();
 }
 
+template <class ElemType>
+auto SGD<ElemType>::SetUpFusedParameterUpdate(ComputationNetworkPtr net,
+                                              const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                              std::list<Matrix<ElemType>>& smoothedGradients) const -> std::unique_ptr<FusedParameterUpdate>
+{
+    // the per-weight part of UpdateWeightsS() can be fused, except for noise and norm-based clipping
+    size_t numSmoothedGradientsPerWeight;
+    switch (GradUpdateType())
+    {
+    case GradientsUpdateType::None:      numSmoothedGradientsPerWeight = 1; break;
+    case GradientsUpdateType::AdaGrad:   numSmoothedGradientsPerWeight = 1; break;
+    case GradientsUpdateType::FSAdaGrad: numSmoothedGradientsPerWeight = 2; break;
+    case GradientsUpdateType::RmsProp:   numSmoothedGradientsPerWeight = 3; break;
+    default:                             return nullptr;
+    }
+    if (GradientUpdateNoiseStd() > 0 || (m_clippingThresholdPerSample != std::numeric_limits<double>::infinity() && !m_gradientClippingWithTruncation))
+        return nullptr;
+
+    // fuse the dense CPU parameters
+    std::unique_ptr<FusedParameterUpdate> fused(new FusedParameterUpdate());
+    fused->numSmoothedGradientsPerWeight = numSmoothedGradientsPerWeight;
+    std::vector<ComputationNodeBasePtr> fusedNodes;
+    std::vector<Matrix<ElemType>*> fusedSmoothedGradients;
+    auto smoothedGradientIter = smoothedGradients.begin();
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+        const auto& value = node->Value();
+        const auto& gradient = node->Gradient();
+        bool isFused = node->IsParameterUpdateRequired() &&
+                       value.GetDeviceId() == CPUDEVICE && value.GetMatrixType() == DENSE &&
+                       gradient.GetMatrixType() == DENSE && gradient.GetNumRows() == value.GetNumRows() && gradient.GetNumCols() == value.GetNumCols() &&
+                       smoothedGradientIter->GetMatrixType() == DENSE && smoothedGradientIter->GetNumElements() == numSmoothedGradientsPerWeight * value.GetNumElements();
+        fused->isFused.push_back(isFused);
+        if (isFused)
+        {
+            fusedNodes.push_back(node);
+            fusedSmoothedGradients.push_back(&*smoothedGradientIter);
+        }
+    }
+    if (fusedNodes.empty())
+        return nullptr;
+
+    auto offsets = net->AllocateLearnableParametersContiguously<ElemType>(fusedNodes, fused->values, fused->gradients);
+    fused->smoothedGradients.Resize(1, numSmoothedGradientsPerWeight * fused->values.GetNumElements());
+    for (size_t i = 0, k = 0; i < fused->isFused.size(); i++)
+    {
+        fused->offsets.push_back(fused->isFused[i] ? offsets[k] : SIZE_MAX);
+        if (!fused->isFused[i])
+            continue;
+
+        Matrix<ElemType>& smoothedGradient = *fusedSmoothedGradients[k];
+        Matrix<ElemType> view = fused->smoothedGradients.ColumnSlice(numSmoothedGradientsPerWeight * offsets[k], smoothedGradient.GetNumElements());
+        view.Reshape(smoothedGradient.GetNumRows(), smoothedGradient.GetNumCols());
+        if (!view.IsEmpty())
+            view.SetValue(smoothedGradient);
+        smoothedGradient = std::move(view);
+        k++;
+    }
+
+    if (m_traceLevel > 0)
+        LOGPRINTF(stderr, "SGD: Fusing the updates of %d out of %d learnable parameters (%d weights).\n",
+                  (int) fusedNodes.size(), (int) learnableNodes.size(), (int) fused->values.GetNumElements());
+    return fused;
+}
+
+template <class ElemType>
+bool SGD<ElemType>::IsFusedParameterUpdateValid(const FusedParameterUpdate& fused,
+                                                const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                                const std::list<Matrix<ElemType>>& smoothedGradients) const
+{
+    if (fused.isFused.size() != learnableNodes.size())
+        return false;
+    auto smoothedGradientIter = smoothedGradients.begin();
+    size_t i = 0;
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++, i++)
+    {
+        if (fused.isFused[i] && !fused.IsInArenas(i, *dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter), *smoothedGradientIter))
+            return false;
+    }
+    return true;
+}
+
+template <class ElemType>
+void SGD<ElemType>::UpdateWeightsFused(FusedParameterUpdate& fused,
+                                       const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                       std::list<Matrix<ElemType>>& smoothedGradients,
+                                       const double learnRatePerSample,
+                                       const double momentumPerSample,
+                                       const size_t actualMBSize) const
+{
+    assert(actualMBSize > 0);
+
+    std::vector<MultiTensorSegment> segments;
+    std::vector<ComputationNodeBasePtr> updatedNodes;
+    auto smoothedGradientIter = smoothedGradients.begin();
+    size_t i = 0;
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++, i++)
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+        if (!fused.isFused[i] || !node->IsParameterUpdateRequired())
+            continue;
+
+        // a parameter drops out of the arenas if any of its matrices got replaced, e.g. by a sparse gradient
+        // Its smoothed gradients get their own storage then, as UpdateWeights() may need to reshape them.
+        if (!fused.IsInArenas(i, *node, *smoothedGradientIter))
+        {
+            if (smoothedGradientIter->GetMatrixType() == DENSE)
+                *smoothedGradientIter = smoothedGradientIter->DeepClone();
+            fused.isFused[i] = false;
+            continue;
+        }
+
+        segments.push_back(MultiTensorSegment{ fused.offsets[i], node->Value().GetNumElements(), learnRatePerSample * node->GetLearningRateMultiplier() });
+        updatedNodes.push_back(node);
+    }
+
+    // cf. UpdateWeightsS()
+    MultiTensorRegularization regularization;
+    regularization.clippingThreshold = m_clippingThresholdPerSample * actualMBSize;
+    regularization.L2RegWeight = m_L2RegWeight * actualMBSize;
+    regularization.L1RegWeight = m_L1RegWeight * actualMBSize;
+    const double momentum = MomentumPerMB(momentumPerSample, actualMBSize);
+    switch (GradUpdateType())
+    {
+    case GradientsUpdateType::None:
+        fused.smoothedGradients.MultiTensorNormalGrad(fused.gradients, fused.values, segments, regularization, (ElemType) momentum, m_useNesterovMomentum);
+        break;
+    case GradientsUpdateType::AdaGrad:
+        fused.smoothedGradients.MultiTensorAdagrad(fused.gradients, fused.values, segments, regularization, m_needAveMultiplier);
+        break;
+    case GradientsUpdateType::FSAdaGrad:
+        fused.smoothedGradients.MultiTensorFSAdagrad(actualMBSize, fused.gradients, fused.values, segments, regularization, (ElemType) momentum);
+        break;
+    case GradientsUpdateType::RmsProp:
+        fused.smoothedGradients.MultiTensorRmsProp(fused.gradients, fused.values, segments, regularization,
+                                                   (ElemType) m_rpi.gamma, (ElemType) m_rpi.inc, (ElemType) m_rpi.max, (ElemType) m_rpi.dec, (ElemType) m_rpi.min,
+                                                   m_needAveMultiplier);
+        break;
+    default:
+        LogicError("UpdateWeightsFused: Unexpected gradient update type.");
+    }
+
+    for (auto& node : updatedNodes)
+        node->BumpEvalTimeStamp();
+}
+
 template <class ElemType>
 void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const
 {
@@ -1985,56 +2316,131 @@ void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actual
 }
 
 template <class ElemType>
-void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen,
-                                       const double learnRatePerSample,
-                                       const std::list<Matrix<ElemType>>& smoothedGradients,
-                                       const double prevCriterion,
-                                       const size_t minibatchSize)
+void SGD<ElemType>::SaveCheckPoint(ComputationNetworkPtr net, const wstring& modelFileName,
+                                   const wstring& checkPointFileName, const size_t totalSamplesSeen,
+                                   const double learnRatePerSample,
+                                   const std::list<Matrix<ElemType>>& smoothedGradients,
+                                   const double prevCriterion,
+                                   const size_t minibatchSize,
+                                   const PartialEpochInfo* partialEpoch,
+                                   const std::vector<wstring>& filesToDelete)
 {
     // In case of parallel training only the main node should we saving the checkpoint to prevent
     // the parallel training nodes from colliding to write the same file
-    if ((m_mpi == nullptr) || m_mpi->IsMainNode())
+    if ((m_mpi != nullptr) && !m_mpi->IsMainNode())
+        return;
+
+    // one checkpoint at a time
+    WaitForCheckPointWriter(/*synchronizeWorkers=*/false);
+
+    // An epoch is resumed from a checkpoint taken in its middle only if the .ckp file exists, so that one is deleted first
+    // and written last. If we die in between, there is no .ckp file rather than one that does not belong to the model.
+    // The reader position and smoothed gradients of a newer checkpoint must never be combined with the weights of an older one.
+
+    // The model aggregation state is saved by its helper, which works on the live state; so that is written right away.
+    if (!m_asyncCheckPoint || m_pMASGDHelper)
     {
-        wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
-        // Saving into temporary file and then renaming it to the checkPointFileName
-        // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
-        wstring tempFileName = checkPointFileName + L".tmp";
+        if (partialEpoch)
+            _wunlink(checkPointFileName.c_str());
+        else
+            SaveCheckPointInfo(checkPointFileName, totalSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, minibatchSize, partialEpoch, /*saveModelAggregationState=*/true);
+        if (net)
+            net->Save(modelFileName);
+        if (partialEpoch)
+            SaveCheckPointInfo(checkPointFileName, totalSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, minibatchSize, partialEpoch, /*saveModelAggregationState=*/true);
+        for (const auto& fileName : filesToDelete)
+            _wunlink(fileName.c_str());
+        return;
+    }
 
-        {
-            File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
-            fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
+    // take a snapshot in CPU memory, and write that in the background
+    auto netSnapshot = net ? net->CreateSnapshotForSaving<ElemType>() : nullptr;
+    auto smoothedGradientsSnapshot = make_shared<std::list<Matrix<ElemType>>>();
+    for (const auto& smoothedGradient : smoothedGradients)
+        smoothedGradientsSnapshot->emplace_back(smoothedGradient, CPUDEVICE);
+    auto partialEpochSnapshot = partialEpoch ? make_shared<PartialEpochInfo>(*partialEpoch) : nullptr;
+    m_checkPointWriter = std::async(std::launch::async, [=]()
+    {
+        if (partialEpochSnapshot)
+            _wunlink(checkPointFileName.c_str());
+        else
+            SaveCheckPointInfo(checkPointFileName, totalSamplesSeen, learnRatePerSample, *smoothedGradientsSnapshot, prevCriterion, minibatchSize, nullptr, /*saveModelAggregationState=*/false);
+        if (netSnapshot)
+            netSnapshot->Save(modelFileName);
+        if (partialEpochSnapshot)
+            SaveCheckPointInfo(checkPointFileName, totalSamplesSeen, learnRatePerSample, *smoothedGradientsSnapshot, prevCriterion, minibatchSize, partialEpochSnapshot.get(), /*saveModelAggregationState=*/false);
+        for (const auto& fileName : filesToDelete)
+            _wunlink(fileName.c_str());
+    });
+}
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
-            fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
+template <class ElemType>
+void SGD<ElemType>::WaitForCheckPointWriter(const bool synchronizeWorkers)
+{
+    if (m_checkPointWriter.valid())
+        m_checkPointWriter.get(); // (rethrows if writing failed)
+    if (synchronizeWorkers && m_asyncCheckPoint && m_mpi != nullptr)
+        m_mpi->WaitAll();
+}
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
-            fstream << minibatchSize;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
+template <class ElemType>
+void SGD<ElemType>::SaveCheckPointInfo(const wstring& checkPointFileName, const size_t totalSamplesSeen,
+                                       const double learnRatePerSample,
+                                       const std::list<Matrix<ElemType>>& smoothedGradients,
+                                       const double prevCriterion,
+                                       const size_t minibatchSize,
+                                       const PartialEpochInfo* partialEpoch,
+                                       const bool saveModelAggregationState)
+{
+    // Saving into temporary file and then renaming it to the checkPointFileName
+    // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
+    wstring tempFileName = checkPointFileName + L".tmp";
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+    {
+        File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
+        fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
 
-            for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
-            {
-                const Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
-                fstream << smoothedGradient;
-            }
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
+        fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
+        fstream << minibatchSize;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
-            if (m_pMASGDHelper)
-                m_pMASGDHelper->SaveToCheckPoint(fstream);
-            // Ensuring that data is written
-            fstream.Flush();
+        for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+        {
+            const Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
+            fstream << smoothedGradient;
         }
 
-        _wunlink(checkPointFileName.c_str());
-        renameOrDie(tempFileName, checkPointFileName);
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+
+        if (partialEpoch)
+        {
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPartialEpoch");
+            fstream << partialEpoch->m_samplePosition << partialEpoch->m_numMBsRun << partialEpoch->m_numSamples;
+            fstream << partialEpoch->m_criterion.first << partialEpoch->m_criterion.second;
+            fstream << partialEpoch->m_evalErrors.size();
+            for (const auto& evalError : partialEpoch->m_evalErrors)
+                fstream << evalError.first << evalError.second;
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPartialEpoch");
+        }
+
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
+        if (m_pMASGDHelper && saveModelAggregationState)
+            m_pMASGDHelper->SaveToCheckPoint(fstream);
+        // Ensuring that data is written
+        fstream.Flush();
     }
+
+    _wunlink(checkPointFileName.c_str());
+    renameOrDie(tempFileName, checkPointFileName);
 }
 
 template <class ElemType>
@@ -2071,9 +2477,11 @@ void SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
                                        /*out*/ double& learnRatePerSample,
                                        std::list<Matrix<ElemType>>& smoothedGradients,
                                        /*out*/ double& prevCriterion,
-                                       /*out*/ size_t& minibatchSize)
+                                       /*out*/ size_t& minibatchSize,
+                                       /*out*/ PartialEpochInfo* partialEpoch)
 {
-    let checkPointFileName = GetCheckPointFileNameForEpoch(int(epochNumber));
+    // if 'partialEpoch' is given, the checkpoint taken in the middle of the epoch is loaded
+    let checkPointFileName = partialEpoch ? GetPartialEpochCheckPointFileName(int(epochNumber)) : GetCheckPointFileNameForEpoch(int(epochNumber));
     File fstream(checkPointFileName,
                  FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
 
@@ -2110,6 +2518,19 @@ void SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
     }
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EGradient");
 
+    if (partialEpoch)
+    {
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPartialEpoch");
+        fstream >> partialEpoch->m_samplePosition >> partialEpoch->m_numMBsRun >> partialEpoch->m_numSamples;
+        fstream >> partialEpoch->m_criterion.first >> partialEpoch->m_criterion.second;
+        size_t numEvalErrors;
+        fstream >> numEvalErrors;
+        partialEpoch->m_evalErrors.resize(numEvalErrors);
+        for (auto& evalError : partialEpoch->m_evalErrors)
+            fstream >> evalError.first >> evalError.second;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPartialEpoch");
+    }
+
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECKP");
 
     if (m_pMASGDHelper)
@@ -2126,6 +2547,18 @@ wstring SGD<ElemType>::GetCheckPointFileNameForEpoch(const int epoch)
     return GetModelNameForEpoch(epoch) + L".ckp";
 }
 
+template <class ElemType>
+wstring SGD<ElemType>::GetPartialEpochModelName(const int epoch)
+{
+    return GetModelNameForEpoch(epoch) + L".partial";
+}
+
+template <class ElemType>
+wstring SGD<ElemType>::GetPartialEpochCheckPointFileName(const int epoch)
+{
+    return GetPartialEpochModelName(epoch) + L".ckp";
+}
+
 template <class ElemType>
 wstring SGD<ElemType>::GetModelNameForEpoch(const int epoch, bool bLastModel)
 {
@@ -2315,7 +2748,8 @@ static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
     else if (EqualCI(s, L"DataParallelSGD"))         return ParallelizationMethod::dataParallelSGD;
     else if (EqualCI(s, L"ModelAveragingSGD"))       return ParallelizationMethod::modelAveragingSGD;
     else if (EqualCI(s, L"BlockMomentumSGD"))        return ParallelizationMethod::blockMomentumSGD;
-    else InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | DataParallelSGD | ModelAveragingSGD | BlockMomentumSGD)");
+    else if (EqualCI(s, L"ParameterServerSGD"))      return ParallelizationMethod::parameterServerSGD;
+    else InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | DataParallelSGD | ModelAveragingSGD | BlockMomentumSGD | ParameterServerSGD)");
 }
 
 static LearningRateSearchAlgorithm ParseLearningRateSearchType(const wstring& s)
@@ -2433,6 +2867,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_needAveMultiplier = configSGD(L"normWithAveMultiplier", true);
     m_L2RegWeight = configSGD(L"L2RegWeight", 0.0);
     m_L1RegWeight = configSGD(L"L1RegWeight", 0.0);
+    m_fuseParameterUpdates = configSGD(L"fuseParameterUpdates", false);
 
     // for backward support. future setup should use gradUpdateType=AdaGrad, instead of
     // useAdagrad=true
@@ -2457,6 +2892,10 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
     m_useAllDataForPreComputedNode = configSGD(L"UseAllDataForPreComputedNode", true);
 
+    m_fuseLSTMs = configSGD(L"fuseLSTMs", false);
+    m_hoistLoopInvariantProjections = configSGD(L"hoistLoopInvariantProjections", false);
+    m_concurrentNodeThreads = configSGD(L"concurrentNodeThreads", (size_t) 0);
+
     // consistency checks
     for (size_t i = 0; i < m_mbSize.size(); i++)
     {
@@ -2558,9 +2997,14 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = 32;
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_gradientFusionBucketSizeInBytes = 0;
+    m_overlapGradientAggregation = false;
+    m_topKGradientRatio = 0;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
     m_modelAggregationBlockSize = 0; 
+    m_numParameterServers = 1;
+    m_parameterServerMaxStaleness = 4;
 
     if (configSGD.Exists(L"ParallelTrain"))
     {
@@ -2580,6 +3024,12 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_enableDistributedMBReading = configParallelTrain(L"distributedMBReading", false);
             m_syncStatsTrace = configParallelTrain(L"syncPerfStats", (int)0);
 
+            // algorithm for all-reduces of dense data: mpi (MPI_Allreduce), ring, hierarchical (shared memory within, ring across machines), or auto
+            AllReduceAlgorithm allReduceAlgorithm = MPIWrapper::ParseAllReduceAlgorithm(configParallelTrain(L"allReduceAlgorithm", L"mpi"));
+            size_t allReduceAutoThresholdInBytes = configParallelTrain(L"allReduceAutoThresholdInKB", (size_t) 64) * 1024;
+            size_t allReduceRanksPerNode = configParallelTrain(L"allReduceRanksPerNode", (size_t) 0); // 0: one node per machine
+            pMPI->SetAllReduceAlgorithm(allReduceAlgorithm, allReduceAutoThresholdInBytes, allReduceRanksPerNode);
+
             if (configParallelTrain.Exists(L"DataParallelSGD"))
             {
                 const ConfigRecordType& configDataParallelSGD(configParallelTrain(L"DataParallelSGD", ConfigRecordType::Record()));
@@ -2587,6 +3037,16 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 m_numGradientBits = configDataParallelSGD(L"gradientBits", defaultGradientBits);
                 m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
                 m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+                m_gradientFusionBucketSizeInBytes = configDataParallelSGD(L"gradientFusionBucketSizeInKB", (size_t) 0) * 1024;
+                m_overlapGradientAggregation = configDataParallelSGD(L"overlapGradientAggregation", false);
+                m_topKGradientRatio = configDataParallelSGD(L"topKGradientRatio", 0.0);
+                if (m_overlapGradientAggregation && m_bufferedAsyncGradientAggregation)
+                    InvalidArgument("overlapGradientAggregation and useBufferedAsyncGradientAggregation cannot be combined.");
+#ifdef CNTK_PARALLEL_TRAINING_SUPPORT
+                // this build always aggregates with the 1-bit SGD AllReduceDistGradAggregator, which does not support these options
+                if (m_gradientFusionBucketSizeInBytes > 0 || m_overlapGradientAggregation || m_topKGradientRatio > 0)
+                    InvalidArgument("gradientFusionBucketSizeInKB, overlapGradientAggregation and topKGradientRatio are not supported with the 1-bit SGD gradient aggregator of this build.");
+#endif
                 if ( m_numGradientBits < 1 || m_numGradientBits > (8 * sizeofElemType) )
                 {
                     InvalidArgument("gradientBits must be in the range [1, 32] when using precision=float and in range [1, 64] when using precision=double!");
@@ -2696,6 +3156,19 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 InitializeAndCheckBlockMomentumSGDParameters();
                 
             }
+            if (configParallelTrain.Exists(L"ParameterServerSGD"))
+            {
+                const ConfigRecordType& configPSSGD(configParallelTrain(L"ParameterServerSGD", ConfigRecordType::Record()));
+                m_numParameterServers = configPSSGD(L"numServers", (size_t) 1);
+                if (m_numParameterServers < 1 || m_numParameterServers >= numMPIWorkers)
+                    InvalidArgument("ParameterServerSGD: numServers must be at least 1 and less than the number of MPI processes (%d).", (int) numMPIWorkers);
+                // a worker's pull waits while the worker is more than maxStaleness pushes ahead of the slowest worker; -1: never wait
+                int maxStaleness = configPSSGD(L"maxStaleness", (int) 4);
+                m_parameterServerMaxStaleness = maxStaleness < 0 ? SIZE_MAX : (size_t) maxStaleness;
+                // push and pull after this many samples per worker (0: after every minibatch)
+                m_modelAggregationBlockSize = configPSSGD(L"blockSizePerWorker", (size_t) 0);
+                m_modelAggregationBlockSize *= numMPIWorkers - m_numParameterServers;
+            }
         } // if (!pMPI)
     } // if (configSGD.Exists(L"ParallelTrain"))
 }
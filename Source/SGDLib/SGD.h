@@ -17,6 +17,7 @@
 #include "Config.h"
 #include <chrono>
 #include <random>
+#include <future>
 #include "Profiler.h"
 #include "MASGD.h"
 
@@ -24,7 +25,8 @@ using namespace std; // ugh! TODO: get rid of this from .h files!!!
 
 #define CNTK_CHECKPOINT_VERSION_1 1     // 1 -> no version number 
 #define CNTK_CHECKPOINT_VERSION_2 2     
-#define CURRENT_CNTK_CHECKPOINT_VERSION CNTK_CHECKPOINT_VERSION_2
+#define CNTK_CHECKPOINT_VERSION_3 3     // 3 -> optional partial-epoch section, for checkpoints taken in the middle of an epoch
+#define CURRENT_CNTK_CHECKPOINT_VERSION CNTK_CHECKPOINT_VERSION_3
 
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -50,8 +52,8 @@ enum class GradientsUpdateType : int
     FSAdaGrad
 };
 
-// modelParallelSGD can be combined with dataParallelSGD/modelAveragingSGD/blockMomentumSGD 
-// but dataParallelSGD/modelAveragingSGD/blockMomentumSGD are mutually exclusive (at least at the moment)
+// modelParallelSGD can be combined with dataParallelSGD/modelAveragingSGD/blockMomentumSGD/parameterServerSGD 
+// but dataParallelSGD/modelAveragingSGD/blockMomentumSGD/parameterServerSGD are mutually exclusive (at least at the moment)
 // we assign the lower 8 bits to the enumerate data parallelization methods 
 // and next 8 bits to model parallelization methods
 enum class ParallelizationMethod : int
@@ -60,6 +62,7 @@ enum class ParallelizationMethod : int
     dataParallelSGD = 1,
     modelAveragingSGD = 2,
     blockMomentumSGD = 3,
+    parameterServerSGD = 4,
     modelParallelSGD = (1 << 8) // Currently unsupported
 };
 
@@ -248,6 +251,10 @@ protected:
 
     bool m_useAllDataForPreComputedNode;
 
+    bool m_fuseLSTMs; // replace LSTM subgraphs by OptimizedLSTMNodes (CPU only)
+    bool m_hoistLoopInvariantProjections; // split W * [x(t); h(t-1)] inside recurrent loops, see ComputationNetwork::HoistLoopInvariantProjections()
+    size_t m_concurrentNodeThreads;       // run independent nodes concurrently on this many threads (CPU only), see ComputationNetwork::SetConcurrentScheduling()
+
     // Parallel training
     MPIWrapperPtr m_mpi;
 
@@ -265,6 +272,9 @@ protected:
     int m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
     bool m_zeroThresholdFor1Bit;
+    size_t m_gradientFusionBucketSizeInBytes; // 0: all-reduce each gradient matrix separately
+    bool m_overlapGradientAggregation;        // start aggregating gradients during backprop
+    double m_topKGradientRatio;               // if > 0: only exchange this fraction of the largest gradient elements
 
     // Parallel training related with MA / BM
     size_t m_modelAggregationBlockSize;
@@ -273,10 +283,16 @@ protected:
     double m_blockLearningRate; 
     double m_blockMomentumAsTimeConstant;
 
+    // Parallel training with parameter servers
+    size_t m_numParameterServers;
+    size_t m_parameterServerMaxStaleness; // SIZE_MAX: unbounded
+
     bool m_needAveMultiplier;
     double m_L2RegWeight;
     double m_L1RegWeight;
 
+    bool m_fuseParameterUpdates; // update all parameters in one pass (CPU only), see FusedParameterUpdate
+
     // sequence training
     double m_hSmoothingWeight;
     double m_frameDropThresh;
@@ -291,6 +307,16 @@ protected:
 template <class ElemType>
 class IDistGradAggregator;
 
+// progress within an epoch, recorded in checkpoints taken in the middle of an epoch (see numMBsToCheckPoint)
+struct PartialEpochInfo
+{
+    size_t m_samplePosition; // where the reader is to resume, from IDataReader::GetCurrentSamplePosition()
+    size_t m_numMBsRun;
+    size_t m_numSamples;     // samples trained on so far in this epoch
+    EpochCriterion m_criterion;
+    std::vector<EpochCriterion> m_evalErrors;
+};
+
 // -----------------------------------------------------------------------
 // class SGD
 // -----------------------------------------------------------------------
@@ -312,6 +338,8 @@ public:
           // TODO: The next few do not belong into SGD any more than the network or reader we operate on. Either move network and reader in here, or move these out.
           m_modelPath((const wstring&) configSGD(L"modelPath")),
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
+          m_numMBsToCheckPoint(configSGD(L"numMBsToCheckPoint", (size_t) 0)),
+          m_asyncCheckPoint(configSGD(L"asyncCheckPoint", false)),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName ((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
           m_traceNodeNamesReal    (configSGD(L"traceNodeNamesReal",     ConfigRecordType::Array(stringargvector()))),
@@ -465,7 +493,9 @@ protected:
                          std::list<Matrix<ElemType>>& smoothedGradients,
                          /*out*/ EpochCriterion& epochCriterion,
                          /*out*/ std::vector<EpochCriterion>& epochEvalErrors,
-                         const std::string& prefixMsg = "");
+                         const std::string& prefixMsg = "",
+                         const PartialEpochInfo* resumeFrom = nullptr,
+                         const std::function<void(const PartialEpochInfo&)>& saveCheckPoint = nullptr);
 
     void InitDistGradAgg(int numEvalNodes, int traceLevel);
     void InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE devID);
@@ -493,13 +523,72 @@ protected:
                        const bool needAveMultiplier,
                        const bool useNesterovMomentum) const;
 
+    // Fused update of all learnable parameters in one parallel pass (CPU only), instead of one or more per parameter.
+    // The values, gradients and smoothed gradients of the parameters are stored back to back in arenas, which are set up
+    // after the first minibatch of training, when the gradients have their final type and the smoothed gradients their final shape.
+    // They are kept across epochs, unless a parameter's matrices have been replaced in the meantime (e.g. by reloading the model).
+    struct FusedParameterUpdate
+    {
+        FusedParameterUpdate() : values(CPUDEVICE), gradients(CPUDEVICE), smoothedGradients(CPUDEVICE) { }
+
+        Matrix<ElemType> values;
+        Matrix<ElemType> gradients;
+        Matrix<ElemType> smoothedGradients;
+        size_t numSmoothedGradientsPerWeight;
+        std::vector<bool> isFused;   // for each learnable node
+        std::vector<size_t> offsets; // for each learnable node, of its values and gradients in the arenas (if fused)
+
+        // are the matrices of learnable node i still the ones in the arenas?
+        bool IsInArenas(size_t i, const ComputationNode<ElemType>& node, const Matrix<ElemType>& smoothedGradient) const
+        {
+            size_t offset = offsets[i];
+            const auto& gradient = node.Gradient();
+            return gradient.GetMatrixType() == DENSE && gradient.Data() == gradients.Data() + offset &&
+                   node.Value().Data() == values.Data() + offset &&
+                   smoothedGradient.GetMatrixType() == DENSE && smoothedGradient.Data() == smoothedGradients.Data() + numSmoothedGradientsPerWeight * offset;
+        }
+    };
+
+    std::unique_ptr<FusedParameterUpdate> SetUpFusedParameterUpdate(ComputationNetworkPtr net,
+                                                                    const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                                                    std::list<Matrix<ElemType>>& smoothedGradients) const;
+
+    // is the fused update that was set up earlier still valid for these parameters?
+    bool IsFusedParameterUpdateValid(const FusedParameterUpdate& fused,
+                                     const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                     const std::list<Matrix<ElemType>>& smoothedGradients) const;
+
+    // update the fused parameters; the others are left to UpdateWeights()
+    void UpdateWeightsFused(FusedParameterUpdate& fused,
+                            const std::list<ComputationNodeBasePtr>& learnableNodes,
+                            std::list<Matrix<ElemType>>& smoothedGradients,
+                            const double learnRatePerSample,
+                            const double momentumPerSample,
+                            const size_t actualMBSize) const;
+
     void ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const;
 
-    void SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen, // TODO: combine totalSamplesSeen and prevCriterion into a EpochCriterion type
+    // Writes the checkpoint file, and the model too if 'net' is given; then deletes 'filesToDelete'.
+    // With asyncCheckPoint, the parameters and smoothed gradients are copied into CPU memory and written by a
+    // background thread, while training goes on.
+    void SaveCheckPoint(ComputationNetworkPtr net, const wstring& modelFileName,
+                        const wstring& checkPointFileName, const size_t totalSamplesSeen, // TODO: combine totalSamplesSeen and prevCriterion into a EpochCriterion type
+                        const double learnRatePerSample,
+                        const std::list<Matrix<ElemType>>& smoothedGradients,
+                        const double prevCriterion,
+                        const size_t minibatchSize,
+                        const PartialEpochInfo* partialEpoch = nullptr,
+                        const std::vector<wstring>& filesToDelete = std::vector<wstring>());
+    void SaveCheckPointInfo(const wstring& checkPointFileName, const size_t totalSamplesSeen,
                             const double learnRatePerSample,
                             const std::list<Matrix<ElemType>>& smoothedGradients,
                             const double prevCriterion,
-                            const size_t minibatchSize);
+                            const size_t minibatchSize,
+                            const PartialEpochInfo* partialEpoch,
+                            const bool saveModelAggregationState);
+    // Waits until a checkpoint being written in the background is complete (rethrowing its error, if any).
+    // With 'synchronizeWorkers', all workers wait for that, so that they can read the files.
+    void WaitForCheckPointWriter(const bool synchronizeWorkers);
 
     bool TryLoadCheckPointInfo(const size_t epochNumber,
                                /*out*/ size_t& totalSamplesSeen,
@@ -512,9 +601,13 @@ protected:
                             /*out*/ double& learnRatePerSample,
                             std::list<Matrix<ElemType>>& smoothedGradients,
                             /*out*/ double& prevCriterion,
-                            /*out*/ size_t& minibatchSize);
+                            /*out*/ size_t& minibatchSize,
+                            /*out*/ PartialEpochInfo* partialEpoch = nullptr);
 
     wstring GetCheckPointFileNameForEpoch(const int epoch);
+    // model and checkpoint files for a checkpoint taken in the middle of an epoch
+    wstring GetPartialEpochModelName(const int epoch);
+    wstring GetPartialEpochCheckPointFileName(const int epoch);
     wstring GetModelNameForEpoch(const int epoch, bool bLastModel = false);
 
     // return -1 if nothing exists
@@ -540,6 +633,9 @@ public:
 protected:
     std::wstring m_modelPath;
     bool m_keepCheckPointFiles;
+    size_t m_numMBsToCheckPoint; // save a checkpoint every this many minibatches, in addition to the end of each epoch (0: off)
+    bool m_asyncCheckPoint;      // write checkpoints on a background thread
+    std::future<void> m_checkPointWriter;
 
     std::wstring m_trainCriterionNodeName;
     std::wstring m_evalCriterionNodeName;
@@ -557,6 +653,8 @@ protected:
 
     shared_ptr<IMASGD<ElemType>> m_pMASGDHelper;
 
+    std::unique_ptr<FusedParameterUpdate> m_fusedParameterUpdate; // (if m_fuseParameterUpdates) set up in the first minibatch of training, then kept across epochs
+
 private:
     void MarkDropoutNodesEvalTimeStampAsOutdated(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode);
 
@@ -567,7 +665,8 @@ private:
     bool UsingModelAggregation(size_t epochNumber) const
     {
         return ((GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD ||
-                 GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD) &&
+                 GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD ||
+                 GetParallelizationMethod() == ParallelizationMethod::parameterServerSGD) &&
                 (epochNumber >= m_parallelizationStartEpochNum));
     }
     bool UsingParallelTrain(size_t epochNumber) const
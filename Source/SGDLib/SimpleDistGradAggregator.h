@@ -3,6 +3,9 @@
 #include "IDistGradAggregator.h"
 #include "CUDAPageLockedMemAllocator.h"
 #include <future>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
 #include "GPUDataTransferer.h"
 #include "TimerUtility.h"
 #include "MatrixQuantizerImpl.h"
@@ -15,13 +18,35 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int syncStatsTrace)
-        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0)
+    // If 'fusionBucketSizeInBytes' is non-zero, gradient matrices smaller than that are packed into contiguous
+    // fusion buffers of up to that size, so that each bucket takes a single all-reduce instead of one per matrix.
+    // If 'useOverlappedAggregation' is set, the all-reduce of a bucket is started as soon as GradientReady() has been called
+    // for all its gradients. Buckets are posted in order, so the gradients should be passed in the order backprop finalizes them.
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int syncStatsTrace, size_t fusionBucketSizeInBytes = 0, bool useOverlappedAggregation = false)
+        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_fusionBucketSizeInBytes(fusionBucketSizeInBytes),
+          m_useOverlappedAggregation(useOverlappedAggregation), m_numBucketsReady(0), m_abortAllReducePosting(false)
     {
+        if (m_useAsyncAggregation && m_useOverlappedAggregation)
+            InvalidArgument("SimpleDistGradAggregator: Buffered async and overlapped gradient aggregation cannot be combined.");
     }
 
     ~SimpleDistGradAggregator()
     {
+        // an in-flight async aggregation still uses the headers and buckets
+        if (m_pendingAsyncAggregation.valid())
+            m_pendingAsyncAggregation.wait();
+
+        // backprop may have failed after handing us some of the gradients
+        if (m_pendingAllReducePosting.valid())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_bucketsReadyMutex);
+                m_abortAllReducePosting = true;
+            }
+            m_bucketsReadyChanged.notify_all();
+            m_pendingAllReducePosting.wait();
+        }
+
         for (size_t i = 0; i < m_recvHeaders.size(); ++i)
         {
             DistGradHeader::Destroy(m_recvHeaders[i]);
@@ -122,6 +147,22 @@ public:
         }
     }
 
+    void GradientReady(Matrix<ElemType>* gradient) override
+    {
+        if (!m_useOverlappedAggregation)
+            return;
+
+        // gradients we don't know yet (in particular, all of them before the first AggregateGradients() call) are aggregated
+        // in AggregateGradients() as usual
+        auto iter = m_bucketOfGradient.find(gradient);
+        if (iter == m_bucketOfGradient.end())
+            return;
+
+        auto& bucket = m_gradientBuckets[iter->second];
+        if (++bucket.m_numGradientsReady == bucket.m_gradientIndices.size())
+            BucketReady(iter->second);
+    }
+
 private:
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
@@ -135,6 +176,181 @@ private:
                                          });
     }
 
+    // A bucket is a run of consecutive gradient matrices that are all-reduced together.
+    // Buckets with more than one gradient matrix pack them into a contiguous fusion buffer; a bucket with a
+    // single gradient matrix reduces it in place.
+    struct GradientBucket
+    {
+        std::vector<size_t> m_gradientIndices;
+        size_t m_numElements;
+        std::unique_ptr<Matrix<ElemType>> m_fusionBuffer;
+
+        // overlapped aggregation: progress of the current minibatch
+        size_t m_numGradientsReady;
+        bool m_isReady;
+        std::unique_ptr<MatrixComputeStreamEvent> m_readyEvent; // GPU: recorded on the main compute stream once all gradients are computed
+
+        GradientBucket() : m_numElements(0), m_numGradientsReady(0), m_isReady(false) { }
+    };
+
+    void CreateGradientBuckets(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        size_t maxBucketElements = m_fusionBucketSizeInBytes / sizeof(ElemType);
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            size_t numElements = gradients[i]->GetNumElements();
+            bool fitsIntoLastBucket = !m_gradientBuckets.empty() &&
+                                      (m_gradientBuckets.back().m_numElements + numElements <= maxBucketElements);
+            if (!fitsIntoLastBucket)
+                m_gradientBuckets.push_back(GradientBucket());
+
+            auto& bucket = m_gradientBuckets.back();
+            bucket.m_gradientIndices.push_back(i);
+            bucket.m_numElements += numElements;
+        }
+
+        for (size_t b = 0; b < m_gradientBuckets.size(); b++)
+        {
+            auto& bucket = m_gradientBuckets[b];
+            if (bucket.m_gradientIndices.size() > 1)
+                bucket.m_fusionBuffer.reset(new Matrix<ElemType>(1, bucket.m_numElements, gradients[0]->GetDeviceId()));
+            for (size_t i : bucket.m_gradientIndices)
+                m_bucketOfGradient[gradients[i]] = b;
+        }
+        m_allReduceRequests.resize(m_gradientBuckets.size());
+
+        if (m_fusionBucketSizeInBytes > 0)
+            fprintf(stderr, "SimpleDistGradAggregator: %d gradient matrices are aggregated in %d buckets of up to %d bytes.\n",
+                    (int) gradients.size(), (int) m_gradientBuckets.size(), (int) m_fusionBucketSizeInBytes);
+    }
+
+    // copy the gradients into the fusion buffer (fromBuffer = false), or back from it (fromBuffer = true)
+    static void CopyFusionBuffer(const GradientBucket& bucket, const std::vector<Matrix<ElemType>*>& gradients, bool fromBuffer)
+    {
+        if (!bucket.m_fusionBuffer)
+            return;
+
+        size_t offset = 0;
+        for (size_t i : bucket.m_gradientIndices)
+        {
+            Matrix<ElemType>& gradient = *gradients[i];
+            size_t numElements = gradient.GetNumElements();
+            Matrix<ElemType> bufferSlice = bucket.m_fusionBuffer->ColumnSlice(offset, numElements).Reshaped(gradient.GetNumRows(), gradient.GetNumCols());
+            if (fromBuffer)
+                gradient.AssignValuesOf(bufferSlice);
+            else
+                bufferSlice.AssignValuesOf(gradient);
+            offset += numElements;
+        }
+    }
+
+    // the matrix that is all-reduced for bucket 'b'
+    Matrix<ElemType>* ReductionMatrix(const std::vector<Matrix<ElemType>*>& gradients, size_t b) const
+    {
+        const auto& bucket = m_gradientBuckets[b];
+        return bucket.m_fusionBuffer ? bucket.m_fusionBuffer.get() : gradients[bucket.m_gradientIndices[0]];
+    }
+
+    // Post the async all-reduce of bucket 'b'. On GPU devices, the copy of the bucket to the CPU must have been initiated.
+    void PostAllReduce(const std::vector<Matrix<ElemType>*>& gradients, size_t b)
+    {
+        Matrix<ElemType>* reductionMatrix = ReductionMatrix(gradients, b);
+        ElemType* reductionBuffer = reductionMatrix->Data();
+        if (reductionMatrix->GetDeviceId() >= 0)
+        {
+            m_gpuDataTransferers[b]->WaitForCopyGPUToCPUAsync();
+            reductionBuffer = m_intermediateCPUBuffers[b].get();
+        }
+
+        // The built-in ring and hierarchical all-reduces of MPIWrapper are blocking; they complete the bucket right here.
+        // (They communicate on a communicator of their own, so they cannot interfere with the header messages in flight.)
+        if (m_mpi->SelectAllReduceAlgorithm(reductionMatrix->GetNumElements() * sizeof(ElemType)) != AllReduceAlgorithm::MPI)
+        {
+            m_mpi->AllReduce(reductionBuffer, reductionMatrix->GetNumElements());
+            m_allReduceRequests[b] = MPI_REQUEST_NULL;
+            return;
+        }
+
+        // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
+        MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, reductionMatrix->GetNumElements(), MPIWrapper::GetDataType(reductionBuffer), MPI_SUM, m_mpi->Communicator(), &m_allReduceRequests[b]) || MpiFail("MPI_Iallreduce");
+    }
+
+    // Overlapped aggregation: all gradients of bucket 'b' are final. Called on the main thread.
+    void BucketReady(size_t b)
+    {
+        auto& bucket = m_gradientBuckets[b];
+        CopyFusionBuffer(bucket, m_gradients, /*fromBuffer=*/false);
+
+        // the transfer to the CPU has to wait until the main compute stream has computed the gradients
+        int deviceId = m_gradients[0]->GetDeviceId();
+        if (deviceId >= 0)
+            bucket.m_readyEvent.reset(MatrixComputeStreamEvent::Create(deviceId));
+
+        // the first bucket of a minibatch starts the thread that posts the all-reduces
+        if (!m_pendingAllReducePosting.valid())
+        {
+            m_numBucketsReady = 0;
+            m_pendingAllReducePosting = std::async(std::launch::async, [this, deviceId]
+                                                   {
+                                                       PostAllReducesAsReady(deviceId);
+                                                   });
+        }
+
+        // MPI requires all nodes to post their collectives in the same order; so we only ever post the buckets in index order
+        {
+            std::lock_guard<std::mutex> lock(m_bucketsReadyMutex);
+            bucket.m_isReady = true;
+            while (m_numBucketsReady < m_gradientBuckets.size() && m_gradientBuckets[m_numBucketsReady].m_isReady)
+                m_numBucketsReady++;
+        }
+        m_bucketsReadyChanged.notify_all();
+    }
+
+    // Overlapped aggregation: runs on a separate thread while backprop continues, and posts the all-reduce of each
+    // bucket once BucketReady() has been called for it and all its predecessors
+    void PostAllReducesAsReady(int deviceId)
+    {
+        if (deviceId >= 0)
+            Matrix<ElemType>::SetDevice(deviceId);
+
+        size_t numBuckets = m_gradientBuckets.size();
+        size_t numPosted = 0;
+        while (numPosted < numBuckets)
+        {
+            size_t numReady;
+            {
+                std::unique_lock<std::mutex> lock(m_bucketsReadyMutex);
+                m_bucketsReadyChanged.wait_for(lock, std::chrono::microseconds(100), [&]
+                                               {
+                                                   return m_numBucketsReady > numPosted || m_abortAllReducePosting;
+                                               });
+                if (m_abortAllReducePosting)
+                    return;
+                numReady = m_numBucketsReady;
+            }
+
+            // While waiting for more gradients, let MPI make progress on the all-reduces in flight.
+            // (The main thread makes no MPI calls before this thread has finished.)
+            if (numReady == numPosted)
+            {
+                int allCompleted;
+                MPI_Testall((int) numPosted, m_allReduceRequests.data(), &allCompleted, MPI_STATUSES_IGNORE) || MpiFail("MPI_Testall");
+                continue;
+            }
+
+            for (; numPosted < numReady; numPosted++)
+            {
+                if (deviceId >= 0)
+                {
+                    m_gradientBuckets[numPosted].m_readyEvent->template SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+                    Matrix<ElemType>* reductionMatrix = ReductionMatrix(m_gradients, numPosted);
+                    m_gpuDataTransferers[numPosted]->CopyGPUToCPUAsync(reductionMatrix->Data(), reductionMatrix->GetNumElements(), m_intermediateCPUBuffers[numPosted].get());
+                }
+                PostAllReduce(m_gradients, numPosted);
+            }
+        }
+    }
+
     bool ResetCurrentEpoch(const std::vector<Matrix<ElemType>*>& gradients, int numEvalNode, int epochNumber)
     {
         bool isNewEpoch = (m_currentEpochNumber != epochNumber);
@@ -154,15 +370,21 @@ private:
                 if (gradients[i]->GetMatrixType() != DENSE)
                     RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
 
-                if (deviceId != CPUDEVICE)
+                if (m_useAsyncAggregation)
                 {
-                    m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(deviceId, m_useAsyncAggregation)));
-                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()));
+                    m_bufferedGradients[gradients[i]].reset(new Matrix<ElemType>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), deviceId));
                 }
+            }
 
-                if (m_useAsyncAggregation)
+            m_gradients = gradients;
+            CreateGradientBuckets(gradients);
+
+            if (deviceId != CPUDEVICE)
+            {
+                for (const auto& bucket : m_gradientBuckets)
                 {
-                    m_bufferedGradients[gradients[i]].reset(new Matrix<ElemType>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), deviceId));
+                    m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(deviceId, m_useAsyncAggregation || m_useOverlappedAggregation)));
+                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, bucket.m_numElements));
                 }
             }
 
@@ -238,12 +460,34 @@ private:
             }
         }
 
-        // Initiate transfer of the gradient matrices to the CPU if needed
-        if (deviceId >= 0)
+        size_t numBuckets = m_gradientBuckets.size();
+        bool allReducesPosted = false;
+        if (m_pendingAllReducePosting.valid())
         {
-            for (size_t i = 0; i < numGradMatrices; ++i)
+            // Backprop has already handed us some of the gradients and their all-reduces are on their way.
+            // Post the remaining ones and wait until that is done.
+            for (size_t i = 0; i < numBuckets; ++i)
+            {
+                if (!m_gradientBuckets[i].m_isReady)
+                    BucketReady(i);
+            }
+            m_pendingAllReducePosting.get();
+            allReducesPosted = true;
+        }
+        else
+        {
+            // Pack the small gradient matrices into the fusion buffers; from here on we reduce one matrix per bucket
+            for (const auto& bucket : m_gradientBuckets)
+                CopyFusionBuffer(bucket, gradients, /*fromBuffer=*/false);
+
+            // Initiate transfer of the gradient matrices to the CPU if needed
+            if (deviceId >= 0)
             {
-                m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradients[i]->Data(), gradients[i]->GetNumElements(), m_intermediateCPUBuffers[i].get());
+                for (size_t i = 0; i < numBuckets; ++i)
+                {
+                    Matrix<ElemType>* reductionMatrix = ReductionMatrix(gradients, i);
+                    m_gpuDataTransferers[i]->CopyGPUToCPUAsync(reductionMatrix->Data(), reductionMatrix->GetNumElements(), m_intermediateCPUBuffers[i].get());
+                }
             }
         }
 
@@ -267,18 +511,10 @@ private:
         }
 
         // Perform MPI async allreduce on the gradient data
-        std::vector<MPI_Request> allReduceRequests(numGradMatrices);
-        for (size_t i = 0; i < numGradMatrices; ++i)
+        if (!allReducesPosted)
         {
-            ElemType* reductionBuffer = gradients[i]->Data();
-            if (deviceId >= 0)
-            {
-                m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
-                reductionBuffer = m_intermediateCPUBuffers[i].get();
-            }
-
-            // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
-            MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, gradients[i]->GetNumElements(), MPIWrapper::GetDataType(reductionBuffer), MPI_SUM, m_mpi->Communicator(), &allReduceRequests[i]) || MpiFail("MPI_Iallreduce");
+            for (size_t i = 0; i < numBuckets; ++i)
+                PostAllReduce(gradients, i);
         }
 
         // On the main node wait for the headers to arrive and aggregate
@@ -322,12 +558,13 @@ private:
         }
 
         // Wait for the allreduce operations to finish and initiate transfer back to the GPU if needed
-        for (size_t i = 0; i < numGradMatrices; ++i)
+        for (size_t i = 0; i < numBuckets; ++i)
         {
-            MPI_Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+            MPI_Wait(&m_allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
             if (deviceId >= 0)
             {
-                m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), gradients[i]->GetNumElements(), gradients[i]->Data());
+                Matrix<ElemType>* reductionMatrix = ReductionMatrix(gradients, i);
+                m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), reductionMatrix->GetNumElements(), reductionMatrix->Data());
             }
         }
 
@@ -340,12 +577,22 @@ private:
         // Wait for all the transfers to finish
         if (deviceId >= 0)
         {
-            for (size_t i = 0; i < numGradMatrices; ++i)
+            for (size_t i = 0; i < numBuckets; ++i)
             {
                 m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
             }
         }
 
+        // Scatter the aggregated fusion buffers back into the gradient matrices
+        for (auto& bucket : m_gradientBuckets)
+        {
+            CopyFusionBuffer(bucket, gradients, /*fromBuffer=*/true);
+
+            bucket.m_numGradientsReady = 0;
+            bucket.m_isReady = false;
+            bucket.m_readyEvent.reset();
+        }
+
         // Wait for completion of the async send requests
         if (!m_mpi->IsMainNode())
         {
@@ -388,5 +635,20 @@ private:
     size_t m_iterationCount;
 
     int m_currentEpochNumber;
+
+    // Gradient matrices are packed into buckets of at most this size (0 = one all-reduce per gradient matrix)
+    size_t m_fusionBucketSizeInBytes;
+    std::vector<GradientBucket> m_gradientBuckets;
+    std::vector<MPI_Request> m_allReduceRequests; // [bucket index]
+
+    // Overlapped aggregation: buckets are posted by a separate thread while backprop still computes the remaining gradients
+    bool m_useOverlappedAggregation;
+    std::vector<Matrix<ElemType>*> m_gradients; // the gradients the buckets were created for
+    std::unordered_map<const Matrix<ElemType>*, size_t> m_bucketOfGradient;
+    std::future<void> m_pendingAllReducePosting;
+    std::mutex m_bucketsReadyMutex;
+    std::condition_variable m_bucketsReadyChanged;
+    size_t m_numBucketsReady; // buckets [0, m_numBucketsReady) may be posted
+    bool m_abortAllReducePosting;
 };
 } } }
@@ -5,6 +5,7 @@
 
 #include "stdafx.h"
 #include "EvalTestHelper.h"
+#include <thread>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -19,7 +20,7 @@ typedef std::map<std::wstring, std::vector<float>*> Variables;
 
 BOOST_FIXTURE_TEST_SUITE(EvalTestSuite, EvalFixture)
 
-IEvaluateModelExtended<float>* SetupNetworkAndGetLayouts(std::string modelDefinition, VariableSchema& inputLayouts, VariableSchema& outputLayouts)
+IEvaluateModelExtended<float>* SetupNetworkAndGetLayouts(std::string modelDefinition, VariableSchema& inputLayouts, VariableSchema& outputLayouts, std::string config = "")
 {
     // Load the eval library
     auto hModule = LoadLibrary(L"evaldll.dll");
@@ -40,6 +41,8 @@ IEvaluateModelExtended<float>* SetupNetworkAndGetLayouts(std::string modelDefini
 
     try
     {
+        if (!config.empty())
+            eval->Init(config);
         eval->CreateNetwork(modelDefinition);
     }
     catch (std::exception& ex)
@@ -294,5 +297,110 @@ BOOST_AUTO_TEST_CASE(EvalSparseTimesTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalConcurrentForwardPassTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Plus(Times(Constant(2, rows=1, cols=4), i1), Constant(1), tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    const size_t numThreads = 4;
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts, "numConcurrentForwardPasses=" + std::to_string(numThreads));
+
+    // every thread evaluates its own inputs on the same model instance, at the same time
+    std::vector<size_t> numErrors(numThreads, 0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for (size_t k = 0; k < 200; k++)
+            {
+                float x = (float) (t * 1000 + k);
+                Values<float> inputBuffer(1);
+                inputBuffer[0].m_buffer = { x, x, x, x, x, x, x, x }; // 2 samples
+                Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 2 });
+                eval->ForwardPass(inputBuffer, outputBuffer);
+                float expected = 2 * 4 * x + 1;
+                auto& buf = outputBuffer[0].m_buffer;
+                if (buf.size() != 2 || buf[0] != expected || buf[1] != expected)
+                    numErrors[t]++;
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (size_t t = 0; t < numThreads; t++)
+        BOOST_CHECK_EQUAL(numErrors[t], 0);
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalBatchedForwardPassTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Plus(Times(Constant(2, rows=1, cols=4), i1), Constant(1), tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    const size_t numThreads = 8;
+    const size_t numRequestsPerThread = 100;
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts, "maxBatchedRequests=8\nmaxBatchingDelayMs=5");
+
+    // requests of different lengths from many threads get combined, and must still each get their own results
+    std::vector<size_t> numErrors(numThreads, 0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for (size_t k = 0; k < numRequestsPerThread; k++)
+            {
+                size_t numSamples = 1 + (t + k) % 3;
+                float x = (float) (t * 1000 + k);
+                Values<float> inputBuffer(1);
+                inputBuffer[0].m_buffer.assign(4 * numSamples, x);
+                Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 3 });
+                eval->ForwardPass(inputBuffer, outputBuffer);
+                std::vector<float> expected(numSamples, 2 * 4 * x + 1);
+                if (outputBuffer[0].m_buffer != expected)
+                    numErrors[t]++;
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (size_t t = 0; t < numThreads; t++)
+        BOOST_CHECK_EQUAL(numErrors[t], 0);
+
+    auto statistics = eval->GetRequestStatistics();
+    BOOST_CHECK_EQUAL(statistics.m_latency.m_numRequests, numThreads * numRequestsPerThread);
+    BOOST_CHECK_EQUAL(statistics.m_queueLatency.m_numRequests, numThreads * numRequestsPerThread);
+    BOOST_CHECK_LT(statistics.m_numBatches, numThreads * numRequestsPerThread);
+    BOOST_CHECK_LE(statistics.m_latency.PercentileMicroseconds(0.5), statistics.m_latency.m_maxMicroseconds);
+
+    eval->Destroy();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
\ No newline at end of file
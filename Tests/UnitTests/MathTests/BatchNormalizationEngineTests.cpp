@@ -89,7 +89,7 @@ BOOST_AUTO_TEST_CASE(BatchNormalizationForward)
     };
 
     int baseDeviceId = 0;
-    for (int deviceId : {0})
+    for (int deviceId : {-1, 0})
     {
         for (const auto& cfg : GenerateBNTestConfigs())
         {
@@ -304,7 +304,7 @@ BOOST_AUTO_TEST_CASE(BatchNormalizationBackward)
     };
 
     int baseDeviceId = 0;
-    for (int deviceId : {0})
+    for (int deviceId : {-1, 0})
     {
         for (const auto& cfg : GenerateBNTestConfigs())
         {
@@ -407,6 +407,163 @@ BOOST_AUTO_TEST_CASE(BatchNormalizationBackward)
     }
 }
 
+// Checks the CNTK engine on the CPU against a naive double-precision reference, so that it is also tested without a GPU,
+// and with fractional blendFactor values, which cuDNN does not support.
+BOOST_AUTO_TEST_CASE(BatchNormalizationCpuReference)
+{
+    std::mt19937 rng(0);
+    std::normal_distribution<float> nd;
+
+    // (input tensor, batch size, spatial, expAvgFactor, blendFactor)
+    std::vector<std::tuple<TensorShape, size_t, bool, double, double>> configs;
+    for (double blendFactor : {0.0, 0.3, 1.0})
+    {
+        for (double expAvgFactor : {1.0, 0.1, 0.0})
+        {
+            configs.push_back(std::make_tuple(TensorShape(17), 13, false, expAvgFactor, blendFactor));
+            configs.push_back(std::make_tuple(TensorShape(6, 1, 1), 512, false, expAvgFactor, blendFactor));
+            configs.push_back(std::make_tuple(TensorShape(2, 2, 2), 8, true, expAvgFactor, blendFactor));
+            configs.push_back(std::make_tuple(TensorShape(11, 11, 13), 11, true, expAvgFactor, blendFactor));
+        }
+    }
+
+    int deviceId = -1;
+    double eps = 1e-5;
+    for (const auto& cfg : configs)
+    {
+        const auto& inOutT = std::get<0>(cfg);
+        size_t batchSize = std::get<1>(cfg);
+        bool spatial = std::get<2>(cfg);
+        double expAvg = std::get<3>(cfg);
+        double blendFactor = std::get<4>(cfg);
+
+        auto engCntk = BNEng::Create(deviceId, inOutT, spatial, ImageLayoutKind::CHW, BatchNormEngineKind::Cntk);
+
+        size_t crow = inOutT.GetNumElements();
+        size_t ccol = batchSize;
+        size_t crowScaleBias = spatial ? inOutT[2] : inOutT.GetNumElements();
+        size_t mapSize = crow / crowScaleBias; // elements of a feature map in one sample
+
+        // (an offset mean, so that computing the variance in one pass would lose precision)
+        vec x(crow * ccol), dy(crow * ccol), dx(crow * ccol), scale(crowScaleBias), bias(crowScaleBias), runMean(crowScaleBias), runInvStdDev(crowScaleBias);
+        std::generate(begin(x), end(x), [&] { return 3 + 2 * nd(rng); });
+        std::generate(begin(dy), end(dy), [&] { return nd(rng); });
+        std::generate(begin(dx), end(dx), [&] { return nd(rng); });
+        std::generate(begin(scale), end(scale), [&] { return nd(rng); });
+        std::generate(begin(bias), end(bias), [&] { return nd(rng); });
+        std::generate(begin(runMean), end(runMean), [&] { return nd(rng); });
+        std::generate(begin(runInvStdDev), end(runInvStdDev), [&] { return 1 + std::abs(nd(rng)); });
+
+        SingleMatrix inM(crow, ccol, x.data(), deviceId, matrixFlagNormal);
+        SingleMatrix scaleM(crowScaleBias, 1, scale.data(), deviceId, matrixFlagNormal);
+        SingleMatrix biasM(crowScaleBias, 1, bias.data(), deviceId, matrixFlagNormal);
+        SingleMatrix runMeanM(crowScaleBias, 1, runMean.data(), deviceId, matrixFlagNormal);
+        SingleMatrix runInvStdDevM(crowScaleBias, 1, runInvStdDev.data(), deviceId, matrixFlagNormal);
+        SingleMatrix saveMeanM(crowScaleBias, 1, deviceId);
+        SingleMatrix saveInvStdDevM(crowScaleBias, 1, deviceId);
+        SingleMatrix outM(crow, ccol, deviceId);
+        engCntk->Forward(inM, scaleM, biasM, expAvg, blendFactor, runMeanM, runInvStdDevM, outM, eps, saveMeanM, saveInvStdDevM);
+
+        // reference: the statistics of the minibatch, blended with the updated running statistics
+        bool needBatchStats = expAvg > 0 || blendFactor < 1;
+        vec refRunMean(crowScaleBias), refRunInvStdDev(crowScaleBias), refMean(crowScaleBias), refInvStdDev(crowScaleBias), refOut(crow * ccol);
+        for (size_t i = 0; i < crowScaleBias; i++)
+        {
+            double sum = 0, sqrSum = 0, count = (double) (ccol * mapSize);
+            for (size_t j = 0; j < ccol; j++)
+                for (size_t k = 0; k < mapSize; k++)
+                    sum += x[j * crow + i * mapSize + k];
+            double mean = sum / count;
+            for (size_t j = 0; j < ccol; j++)
+                for (size_t k = 0; k < mapSize; k++)
+                    sqrSum += (x[j * crow + i * mapSize + k] - mean) * (x[j * crow + i * mapSize + k] - mean);
+            double invStdDev = 1 / std::sqrt(sqrSum / count + eps);
+
+            double newRunMean = needBatchStats ? expAvg * mean + (1 - expAvg) * runMean[i] : runMean[i];
+            double newRunInvStdDev = needBatchStats ? expAvg * invStdDev + (1 - expAvg) * runInvStdDev[i] : runInvStdDev[i];
+            refRunMean[i] = (float) newRunMean;
+            refRunInvStdDev[i] = (float) newRunInvStdDev;
+            refMean[i] = (float) ((1 - blendFactor) * mean + blendFactor * newRunMean);
+            refInvStdDev[i] = (float) ((1 - blendFactor) * invStdDev + blendFactor * newRunInvStdDev);
+            for (size_t j = 0; j < ccol; j++)
+            {
+                for (size_t k = 0; k < mapSize; k++)
+                {
+                    size_t p = j * crow + i * mapSize + k;
+                    refOut[p] = (float) (scale[i] * (x[p] - (double) refMean[i]) * refInvStdDev[i] + bias[i]);
+                }
+            }
+        }
+
+        std::stringstream tmsg;
+        tmsg << "inOut tensor: " << (std::string)inOutT
+             << ", spatial = " << (spatial ? "true" : "false")
+             << ", expAvg = " << expAvg << ", blendFactor = " << blendFactor;
+        std::string msg = " are not equal, " + tmsg.str();
+
+        float relErr = Err<float>::Rel;
+        float absErr = Err<float>::Abs;
+        std::string emsg;
+
+        SingleMatrix refOutM(crow, ccol, refOut.data(), deviceId, matrixFlagNormal);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(outM, refOutM, emsg, relErr * 16, absErr * 20), "out" << msg << ". " << emsg);
+        SingleMatrix refRunMeanM(crowScaleBias, 1, refRunMean.data(), deviceId, matrixFlagNormal);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(runMeanM, refRunMeanM, emsg, relErr, absErr * 16), "runMean" << msg << ". " << emsg);
+        SingleMatrix refRunInvStdDevM(crowScaleBias, 1, refRunInvStdDev.data(), deviceId, matrixFlagNormal);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(runInvStdDevM, refRunInvStdDevM, emsg, relErr, absErr * 16), "runInvStdDev" << msg << ". " << emsg);
+        // (with blendFactor == 1, the saved statistics are not used)
+        if (blendFactor < 1)
+        {
+            SingleMatrix refMeanM(crowScaleBias, 1, refMean.data(), deviceId, matrixFlagNormal);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(saveMeanM, refMeanM, emsg, relErr, absErr * 16), "saveMean" << msg << ". " << emsg);
+            SingleMatrix refInvStdDevM(crowScaleBias, 1, refInvStdDev.data(), deviceId, matrixFlagNormal);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(saveInvStdDevM, refInvStdDevM, emsg, relErr, absErr * 16), "saveInvStdDev" << msg << ". " << emsg);
+        }
+
+        // backprop with the blended statistics; the input gradient is accumulated
+        SingleMatrix meanM(crowScaleBias, 1, refMean.data(), deviceId, matrixFlagNormal);
+        SingleMatrix invStdDevM(crowScaleBias, 1, refInvStdDev.data(), deviceId, matrixFlagNormal);
+        SingleMatrix dyM(crow, ccol, dy.data(), deviceId, matrixFlagNormal);
+        SingleMatrix dxM(crow, ccol, dx.data(), deviceId, matrixFlagNormal);
+        SingleMatrix dScaleM(crowScaleBias, 1, deviceId);
+        SingleMatrix dBiasM(crowScaleBias, 1, deviceId);
+        engCntk->Backward(inM, dyM, dxM, scaleM, meanM, invStdDevM, dScaleM, dBiasM);
+
+        vec refDx(crow * ccol), refDScale(crowScaleBias), refDBias(crowScaleBias);
+        for (size_t i = 0; i < crowScaleBias; i++)
+        {
+            double dScale = 0, dBias = 0, count = (double) (ccol * mapSize);
+            for (size_t j = 0; j < ccol; j++)
+            {
+                for (size_t k = 0; k < mapSize; k++)
+                {
+                    size_t p = j * crow + i * mapSize + k;
+                    dScale += dy[p] * (x[p] - (double) refMean[i]) * refInvStdDev[i];
+                    dBias += dy[p];
+                }
+            }
+            refDScale[i] = (float) dScale;
+            refDBias[i] = (float) dBias;
+            for (size_t j = 0; j < ccol; j++)
+            {
+                for (size_t k = 0; k < mapSize; k++)
+                {
+                    size_t p = j * crow + i * mapSize + k;
+                    double xHat = (x[p] - (double) refMean[i]) * refInvStdDev[i];
+                    refDx[p] = (float) (dx[p] + scale[i] * refInvStdDev[i] * (dy[p] - (xHat * dScale + dBias) / count));
+                }
+            }
+        }
+
+        SingleMatrix refDxM(crow, ccol, refDx.data(), deviceId, matrixFlagNormal);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(dxM, refDxM, emsg, relErr * 16, absErr * 16), "dx" << msg << ". " << emsg);
+        SingleMatrix refDScaleM(crowScaleBias, 1, refDScale.data(), deviceId, matrixFlagNormal);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(dScaleM, refDScaleM, emsg, relErr * 32, absErr * 16), "dScale" << msg << ". " << emsg);
+        SingleMatrix refDBiasM(crowScaleBias, 1, refDBias.data(), deviceId, matrixFlagNormal);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(dBiasM, refDBiasM, emsg, relErr * 32, absErr * 16), "dBias" << msg << ". " << emsg);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
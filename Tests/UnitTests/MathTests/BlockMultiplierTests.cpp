@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/BlockMultiplier.h"
+#include "../../../Source/Math/QuantizedMultiplier.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace TEST {
 
@@ -191,5 +192,41 @@ BOOST_AUTO_TEST_CASE(BlockMultiplyTestAllKFourRowsMultiThread)
     TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerSSE>>(4, 128 + 64 + 32 + 16 + 8 + 1, 1, 2);
 }
 
+// Quantized float product vs. the regular one. The quantization error of each term is
+// proportional to the value range of the operands, so the tolerance grows with inDim.
+template <typename ElemType> static void TestQuantizedMultiplier(size_t outDim, size_t inDim, size_t numCols, bool transposeWeights)
+{
+    Matrix<ElemType> weights = Matrix<ElemType>::RandomUniform(transposeWeights ? inDim : outDim, transposeWeights ? outDim : inDim, CPUDEVICE, -1, 1, 1);
+    Matrix<ElemType> input = Matrix<ElemType>::RandomUniform(inDim, numCols, CPUDEVICE, -2, 2, 2);
+    Matrix<ElemType> refOutput(outDim, numCols, CPUDEVICE);
+    Matrix<ElemType>::Multiply(weights, transposeWeights, input, false, refOutput);
+
+    QuantizedMultiplier<ElemType> quantizedMultiplier(weights, transposeWeights);
+    BOOST_CHECK_EQUAL(quantizedMultiplier.GetOutputDim(), outDim);
+    BOOST_CHECK_EQUAL(quantizedMultiplier.GetInputDim(), inDim);
+    Matrix<ElemType> testOutput(outDim, numCols, CPUDEVICE);
+    quantizedMultiplier.Multiply(input, testOutput);
+
+    ElemType tolerance = (ElemType) (1e-3 * inDim);
+    foreach_coord (i, j, refOutput)
+    {
+        BOOST_CHECK_SMALL(refOutput(i, j) - testOutput(i, j), tolerance);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(QuantizedMultiplierTest)
+{
+    TestQuantizedMultiplier<float>(13, 128 + 64 + 32 + 16 + 8 + 1, 7, false);
+    TestQuantizedMultiplier<float>(16, 256, 8, false);
+    // long inner dimension, which must not overflow the int32 accumulators
+    TestQuantizedMultiplier<float>(64, 1024, 64, false);
+}
+
+BOOST_AUTO_TEST_CASE(QuantizedMultiplierTransposedTest)
+{
+    TestQuantizedMultiplier<float>(13, 128 + 64 + 32 + 16 + 8 + 1, 7, true);
+    TestQuantizedMultiplier<double>(16, 256, 8, true);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}} //end namespaces
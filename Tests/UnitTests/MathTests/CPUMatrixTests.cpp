@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/TensorOpsVectorized.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -61,6 +62,28 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixConstructorFormatRowMajor, RandomSeedFixture)
     BOOST_CHECK_EQUAL(m(1, 2), 12);
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSetValueExternalBuffer, RandomSeedFixture)
+{
+    std::array<float, 6> array1 = {1, 2, 3, 4, 5, 6};
+    std::array<float, 4> array2 = {7, 8, 9, 10};
+    SMatrix m;
+    m.SetValue(2, 3, array1.data(), matrixFlagDontOwnBuffer);
+    BOOST_CHECK_EQUAL(m.Data(), array1.data());
+    BOOST_CHECK_EQUAL(m(1, 2), 6);
+
+    // switching to another external buffer must not free the previous one
+    m.SetValue(2, 2, array2.data(), matrixFlagDontOwnBuffer);
+    BOOST_CHECK_EQUAL(m.Data(), array2.data());
+    BOOST_CHECK_EQUAL(m(1, 1), 10);
+    BOOST_CHECK_EQUAL(array1[5], 6);
+
+    // a deep copy of the same size goes into the external buffer
+    std::array<float, 4> array3 = {11, 12, 13, 14};
+    m.SetValue(2, 2, array3.data(), matrixFlagNormal);
+    BOOST_CHECK_EQUAL(m.Data(), array2.data());
+    BOOST_CHECK_EQUAL(array2[0], 11);
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixAddAndSub, RandomSeedFixture)
 {
     DMatrix m0(2, 3);
@@ -874,6 +897,190 @@ BOOST_FIXTURE_TEST_CASE(CPUColumnElementOperations, RandomSeedFixture)
     BOOST_CHECK(m0.IsEqualTo(m2, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpReduction, RandomSeedFixture)
+{
+    // reduce [rows x cols] over the columns (like a bias gradient), and over everything, into out = beta * out + alpha * sum
+    // The shapes cover both the many-outputs and the tiny-output (partial sums per thread) parallel strategies.
+    const double beta = 0.5;
+    const double alpha = 2;
+    for (size_t rows : {1, 3, 256})
+    {
+        const size_t cols = 1000000 / rows / 8;
+        DMatrix a = DMatrix::RandomUniform(rows, cols, -1, 1, IncrementCounter());
+        DMatrix out = DMatrix::RandomUniform(rows, 1, -1, 1, IncrementCounter());
+
+        // reference
+        DMatrix expected(rows, 1);
+        double expectedTotal = 0;
+        for (size_t i = 0; i < rows; i++)
+        {
+            double sum = 0;
+            for (size_t j = 0; j < cols; j++)
+                sum += a(i, j);
+            expected(i, 0) = beta * out(i, 0) + alpha * sum;
+            expectedTotal += sum;
+        }
+
+        out.TensorOp(beta, a, alpha, ElementWiseOperator::opCopy, ElementWiseOperator::opSum,
+                     std::array<size_t, 2>{0, 0},
+                     SmallVector<size_t>{rows}, std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{1}},
+                     SmallVector<size_t>{cols}, std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{(ptrdiff_t) rows}, SmallVector<ptrdiff_t>{0}});
+        BOOST_CHECK(out.IsEqualTo(expected, c_epsilonFloatE4));
+
+        // full reduction to a scalar, with two reducing dimensions
+        DMatrix total = DMatrix::RandomUniform(1, 1, -1, 1, IncrementCounter());
+        expectedTotal = beta * total(0, 0) + alpha * expectedTotal;
+
+        total.TensorOp(beta, a, alpha, ElementWiseOperator::opCopy, ElementWiseOperator::opSum,
+                       std::array<size_t, 2>{0, 0},
+                       SmallVector<size_t>{}, std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{}, SmallVector<ptrdiff_t>{}},
+                       SmallVector<size_t>{rows, cols}, std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1, (ptrdiff_t) rows}, SmallVector<ptrdiff_t>{0, 0}});
+        BOOST_CHECK_CLOSE(total(0, 0), expectedTotal, 1e-8);
+
+        // view 'a' as [rows x cols/2 x 2] and reduce over the middle dimension: the output [rows x 2] has a tiny
+        // outermost dimension, which exercises splitting the flattened output across threads
+        const size_t halfCols = cols / 2;
+        DMatrix out2 = DMatrix::RandomUniform(rows, 2, -1, 1, IncrementCounter());
+        DMatrix expected2(rows, 2);
+        for (size_t i = 0; i < rows; i++)
+            for (size_t h = 0; h < 2; h++)
+            {
+                double sum = 0;
+                for (size_t j = 0; j < halfCols; j++)
+                    sum += a(i, h * halfCols + j);
+                expected2(i, h) = beta * out2(i, h) + alpha * sum;
+            }
+
+        out2.TensorOp(beta, a, alpha, ElementWiseOperator::opCopy, ElementWiseOperator::opSum,
+                      std::array<size_t, 2>{0, 0},
+                      SmallVector<size_t>{rows, 2}, std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1, (ptrdiff_t) (rows * halfCols)}, SmallVector<ptrdiff_t>{1, (ptrdiff_t) rows}},
+                      SmallVector<size_t>{halfCols}, std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{(ptrdiff_t) rows}, SmallVector<ptrdiff_t>{0}});
+        BOOST_CHECK(out2.IsEqualTo(expected2, c_epsilonFloatE4));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpVectorized, RandomSeedFixture)
+{
+    // compare the vectorized kernels (for each instruction set this machine has) against the generic code
+    // The size is not a multiple of the vector width, to cover the remainder handling.
+    const size_t rows = 129, cols = 37;
+    SMatrix a = SMatrix::RandomUniform(rows, cols, -5, 5, IncrementCounter());
+    SMatrix b = SMatrix::RandomUniform(rows, cols, -5, 5, IncrementCounter());
+    SMatrix c0 = SMatrix::RandomUniform(rows, cols, -5, 5, IncrementCounter());
+    const auto unaryOffsets = std::array<size_t, 2>{0, 0};
+    const auto binaryOffsets = std::array<size_t, 3>{0, 0, 0};
+    const SmallVector<size_t> dims{rows * cols};
+    const auto unaryStrides = std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{1}};
+    const auto binaryStrides = std::array<SmallVector<ptrdiff_t>, 3>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{1}};
+    const SmallVector<size_t> noDims;
+    const auto noUnaryStrides = std::array<SmallVector<ptrdiff_t>, 2>{};
+    const auto noBinaryStrides = std::array<SmallVector<ptrdiff_t>, 3>{};
+
+    for (auto instructionSet : {VectorInstructionSet::AVX512, VectorInstructionSet::AVX2})
+    {
+        SetMaxVectorInstructionSet(instructionSet);
+        if (GetVectorInstructionSet() != instructionSet)
+            continue;
+
+        for (auto op : {ElementWiseOperator::opCopy, ElementWiseOperator::opLinearRectifier, ElementWiseOperator::opExp,
+                        ElementWiseOperator::opLog, ElementWiseOperator::opSigmoid, ElementWiseOperator::opTanh})
+        {
+            SMatrix expected(c0), actual(c0);
+            SetMaxVectorInstructionSet(VectorInstructionSet::None);
+            expected.TensorOp(0.5f, a, 2.0f, op, ElementWiseOperator::opSum, unaryOffsets, dims, unaryStrides, noDims, noUnaryStrides);
+            SetMaxVectorInstructionSet(instructionSet);
+            SetVectorMathMode(VectorMathMode::Accurate);
+            actual.TensorOp(0.5f, a, 2.0f, op, ElementWiseOperator::opSum, unaryOffsets, dims, unaryStrides, noDims, noUnaryStrides);
+            if (op == ElementWiseOperator::opCopy || op == ElementWiseOperator::opLinearRectifier)
+                BOOST_CHECK(actual.IsEqualTo(expected, 0));
+            else
+                BOOST_CHECK(actual.IsEqualTo(expected, c_epsilonFloatE4)); // (absolute; exp() goes up to about 300 here)
+
+            // the default mode only vectorizes the exact ops, so results must be identical to the generic code
+            actual.SetValue(c0);
+            SetVectorMathMode(VectorMathMode::Off);
+            actual.TensorOp(0.5f, a, 2.0f, op, ElementWiseOperator::opSum, unaryOffsets, dims, unaryStrides, noDims, noUnaryStrides);
+            BOOST_CHECK(actual.IsEqualTo(expected, 0));
+        }
+
+        for (auto op : {ElementWiseOperator::opSum, ElementWiseOperator::opDifference, ElementWiseOperator::opElementwiseProduct})
+        {
+            SMatrix expected(c0), actual(c0);
+            SetMaxVectorInstructionSet(VectorInstructionSet::None);
+            expected.TensorOp(0.5f, a, b, 2.0f, op, ElementWiseOperator::opSum, binaryOffsets, dims, binaryStrides, noDims, noBinaryStrides);
+            SetMaxVectorInstructionSet(instructionSet);
+            actual.TensorOp(0.5f, a, b, 2.0f, op, ElementWiseOperator::opSum, binaryOffsets, dims, binaryStrides, noDims, noBinaryStrides);
+            BOOST_CHECK(actual.IsEqualTo(expected, 0));
+        }
+    }
+    SetMaxVectorInstructionSet(VectorInstructionSet::AVX512);
+    SetVectorMathMode(VectorMathMode::Off);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpVectorizedAccuracy, RandomSeedFixture)
+{
+    // check the approximations of the 'accurate' and 'fast' modes against the generic code (i.e. the C runtime functions)
+    // over each function's useful input range, with the error bounds documented in TensorOpsVectorized.h:
+    // |actual - expected| <= relative * |expected| + absolute
+    struct Case
+    {
+        ElementWiseOperator op;
+        float low, high;          // input range; for log, the exponent range of the input (log needs a large dynamic range)
+        float accurateRelative, fastRelative, fastAbsolute;
+    };
+    const float ulp = 1.1920929e-7f; // FLT_EPSILON
+    const Case cases[] = {
+        {ElementWiseOperator::opExp,     -87,  88, 3 * ulp, 6e-5f, 0},
+        {ElementWiseOperator::opLog,     -80,  80, 3 * ulp, 4e-6f, 2e-7f},
+        {ElementWiseOperator::opSigmoid, -40,  40, 4 * ulp, 6e-5f, 0},
+        {ElementWiseOperator::opTanh,    -10,  10, 4 * ulp, 0,     3e-5f},
+    };
+    const size_t n = 100003;
+    const auto offsets = std::array<size_t, 2>{0, 0};
+    const SmallVector<size_t> dims{n};
+    const auto strides = std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{1}};
+    const SmallVector<size_t> noDims;
+    const auto noStrides = std::array<SmallVector<ptrdiff_t>, 2>{};
+
+    for (auto instructionSet : {VectorInstructionSet::AVX512, VectorInstructionSet::AVX2})
+    {
+        SetMaxVectorInstructionSet(instructionSet);
+        if (GetVectorInstructionSet() != instructionSet)
+            continue;
+
+        for (const auto& c : cases)
+        {
+            SMatrix a = SMatrix::RandomUniform(n, 1, c.low, c.high, IncrementCounter());
+            if (c.op == ElementWiseOperator::opLog)
+                for (size_t i = 0; i < n; i++)
+                    a(i, 0) = expf(a(i, 0));
+
+            SMatrix expected(n, 1);
+            SetMaxVectorInstructionSet(VectorInstructionSet::None);
+            expected.TensorOp(0, a, 1, c.op, ElementWiseOperator::opSum, offsets, dims, strides, noDims, noStrides);
+            SetMaxVectorInstructionSet(instructionSet);
+
+            for (auto mode : {VectorMathMode::Accurate, VectorMathMode::Fast})
+            {
+                const float relative = mode == VectorMathMode::Accurate ? c.accurateRelative : c.fastRelative;
+                const float absolute = mode == VectorMathMode::Accurate ? 0 : c.fastAbsolute;
+                SMatrix actual(n, 1);
+                SetVectorMathMode(mode);
+                actual.TensorOp(0, a, 1, c.op, ElementWiseOperator::opSum, offsets, dims, strides, noDims, noStrides);
+                size_t numFailed = 0;
+                for (size_t i = 0; i < n; i++)
+                {
+                    if (fabs((double) actual(i, 0) - expected(i, 0)) > relative * fabs(expected(i, 0)) + absolute)
+                        numFailed++;
+                }
+                BOOST_CHECK_EQUAL(numFailed, 0);
+            }
+        }
+    }
+    SetMaxVectorInstructionSet(VectorInstructionSet::AVX512);
+    SetVectorMathMode(VectorMathMode::Off);
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingFloat, RandomSeedFixture)
 {
     const float low = 0;
@@ -898,6 +1105,156 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingDouble, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2));
 }
 
+// Check a fused update of two parameters stored in arenas, the second one spanning several chunks of the fused update,
+// against updating one parameter at a time like SGD::UpdateWeightsS(): truncation, L2, the update, and L1.
+// 'updateOne(p, smoothedGradient, gradient, weights)' applies the update proper to parameter p.
+// Like SGD, the first step runs one parameter at a time, and its smoothed gradients then move into the arena.
+template <class UpdateOne, class UpdateFused>
+static void CheckMultiTensorUpdate(RandomSeedFixture& fixture, size_t numSmoothedGradientsPerWeight, const MultiTensorRegularization& regularization,
+                                   const UpdateOne& updateOne, const UpdateFused& updateFused)
+{
+    const size_t size0 = 35;
+    const size_t size1 = 40000;
+    const std::vector<MultiTensorSegment> segments = { { 0, size0, 0.1 }, { size0, size1, 0.05 } };
+
+    DMatrix expectedValues = DMatrix::RandomUniform(1, size0 + size1, -1, 1, fixture.IncrementCounter());
+    std::vector<DMatrix> expectedSmoothedGradients;
+    for (const auto& segment : segments)
+    {
+        expectedSmoothedGradients.push_back(DMatrix(1, segment.numElements)); // (SGD creates them in the shape of the parameter)
+        expectedSmoothedGradients.back().SetValue(0);
+    }
+    DMatrix values, smoothedGradients;
+    for (size_t step = 0; step < 4; step++)
+    {
+        DMatrix gradients = DMatrix::RandomUniform(1, size0 + size1, -2, 2, fixture.IncrementCounter());
+
+        for (size_t p = 0; p < segments.size(); p++)
+        {
+            DMatrix weights = expectedValues.ColumnSlice(segments[p].offset, segments[p].numElements);
+            DMatrix gradient;
+            gradient.SetValue(gradients.ColumnSlice(segments[p].offset, segments[p].numElements));
+            gradient.InplaceTruncate(regularization.clippingThreshold);
+            DMatrix::ScaleAndAdd(regularization.L2RegWeight, weights, gradient);
+            updateOne(segments[p], expectedSmoothedGradients[p], gradient, weights);
+            if (regularization.L1RegWeight > 0)
+                weights.InplaceSoftThreshold(segments[p].learnRatePerSample * regularization.L1RegWeight);
+        }
+
+        if (step == 0)
+        {
+            values.SetValue(expectedValues);
+            smoothedGradients.Resize(1, numSmoothedGradientsPerWeight * (size0 + size1));
+            for (size_t p = 0; p < segments.size(); p++)
+                smoothedGradients.SetColumnSlice(expectedSmoothedGradients[p], numSmoothedGradientsPerWeight * segments[p].offset, expectedSmoothedGradients[p].GetNumCols());
+        }
+        else
+            updateFused(segments, smoothedGradients, gradients, values);
+    }
+
+    BOOST_CHECK(values.IsEqualTo(expectedValues, c_epsilonFloatE4));
+    for (size_t p = 0; p < segments.size(); p++)
+    {
+        const auto& expected = expectedSmoothedGradients[p];
+        BOOST_CHECK(smoothedGradients.ColumnSlice(numSmoothedGradientsPerWeight * segments[p].offset, expected.GetNumCols()).IsEqualTo(expected, c_epsilonFloatE4));
+    }
+}
+
+static MultiTensorRegularization TestRegularization()
+{
+    MultiTensorRegularization regularization;
+    regularization.clippingThreshold = 0.9;
+    regularization.L2RegWeight = 0.01;
+    regularization.L1RegWeight = 0.001;
+    return regularization;
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiTensorNormalGrad, RandomSeedFixture)
+{
+    const double momentum = 0.9;
+    for (bool useNesterovMomentum : { false, true })
+    {
+        BOOST_TEST_CONTEXT("useNesterovMomentum=" << useNesterovMomentum)
+        {
+            // cf. the dense case of Matrix::NormalGrad()
+            CheckMultiTensorUpdate(*this, 1, TestRegularization(),
+                [&](const MultiTensorSegment& segment, DMatrix& smoothedGradient, DMatrix& gradient, DMatrix& weights)
+                {
+                    DMatrix::Scale(momentum, smoothedGradient);
+                    DMatrix::ScaleAndAdd((1 - momentum) * segment.learnRatePerSample, gradient, smoothedGradient);
+                    if (!useNesterovMomentum)
+                        weights -= smoothedGradient;
+                    else
+                    {
+                        DMatrix::ScaleAndAdd(-momentum, smoothedGradient, weights);
+                        DMatrix::ScaleAndAdd(-(1 - momentum) * segment.learnRatePerSample, gradient, weights);
+                    }
+                },
+                [&](const std::vector<MultiTensorSegment>& segments, DMatrix& smoothedGradients, DMatrix& gradients, DMatrix& values)
+                {
+                    smoothedGradients.MultiTensorNormalGrad(gradients, values, segments, TestRegularization(), momentum, useNesterovMomentum);
+                });
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiTensorAdagrad, RandomSeedFixture)
+{
+    for (bool needAveMultiplier : { false, true })
+    {
+        BOOST_TEST_CONTEXT("needAveMultiplier=" << needAveMultiplier)
+        {
+            CheckMultiTensorUpdate(*this, 1, TestRegularization(),
+                [&](const MultiTensorSegment& segment, DMatrix& smoothedGradient, DMatrix& gradient, DMatrix& weights)
+                {
+                    double aveMultiplier = smoothedGradient.Adagrad(gradient, needAveMultiplier);
+                    DMatrix::ScaleAndAdd(-segment.learnRatePerSample / aveMultiplier, gradient, weights);
+                },
+                [&](const std::vector<MultiTensorSegment>& segments, DMatrix& smoothedGradients, DMatrix& gradients, DMatrix& values)
+                {
+                    smoothedGradients.MultiTensorAdagrad(gradients, values, segments, TestRegularization(), needAveMultiplier);
+                });
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiTensorFSAdagrad, RandomSeedFixture)
+{
+    // (Matrix::FSAdagrad() derives adaWeight and adaMul from the running average of the minibatch size, advancing it for each parameter)
+    const double momentum = 0.9, adaWeight = 0.99;
+    const std::vector<double> adaMuls = { 0.02, 0.03 };
+    CheckMultiTensorUpdate(*this, 2, TestRegularization(),
+        [&](const MultiTensorSegment& segment, DMatrix& smoothedGradient, DMatrix& gradient, DMatrix& weights)
+        {
+            smoothedGradient.FSAdagrad(gradient, weights, segment.learnRatePerSample, momentum, adaWeight, adaMuls[segment.offset == 0 ? 0 : 1]);
+        },
+        [&](const std::vector<MultiTensorSegment>& segments, DMatrix& smoothedGradients, DMatrix& gradients, DMatrix& values)
+        {
+            smoothedGradients.MultiTensorFSAdagrad(gradients, values, segments, TestRegularization(), momentum, adaWeight, adaMuls);
+        });
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiTensorRmsProp, RandomSeedFixture)
+{
+    const double gamma = 0.99, inc = 1.2, max = 10, dec = 0.75, min = 0.1;
+    for (bool needAveMultiplier : { false, true })
+    {
+        BOOST_TEST_CONTEXT("needAveMultiplier=" << needAveMultiplier)
+        {
+            CheckMultiTensorUpdate(*this, 3, TestRegularization(),
+                [&](const MultiTensorSegment& segment, DMatrix& smoothedGradient, DMatrix& gradient, DMatrix& weights)
+                {
+                    double aveMultiplier = smoothedGradient.RmsProp(gradient, gamma, inc, max, dec, min, needAveMultiplier);
+                    DMatrix::ScaleAndAdd(-segment.learnRatePerSample / aveMultiplier, gradient, weights);
+                },
+                [&](const std::vector<MultiTensorSegment>& segments, DMatrix& smoothedGradients, DMatrix& gradients, DMatrix& values)
+                {
+                    smoothedGradients.MultiTensorRmsProp(gradients, values, segments, TestRegularization(), gamma, inc, max, dec, min, needAveMultiplier);
+                });
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
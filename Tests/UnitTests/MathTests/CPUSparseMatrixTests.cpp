@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include <crtdefs.h>
+#include <random>
 #include "../../../Source/Math/CPUSparseMatrix.h"
 
 using namespace Microsoft::MSR::CNTK;
@@ -59,6 +60,120 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixCopyColumnSliceToDense, RandomSeedFixture
     BOOST_CHECK(dm1.IsEqualTo(dm2, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixLazyNormalGrad, RandomSeedFixture)
+{
+    // embedding-like gradients touch only a few columns per step; the lazy update must match
+    // the dense one in which the smoothed gradients of all columns decay in every step
+    const size_t m = 4;
+    const size_t vocab = 50;
+    const size_t numWords = 3;
+    const size_t numSteps = 300; // long enough for the scale factor to be renormalized
+    const double momentum = 0.9;
+    const double learnRate = 0.1;
+    std::mt19937 rng(0);
+
+    for (bool useNesterovMomentum : { false, true })
+    {
+        DenseMatrix weights(m, vocab);
+        weights.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix weightsRef(weights);
+        DenseMatrix smoothed(m, vocab);
+        smoothed.SetValue(0);
+        DenseMatrix smoothedRef(m, vocab);
+        smoothedRef.SetValue(0);
+
+        for (size_t step = 0; step < numSteps; step++)
+        {
+            DenseMatrix dY(m, numWords);
+            dY.SetUniformRandomValue(-1, 1, IncrementCounter());
+            SparseMatrix x(MatrixFormat::matrixFormatSparseCSC, vocab, numWords, 0);
+            DenseMatrix gradientRef(m, vocab);
+            gradientRef.SetValue(0);
+            std::vector<bool> touched(vocab, false);
+            for (size_t t = 0; t < numWords; t++)
+            {
+                size_t word = rng() % vocab;
+                x.SetValue(word, t, 1);
+                touched[word] = true;
+                for (size_t row = 0; row < m; row++)
+                    gradientRef(row, word) += dY(row, t);
+            }
+            SparseMatrix gradient(MatrixFormat::matrixFormatSparseBlockCol, m, vocab, 0);
+            SparseMatrix::MultiplyAndAdd(1, dY, false, x, true, gradient);
+
+            gradient.NormalGrad(smoothed, momentum, useNesterovMomentum);
+            SparseMatrix::ScaleAndAdd(-learnRate, gradient, weights);
+
+            foreach_coord (row, col, smoothedRef)
+            {
+                smoothedRef(row, col) = momentum * smoothedRef(row, col) + (1 - momentum) * gradientRef(row, col);
+                double update = useNesterovMomentum ? momentum * smoothedRef(row, col) + (1 - momentum) * gradientRef(row, col) : smoothedRef(row, col);
+                if (touched[col])
+                    weightsRef(row, col) -= learnRate * update;
+            }
+        }
+
+        BOOST_CHECK(weights.IsEqualTo(weightsRef, c_epsilonFloatE4));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixLazyFSAdagrad, RandomSeedFixture)
+{
+    // like CPUSparseMatrixLazyNormalGrad: the lazy update must match the dense one on the touched columns,
+    // with the smoothed squared gradients and smoothed gradients of all columns decaying in every step
+    const size_t m = 4;
+    const size_t vocab = 50;
+    const size_t numWords = 3;
+    const size_t numSteps = 300;
+    const double learnRate = 0.1;
+    const double adaWeight = 0.9;
+    const double adaMul = 0.5;
+    std::mt19937 rng(0);
+
+    for (double momentum : { 0.0, 0.9 })
+    {
+        DenseMatrix weights(m, vocab);
+        weights.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix weightsRef(weights);
+        DenseMatrix smoothed(m, 2 * vocab + 2);
+        smoothed.SetValue(0);
+        DenseMatrix smoothedRef(m, 2 * vocab);
+        smoothedRef.SetValue(0);
+
+        for (size_t step = 0; step < numSteps; step++)
+        {
+            DenseMatrix dY(m, numWords);
+            dY.SetUniformRandomValue(-1, 1, IncrementCounter());
+            SparseMatrix x(MatrixFormat::matrixFormatSparseCSC, vocab, numWords, 0);
+            DenseMatrix gradientRef(m, vocab);
+            gradientRef.SetValue(0);
+            std::vector<bool> touched(vocab, false);
+            for (size_t t = 0; t < numWords; t++)
+            {
+                size_t word = rng() % vocab;
+                x.SetValue(word, t, 1);
+                touched[word] = true;
+                for (size_t row = 0; row < m; row++)
+                    gradientRef(row, word) += dY(row, t);
+            }
+            SparseMatrix gradient(MatrixFormat::matrixFormatSparseBlockCol, m, vocab, 0);
+            SparseMatrix::MultiplyAndAdd(1, dY, false, x, true, gradient);
+
+            gradient.FSAdagrad(smoothed, weights, learnRate, momentum, adaWeight, adaMul);
+
+            DenseMatrix updatedRef(weightsRef);
+            smoothedRef.FSAdagrad(gradientRef, updatedRef, learnRate, momentum, adaWeight, adaMul);
+            foreach_coord (row, col, weightsRef)
+            {
+                if (touched[col])
+                    weightsRef(row, col) = updatedRef(row, col);
+            }
+        }
+
+        BOOST_CHECK(weights.IsEqualTo(weightsRef, c_epsilonFloatE4));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
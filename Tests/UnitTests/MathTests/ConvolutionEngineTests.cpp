@@ -12,6 +12,7 @@
 #include "../../../Source/Math/GPUMatrix.h"
 #include "../../../Source/Math/ConvolutionEngine.h"
 #include "../../../Source/Math/CuDnnFactories.h"
+#include "../../../Source/Math/TensorOpsVectorized.h"
 #include "common.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -59,6 +60,10 @@ std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE, size_t>> GetTestEng
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 0));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 1));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 3));
+
+    // Direct engine. Implemented only for CPU and 2D convolutions, so Gemm handles the 3D test cases.
+    // Uses temp memory, but not maxTempMemSizeInSamples.
+    res.push_back(std::make_tuple((ConvolutionEngineKind)((int)ConvolutionEngineKind::Direct | (int)ConvolutionEngineKind::Gemm), -1, 0));
     return res;
 }
 
@@ -580,6 +585,110 @@ BOOST_AUTO_TEST_CASE(MaxUnpooling)
     }
 }
 
+// Geometries for comparing the direct engine with the reference engine on CPU. The widths are not multiples of the
+// vector width and the map counts not multiples of the register blocking, so that the remainder paths run too.
+std::vector<ConvolveGeometryPtr> GenerateDirectConvTestConfigs()
+{
+    std::vector<ConvolveGeometryPtr> res;
+    // 3x3 with stride 1 (Winograd), padded and not.
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(13, 11, 3),
+        TensorShape(3, 3, 3), TensorShape(5), TensorShape(1, 1, 3),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0)));
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(20, 9, 4),
+        TensorShape(3, 3, 4), TensorShape(9), TensorShape(1, 1, 4),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(0), TensorShape(0)));
+    // Strided, padded and not.
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(17, 12, 3),
+        TensorShape(3, 3, 3), TensorShape(6), TensorShape(2, 2, 3),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0)));
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(21, 19, 2),
+        TensorShape(5, 5, 2), TensorShape(4), TensorShape(2, 3, 2),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(0), TensorShape(0)));
+    // Padded 5x5 with stride 1, which is not Winograd.
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(10, 7, 2),
+        TensorShape(5, 5, 2), TensorShape(3), TensorShape(1, 1, 2),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0)));
+    // 1x1 with stride 1 and 2.
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(35, 7, 6),
+        TensorShape(1, 1, 6), TensorShape(5), TensorShape(1, 1, 6),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(0), TensorShape(0)));
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(16, 16, 2),
+        TensorShape(1, 1, 2), TensorShape(3), TensorShape(2, 2, 2),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(0), TensorShape(0)));
+    return res;
+}
+
+BOOST_AUTO_TEST_CASE(DirectConvolutionCPU)
+{
+    std::mt19937 rng(0);
+    std::normal_distribution<float> nd;
+    const int cpuDeviceId = -1;
+
+    auto randomMat = [&](size_t r, size_t c) -> SingleMatrix
+    {
+        vec buf(r * c);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        return SingleMatrix(r, c, buf.data(), cpuDeviceId, matrixFlagNormal);
+    };
+
+    for (auto instructionSet : {VectorInstructionSet::AVX512, VectorInstructionSet::AVX2, VectorInstructionSet::None})
+    {
+        SetMaxVectorInstructionSet(instructionSet);
+        if (GetVectorInstructionSet() != instructionSet)
+            continue;
+
+        for (const auto& g : GenerateDirectConvTestConfigs())
+        {
+            auto refEng = ConvEng::Create(g, cpuDeviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+            auto testEng = ConvEng::Create(g, cpuDeviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Direct);
+
+            const size_t n = 3;
+            const size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+            SingleMatrix in = randomMat(g->InputShape().GetNumElements(), n);
+            SingleMatrix kernel = randomMat(mapCount, g->KernelShape().GetNumElements());
+            SingleMatrix srcGrad = randomMat(g->OutputShape().GetNumElements(), n);
+            SingleMatrix workspace(cpuDeviceId);
+            SingleMatrix workspaceR(cpuDeviceId);
+
+            std::stringstream tmsg;
+            tmsg << "Geometry: " << (std::string)(*g) << ", instruction set: " << VectorInstructionSetName(instructionSet);
+            std::string msg = " are not equal, " + tmsg.str();
+            // Winograd and the blocked sums round differently from the reference engine, by a few ulps of the
+            // terms that are summed rather than of the result, which can be much smaller.
+            float relErr = Err<float>::Rel;
+            float absErr = 1e-5f;
+            std::string emsg;
+
+            SingleMatrix out(g->OutputShape().GetNumElements(), n, cpuDeviceId);
+            SingleMatrix outR(g->OutputShape().GetNumElements(), n, cpuDeviceId);
+            testEng->Forward(in, kernel, out, workspace);
+            refEng->Forward(in, kernel, outR, workspaceR);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, outR, emsg, relErr * 4, absErr), "out" << msg << ". " << emsg);
+
+            // the gradients are added to
+            SingleMatrix grad = randomMat(g->InputShape().GetNumElements(), n);
+            SingleMatrix gradR(grad.DeepClone());
+            testEng->BackwardData(srcGrad, kernel, grad, workspace);
+            refEng->BackwardData(srcGrad, kernel, gradR, workspaceR);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradR, emsg, relErr * 4, absErr), "grad" << msg << ". " << emsg);
+
+            SingleMatrix kernelGrad = randomMat(mapCount, g->KernelShape().GetNumElements());
+            SingleMatrix kernelGradR(kernelGrad.DeepClone());
+            testEng->BackwardKernel(srcGrad, in, kernelGrad, false, workspace);
+            refEng->BackwardKernel(srcGrad, in, kernelGradR, false, workspaceR);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(kernelGrad, kernelGradR, emsg, relErr * 4, absErr * 4), "kernel" << msg << ". " << emsg);
+        }
+    }
+    SetMaxVectorInstructionSet(VectorInstructionSet::AVX512);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
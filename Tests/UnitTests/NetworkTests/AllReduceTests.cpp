@@ -0,0 +1,109 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for the built-in all-reduce algorithms of MPIWrapper, against MPI_Allreduce of the installed MPI.
+// With a single process, all-reduces are trivial. To actually test them, run this suite with several ranks on one machine:
+//     mpiexec -n N NetworkTests --run_test=AllReduceSuite
+// for N = 2..4. The ranks are grouped into simulated machines of 2 ranks each, so that N = 2 is one machine,
+// N = 3 two machines of differing size (hierarchical falls back to ring), and N = 4 two machines of 2 ranks each.
+//
+#include "stdafx.h"
+#include "MPIWrapper.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t numRanksPerSimulatedMachine = 2;
+
+static MPIWrapperPtr GetMPI()
+{
+    static MPIWrapperPtr mpi = MPIWrapper::GetInstance(/*create=*/true);
+    return mpi;
+}
+
+// distinct values on each rank, with a fractional part so that the order of summation matters
+template <class ElemType>
+static vector<ElemType> CreateTestData(size_t numElements, size_t rank)
+{
+    vector<ElemType> data(numElements);
+    for (size_t i = 0; i < numElements; i++)
+        data[i] = (ElemType) ((rank + 1) * 0.1 + (i % 1000) * 1.37);
+    return data;
+}
+
+// element-wise maximum or minimum across the ranks in use
+template <class ElemType>
+static vector<ElemType> AllReduceWith(const MPIWrapperPtr& mpi, vector<ElemType> data, MPI_Op op)
+{
+    MPI_Allreduce(MPI_IN_PLACE, data.data(), (int) data.size(), MPIWrapper::GetDataType(data.data()), op, mpi->Communicator()) || MpiFail("AllReduceWith: MPI_Allreduce");
+    return data;
+}
+
+// Checks MPIWrapper::AllReduce() with the current algorithm against MPI_Allreduce() over the ranks in use,
+// and that the ranks set aside keep their data.
+template <class ElemType>
+static void CheckAllReduce(const MPIWrapperPtr& mpi)
+{
+    for (size_t numElements : { 0, 1, 3, 5, 17, 1000, 100003 })
+    {
+        BOOST_TEST_CONTEXT("numElements=" << numElements << ", sizeof(ElemType)=" << sizeof(ElemType))
+        {
+            auto data = CreateTestData<ElemType>(numElements, mpi->CurrentNodeRank());
+            mpi->AllReduce(data.data(), data.size());
+
+            if (mpi->IsIdle())
+            {
+                BOOST_CHECK(data == CreateTestData<ElemType>(numElements, mpi->CurrentNodeRank()));
+                continue;
+            }
+
+            auto expected = CreateTestData<ElemType>(numElements, mpi->CurrentNodeRank());
+            if (mpi->NumNodesInUse() > 1)
+                expected = AllReduceWith(mpi, expected, MPI_SUM);
+            for (size_t i = 0; i < numElements; i++)
+                BOOST_CHECK_CLOSE(data[i], expected[i], 1e-4);
+
+            // all ranks get bit-identical results
+            if (mpi->NumNodesInUse() > 1)
+                BOOST_CHECK(AllReduceWith(mpi, data, MPI_MAX) == AllReduceWith(mpi, data, MPI_MIN));
+        }
+    }
+}
+
+static void CheckAllReduceAlgorithms(const MPIWrapperPtr& mpi)
+{
+    for (const wstring& algorithm : { L"ring", L"hierarchical", L"auto", L"mpi" })
+    {
+        BOOST_TEST_CONTEXT("allReduceAlgorithm=" << string(algorithm.begin(), algorithm.end()))
+        {
+            // (auto: MPI_Allreduce below 1 KB)
+            mpi->SetAllReduceAlgorithm(MPIWrapper::ParseAllReduceAlgorithm(algorithm), 1024, numRanksPerSimulatedMachine);
+            CheckAllReduce<float>(mpi);
+            CheckAllReduce<double>(mpi);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(AllReduceSuite)
+
+BOOST_AUTO_TEST_CASE(AllReduceAlgorithmsMatchMPI)
+{
+    CheckAllReduceAlgorithms(GetMPI());
+}
+
+// (must come last, ranks cannot be brought back once set aside)
+BOOST_AUTO_TEST_CASE(AllReduceAlgorithmsMatchMPIWithRanksSetAside)
+{
+    auto mpi = GetMPI();
+    if (mpi->NumNodesInUse() < 2)
+        return;
+
+    mpi->SetAsideRanks(1);
+    CheckAllReduceAlgorithms(mpi);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,164 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for the memory sharing plan of MatrixPool::OptimizedMemoryAllocation().
+//
+#include "stdafx.h"
+#include "ComputationNode.h" // (includes MatrixPool.h)
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+typedef shared_ptr<Matrix<float>> MatrixPtr;
+
+BOOST_AUTO_TEST_SUITE(MatrixPoolSuite)
+
+BOOST_AUTO_TEST_CASE(MatrixPoolDisjointIntervalsShare)
+{
+    MatrixPool pool;
+    MatrixPtr a, b;
+    pool.Request<float>(a, nullptr, CPUDEVICE, 100, true);
+    pool.Release<float>(a, nullptr);
+    pool.Request<float>(b, nullptr, CPUDEVICE, 100, true);
+    pool.Release<float>(b, nullptr);
+    pool.OptimizedMemoryAllocation<float>();
+
+    BOOST_CHECK(a != nullptr);
+    BOOST_CHECK(a == b);
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolOverlappingIntervalsDoNotShare)
+{
+    MatrixPool pool;
+    MatrixPtr a, b, c;
+    pool.Request<float>(a, nullptr, CPUDEVICE, 100, true);
+    pool.Request<float>(b, nullptr, CPUDEVICE, 100, true);
+    pool.Release<float>(a, nullptr);
+    pool.Request<float>(c, nullptr, CPUDEVICE, 100, true); // overlaps b, but not a
+    pool.Release<float>(b, nullptr);
+    pool.Release<float>(c, nullptr);
+    pool.OptimizedMemoryAllocation<float>();
+
+    BOOST_CHECK(a != b);
+    BOOST_CHECK(b != c);
+    BOOST_CHECK(a == c);
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolNeverReleasedDoesNotShare)
+{
+    MatrixPool pool;
+    MatrixPtr a, b;
+    pool.Request<float>(a, nullptr, CPUDEVICE, 100, true); // e.g. a network output, which lives forever
+    pool.Request<float>(b, nullptr, CPUDEVICE, 100, true);
+    pool.Release<float>(b, nullptr);
+    pool.OptimizedMemoryAllocation<float>();
+
+    BOOST_CHECK(a != b);
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolBestFit)
+{
+    // 'large' and 'small' are live at the same time; 'later' is small and comes after both.
+    // Both buffers are free for it and neither has to grow, so it must go into the smaller one.
+    MatrixPool pool;
+    MatrixPtr large, small, later;
+    pool.Request<float>(large, nullptr, CPUDEVICE, 1000, true);
+    pool.Request<float>(small, nullptr, CPUDEVICE, 10, true);
+    pool.Release<float>(large, nullptr);
+    pool.Release<float>(small, nullptr);
+    pool.Request<float>(later, nullptr, CPUDEVICE, 10, true);
+    pool.Release<float>(later, nullptr);
+    pool.OptimizedMemoryAllocation<float>();
+
+    BOOST_CHECK(large != small);
+    BOOST_CHECK(later == small);
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolMinibatchScaledVersusFixedSize)
+{
+    // A minibatch-scaled buffer of 100 elements per sample and a fixed-size one of 500 elements are live at the same time.
+    // Later requests of each kind must go into the buffer of the same kind, since the other one would have to grow.
+    MatrixPool pool;
+    MatrixPtr perSample, fixed, laterPerSample, laterFixed;
+    pool.Request<float>(perSample, nullptr, CPUDEVICE, 100, true);
+    pool.Request<float>(fixed, nullptr, CPUDEVICE, 500, false);
+    pool.Release<float>(perSample, nullptr);
+    pool.Release<float>(fixed, nullptr);
+    pool.Request<float>(laterFixed, nullptr, CPUDEVICE, 500, false);
+    pool.Release<float>(laterFixed, nullptr);
+    pool.Request<float>(laterPerSample, nullptr, CPUDEVICE, 100, true);
+    pool.Release<float>(laterPerSample, nullptr);
+    pool.OptimizedMemoryAllocation<float>();
+
+    BOOST_CHECK(perSample != fixed);
+    BOOST_CHECK(laterFixed == fixed);
+    BOOST_CHECK(laterPerSample == perSample);
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolReleasedWithoutRequest)
+{
+    // a matrix released without having been requested keeps its identity and is shared with later requests
+    MatrixPool pool;
+    MatrixPtr own = make_shared<Matrix<float>>(CPUDEVICE);
+    MatrixPtr owned = own, a;
+    pool.Release<float>(own, nullptr, 100, true);
+    pool.Request<float>(a, nullptr, CPUDEVICE, 100, true);
+    pool.Release<float>(a, nullptr);
+    pool.OptimizedMemoryAllocation<float>();
+
+    BOOST_CHECK(a == owned);
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolReuseOrderPredicate)
+{
+    // with a predicate that forbids any hand-over, disjoint intervals must not share either
+    MatrixPool pool;
+    MatrixPtr a, b;
+    pool.Request<float>(a, nullptr, CPUDEVICE, 100, true);
+    pool.Release<float>(a, nullptr);
+    pool.Request<float>(b, nullptr, CPUDEVICE, 100, true);
+    pool.Release<float>(b, nullptr);
+    pool.OptimizedMemoryAllocation<float>([](const ComputationNodeBase*, int, const ComputationNodeBase*, int) { return false; });
+
+    BOOST_CHECK(a != b);
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolSharedParameterGradientMovedIntoArena)
+{
+    // the gradient of a parameter shares its pooled matrix with the gradient of another node that is done before it;
+    // fusing the parameter updates must move only the parameter's gradient into the arena, not the other one
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto weights = builder.CreateLearnableParameter(L"W", TensorShape(3, 4));
+    weights->Value().SetValue(0.5f);
+
+    MatrixPool pool;
+    MatrixPtr otherGradient;
+    pool.Request<float>(otherGradient, nullptr, CPUDEVICE, 12, false);
+    pool.Release<float>(otherGradient, nullptr);
+    weights->RequestMatricesBeforeBackprop(pool);
+    pool.OptimizedMemoryAllocation<float>();
+    BOOST_REQUIRE(otherGradient.get() == &weights->Gradient());
+
+    Matrix<float> valueArena(CPUDEVICE), gradientArena(CPUDEVICE);
+    net->AllocateLearnableParametersContiguously<float>({ weights }, valueArena, gradientArena);
+    BOOST_CHECK(otherGradient.get() != &weights->Gradient());
+    BOOST_CHECK(weights->Value().Data() == valueArena.Data());
+    BOOST_CHECK(weights->Gradient().Data() == gradientArena.Data());
+    BOOST_CHECK_EQUAL(valueArena.SumOfElements(), 6.0f);
+
+    // the other node's gradient is still an ordinary matrix, which it can resize and write without touching the arena
+    BOOST_CHECK_NO_THROW(otherGradient->Resize(12, 5));
+    otherGradient->SetValue(1.0f);
+    weights->Gradient().SetValue(2.0f);
+    BOOST_CHECK_EQUAL(gradientArena.SumOfElements(), 24.0f);
+    BOOST_CHECK_EQUAL(otherGradient->SumOfElements(), 60.0f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,532 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for the network rewrites that replace subgraphs by faster equivalents, and for the concurrent traversal: each
+// rewritten (or concurrently run) network must compute the same function, and the same gradients, as the original one.
+// Also tests that network snapshots for saving in the background keep the state they were taken with.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "ConvolutionalNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "RecurrentNodes.h"
+#include "ReshapingNodes.h"
+#include "TrainingNodes.h"
+#include "fileutil.h"
+#include <fstream>
+#include <iterator>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+typedef shared_ptr<ComputationNode<float>> NodePtr;
+
+// what a network computes in one minibatch: the output values in all valid frames, and the criterion and parameter gradients if it has a criterion
+struct MinibatchResult
+{
+    vector<float> output;
+    float criterion = 0;
+    map<wstring, vector<float>> gradients;
+};
+
+static vector<float> ValuesOf(const Matrix<float>& matrix)
+{
+    return vector<float>(matrix.Data(), matrix.Data() + matrix.GetNumElements());
+}
+
+// run one minibatch of two sequences of 5 and 3 frames (the latter followed by a gap) of fixed random inputs through 'net'
+static MinibatchResult RunMinibatch(const ComputationNetworkPtr& net, const wstring& outputName)
+{
+    auto output = net->GetNodeFromName(outputName);
+    auto criterion = net->FinalCriterionNodes().empty() ? nullptr : net->FinalCriterionNodes().front();
+    net->AllocateAllMatrices({}, { output }, criterion);
+
+    auto layout = net->GetMBLayoutPtrOfNetwork();
+    layout->Init(2, 5);
+    layout->AddSequence(0, 0, 0, 5);
+    layout->AddSequence(1, 1, 0, 3);
+    layout->AddGap(1, 3, 5);
+    vector<ComputationNodeBasePtr> inputs = net->FeatureNodes();
+    inputs.insert(inputs.end(), net->LabelNodes().begin(), net->LabelNodes().end());
+    unsigned long seed = 1;
+    for (const auto& input : inputs)
+    {
+        auto& value = input->As<ComputationNode<float>>()->Value();
+        value.Resize(input->GetSampleLayout().GetNumElements(), layout->GetNumCols());
+        value.SetUniformRandomValue(-1.0f, 1.0f, seed++);
+    }
+    ComputationNetwork::BumpEvalTimeStamp(inputs);
+
+    MinibatchResult result;
+    ScopedNetworkOperationMode modeGuard(net, criterion ? NetworkOperationMode::training : NetworkOperationMode::inferring);
+    net->StartEvaluateMinibatchLoop(output);
+    net->ForwardProp(output);
+    if (criterion)
+    {
+        net->StartEvaluateMinibatchLoop(criterion);
+        net->ForwardProp(criterion);
+        net->Backprop(criterion);
+        result.criterion = criterion->As<ComputationNode<float>>()->Value().Get00Element();
+        for (const auto& parameter : net->LearnableParameterNodes(criterion))
+            result.gradients[parameter->NodeName()] = ValuesOf(parameter->As<ComputationNode<float>>()->Gradient());
+    }
+
+    // (gap frames hold undefined values)
+    auto value = ValuesOf(output->As<ComputationNode<float>>()->Value());
+    size_t rows = output->GetSampleLayout().GetNumElements();
+    for (size_t t = 0; t < layout->GetNumTimeSteps(); t++)
+        for (size_t s = 0; s < layout->GetNumParallelSequences(); s++)
+            if (!layout->IsGap(FrameRange(layout, t).Sequence(s)))
+                result.output.insert(result.output.end(), value.begin() + (t * 2 + s) * rows, value.begin() + (t * 2 + s + 1) * rows);
+    return result;
+}
+
+static void CheckClose(const vector<float>& actual, const vector<float>& expected, float tolerance)
+{
+    BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+    for (size_t k = 0; k < actual.size(); k++)
+        BOOST_CHECK_SMALL(actual[k] - expected[k], tolerance * (1 + fabs(expected[k])));
+}
+
+static void CheckSameResult(const MinibatchResult& actual, const MinibatchResult& expected, float tolerance)
+{
+    CheckClose(actual.output, expected.output, tolerance);
+    BOOST_CHECK_SMALL(actual.criterion - expected.criterion, tolerance * (1 + fabs(expected.criterion)));
+    BOOST_REQUIRE_EQUAL(actual.gradients.size(), expected.gradients.size());
+    for (const auto& gradient : expected.gradients)
+    {
+        BOOST_TEST_CONTEXT("gradient of " << string(gradient.first.begin(), gradient.first.end()))
+        {
+            BOOST_REQUIRE(actual.gradients.find(gradient.first) != actual.gradients.end());
+            CheckClose(actual.gradients.at(gradient.first), gradient.second, tolerance);
+        }
+    }
+}
+
+static size_t CountNodesOf(const ComputationNetworkPtr& net, const wstring& operationName)
+{
+    size_t count = 0;
+    for (const auto& node : net->GetAllNodes())
+        count += node->OperationName() == operationName;
+    return count;
+}
+
+// -----------------------------------------------------------------------
+// FuseLSTMs()
+// -----------------------------------------------------------------------
+
+// an LSTM as created by the BrainScript LSTMP without projection, with a squared-error criterion on h
+// The biases have 'biasDim' elements; anything but cellDim makes the Plus broadcast, which the fused node can't do.
+static ComputationNetworkPtr CreateLSTMNetwork(bool withPeepholes, size_t biasDim = 4)
+{
+    const size_t inputDim = 3, cellDim = 4;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    unsigned long seed = 100;
+    auto parameter = [&](const wstring& name, const TensorShape& shape)
+    {
+        auto node = builder.CreateLearnableParameter(name, shape);
+        node->Value().SetUniformRandomValue(-0.5f, 0.5f, seed++);
+        return node;
+    };
+
+    NodePtr x = builder.CreateInputNode(L"features", inputDim);
+    NodePtr labels = builder.CreateInputNode(L"labels", cellDim);
+    NodePtr prevH = builder.PastValue(nullptr, 0.1f, cellDim, 1, L"prevH");
+    NodePtr prevC = builder.PastValue(nullptr, 0.2f, cellDim, 1, L"prevC");
+    auto gateInput = [&](const wstring& gate, const NodePtr& peepholeOperand)
+    {
+        NodePtr sum = builder.Plus(builder.Plus(builder.Times(parameter(L"W" + gate, TensorShape(cellDim, inputDim)), x),
+                                                builder.Times(parameter(L"H" + gate, TensorShape(cellDim, cellDim)), prevH)),
+                                   parameter(L"b" + gate, TensorShape(biasDim)));
+        if (withPeepholes && peepholeOperand)
+            sum = builder.Plus(sum, builder.ElementTimes(parameter(L"C" + gate, TensorShape(cellDim)), peepholeOperand));
+        return sum;
+    };
+    NodePtr i = builder.Sigmoid(gateInput(L"i", prevC));
+    NodePtr f = builder.Sigmoid(gateInput(L"f", prevC));
+    NodePtr g = builder.Tanh(gateInput(L"g", nullptr));
+    NodePtr c = builder.Plus(builder.ElementTimes(f, prevC), builder.ElementTimes(i, g), L"c");
+    NodePtr o = builder.Sigmoid(gateInput(L"o", c));
+    NodePtr h = builder.ElementTimes(o, builder.Tanh(c), L"h");
+    prevH->AttachInputs({ h });
+    prevC->AttachInputs({ c });
+    NodePtr criterion = builder.SquareError(labels, h, L"criterion");
+
+    net->AddToNodeGroup(L"feature", x);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->AddToNodeGroup(L"output", h);
+    net->CompileNetwork();
+    return net;
+}
+
+// -----------------------------------------------------------------------
+// FoldBatchNormalization()
+// -----------------------------------------------------------------------
+
+// a 3x3 convolution of 'x' with 'weights' [+ bias] followed by a spatial batch normalization with random statistics [and a ReLU]
+static NodePtr ConvolutionBatchNormalization(ComputationNetworkBuilder<float>& builder, const NodePtr& weights, const NodePtr& x,
+                                             bool withBias, bool withReLU, unsigned long seed)
+{
+    const size_t numMaps = 4;
+    auto parameter = [&](const wstring& name, const TensorShape& shape, float low, float high)
+    {
+        auto node = builder.CreateLearnableParameter(name, shape);
+        node->Value().SetUniformRandomValue(low, high, seed++);
+        return node;
+    };
+
+    const wstring prefix = L"bn" + to_wstring(seed);
+    NodePtr y = builder.Convolution(weights, x, TensorShape(3, 3, x->GetSampleLayout()[2]), TensorShape(numMaps), TensorShape(1, 1, x->GetSampleLayout()[2]),
+                                    { true }, { true, true, false }, TensorShape(0), TensorShape(0), /*transpose=*/false, ImageLayoutKind::CHW, 0, prefix + L".conv");
+    if (withBias)
+        y = builder.Plus(y, parameter(prefix + L".convB", TensorShape(1, 1, numMaps), -0.5f, 0.5f));
+    y = builder.BatchNormalization(y, parameter(prefix + L".scale", TensorShape(numMaps), 0.5f, 1.5f), parameter(prefix + L".bias", TensorShape(numMaps), -0.5f, 0.5f),
+                                   parameter(prefix + L".runMean", TensorShape(numMaps), -0.5f, 0.5f), parameter(prefix + L".runInvStdDev", TensorShape(numMaps), 0.5f, 1.5f),
+                                   /*spatial=*/true, 0, 0, 1e-5, /*useCntkEngine=*/true, ImageLayoutKind::CHW, prefix);
+    if (withReLU)
+        y = builder.RectifiedLinear(y, prefix + L".relu");
+    return y;
+}
+
+// a network with one convolution + batch normalization on a [6 x 5 x 3] image, for inference
+static ComputationNetworkPtr CreateConvolutionBatchNormalizationNetwork(bool withBias, bool withReLU)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    NodePtr x = builder.CreateInputNode(L"features", TensorShape(6, 5, 3));
+    NodePtr weights = builder.CreateLearnableParameter(L"W", TensorShape(4, 3 * 3 * 3));
+    weights->Value().SetUniformRandomValue(-0.5f, 0.5f, 100);
+    NodePtr y = ConvolutionBatchNormalization(builder, weights, x, withBias, withReLU, 200);
+    net->AddToNodeGroup(L"feature", x);
+    net->AddToNodeGroup(L"output", y);
+    net->CompileNetwork();
+    return net;
+}
+
+// -----------------------------------------------------------------------
+// HoistLoopInvariantProjections()
+// -----------------------------------------------------------------------
+
+// a simple RNN h = Tanh(W * RowStack(...) + b) over the inputs x (3), z (2) and h(t-1) (4), stacked in the order given by 'stackOrder',
+// with a squared-error criterion on h
+// With 'withSharedWeights', W also projects a further input u outside the loop, which adds to the criterion.
+static ComputationNetworkPtr CreateStackedRNNNetwork(const wstring& stackOrder, bool withSharedWeights)
+{
+    const size_t cellDim = 4;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    NodePtr x = builder.CreateInputNode(L"features", 3);
+    NodePtr z = builder.CreateInputNode(L"auxFeatures", 2);
+    NodePtr labels = builder.CreateInputNode(L"labels", cellDim);
+    NodePtr prevH = builder.PastValue(nullptr, 0.1f, cellDim, 1, L"prevH");
+    NodePtr weights = builder.CreateLearnableParameter(L"W", TensorShape(cellDim, 3 + 2 + cellDim));
+    weights->Value().SetUniformRandomValue(-0.5f, 0.5f, 100);
+    NodePtr bias = builder.CreateLearnableParameter(L"b", TensorShape(cellDim));
+    bias->Value().SetUniformRandomValue(-0.5f, 0.5f, 101);
+
+    vector<NodePtr> stacked;
+    for (auto c : stackOrder)
+        stacked.push_back(c == L'x' ? x : c == L'z' ? z : prevH);
+    NodePtr h = builder.Tanh(builder.Plus(builder.Times(weights, builder.RowStack(stacked, L"stack"), 1, L"proj"), bias), L"h");
+    prevH->AttachInputs({ h });
+    NodePtr prediction = h;
+    if (withSharedWeights)
+    {
+        NodePtr u = builder.CreateInputNode(L"sharedFeatures", 3 + 2 + cellDim);
+        net->AddToNodeGroup(L"feature", u);
+        prediction = builder.Plus(h, builder.Times(weights, u));
+    }
+    NodePtr criterion = builder.SquareError(labels, prediction, L"criterion");
+
+    net->AddToNodeGroup(L"feature", x);
+    net->AddToNodeGroup(L"feature", z);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->AddToNodeGroup(L"output", h);
+    net->CompileNetwork();
+    return net;
+}
+
+// -----------------------------------------------------------------------
+// SetConcurrentScheduling()
+// -----------------------------------------------------------------------
+
+// independent projections Tanh(W * x_k) of several inputs with a shared W, summed into a squared-error criterion,
+// so that the consumers of W become ready for backprop at about the same time (and large enough that unsynchronized
+// updates of its gradient would overlap)
+static ComputationNetworkPtr CreateSharedParameterNetwork(size_t numThreads)
+{
+    const size_t dim = 512, numConsumers = 8;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    NodePtr weights = builder.CreateLearnableParameter(L"W", TensorShape(dim, dim));
+    weights->Value().SetUniformRandomValue(-0.5f, 0.5f, 100);
+    NodePtr labels = builder.CreateInputNode(L"labels", dim);
+    NodePtr sum;
+    for (size_t k = 0; k < numConsumers; k++)
+    {
+        NodePtr x = builder.CreateInputNode(L"features" + to_wstring(k), dim);
+        net->AddToNodeGroup(L"feature", x);
+        NodePtr y = builder.Tanh(builder.Times(weights, x));
+        sum = sum ? builder.Plus(sum, y) : y;
+    }
+    NodePtr criterion = builder.SquareError(labels, sum, L"criterion");
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->AddToNodeGroup(L"output", sum);
+    net->CompileNetwork();
+    net->SetConcurrentScheduling(numThreads);
+    return net;
+}
+
+BOOST_AUTO_TEST_SUITE(NetworkRewriteSuite)
+
+BOOST_AUTO_TEST_CASE(FuseLSTMsForwardAndBackward)
+{
+    for (bool withPeepholes : { false, true })
+    {
+        BOOST_TEST_CONTEXT("withPeepholes=" << withPeepholes)
+        {
+            auto expected = RunMinibatch(CreateLSTMNetwork(withPeepholes), L"h");
+
+            auto net = CreateLSTMNetwork(withPeepholes);
+            net->FuseLSTMs<float>();
+            BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(OptimizedLSTMNode)), 1);
+            BOOST_CHECK(net->GetNodeFromName(L"h")->OperationName() == OperationNameOf(OptimizedLSTMNode));
+            CheckSameResult(RunMinibatch(net, L"h"), expected, 1e-5f);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(FuseLSTMsSkipsMismatchingShapes)
+{
+    // a scalar bias is broadcast by the Plus, which OptimizedLSTMNode does not do; the LSTM must be left alone
+    auto net = CreateLSTMNetwork(/*withPeepholes=*/false, /*biasDim=*/1);
+    size_t numNodes = net->GetTotalNumberOfNodes();
+    auto expected = RunMinibatch(CreateLSTMNetwork(/*withPeepholes=*/false, /*biasDim=*/1), L"h");
+
+    net->FuseLSTMs<float>();
+    BOOST_CHECK_EQUAL(net->GetTotalNumberOfNodes(), numNodes);
+    BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(OptimizedLSTMNode)), 0);
+    CheckSameResult(RunMinibatch(net, L"h"), expected, 0);
+}
+
+BOOST_AUTO_TEST_CASE(FuseLSTMsSavesOriginalNodes)
+{
+    const wstring modelPath = L"FuseLSTMsSavesOriginalNodes.model";
+    auto unfused = CreateLSTMNetwork(/*withPeepholes=*/true);
+    size_t numNodes = unfused->GetTotalNumberOfNodes();
+    auto expected = RunMinibatch(unfused, L"h");
+
+    // a fused network is saved in its original form, which any device can load
+    auto net = CreateLSTMNetwork(/*withPeepholes=*/true);
+    net->FuseLSTMs<float>();
+    net->Save(modelPath);
+    auto loaded = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, modelPath);
+    BOOST_CHECK_EQUAL(loaded->GetTotalNumberOfNodes(), numNodes);
+    BOOST_CHECK_EQUAL(CountNodesOf(loaded, OperationNameOf(OptimizedLSTMNode)), 0);
+    BOOST_CHECK(loaded->GetNodeFromName(L"h")->OperationName() == OperationNameOf(ElementTimesNode));
+    CheckSameResult(RunMinibatch(loaded, L"h"), expected, 0);
+
+    // and can be reread into the fused network
+    for (const auto& parameter : net->LearnableParameterNodes(net->FinalCriterionNodes().front()))
+        parameter->As<ComputationNode<float>>()->Value().SetValue(0);
+    net->RereadPersistableParameters<float>(modelPath);
+    CheckSameResult(RunMinibatch(net, L"h"), expected, 1e-5f);
+
+    unlinkOrDie(modelPath);
+}
+
+BOOST_AUTO_TEST_CASE(FoldBatchNormalizationOutputs)
+{
+    for (bool withBias : { false, true })
+    {
+        for (bool withReLU : { false, true })
+        {
+            BOOST_TEST_CONTEXT("withBias=" << withBias << ", withReLU=" << withReLU)
+            {
+                auto net = CreateConvolutionBatchNormalizationNetwork(withBias, withReLU);
+                auto outputName = net->OutputNodes().front()->NodeName();
+                auto expected = RunMinibatch(CreateConvolutionBatchNormalizationNetwork(withBias, withReLU), outputName);
+
+                net->FoldBatchNormalization<float>();
+                BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(FusedConvolutionNode)), 1);
+                BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(BatchNormalizationNode)), 0);
+                BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(ConvolutionNode)), 0);
+                BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(RectifiedLinearNode)), 0);
+                BOOST_CHECK(net->OutputNodes().front()->NodeName() == outputName);
+                BOOST_CHECK(!net->NodeNameExists(L"W")); // (no longer used)
+                CheckSameResult(RunMinibatch(net, outputName), expected, 1e-5f);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(FoldBatchNormalizationCuDnnStatistics)
+{
+    // The cuDNN engine stores the running variance instead of its inverse square root, and raises epsilon to its minimum
+    // of 1e-5. Networks with such nodes can't be validated on CPU, but the folding only depends on the per-map transform
+    // y = a .* x + b, which must be the same as that of the equivalent CNTK-engine node.
+    const size_t numMaps = 4;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    NodePtr x = builder.CreateInputNode(L"features", TensorShape(6, 5, numMaps));
+    unsigned long seed = 1;
+    auto parameter = [&](const wstring& name, float low, float high)
+    {
+        auto node = builder.CreateLearnableParameter(name, TensorShape(numMaps));
+        node->Value().SetUniformRandomValue(low, high, seed++);
+        return node;
+    };
+    NodePtr scale = parameter(L"scale", 0.5f, 1.5f), bias = parameter(L"bias", -0.5f, 0.5f), runMean = parameter(L"runMean", -0.5f, 0.5f);
+    NodePtr runVariance = parameter(L"runVariance", 0.5f, 1.5f);
+    NodePtr runInvStdDev = builder.CreateLearnableParameter(L"runInvStdDev", TensorShape(numMaps));
+    runInvStdDev->Value().SetValue(runVariance->Value());
+    runInvStdDev->Value() += 1e-5f;
+    runInvStdDev->Value().InplaceSqrt().ElementInverse();
+
+    auto cudnn = dynamic_pointer_cast<BatchNormalizationNode<float>>(builder.BatchNormalization(x, scale, bias, runMean, runVariance, /*spatial=*/true,
+                                                                                                0, 0, /*epsilon=*/1e-6, /*useCntkEngine=*/false, ImageLayoutKind::CHW, L"cudnn"));
+    auto cntk = dynamic_pointer_cast<BatchNormalizationNode<float>>(builder.BatchNormalization(x, scale, bias, runMean, runInvStdDev, /*spatial=*/true,
+                                                                                               0, 0, /*epsilon=*/1e-5, /*useCntkEngine=*/true, ImageLayoutKind::CHW, L"cntk"));
+    vector<double> a, b, expectedA, expectedB;
+    cudnn->GetInferenceTransform(a, b);
+    cntk->GetInferenceTransform(expectedA, expectedB);
+    CheckClose(vector<float>(a.begin(), a.end()), vector<float>(expectedA.begin(), expectedA.end()), 1e-6f);
+    CheckClose(vector<float>(b.begin(), b.end()), vector<float>(expectedB.begin(), expectedB.end()), 1e-6f);
+}
+
+BOOST_AUTO_TEST_CASE(FoldBatchNormalizationSharedWeights)
+{
+    // three convolutions share their weights: two are followed by different batch normalizations, the third is not
+    // Both get their own folded weights, and the original weights stay for the third.
+    auto createNetwork = []()
+    {
+        auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+        ComputationNetworkBuilder<float> builder(*net);
+        NodePtr x = builder.CreateInputNode(L"features", TensorShape(6, 5, 3));
+        NodePtr weights = builder.CreateLearnableParameter(L"W", TensorShape(4, 3 * 3 * 3));
+        weights->Value().SetUniformRandomValue(-0.5f, 0.5f, 100);
+        NodePtr a = ConvolutionBatchNormalization(builder, weights, x, /*withBias=*/false, /*withReLU=*/true, 200);
+        NodePtr b = ConvolutionBatchNormalization(builder, weights, x, /*withBias=*/true, /*withReLU=*/false, 300);
+        NodePtr c = builder.Convolution(weights, x, TensorShape(3, 3, 3), TensorShape(4), TensorShape(1, 1, 3),
+                                        { true }, { true, true, false }, TensorShape(0), TensorShape(0), /*transpose=*/false, ImageLayoutKind::CHW, 0, L"c");
+        NodePtr y = builder.Plus(builder.Plus(a, b), c, L"y");
+        net->AddToNodeGroup(L"feature", x);
+        net->AddToNodeGroup(L"output", y);
+        net->CompileNetwork();
+        return net;
+    };
+    auto expected = RunMinibatch(createNetwork(), L"y");
+
+    auto net = createNetwork();
+    net->FoldBatchNormalization<float>();
+    BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(FusedConvolutionNode)), 2);
+    BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(BatchNormalizationNode)), 0);
+    BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(ConvolutionNode)), 1);
+    BOOST_CHECK(net->NodeNameExists(L"W"));
+    BOOST_CHECK(net->GetNodeFromName(L"c")->GetInputs()[0] == net->GetNodeFromName(L"W"));
+    CheckSameResult(RunMinibatch(net, L"y"), expected, 1e-5f);
+}
+
+BOOST_AUTO_TEST_CASE(HoistLoopInvariantProjectionsForwardAndBackward)
+{
+    // "xhz" gives two invariant runs around the recurrent input, which are summed; "xzh" gives one run of two inputs, which is restacked
+    for (const wstring stackOrder : { L"xhz", L"xzh" })
+    {
+        for (bool withSharedWeights : { false, true })
+        {
+            BOOST_TEST_CONTEXT("stackOrder=" << string(stackOrder.begin(), stackOrder.end()) << ", withSharedWeights=" << withSharedWeights)
+            {
+                auto expected = RunMinibatch(CreateStackedRNNNetwork(stackOrder, withSharedWeights), L"h");
+
+                auto net = CreateStackedRNNNetwork(stackOrder, withSharedWeights);
+                net->HoistLoopInvariantProjections<float>();
+                size_t numParts = stackOrder == L"xhz" ? 3 : 2;
+                BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(SliceNode)), numParts);
+                BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(TimesNode)), numParts + withSharedWeights);
+                BOOST_CHECK_EQUAL(CountNodesOf(net, OperationNameOf(RowStackNode)), stackOrder == L"xhz" ? 0 : 1);
+                BOOST_CHECK(!net->NodeNameExists(L"stack"));
+                BOOST_CHECK(net->GetNodeFromName(L"proj")->OperationName() == OperationNameOf(PlusNode));
+
+                // only the projection of h(t-1) is left inside the loop
+                size_t numTimesInLoop = 0;
+                for (const auto& node : net->GetAllNodes())
+                    numTimesInLoop += node->OperationName() == OperationNameOf(TimesNode) && node->IsPartOfLoop();
+                BOOST_CHECK_EQUAL(numTimesInLoop, 1);
+
+                // W now has several consumers, but must still be listed, and thus updated, only once
+                auto parameters = net->LearnableParameterNodes(net->FinalCriterionNodes().front());
+                BOOST_CHECK_EQUAL(count_if(parameters.begin(), parameters.end(), [](const ComputationNodeBasePtr& node) { return node->NodeName() == L"W"; }), 1);
+                BOOST_CHECK_EQUAL(parameters.size(), 2);
+
+                CheckSameResult(RunMinibatch(net, L"h"), expected, 1e-5f);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentSchedulingSharedParameterGradient)
+{
+    // all consumers of W add into its gradient; the concurrent traversal must give the same gradient as the sequential one
+    auto sequential = CreateSharedParameterNetwork(0);
+    auto expected = RunMinibatch(sequential, sequential->OutputNodes().front()->NodeName());
+    for (size_t repetition = 0; repetition < 10; repetition++)
+    {
+        auto net = CreateSharedParameterNetwork(4);
+        BOOST_REQUIRE_EQUAL(net->GetConcurrentSchedulingThreads(), 4);
+        CheckSameResult(RunMinibatch(net, net->OutputNodes().front()->NodeName()), expected, 1e-5f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CreateSnapshotForSavingKeepsState)
+{
+    // the snapshot must save what the network was at the time it was taken, although training goes on until it is written
+    const wstring expectedPath = L"CreateSnapshotForSaving.expected.model", snapshotPath = L"CreateSnapshotForSaving.snapshot.model";
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    NodePtr x = builder.CreateInputNode(L"features", TensorShape(6, 5, 3));
+    NodePtr labels = builder.CreateInputNode(L"labels", TensorShape(6, 5, 4));
+    NodePtr weights = builder.CreateLearnableParameter(L"W", TensorShape(4, 3 * 3 * 3));
+    weights->Value().SetUniformRandomValue(-0.5f, 0.5f, 100);
+    NodePtr y = ConvolutionBatchNormalization(builder, weights, x, /*withBias=*/false, /*withReLU=*/false, 200);
+    NodePtr criterion = builder.SquareError(labels, y, L"criterion");
+    net->AddToNodeGroup(L"feature", x);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->AddToNodeGroup(L"output", y);
+    net->CompileNetwork();
+
+    // training-mode minibatches update the running statistics and the minibatch count of the batch normalization
+    RunMinibatch(net, y->NodeName());
+    net->Save(expectedPath);
+    auto snapshot = net->CreateSnapshotForSaving<float>();
+    {
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        ComputationNetwork::BumpEvalTimeStamp(net->FeatureNodes());
+        net->ForwardProp(net->FinalCriterionNodes().front());
+    }
+    snapshot->Save(snapshotPath);
+
+    auto readFile = [](const wstring& path)
+    {
+        ifstream file(string(path.begin(), path.end()), ios::binary);
+        return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    };
+    auto expected = readFile(expectedPath);
+    BOOST_CHECK(!expected.empty());
+    BOOST_CHECK(readFile(snapshotPath) == expected);
+
+    unlinkOrDie(expectedPath);
+    unlinkOrDie(snapshotPath);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
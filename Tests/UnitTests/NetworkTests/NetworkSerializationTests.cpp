@@ -0,0 +1,130 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for saving and loading networks, in particular the page-aligned parameter values of model version 10, which
+// can be loaded by memory-mapping the model file.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "fileutil.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+typedef shared_ptr<ComputationNode<float>> NodePtr;
+
+static const size_t pageSize = 4096;
+
+// y = W * x + b, with a W of 8 KB, which is stored page-aligned, and a b of 128 bytes, which is not
+static ComputationNetworkPtr CreateAffineNetwork(unsigned long seed)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    NodePtr x = builder.CreateInputNode(L"features", 64);
+    NodePtr weights = builder.CreateLearnableParameter(L"W", TensorShape(32, 64));
+    weights->Value().SetUniformRandomValue(-0.5f, 0.5f, seed);
+    NodePtr bias = builder.CreateLearnableParameter(L"b", TensorShape(32));
+    bias->Value().SetUniformRandomValue(-0.5f, 0.5f, seed + 1);
+    NodePtr y = builder.Plus(builder.Times(weights, x, 1, L"Wx"), bias, L"y");
+    net->AddToNodeGroup(L"feature", x);
+    net->AddToNodeGroup(L"output", y);
+    net->CompileNetwork();
+    return net;
+}
+
+static const Matrix<float>& ValueOf(const ComputationNetworkPtr& net, const wstring& nodeName)
+{
+    return net->GetNodeFromName(nodeName)->As<ComputationNode<float>>()->Value();
+}
+
+static vector<float> ValuesOf(const ComputationNetworkPtr& net, const wstring& nodeName)
+{
+    const auto& value = ValueOf(net, nodeName);
+    return vector<float>(value.Data(), value.Data() + value.GetNumElements());
+}
+
+static void CheckSameParameters(const ComputationNetworkPtr& actual, const ComputationNetworkPtr& expected)
+{
+    for (const wstring nodeName : { L"W", L"b" })
+    {
+        BOOST_TEST_CONTEXT("parameter " << string(nodeName.begin(), nodeName.end()))
+        {
+            BOOST_CHECK_EQUAL(ValueOf(actual, nodeName).GetNumRows(), ValueOf(expected, nodeName).GetNumRows());
+            BOOST_CHECK_EQUAL(ValueOf(actual, nodeName).GetNumCols(), ValueOf(expected, nodeName).GetNumCols());
+            BOOST_CHECK(ValuesOf(actual, nodeName) == ValuesOf(expected, nodeName));
+        }
+    }
+}
+
+static bool IsPageAligned(const Matrix<float>& matrix)
+{
+    return (uintptr_t) matrix.Data() % pageSize == 0;
+}
+
+BOOST_AUTO_TEST_SUITE(NetworkSerializationSuite)
+
+BOOST_AUTO_TEST_CASE(SaveLoadPageAlignedParameters)
+{
+    const wstring modelPath = L"SaveLoadPageAlignedParameters.model";
+    auto original = CreateAffineNetwork(100);
+    original->Save(modelPath);
+
+    for (bool mapParameters : { false, true })
+    {
+        BOOST_TEST_CONTEXT("mapParameters=" << mapParameters)
+        {
+            auto loaded = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, modelPath, mapParameters);
+            CheckSameParameters(loaded, original);
+            // a mapped W is used in place, which only works if it starts at a page-aligned file offset
+            if (mapParameters)
+                BOOST_CHECK(IsPageAligned(ValueOf(loaded, L"W")));
+        }
+    }
+
+    // the file is mapped copy-on-write: changing a mapped parameter in place leaves the model file alone
+    {
+        auto mapped = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, modelPath, /*mapParameters=*/true);
+        BOOST_REQUIRE(IsPageAligned(ValueOf(mapped, L"W")));
+        mapped->GetNodeFromName(L"W")->As<ComputationNode<float>>()->Value().SetValue(0);
+        BOOST_CHECK(ValuesOf(mapped, L"W") == vector<float>(32 * 64, 0));
+    }
+    CheckSameParameters(ComputationNetwork::CreateFromFile<float>(CPUDEVICE, modelPath), original);
+
+    unlinkOrDie(modelPath);
+}
+
+BOOST_AUTO_TEST_CASE(RereadPersistableParametersIntoMappedParameters)
+{
+    const wstring modelPath = L"RereadMapped.model", otherModelPath = L"RereadMapped.other.model";
+    auto original = CreateAffineNetwork(100);
+    original->Save(modelPath);
+    auto other = CreateAffineNetwork(200);
+    other->Save(otherModelPath);
+
+    // rereading writes the values into the mapped pages, which get private copies
+    auto mapped = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, modelPath, /*mapParameters=*/true);
+    BOOST_REQUIRE(IsPageAligned(ValueOf(mapped, L"W")));
+    mapped->RereadPersistableParameters<float>(otherModelPath);
+    CheckSameParameters(mapped, other);
+
+    // and neither of the files changes
+    CheckSameParameters(ComputationNetwork::CreateFromFile<float>(CPUDEVICE, modelPath), original);
+    CheckSameParameters(ComputationNetwork::CreateFromFile<float>(CPUDEVICE, otherModelPath), other);
+
+    // the mapped network can still be saved, and reads back the same
+    const wstring resavedModelPath = L"RereadMapped.resaved.model";
+    mapped->Save(resavedModelPath);
+    CheckSameParameters(ComputationNetwork::CreateFromFile<float>(CPUDEVICE, resavedModelPath, /*mapParameters=*/true), other);
+
+    mapped.reset(); // (releases the mapping before the file goes)
+    unlinkOrDie(modelPath);
+    unlinkOrDie(otherModelPath);
+    unlinkOrDie(resavedModelPath);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,91 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for the staleness bound of the parameter servers of ParameterServerSGD.
+//
+#include "stdafx.h"
+#include "SGD.h"
+#include "ParameterServerSGD.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(ParameterServerSuite)
+
+BOOST_AUTO_TEST_CASE(StalenessBoundWithinEpoch)
+{
+    BoundedStalenessClock clock(/*numWorkers=*/2, /*maxStaleness=*/2);
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        clock.OnPush(0);
+        BOOST_CHECK(clock.MayAnswer(0) == (i < 2));
+        BOOST_CHECK(clock.MayAnswer(1));
+    }
+
+    // the slow worker catches up
+    clock.OnPush(1);
+    BOOST_CHECK(clock.MayAnswer(0));
+
+    // a worker at the end of the epoch does not hold back the others
+    clock.OnPush(0);
+    BOOST_CHECK(!clock.MayAnswer(0));
+    clock.Deactivate(1);
+    BOOST_CHECK(clock.MayAnswer(0));
+}
+
+BOOST_AUTO_TEST_CASE(StalenessBoundWithUnevenPushesPerEpoch)
+{
+    const size_t maxStaleness = 2;
+    BoundedStalenessClock clock(/*numWorkers=*/2, maxStaleness);
+
+    for (size_t epoch = 0; epoch < 3; epoch++)
+    {
+        BOOST_TEST_CONTEXT("epoch=" << epoch)
+        {
+            // worker 1 gets one minibatch per epoch and reaches the end of the epoch first
+            clock.OnPush(1);
+            BOOST_CHECK(clock.MayAnswer(1));
+            clock.Deactivate(1);
+
+            // worker 0 gets many more, and must never wait for the finished worker 1
+            for (size_t i = 0; i < 10; i++)
+            {
+                clock.OnPush(0);
+                BOOST_CHECK(clock.MayAnswer(0));
+            }
+            clock.Deactivate(0);
+            clock.OnEpochEnd();
+
+            // in the next epoch, the bound applies to the pushes of that epoch only
+            clock.OnPush(0);
+            BOOST_CHECK(clock.MayAnswer(0));
+            clock.OnPush(0);
+            clock.OnPush(0);
+            BOOST_CHECK(!clock.MayAnswer(0));
+            clock.OnPush(1);
+            clock.OnPush(1);
+            BOOST_CHECK(clock.MayAnswer(0));
+
+            // (end this epoch as well, so that the next iteration starts evenly)
+            clock.Deactivate(0);
+            clock.Deactivate(1);
+            clock.OnEpochEnd();
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(NoStalenessBound)
+{
+    BoundedStalenessClock clock(/*numWorkers=*/3, /*maxStaleness=*/SIZE_MAX);
+    for (size_t i = 0; i < 1000; i++)
+        clock.OnPush(2);
+    BOOST_CHECK(clock.MayAnswer(0));
+    BOOST_CHECK(clock.MayAnswer(2));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
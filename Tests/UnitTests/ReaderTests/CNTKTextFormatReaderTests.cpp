@@ -33,11 +33,34 @@ public:
         m_parser.SetNumRetries(0);
         m_parser.Initialize();
     }
+
+    CNTKTextFormatReaderTestRunner(const string& filename,
+        const vector<StreamDescriptor>& streams, bool skipSequenceIds, bool cacheIndex) :
+        m_parser(std::make_shared<CorpusDescriptor>(), wstring(filename.begin(), filename.end()), streams)
+    {
+        m_parser.SetChunkSize(SIZE_MAX);
+        m_parser.SetNumRetries(0);
+        m_parser.SetSkipSequenceIds(skipSequenceIds);
+        m_parser.SetCacheIndex(cacheIndex);
+        m_parser.Initialize();
+    }
+
     // Retrieves a chunk of data.
     void LoadChunk()
     {
         m_chunk = m_parser.GetChunk(0);
     }
+
+    // Returns the number of sequences found by the indexer.
+    size_t GetNumberOfSequences()
+    {
+        size_t numberOfSequences = 0;
+        for (const auto& chunk : m_parser.GetChunkDescriptions())
+        {
+            numberOfSequences += chunk->m_numberOfSequences;
+        }
+        return numberOfSequences;
+    }
 };
 
 namespace Test {
@@ -691,6 +714,139 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_100x100x3)
     CheckFilesEquivalent(controlFile, outputFile);
 };
 
+// Same as above, but with a memory mapped input file and a cached index.
+// The first run builds the index and writes the cache file, the second one reuses it.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_100x100x3_memory_mapped)
+{
+    string cacheFile = "100x100x3_jagged_sequences_dense.txt.idx";
+    boost::filesystem::remove(cacheFile);
+
+    string outputFile = testDataPath() + "/Control/CNTKTextFormatReader/100x100x3_jagged_sequences_dense_memory_mapped_Output.txt";
+    auto controlFile = testDataPath() + "/Control/CNTKTextFormatReader/100x100x3_jagged_sequences_dense_sorted.txt";
+
+    for (int run = 0; run < 2; run++)
+    {
+        HelperReadInAndWriteOut<double>(
+            testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+            outputFile,
+            "100x100x3_memory_mapped",
+            "reader",
+            5476,  // epoch size = number of samples in the input file
+            1000,  // mb size
+            1,  // num epochs
+            3,
+            0,
+            0,
+            1,
+            false, // dense features
+            false,
+            false); // do not user shared layout
+
+        BOOST_REQUIRE(boost::filesystem::exists(cacheFile));
+
+        SortLinesInFile(outputFile, 5476 * 3);
+
+        CheckFilesEquivalent(controlFile, outputFile);
+    }
+
+    boost::filesystem::remove(cacheFile);
+};
+
+// The cached index depends on whether sequence ids are skipped (every line is a sequence then),
+// a cache file built in one mode must not be reused in the other.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_cached_index_skipSequenceIds)
+{
+    string inputFile = "cached_index_multiline_sequences.txt";
+    string cacheFile = inputFile + ".idx";
+    {
+        ofstream input(inputFile);
+        input << "0 |A 1\n0 |A 2\n1 |A 3\n1 |A 4\n1 |A 5\n";
+    }
+    boost::filesystem::remove(cacheFile);
+
+    vector<StreamDescriptor> streams(1);
+    streams[0].m_alias = "A";
+    streams[0].m_name = L"A";
+    streams[0].m_storageType = StorageType::dense;
+    streams[0].m_sampleDimension = 1;
+
+    for (bool skipSequenceIdsFirst : { true, false })
+    {
+        BOOST_TEST_CONTEXT("skipSequenceIds=" << skipSequenceIdsFirst << " first")
+        {
+            // each run (re)writes the cache file, unless it can be reused
+            for (bool skipSequenceIds : { skipSequenceIdsFirst, !skipSequenceIdsFirst, !skipSequenceIdsFirst, skipSequenceIdsFirst })
+            {
+                CNTKTextFormatReaderTestRunner<float> testRunner(inputFile, streams, skipSequenceIds, /*cacheIndex=*/true);
+                BOOST_REQUIRE(boost::filesystem::exists(cacheFile));
+                BOOST_CHECK_EQUAL(testRunner.GetNumberOfSequences(), (size_t)(skipSequenceIds ? 5 : 2));
+            }
+        }
+        boost::filesystem::remove(cacheFile);
+    }
+
+    boost::filesystem::remove(inputFile);
+};
+
+// TextParser converts runs of 8 digits at once, and falls back to one digit at a time
+// for shorter runs and at the end of a sequence. Checks numbers that cross 8-digit boundaries,
+// have leading zeros, signs and exponents, or mix both ways of parsing.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_number_parsing)
+{
+    const vector<string> values = {
+        "7", "1.5", "1234567", "12345678", "123456789", "1234567890", "12345678901234567",
+        "123456789012", "99999999", "100000000", "0000000000000012", "00000000.00000001",
+        "-12345678", "+12345678", "-0.123456789", "+987654321.123456789", "3.14159265358979",
+        "0.000000001", "1.23456789e+10", "123456789E-8", "-1234567890123e-5", "12345678e2",
+        "1.2345678e-00000012", "123456789012345678e-10" };
+    const vector<string> indices = { "0", "7", "12345678", "123456789", "00000000042", "999999999" };
+
+    // one sequence per line, the sparse value ends the line (no run of 8 digits fits before the end)
+    string inputFile = "number_parsing.txt";
+    {
+        ofstream input(inputFile);
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            input << "|A " << values[i] << " |B " << indices[i % indices.size()] << ":" << values[values.size() - 1 - i] << "\n";
+        }
+    }
+
+    vector<StreamDescriptor> streams(2);
+    streams[0].m_alias = "A";
+    streams[0].m_name = L"A";
+    streams[0].m_storageType = StorageType::dense;
+    streams[0].m_sampleDimension = 1;
+
+    streams[1].m_alias = "B";
+    streams[1].m_name = L"B";
+    streams[1].m_storageType = StorageType::sparse_csc;
+    streams[1].m_sampleDimension = 1000000000;
+
+    CNTKTextFormatReaderTestRunner<double> testRunner(inputFile, streams, 0);
+    testRunner.LoadChunk();
+
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        BOOST_TEST_CONTEXT("line " << i)
+        {
+            vector<SequenceDataPtr> data;
+            testRunner.m_chunk->GetSequence(i, data);
+            BOOST_REQUIRE_EQUAL(data.size(), 2);
+
+            auto dense = static_cast<DenseSequenceData*>(data[0].get());
+            BOOST_REQUIRE_EQUAL(dense->m_numberOfSamples, 1);
+            BOOST_CHECK_CLOSE(*static_cast<double*>(dense->m_data), strtod(values[i].c_str(), nullptr), 1e-12);
+
+            auto sparse = static_cast<SparseSequenceData*>(data[1].get());
+            BOOST_REQUIRE_EQUAL(sparse->m_totalNnzCount, 1);
+            BOOST_CHECK_EQUAL(sparse->m_indices[0], strtol(indices[i % indices.size()].c_str(), nullptr, 10));
+            BOOST_CHECK_CLOSE(*static_cast<double*>(sparse->m_data), strtod(values[values.size() - 1 - i].c_str(), nullptr), 1e-12);
+        }
+    }
+
+    boost::filesystem::remove(inputFile);
+};
+
 // 200 sequences with N samples in an input, 
 // where N is chosen at random from [1, 200] for each input in a sequence.
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_200x200x2_seq2seq)
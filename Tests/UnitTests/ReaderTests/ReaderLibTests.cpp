@@ -9,7 +9,10 @@
 #include "DataDeserializer.h"
 #include "BlockRandomizer.h"
 #include "CorpusDescriptor.h"
+#include "SequencePacker.h"
+#include "HeapMemoryProvider.h"
 
+#include <functional>
 #include <numeric>
 #include <random>
 
@@ -327,6 +330,55 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerChaosMonkey)
     }
 }
 
+// Loading chunks in the background must not change what is returned.
+BOOST_AUTO_TEST_CASE(BlockRandomizerChunkPrefetching)
+{
+    const int numChunks = 50;
+    const int numSequencesPerChunk = 4;
+    vector<float> data(numChunks * numSequencesPerChunk);
+    iota(data.begin(), data.end(), 0.0f);
+
+    auto getAllSequences = [&](size_t prefetchThreads, size_t prefetchChunks, size_t numberOfWorkers, size_t workerRank)
+    {
+        auto mockDeserializer = make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data);
+        auto randomizer = make_shared<BlockRandomizer>(0, 3 * numSequencesPerChunk, mockDeserializer, BlockRandomizer::DecimationMode::chunk, false, false, prefetchThreads, prefetchChunks);
+
+        vector<float> actual;
+        for (size_t epoch = 0; epoch < 3; epoch++)
+        {
+            EpochConfiguration epochConfiguration;
+            epochConfiguration.m_numberOfWorkers = numberOfWorkers;
+            epochConfiguration.m_workerRank = workerRank;
+            epochConfiguration.m_minibatchSizeInSamples = 0;
+            epochConfiguration.m_totalEpochSizeInSamples = data.size() * 2 / 3; // epochs do not align with sweeps
+            epochConfiguration.m_epochIndex = epoch;
+            randomizer->StartEpoch(epochConfiguration);
+
+            for (;;)
+            {
+                Sequences sequences = randomizer->GetNextSequences(3);
+                if (sequences.m_endOfEpoch)
+                    break;
+                for (const auto& sequence : sequences.m_data.empty() ? vector<SequenceDataPtr>() : sequences.m_data[0])
+                    actual.push_back(*((float*)reinterpret_cast<DenseSequenceData&>(*sequence).m_data));
+            }
+        }
+        return actual;
+    };
+
+    for (size_t numberOfWorkers = 1; numberOfWorkers <= 2; numberOfWorkers++)
+    {
+        vector<float> expected = getAllSequences(0, 0, numberOfWorkers, 0);
+        BOOST_CHECK(!expected.empty());
+        for (size_t prefetchThreads = 1; prefetchThreads <= 4; prefetchThreads *= 2)
+        {
+            vector<float> actual = getAllSequences(prefetchThreads, 2 * prefetchThreads, numberOfWorkers, 0);
+            BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                          actual.begin(), actual.end());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochLegacyRandomization)
 {
     vector<float> data(10);
@@ -404,6 +456,307 @@ BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
                                   actual.begin(), actual.end());
 }
 
+BOOST_AUTO_TEST_CASE(SequenceEnumeratorResumeFromSamplePosition)
+{
+    vector<float> data(100);
+    iota(data.begin(), data.end(), 0.0f);
+
+    // The second epoch spans the end of the first sweep and the beginning of the second one.
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = 0;
+    epochConfiguration.m_totalEpochSizeInSamples = 60;
+    epochConfiguration.m_epochIndex = 1;
+
+    auto readToEnd = [](SequenceEnumeratorPtr enumerator)
+    {
+        vector<float> result;
+        for (;;)
+        {
+            Sequences sequences = enumerator->GetNextSequences(1);
+            if (!sequences.m_data.empty())
+            {
+                result.push_back(*((float*)sequences.m_data[0][0]->m_data));
+            }
+
+            if (sequences.m_endOfEpoch)
+            {
+                return result;
+            }
+        }
+    };
+
+    vector<function<SequenceEnumeratorPtr(IDataDeserializerPtr)>> factories =
+    {
+        [](IDataDeserializerPtr d) { return make_shared<BlockRandomizer>(0, 20, d, BlockRandomizer::DecimationMode::chunk, false); },
+        [](IDataDeserializerPtr d) { return make_shared<NoRandomizer>(d); },
+    };
+
+    for (const auto& factory : factories)
+    {
+        for (size_t numRead : { 0, 17, 45, 60 })
+        {
+            // Reads the first sequences of the epoch and continues from the position after them.
+            auto enumerator = factory(make_shared<MockDeserializer>(10, 10, data));
+            enumerator->StartEpoch(epochConfiguration);
+            for (size_t i = 0; i < numRead; i++)
+            {
+                enumerator->GetNextSequences(1);
+            }
+
+            size_t position = enumerator->GetCurrentSamplePosition();
+            BOOST_CHECK_EQUAL(position, 60 + numRead);
+            auto expected = readToEnd(enumerator);
+
+            // A fresh enumerator resumed from the position has to deliver the same sequences.
+            auto resumed = factory(make_shared<MockDeserializer>(10, 10, data));
+            resumed->StartEpoch(epochConfiguration);
+            resumed->SetCurrentSamplePosition(position);
+            auto actual = readToEnd(resumed);
+            BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                          actual.begin(), actual.end());
+
+            BOOST_CHECK_THROW(resumed->SetCurrentSamplePosition(59), std::invalid_argument);
+        }
+    }
+}
+
+// Returns sequences of the given lengths in order, filling up the requested number of samples the way the
+// randomizers do. All samples of sequence i have the value i.
+class MockSequenceEnumerator : public SequenceEnumerator
+{
+private:
+    vector<StreamDescriptionPtr> m_streams;
+    TensorShapePtr m_sampleLayout;
+    vector<vector<float>> m_sequenceData;
+    size_t m_position;
+    size_t m_samplePosition;
+
+public:
+    MockSequenceEnumerator(const vector<uint32_t>& lengths)
+        : m_sampleLayout(make_shared<TensorShape>(1)),
+          m_position(0),
+          m_samplePosition(0)
+    {
+        for (size_t i = 0; i < lengths.size(); i++)
+        {
+            m_sequenceData.push_back(vector<float>(lengths[i], (float)i));
+        }
+
+        m_streams.push_back(make_shared<StreamDescription>(StreamDescription{
+            L"input",
+            0,
+            StorageType::dense,
+            ElementType::tfloat,
+            m_sampleLayout
+        }));
+    }
+
+    vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+    void StartEpoch(const EpochConfiguration&) override
+    {
+        m_position = 0;
+        m_samplePosition = 0;
+    }
+
+    size_t GetCurrentSamplePosition() override
+    {
+        return m_samplePosition;
+    }
+
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override
+    {
+        m_position = 0;
+        m_samplePosition = 0;
+        while (m_samplePosition < currentSamplePosition)
+        {
+            m_samplePosition += m_sequenceData[m_position++].size();
+        }
+    }
+
+    Sequences GetNextSequences(size_t sampleCount) override
+    {
+        Sequences result;
+        size_t samples = 0;
+        while (m_position < m_sequenceData.size() &&
+               (samples == 0 || samples + m_sequenceData[m_position].size() <= sampleCount))
+        {
+            auto data = make_shared<DenseSequenceData>();
+            data->m_data = &m_sequenceData[m_position][0];
+            data->m_numberOfSamples = (uint32_t)m_sequenceData[m_position].size();
+            data->m_sampleLayout = m_sampleLayout;
+            if (result.m_data.empty())
+            {
+                result.m_data.resize(1);
+            }
+
+            result.m_data[0].push_back(data);
+            samples += m_sequenceData[m_position].size();
+            m_samplePosition += m_sequenceData[m_position].size();
+            m_position++;
+        }
+
+        result.m_endOfEpoch = m_position == m_sequenceData.size();
+        return result;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(SequencePackerBucketing)
+{
+    const size_t numSequences = 2000;
+    const size_t minibatchSize = 1000;
+    mt19937 rng(7);
+    uniform_int_distribution<uint32_t> lengthDistribution(1, 60);
+    vector<uint32_t> lengths(numSequences);
+    for (auto& length : lengths)
+    {
+        length = lengthDistribution(rng);
+    }
+
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = minibatchSize;
+    epochConfiguration.m_totalEpochSizeInSamples = accumulate(lengths.begin(), lengths.end(), (size_t)0);
+    epochConfiguration.m_epochIndex = 0;
+
+    // Every sequence must be packed exactly once, in one piece, into minibatches that respect the minibatch size.
+    auto packEpoch = [&](size_t bucketingLookahead) -> double
+    {
+        auto enumerator = make_shared<MockSequenceEnumerator>(lengths);
+        auto packer = make_shared<SequencePacker>(make_shared<HeapMemoryProvider>(), enumerator, enumerator->GetStreamDescriptions(), bucketingLookahead);
+        enumerator->StartEpoch(epochConfiguration);
+        packer->StartEpoch(epochConfiguration);
+
+        vector<size_t> timesPacked(numSequences, 0);
+        size_t numSamples = 0, numColumns = 0;
+        for (bool endOfEpoch = false; !endOfEpoch;)
+        {
+            Minibatch minibatch = packer->ReadMinibatch();
+            endOfEpoch = minibatch.m_endOfEpoch;
+            BOOST_REQUIRE_EQUAL(minibatch.m_data.size(), 1);
+            const auto& layout = minibatch.m_data[0]->m_layout;
+            const float* data = reinterpret_cast<const float*>(minibatch.m_data[0]->m_data);
+            size_t minibatchSamples = 0;
+            for (const auto& sequence : layout->GetAllSequences())
+            {
+                if (sequence.seqId == GAP_SEQUENCE_ID)
+                {
+                    continue;
+                }
+
+                size_t index = (size_t)data[layout->GetColumnIndex(sequence, 0)];
+                BOOST_REQUIRE_LT(index, numSequences);
+                BOOST_CHECK_EQUAL(sequence.GetNumTimeSteps(), lengths[index]);
+                for (size_t t = 0; t < sequence.GetNumTimeSteps(); t++)
+                {
+                    BOOST_CHECK_EQUAL(data[layout->GetColumnIndex(sequence, t)], (float)index);
+                }
+
+                timesPacked[index]++;
+                minibatchSamples += sequence.GetNumTimeSteps();
+            }
+
+            BOOST_CHECK(minibatchSamples <= minibatchSize || layout->GetNumSequences() == 1);
+            BOOST_CHECK_CLOSE(minibatch.GetPaddingEfficiency(), (double)minibatchSamples / layout->GetNumCols(), 1e-10);
+            numSamples += minibatchSamples;
+            numColumns += layout->GetNumCols();
+        }
+
+        BOOST_CHECK(all_of(timesPacked.begin(), timesPacked.end(), [](size_t n) { return n == 1; }));
+        BOOST_CHECK_EQUAL(numSamples, epochConfiguration.m_totalEpochSizeInSamples);
+        return (double)numSamples / numColumns;
+    };
+
+    double unbucketed = packEpoch(0);
+    double bucketed = packEpoch(8);
+    BOOST_CHECK_GT(bucketed, unbucketed);
+    BOOST_CHECK_GT(bucketed, 0.9);
+}
+
+BOOST_AUTO_TEST_CASE(SequencePackerBucketingResumeFromSamplePosition)
+{
+    const size_t numSequences = 500;
+    const size_t minibatchSize = 200;
+    mt19937 rng(11);
+    uniform_int_distribution<uint32_t> lengthDistribution(1, 30);
+    vector<uint32_t> lengths(numSequences);
+    for (auto& length : lengths)
+    {
+        length = lengthDistribution(rng);
+    }
+
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = minibatchSize;
+    epochConfiguration.m_totalEpochSizeInSamples = accumulate(lengths.begin(), lengths.end(), (size_t)0);
+    epochConfiguration.m_epochIndex = 0;
+
+    // Counts how often each sequence is packed into the minibatches read from the packer.
+    auto pack = [&](SequencePackerPtr packer, size_t maxMinibatches, vector<size_t>& timesPacked)
+    {
+        for (size_t i = 0; i < maxMinibatches; i++)
+        {
+            Minibatch minibatch = packer->ReadMinibatch();
+            if (!minibatch.m_data.empty())
+            {
+                const auto& layout = minibatch.m_data[0]->m_layout;
+                const float* data = reinterpret_cast<const float*>(minibatch.m_data[0]->m_data);
+                for (const auto& sequence : layout->GetAllSequences())
+                {
+                    if (sequence.seqId != GAP_SEQUENCE_ID)
+                    {
+                        timesPacked[(size_t)data[layout->GetColumnIndex(sequence, 0)]]++;
+                    }
+                }
+            }
+
+            if (minibatch.m_endOfEpoch)
+            {
+                return;
+            }
+        }
+    };
+
+    auto createPacker = [&](size_t bucketingLookahead)
+    {
+        auto enumerator = make_shared<MockSequenceEnumerator>(lengths);
+        auto packer = make_shared<SequencePacker>(make_shared<HeapMemoryProvider>(), enumerator, enumerator->GetStreamDescriptions(), bucketingLookahead);
+        enumerator->StartEpoch(epochConfiguration);
+        packer->StartEpoch(epochConfiguration);
+        return packer;
+    };
+
+    for (size_t bucketingLookahead : { 0, 4 })
+    {
+        auto packer = createPacker(bucketingLookahead);
+        vector<size_t> timesPacked(numSequences, 0);
+        pack(packer, 10, timesPacked);
+        size_t position = packer->GetCurrentSamplePosition();
+
+        // No sequence may be lost when resuming; without bucketing none is packed twice either.
+        auto resumed = createPacker(bucketingLookahead);
+        resumed->SetCurrentSamplePosition(position);
+        vector<size_t> timesPackedAfterResume(numSequences, 0);
+        pack(resumed, SIZE_MAX, timesPackedAfterResume);
+        for (size_t i = 0; i < numSequences; i++)
+        {
+            BOOST_CHECK_LE(timesPackedAfterResume[i], 1u);
+            BOOST_CHECK_GE(timesPacked[i] + timesPackedAfterResume[i], 1u);
+            if (bucketingLookahead == 0)
+            {
+                BOOST_CHECK_EQUAL(timesPacked[i] + timesPackedAfterResume[i], 1u);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(DefaultCorpusDescriptor)
 {
     const int seed = 13;